@@ -28,7 +28,10 @@ check_znver_1_2() {
 
 # Set the file CPU x86_64 architecture
 set_arch_x86_64() {
-  if check_flags 'avx512vnni' 'avx512dq' 'avx512f' 'avx512bw' 'avx512vl'; then
+  if check_flags 'avx512vbmi2' 'avx512vbmi' 'avx512ifma' 'avx512vpopcntdq' 'avx512bitalg' 'avx512vnni' 'avx512dq' 'avx512f' 'avx512bw' 'avx512vl'; then
+    true_arch='x86-64-avx512icl'
+    file_arch='x86-64-vnni256'
+  elif check_flags 'avx512vnni' 'avx512dq' 'avx512f' 'avx512bw' 'avx512vl'; then
     true_arch='x86-64-vnni256'
   elif check_flags 'avx512f' 'avx512bw'; then
     true_arch='x86-64-avx512'
@@ -58,7 +61,7 @@ case $uname_s in
       'x86_64')
         flags=$(sysctl -n machdep.cpu.features machdep.cpu.leaf7_features | tr '\n' ' ' | tr '[:upper:]' '[:lower:]' | tr -d '_.')
         set_arch_x86_64
-        if [ "$true_arch" = 'x86-64-vnni256' ] || [ "$true_arch" = 'x86-64-avx512' ]; then
+        if [ "$true_arch" = 'x86-64-avx512icl' ] || [ "$true_arch" = 'x86-64-vnni256' ] || [ "$true_arch" = 'x86-64-avx512' ]; then
            file_arch='x86-64-bmi2'
         fi
         ;;
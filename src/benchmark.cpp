@@ -18,11 +18,21 @@
 
 #include "benchmark.h"
 
+#include <chrono>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <vector>
 
+#include "misc.h"
+#include "movegen.h"
+#include "nnue/network.h"
+#include "nnue/nnue_accumulator.h"
+#include "position.h"
+#include "tt.h"
+
 namespace {
 
 // clang-format off
@@ -86,6 +96,81 @@ const std::vector<std::string> Defaults = {
 };
 // clang-format on
 
+using namespace Stockfish;
+
+// Every section is repeated until it has run for at least this long
+constexpr auto MinSectionTime = std::chrono::milliseconds(200);
+
+// Runs a pass over the positions until MinSectionTime is reached. The pass
+// returns the number of operations it did.
+template<typename Pass>
+Benchmark::MicroResult time_section(const char* name, Pass&& pass) {
+
+    using Clock = std::chrono::steady_clock;
+
+    std::uint64_t   ops   = 0;
+    const auto      start = Clock::now();
+    Clock::duration elapsed;
+
+    do
+    {
+        ops += pass();
+        elapsed = Clock::now() - start;
+    } while (elapsed < MinSectionTime);
+
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    return {name, ops, double(ns) / double(ops)};
+}
+
+// Looks for two quiet moves, one of each side, that can be played and then
+// taken back, returning to the same position after four plies.
+std::vector<Move> find_repetition(Position& pos) {
+
+    auto quiet = [&](Move m) {
+        return !pos.capture(m) && type_of(pos.moved_piece(m)) != PAWN && !pos.gives_check(m);
+    };
+
+    StateInfo st[3];
+
+    for (const auto& m1 : MoveList<LEGAL>(pos))
+    {
+        if (!quiet(m1))
+            continue;
+
+        pos.do_move(m1, st[0]);
+
+        for (const auto& m2 : MoveList<LEGAL>(pos))
+        {
+            if (!quiet(m2))
+                continue;
+
+            const Move back1(m1.to_sq(), m1.from_sq()), back2(m2.to_sq(), m2.from_sq());
+
+            pos.do_move(m2, st[1]);
+            bool found = MoveList<LEGAL>(pos).contains(back1) && quiet(back1);
+
+            if (found)
+            {
+                pos.do_move(back1, st[2]);
+                found = MoveList<LEGAL>(pos).contains(back2) && quiet(back2);
+                pos.undo_move(back1);
+            }
+
+            pos.undo_move(m2);
+
+            if (found)
+            {
+                pos.undo_move(m1);
+                return {m1, m2, back1, back2};
+            }
+        }
+
+        pos.undo_move(m1);
+    }
+
+    return {};
+}
+
 }  // namespace
 
 namespace Stockfish::Benchmark {
@@ -155,4 +240,182 @@ std::vector<std::string> setup_bench(const std::string& currentFen, std::istream
     return list;
 }
 
+// Times the hot paths of the engine separately, over the default bench
+// positions. The NNUE sections measure an accumulator refresh from the cache,
+// an incremental update after a move (including the move itself), and the
+// output layers alone on an already computed accumulator.
+std::vector<MicroResult> run_microbench(const Eval::NNUE::Network& network, ThreadPool& threads) {
+
+    std::vector<MicroResult> results;
+    std::deque<StateInfo>    states(Defaults.size());
+    std::vector<Position>    positions(Defaults.size());
+    volatile std::uint64_t   sink = 0;
+
+    for (size_t i = 0; i < Defaults.size(); ++i)
+        positions[i].set(Defaults[i], &states[i]);
+
+    results.push_back(time_section("movegen_pseudo_legal", [&] {
+        for (const Position& pos : positions)
+            sink = sink + MoveList<PSEUDO_LEGAL>(pos).size();
+        return positions.size();
+    }));
+
+    results.push_back(time_section("movegen_legal", [&] {
+        for (const Position& pos : positions)
+            sink = sink + MoveList<LEGAL>(pos).size();
+        return positions.size();
+    }));
+
+    results.push_back(time_section("do_undo_move", [&] {
+        std::uint64_t ops = 0;
+        StateInfo     st;
+        for (Position& pos : positions)
+            for (const auto& m : MoveList<LEGAL>(pos))
+            {
+                pos.do_move(m, st);
+                pos.undo_move(m);
+                ++ops;
+            }
+        return ops;
+    }));
+
+    results.push_back(time_section("attackers_to", [&] {
+        Bitboard b = 0;
+        for (const Position& pos : positions)
+            for (Square s = SQ_A0; s <= SQ_I9; ++s)
+                b |= pos.attackers_to(s);
+        sink = sink + std::uint64_t(b);
+        return positions.size() * SQUARE_NB;
+    }));
+
+    // Text and binary round trips, into a scratch position
+    auto      scratch = std::make_unique<Position>();
+    StateInfo scratchState;
+
+    std::vector<std::string> fens;
+    for (const Position& pos : positions)
+        fens.push_back(pos.fen());
+
+    results.push_back(time_section("fen_parse", [&] {
+        for (const std::string& fen : fens)
+            sink = sink + scratch->set(fen, &scratchState).key();
+        return fens.size();
+    }));
+
+    results.push_back(time_section("fen_write", [&] {
+        char buffer[Position::MaxFenLength];
+        for (const Position& pos : positions)
+            sink = sink + pos.fen(buffer);
+        return positions.size();
+    }));
+
+    results.push_back(time_section("pack_unpack", [&] {
+        for (const Position& pos : positions)
+            sink = sink + scratch->set(pos.pack(), &scratchState).key();
+        return positions.size();
+    }));
+
+    // Repeat each position after four quiet plies, so that rule_judge() runs
+    // the chase detection, which is most of its work.
+    std::deque<StateInfo> repetitionStates;
+    std::vector<Move>     repetitionMoves;
+    std::vector<size_t>   repeated;
+
+    for (size_t i = 0; i < positions.size(); ++i)
+        if (auto cycle = find_repetition(positions[i]); !cycle.empty())
+        {
+            for (Move m : cycle)
+                positions[i].do_move(m, repetitionStates.emplace_back());
+
+            repetitionMoves.insert(repetitionMoves.end(), cycle.begin(), cycle.end());
+            repeated.push_back(i);
+        }
+
+    // The states cache the chased squares, so they are dropped on every pass,
+    // which then times their detection again rather than the cache.
+    results.push_back(time_section("rule_judge", [&] {
+        for (auto* list : {&states, &repetitionStates})
+            for (StateInfo& st : *list)
+                st.chasedReady[WHITE] = st.chasedReady[BLACK] = false;
+
+        Value result;
+        for (size_t i : repeated)
+            sink = sink + positions[i].rule_judge(result, 5);
+        return repeated.size();
+    }));
+
+    for (size_t n = repeated.size(); n-- > 0;)
+        for (int j = 3; j >= 0; --j)
+            positions[repeated[n]].undo_move(repetitionMoves[4 * n + j]);
+
+    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>();
+    auto caches       = std::make_unique<Eval::NNUE::AccumulatorCaches>(network);
+
+    auto evaluate = [&](const Position& pos) {
+        auto [psqt, positional] = network.evaluate(pos, *accumulators, &caches->cache);
+        sink                    = sink + std::uint64_t(psqt + positional);
+    };
+
+    results.push_back(time_section("nnue_refresh", [&] {
+        for (const Position& pos : positions)
+        {
+            accumulators->reset();
+            evaluate(pos);
+        }
+        return positions.size();
+    }));
+
+    results.push_back(time_section("nnue_incremental", [&] {
+        std::uint64_t ops = 0;
+        StateInfo     st;
+        for (Position& pos : positions)
+        {
+            accumulators->reset();
+            evaluate(pos);
+
+            for (const auto& m : MoveList<LEGAL>(pos))
+            {
+                pos.do_move(m, st);
+                accumulators->push();
+                if (!pos.checkers())
+                {
+                    evaluate(pos);
+                    ++ops;
+                }
+                accumulators->pop();
+                pos.undo_move(m);
+            }
+        }
+        return ops;
+    }));
+
+    results.push_back(time_section("nnue_propagate", [&] {
+        for (const Position& pos : positions)
+        {
+            accumulators->reset();
+            evaluate(pos);
+            for (int i = 0; i < 8; ++i)
+                evaluate(pos);
+        }
+        return 8 * positions.size();
+    }));
+
+    TranspositionTable tt;
+    tt.resize(16, threads, false);
+
+    results.push_back(time_section("tt_probe_write", [&] {
+        PRNG rng(1070372);
+        for (int i = 0; i < 100000; ++i)
+        {
+            const Key key                  = rng.rand<Key>();
+            auto [ttHit, ttData, ttWriter] = tt.probe(key);
+            ttWriter.write(key, ttHit ? ttData.value : VALUE_ZERO, false, BOUND_LOWER,
+                           Depth(key & 15), Move::none(), VALUE_ZERO, tt.generation());
+        }
+        return 100000;
+    }));
+
+    return results;
+}
+
 }  // namespace Stockfish
@@ -19,14 +19,39 @@
 #ifndef BENCHMARK_H_INCLUDED
 #define BENCHMARK_H_INCLUDED
 
+#include <cstdint>
+#include <functional>
 #include <iosfwd>
 #include <string>
+#include <string_view>
 #include <vector>
 
-namespace Stockfish::Benchmark {
+namespace Stockfish {
+
+class ThreadPool;
+
+namespace Eval::NNUE {
+class Network;
+}
+
+namespace Benchmark {
 
 std::vector<std::string> setup_bench(const std::string&, std::istream&);
 
+// The timing of one hot path, see run_microbench()
+struct MicroResult {
+    std::string   name;
+    std::uint64_t ops;
+    double        nsPerOp;
+};
+
+std::vector<MicroResult> run_microbench(const Eval::NNUE::Network& network, ThreadPool& threads);
+
+// Gets each root move of a perft in UCI format with the leaf count of its subtree
+using PerftCallback = std::function<void(std::string_view, std::uint64_t)>;
+
+}  // namespace Benchmark
+
 }  // namespace Stockfish
 
 #endif  // #ifndef BENCHMARK_H_INCLUDED
@@ -0,0 +1,286 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "binary.h"
+
+#include <algorithm>
+#include <istream>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+#include "score.h"
+#include "uci.h"
+
+namespace Stockfish::Binary {
+
+namespace {
+
+constexpr uint32_t MaxFrameSize = 1 << 20;
+
+// Appends little-endian integers to a frame under construction
+class Writer {
+   public:
+    explicit Writer(MessageType type) { put<uint32_t>(0), put<uint8_t>(uint8_t(type)); }
+
+    template<typename T>
+    void put(T value) {
+        static_assert(std::is_integral_v<T>);
+        for (size_t i = 0; i < sizeof(T); ++i)
+            buf.push_back(char(uint64_t(value) >> (8 * i)));
+    }
+
+    void put(Move m) { put<uint16_t>(m.raw()); }
+
+    void put(const Score& s) {
+        const bool isMate = s.is<Score::Mate>();
+        put<uint8_t>(isMate);
+        put<int32_t>(isMate ? s.get<Score::Mate>().plies : s.get<Score::InternalUnits>().value);
+    }
+
+    void put(std::string_view str) {
+        put<uint16_t>(uint16_t(std::min<size_t>(str.size(), std::numeric_limits<uint16_t>::max())));
+        buf.append(str.substr(0, std::numeric_limits<uint16_t>::max()));
+    }
+
+    // Fills in the size and returns the frame
+    std::string finish() {
+        const uint32_t size = uint32_t(buf.size() - sizeof(uint32_t));
+        for (size_t i = 0; i < sizeof(uint32_t); ++i)
+            buf[i] = char(size >> (8 * i));
+        return std::move(buf);
+    }
+
+   private:
+    std::string buf;
+};
+
+// Reads little-endian integers from a frame body. Reading past the end
+// returns zeros and clears ok.
+class Reader {
+   public:
+    explicit Reader(const std::string& body) :
+        buf(body) {}
+
+    template<typename T>
+    T get() {
+        static_assert(std::is_integral_v<T>);
+        if (pos + sizeof(T) > buf.size())
+        {
+            ok  = false;
+            pos = buf.size();
+            return T(0);
+        }
+
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+            value |= uint64_t(uint8_t(buf[pos++])) << (8 * i);
+        return T(value);
+    }
+
+    // Only moves between two squares of the board are accepted
+    Move get_move() {
+        const Move m(get<uint16_t>());
+        if ((m.raw() >> 7) >= SQUARE_NB || (m.raw() & 0x7F) >= SQUARE_NB || m.raw() >> 14)
+            ok = false;
+        return m;
+    }
+
+    std::vector<Move> get_moves() {
+        std::vector<Move> moves(get<uint16_t>());
+        for (Move& m : moves)
+            m = get_move();
+        return moves;
+    }
+
+    std::string get_string() {
+        const size_t size = get<uint16_t>();
+        if (pos + size > buf.size())
+        {
+            ok = false;
+            return {};
+        }
+
+        pos += size;
+        return buf.substr(pos - size, size);
+    }
+
+    // True if everything was read, and nothing was left over
+    bool done() const { return ok && pos == buf.size(); }
+
+    bool ok = true;
+
+   private:
+    const std::string& buf;
+    size_t             pos = 0;
+};
+
+Square parse_square(std::string_view str) {
+    return make_square(File(str[0] - 'a'), Rank(str[1] - '0'));
+}
+
+// The bestmove of the search comes in UCI notation
+Move parse_move(std::string_view str) {
+    if (str.size() != 4 || str[0] < 'a' || str[0] > 'i' || str[2] < 'a' || str[2] > 'i'
+        || str[1] < '0' || str[1] > '9' || str[3] < '0' || str[3] > '9')
+        return Move::none();
+
+    return Move(parse_square(str.substr(0, 2)), parse_square(str.substr(2, 2)));
+}
+
+}  // namespace
+
+bool read_frame(std::istream& is, MessageType& type, std::string& body) {
+
+    unsigned char header[5];
+    if (!is.read(reinterpret_cast<char*>(header), sizeof(header)))
+        return false;
+
+    const uint32_t size = header[0] | header[1] << 8 | header[2] << 16 | uint32_t(header[3]) << 24;
+    if (size == 0 || size > MaxFrameSize)
+        return false;
+
+    type = MessageType(header[4]);
+    body.resize(size - 1);
+
+    return bool(is.read(body.data(), std::streamsize(body.size())));
+}
+
+bool decode_position(const std::string& body, PositionData& data) {
+    Reader r(body);
+
+    data.sideToMove = Color(r.get<uint8_t>());
+    data.rule60     = r.get<uint16_t>();
+    data.gamePly    = r.get<uint16_t>();
+
+    for (int s = SQ_A0; s < SQUARE_NB; s += 2)
+    {
+        const uint8_t b   = r.get<uint8_t>();
+        data.board[s]     = Piece(b & 0xF);
+        data.board[s + 1] = Piece(b >> 4);
+    }
+
+    data.moves = r.get_moves();
+
+    return r.done() && data.sideToMove <= BLACK && data.rule60 <= 120
+        && Position::is_valid(data.board, data.sideToMove);
+}
+
+bool decode_limits(const std::string& body, Search::LimitsType& limits) {
+    Reader r(body);
+
+    limits.time[WHITE] = r.get<int64_t>();
+    limits.time[BLACK] = r.get<int64_t>();
+    limits.inc[WHITE]  = r.get<int64_t>();
+    limits.inc[BLACK]  = r.get<int64_t>();
+    limits.movetime    = r.get<int64_t>();
+    limits.movestogo   = r.get<int32_t>();
+    limits.depth       = r.get<int32_t>();
+    limits.mate        = r.get<int32_t>();
+    limits.nodes       = r.get<uint64_t>();
+
+    const uint8_t flags = r.get<uint8_t>();
+    limits.infinite     = flags & 1;
+    limits.ponderMode   = flags & 2;
+
+    for (Move m : r.get_moves())
+        limits.searchmoves.push_back(UCIEngine::move(m));
+
+    return r.done();
+}
+
+bool decode_option(const std::string& body, std::string& name, std::string& value) {
+    Reader r(body);
+
+    name  = r.get_string();
+    value = r.get_string();
+
+    return r.done();
+}
+
+std::string encode_info(const Search::InfoFull& info) {
+    Writer w(MessageType::Info);
+
+    w.put<int32_t>(info.depth);
+    w.put<int32_t>(info.selDepth);
+    w.put<uint32_t>(uint32_t(info.multiPV));
+    w.put(info.score);
+
+    int                wdl[3] = {};
+    std::istringstream ss{std::string(info.wdl)};
+    const bool         hasWdl = !info.wdl.empty() && (ss >> wdl[0] >> wdl[1] >> wdl[2]);
+
+    w.put<uint8_t>((info.bound == "lowerbound") | (info.bound == "upperbound") << 1
+                   | hasWdl << 2);
+    for (int v : wdl)
+        w.put<uint16_t>(uint16_t(v));
+
+    w.put<uint64_t>(info.nodes);
+    w.put<uint64_t>(info.nps);
+    w.put<uint64_t>(info.tbHits);
+    w.put<uint64_t>(info.timeMs);
+    w.put<int32_t>(info.hashfull);
+
+    w.put<uint16_t>(uint16_t(info.pvMoves->size()));
+    for (Move m : *info.pvMoves)
+        w.put(m);
+
+    return w.finish();
+}
+
+std::string encode_info(const Search::InfoShort& info) {
+    Writer w(MessageType::InfoShort);
+
+    w.put<int32_t>(info.depth);
+    w.put(info.score);
+
+    return w.finish();
+}
+
+std::string encode_iter(const Search::InfoIteration& info) {
+    Writer w(MessageType::CurrMove);
+
+    w.put<int32_t>(info.depth);
+    w.put(parse_move(info.currmove));
+    w.put<uint32_t>(uint32_t(info.currmovenumber));
+
+    return w.finish();
+}
+
+std::string encode_bestmove(std::string_view bestmove, std::string_view ponder) {
+    Writer w(MessageType::BestMove);
+
+    w.put(parse_move(bestmove));
+    w.put(parse_move(ponder));
+
+    return w.finish();
+}
+
+std::string encode_string(MessageType type, std::string_view str) {
+    Writer w(type);
+
+    w.put(str);
+
+    return w.finish();
+}
+
+std::string encode(MessageType type) { return Writer(type).finish(); }
+
+}  // namespace Stockfish::Binary
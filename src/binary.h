@@ -0,0 +1,91 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BINARY_H_INCLUDED
+#define BINARY_H_INCLUDED
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search.h"
+#include "types.h"
+
+namespace Stockfish::Binary {
+
+// A compact framed protocol for analysis clients, entered with the 'binary'
+// command. It carries the same data as UCI without text parsing or formatting.
+//
+// All integers are little-endian. Each frame is a uint32 with the size of what
+// follows, a uint8 message type, then the body. Strings are a uint16 size then
+// the bytes. Moves are the uint16 of the internal Move, i.e. from * 128 + to with
+// squares numbered a0 = 0, b0 = 1, ... i9 = 89. A board is 90 pieces, two per
+// byte, low nibble first, from a0 to i9, using the Piece values of types.h.
+enum class MessageType : uint8_t {
+    // Client to engine
+    Position  = 0x01,  // u8 side to move, u16 rule60, u16 game ply, board, u16 n, n moves
+    Go        = 0x02,  // i64 wtime btime winc binc movetime, i32 movestogo depth mate,
+                       // u64 nodes, u8 flags (1 infinite, 2 ponder), u16 n, n searchmoves
+    Stop      = 0x03,
+    PonderHit = 0x04,
+    IsReady   = 0x05,
+    NewGame   = 0x06,
+    SetOption = 0x07,  // string name, string value
+    Quit      = 0x08,
+
+    // Engine to client
+    ReadyOk    = 0x81,
+    Info       = 0x82,  // i32 depth seldepth, u32 multipv, score, u8 flags (1 lowerbound,
+                        // 2 upperbound, 4 wdl), u16 win draw loss, u64 nodes nps tbhits time,
+                        // i32 hashfull, u16 n, n pv moves
+    InfoShort  = 0x83,  // i32 depth, score
+    CurrMove   = 0x84,  // i32 depth, move, u32 currmovenumber
+    BestMove   = 0x85,  // move, ponder move, Move::none() if there is none
+    InfoString = 0x86,  // string
+};
+// A score is a u8 kind (0 for internal units, 1 for mate in plies) and an i32 value.
+
+struct PositionData {
+    Piece             board[SQUARE_NB];
+    Color             sideToMove;
+    int               rule60, gamePly;
+    std::vector<Move> moves;
+};
+
+// Reads the next frame, false at the end of the input or on a malformed frame
+bool read_frame(std::istream& is, MessageType& type, std::string& body);
+
+// Return false if the body is malformed
+bool decode_position(const std::string& body, PositionData& data);
+bool decode_limits(const std::string& body, Search::LimitsType& limits);
+bool decode_option(const std::string& body, std::string& name, std::string& value);
+
+// Whole frames, ready to be written
+std::string encode_info(const Search::InfoFull& info);
+std::string encode_info(const Search::InfoShort& info);
+std::string encode_iter(const Search::InfoIteration& info);
+std::string encode_bestmove(std::string_view bestmove, std::string_view ponder);
+std::string encode_string(MessageType type, std::string_view str);
+std::string encode(MessageType type);  // For the messages without a body
+
+}  // namespace Stockfish::Binary
+
+#endif  // #ifndef BINARY_H_INCLUDED
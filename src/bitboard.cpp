@@ -19,157 +19,64 @@
 #include "bitboard.h"
 
 #include <algorithm>
-#include <bitset>
 #include <initializer_list>
 
-#include <set>
-#include <utility>
 #include "magics.h"
 
-namespace Stockfish {
-
-uint8_t PopCnt16[1 << 16];
-uint8_t SquareDistance[SQUARE_NB][SQUARE_NB];
-
-Bitboard SquareBB[SQUARE_NB];
-Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
-Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-Bitboard PawnAttacksTo[COLOR_NB][SQUARE_NB];
+// All the tables are computed at compile time and end up in read-only data, so
+// there is nothing to initialize at startup and the pages are shared between all
+// the processes running the engine.
 
-Magic RookMagics[SQUARE_NB];
-Magic CannonMagics[SQUARE_NB];
-Magic BishopMagics[SQUARE_NB];
-Magic KnightMagics[SQUARE_NB];
-Magic KnightToMagics[SQUARE_NB];
+namespace Stockfish {
 
 namespace {
 
-Bitboard RookTable[0x108000];    // To store rook attacks
-Bitboard CannonTable[0x108000];  // To store cannon attacks
-Bitboard BishopTable[0x228];     // To store bishop attacks
-Bitboard KnightTable[0x380];     // To store knight attacks
-Bitboard KnightToTable[0x3E0];   // To store by knight attacks
+constexpr Direction KnightDirections[] = {2 * SOUTH + WEST, 2 * SOUTH + EAST, SOUTH + 2 * WEST,
+                                          SOUTH + 2 * EAST, NORTH + 2 * WEST, NORTH + 2 * EAST,
+                                          2 * NORTH + WEST, 2 * NORTH + EAST};
+constexpr Direction BishopDirections[] = {2 * NORTH_EAST, 2 * SOUTH_EAST, 2 * SOUTH_WEST,
+                                          2 * NORTH_WEST};
 
-const std::set<Direction> KnightDirections{2 * SOUTH + WEST, 2 * SOUTH + EAST, SOUTH + 2 * WEST,
-                                           SOUTH + 2 * EAST, NORTH + 2 * WEST, NORTH + 2 * EAST,
-                                           2 * NORTH + WEST, 2 * NORTH + EAST};
-const std::set<Direction> BishopDirections{2 * NORTH_EAST, 2 * SOUTH_EAST, 2 * SOUTH_WEST,
-                                           2 * NORTH_WEST};
+// Compile time versions of square_bb(), distance() and popcount(), which rely
+// on the tables being built here.
+constexpr Bitboard make_bb(Square s) { return Bitboard(1) << s; }
 
+constexpr int abs(int x) { return x < 0 ? -x : x; }
 
-template<PieceType pt>
-void init_magics(Bitboard table[], Magic magics[], const Bitboard magicsInit[]);
+constexpr int square_distance(Square x, Square y) {
+    return std::max(abs(file_of(x) - file_of(y)), abs(rank_of(x) - rank_of(y)));
+}
 
-template<PieceType pt>
-Bitboard lame_leaper_path(Direction d, Square s);
+constexpr int count_bits(Bitboard b) {
+    int n = 0;
+    for (; b; b &= b - 1)
+        ++n;
+    return n;
+}
 
 // Returns the bitboard of target square for the given step
 // from the given square. If the step is off the board, returns empty bitboard.
-Bitboard safe_destination(Square s, int step) {
+constexpr Bitboard safe_destination(Square s, int step) {
     Square to = Square(s + step);
-    return is_ok(to) && distance(s, to) <= 2 ? square_bb(to) : Bitboard(0);
-}
-
-}
-
-// Returns an ASCII representation of a bitboard suitable
-// to be printed to standard output. Useful for debugging.
-std::string Bitboards::pretty(Bitboard b) {
-
-    std::string s = "+---+---+---+---+---+---+---+---+---+\n";
-
-    for (Rank r = RANK_9; r >= RANK_0; --r)
-    {
-        for (File f = FILE_A; f <= FILE_I; ++f)
-            s += b & make_square(f, r) ? "| X " : "|   ";
-
-        s += "| " + std::to_string(r) + "\n+---+---+---+---+---+---+---+---+---+\n";
-    }
-    s += "  a   b   c   d   e   f   g   h   i\n";
-
-    return s;
+    return is_ok(to) && square_distance(s, to) <= 2 ? make_bb(to) : Bitboard(0);
 }
 
-
-// Initializes various bitboard tables. It is called at
-// startup and relies on global objects to be already zero-initialized.
-void Bitboards::init() {
-
-    for (unsigned i = 0; i < (1 << 16); ++i)
-        PopCnt16[i] = uint8_t(std::bitset<16>(i).count());
-
-    for (Square s = SQ_A0; s <= SQ_I9; ++s)
-        SquareBB[s] = (Bitboard(1ULL) << std::uint8_t(s));
-
-    for (Square s1 = SQ_A0; s1 <= SQ_I9; ++s1)
-        for (Square s2 = SQ_A0; s2 <= SQ_I9; ++s2)
-            SquareDistance[s1][s2] = std::max(distance<File>(s1, s2), distance<Rank>(s1, s2));
-
-    init_magics<ROOK>(RookTable, RookMagics, RookMagicsInit);
-    init_magics<CANNON>(CannonTable, CannonMagics, RookMagicsInit);
-    init_magics<BISHOP>(BishopTable, BishopMagics, BishopMagicsInit);
-    init_magics<KNIGHT>(KnightTable, KnightMagics, KnightMagicsInit);
-    init_magics<KNIGHT_TO>(KnightToTable, KnightToMagics, KnightToMagicsInit);
-
-    for (Square s1 = SQ_A0; s1 <= SQ_I9; ++s1)
-    {
-        PawnAttacks[WHITE][s1] = pawn_attacks_bb<WHITE>(s1);
-        PawnAttacks[BLACK][s1] = pawn_attacks_bb<BLACK>(s1);
-
-        PawnAttacksTo[WHITE][s1] = pawn_attacks_to_bb<WHITE>(s1);
-        PawnAttacksTo[BLACK][s1] = pawn_attacks_to_bb<BLACK>(s1);
-
-        PseudoAttacks[ROOK][s1]   = attacks_bb<ROOK>(s1, 0);
-        PseudoAttacks[BISHOP][s1] = attacks_bb<BISHOP>(s1, 0);
-        PseudoAttacks[KNIGHT][s1] = attacks_bb<KNIGHT>(s1, 0);
-
-        // Only generate pseudo attacks in the palace squares for king and advisor
-        if (Palace & s1)
-        {
-            for (int step : {NORTH, SOUTH, WEST, EAST})
-                PseudoAttacks[KING][s1] |= safe_destination(s1, step);
-            PseudoAttacks[KING][s1] &= Palace;
-
-            for (int step : {NORTH_WEST, NORTH_EAST, SOUTH_WEST, SOUTH_EAST})
-                PseudoAttacks[ADVISOR][s1] |= safe_destination(s1, step);
-            PseudoAttacks[ADVISOR][s1] &= Palace;
-        }
-
-        for (Square s2 = SQ_A0; s2 <= SQ_I9; ++s2)
-        {
-            if (PseudoAttacks[ROOK][s1] & s2)
-            {
-                LineBB[s1][s2] = (attacks_bb(ROOK, s1, 0) & attacks_bb(ROOK, s2, 0)) | s1 | s2;
-                BetweenBB[s1][s2] =
-                  (attacks_bb(ROOK, s1, square_bb(s2)) & attacks_bb(ROOK, s2, square_bb(s1)));
-            }
-
-            if (PseudoAttacks[KNIGHT][s1] & s2)
-                BetweenBB[s1][s2] |= lame_leaper_path<KNIGHT_TO>(Direction(s2 - s1), s1);
-
-            BetweenBB[s1][s2] |= s2;
-        }
-    }
-}
-
-namespace {
-
+// Returns the attacks of a rook or cannon on the i-th square of a line of n
+// squares, both the line occupancy and the attacks being bit masks of the line.
 template<PieceType pt>
-Bitboard sliding_attack(Square sq, Bitboard occupied) {
-    assert(pt == ROOK || pt == CANNON);
-    Bitboard attack = 0;
+constexpr unsigned line_attack(int i, int n, unsigned occupied) {
+    static_assert(pt == ROOK || pt == CANNON);
+    unsigned attack = 0;
 
-    for (auto const& d : {NORTH, SOUTH, EAST, WEST})
+    for (int d : {-1, 1})
     {
         bool hurdle = false;
-        for (Square s = sq + d; is_ok(s) && distance(s - d, s) == 1; s += d)
+        for (int j = i + d; j >= 0 && j < n; j += d)
         {
             if (pt == ROOK || hurdle)
-                attack |= s;
+                attack |= 1U << j;
 
-            if (occupied & s)
+            if (occupied & (1U << j))
             {
                 if (pt == CANNON && !hurdle)
                     hurdle = true;
@@ -182,24 +89,34 @@ Bitboard sliding_attack(Square sq, Bitboard occupied) {
     return attack;
 }
 
+// Returns the squares of the given file on the ranks set in the given mask
+constexpr Bitboard file_squares(File f, unsigned ranks) {
+    Bitboard b = 0;
+    for (Rank r = RANK_0; r <= RANK_9; ++r)
+        if (ranks & (1U << r))
+            b |= make_bb(make_square(f, r));
+    return b;
+}
+
 template<PieceType pt>
-Bitboard lame_leaper_path(Direction d, Square s) {
-    Bitboard b  = 0;
-    Square   to = s + d;
-    if (!is_ok(to) || distance(s, to) >= 4)
-        return b;
+constexpr Bitboard lame_leaper_path(Direction d, Square s) {
+    Square to = s + d;
+    if (!is_ok(to) || square_distance(s, to) >= 4)
+        return 0;
 
     // If piece type is by knight attacks, swap the source and destination square
     if (pt == KNIGHT_TO)
     {
-        std::swap(s, to);
-        d = -d;
+        Square tmp = s;
+        s          = to;
+        to         = tmp;
+        d          = -d;
     }
 
     Direction dr = d > 0 ? NORTH : SOUTH;
-    Direction df = (std::abs(d % NORTH) < NORTH / 2 ? d % NORTH : -(d % NORTH)) < 0 ? WEST : EAST;
+    Direction df = (abs(d % NORTH) < NORTH / 2 ? d % NORTH : -(d % NORTH)) < 0 ? WEST : EAST;
 
-    int diff = std::abs(file_of(to) - file_of(s)) - std::abs(rank_of(to) - rank_of(s));
+    int diff = abs(file_of(to) - file_of(s)) - abs(rank_of(to) - rank_of(s));
     if (diff > 0)
         s += df;
     else if (diff < 0)
@@ -207,14 +124,21 @@ Bitboard lame_leaper_path(Direction d, Square s) {
     else
         s += df + dr;
 
-    b |= s;
-    return b;
+    return make_bb(s);
 }
 
 template<PieceType pt>
-Bitboard lame_leaper_path(Square s) {
+constexpr const auto& leaper_directions() {
+    if constexpr (pt == BISHOP)
+        return BishopDirections;
+    else
+        return KnightDirections;
+}
+
+template<PieceType pt>
+constexpr Bitboard lame_leaper_path(Square s) {
     Bitboard b = 0;
-    for (const auto& d : pt == BISHOP ? BishopDirections : KnightDirections)
+    for (Direction d : leaper_directions<pt>())
         b |= lame_leaper_path<pt>(d, s);
     if (pt == BISHOP)
         b &= HalfBB[rank_of(s) > RANK_4];
@@ -222,13 +146,13 @@ Bitboard lame_leaper_path(Square s) {
 }
 
 template<PieceType pt>
-Bitboard lame_leaper_attack(Square s, Bitboard occupied) {
+constexpr Bitboard lame_leaper_attack(Square s, Bitboard occupied) {
     Bitboard b = 0;
-    for (const auto& d : pt == BISHOP ? BishopDirections : KnightDirections)
+    for (Direction d : leaper_directions<pt>())
     {
         Square to = s + d;
-        if (is_ok(to) && distance(s, to) < 4 && !(lame_leaper_path<pt>(d, s) & occupied))
-            b |= to;
+        if (is_ok(to) && square_distance(s, to) < 4 && !(lame_leaper_path<pt>(d, s) & occupied))
+            b |= make_bb(to);
     }
     if (pt == BISHOP)
         b &= HalfBB[rank_of(s) > RANK_4];
@@ -236,56 +160,250 @@ Bitboard lame_leaper_attack(Square s, Bitboard occupied) {
 }
 
 
-// Computes all rook and bishop attacks at startup. Magic
-// bitboards are used to look up attacks of sliding pieces. As a reference see
-// www.chessprogramming.org/Magic_Bitboards. In particular, here we use the so
-// called "fancy" approach.
+// Computes the mask, magic and shift of the given square. Board edges are not
+// considered in the relevant occupancies, except for by knight attacks. The
+// index must be big enough to contain all the attacks for each possible subset
+// of the mask and so is 2 power the number of 1s of the mask.
 template<PieceType pt>
-void init_magics(Bitboard table[], Magic magics[], const Bitboard magicsInit[]) {
+constexpr Magic square_magic(Square s, const Bitboard magicsInit[]) {
+
+    Bitboard edges = ((Rank0BB | Rank9BB) & ~rank_bb(s)) | ((FileABB | FileIBB) & ~file_bb(s));
+
+    Magic m{};
+    m.mask = lame_leaper_path<pt>(s);
+    if (pt != KNIGHT_TO)
+        m.mask &= ~edges;
+
+    m.magic = magicsInit[s];
+    m.shift = HasPext ? count_bits(uint64_t(m.mask)) : 64 - count_bits(m.mask);
+    return m;
+}
+
+// Same as Magic::index(), with a software pext so that it can be evaluated at
+// compile time.
+constexpr unsigned magic_index(const Magic& m, Bitboard occupied) {
 
-    Bitboard edges, b;
-    uint64_t size = 0;
+    if (HasPext)
+    {
+        unsigned idx = 0;
+        int      n   = 0;
+        for (Bitboard mask = m.mask; mask; mask &= mask - 1, ++n)
+            if (occupied & mask & ~(mask - 1))
+                idx |= 1U << n;
+        return idx;
+    }
+
+    Bitboard b  = occupied & m.mask;
+    uint64_t lo = uint64_t(b), mlo = uint64_t(m.magic);
+    uint64_t hi = uint64_t((Bitboard(lo) * mlo) >> 64) + lo * uint64_t(m.magic >> 64)
+                + uint64_t(b >> 64) * mlo;
+    return unsigned(hi >> m.shift);
+}
+
+// Magic bitboards are used to look up attacks of lame leapers. As a reference
+// see www.chessprogramming.org/Magic_Bitboards. In particular, here we use the
+// so called "fancy" approach: the squares have individual table sizes, stored
+// one after the other.
+template<PieceType pt, size_t Size>
+constexpr std::array<Bitboard, Size> init_magic_table(const Bitboard magicsInit[]) {
+
+    std::array<Bitboard, Size> table{};
+    size_t                     offset = 0;
 
     for (Square s = SQ_A0; s <= SQ_I9; ++s)
     {
-        // Board edges are not considered in the relevant occupancies
-        edges = ((Rank0BB | Rank9BB) & ~rank_bb(s)) | ((FileABB | FileIBB) & ~file_bb(s));
-
-        // Given a square 's', the mask is the bitboard of sliding attacks from
-        // 's' computed on an empty board. The index must be big enough to contain
-        // all the attacks for each possible subset of the mask and so is 2 power
-        // the number of 1s of the mask.
-        Magic& m = magics[s];
-        m.mask   = pt == ROOK   ? sliding_attack<pt>(s, 0)
-                 : pt == CANNON ? RookMagics[s].mask
-                                : lame_leaper_path<pt>(s);
-        if (pt != KNIGHT_TO)
-            m.mask &= ~edges;
-
-        if (HasPext)
-            m.shift = popcount(uint64_t(m.mask));
-        else
-            m.shift = 128 - popcount(m.mask);
-
-        m.magic = magicsInit[s];
-
-        // Set the offset for the attacks table of the square. We have individual
-        // table sizes for each square with "Fancy Magic Bitboards".
-        m.attacks = s == SQ_A0 ? table : magics[s - 1].attacks + size;
-
-        // Use Carry-Rippler trick to enumerate all subsets of masks[s] and
-        // store the corresponding attack bitboard in m.attacks.
-        b = size = 0;
+        Magic m = square_magic<pt>(s, magicsInit);
+
+        // Use Carry-Rippler trick to enumerate all subsets of the mask and
+        // store the corresponding attack bitboard in the table.
+        Bitboard b = 0;
         do
         {
-            m.attacks[m.index(b)] =
-              pt == ROOK || pt == CANNON ? sliding_attack<pt>(s, b) : lame_leaper_attack<pt>(s, b);
-
-            size++;
-            b = (b - m.mask) & m.mask;
+            table[offset + magic_index(m, b)] = lame_leaper_attack<pt>(s, b);
+            b                                 = (b - m.mask) & m.mask;
         } while (b);
+
+        offset += size_t(1) << count_bits(m.mask);
     }
+
+    assert(offset == Size);
+    return table;
+}
+
+template<PieceType pt>
+constexpr std::array<Magic, SQUARE_NB> init_magics(const Bitboard* table,
+                                                   const Bitboard  magicsInit[]) {
+
+    std::array<Magic, SQUARE_NB> magics{};
+    size_t                       offset = 0;
+
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+    {
+        magics[s]         = square_magic<pt>(s, magicsInit);
+        magics[s].attacks = table + offset;
+        offset += size_t(1) << count_bits(magics[s].mask);
+    }
+
+    return magics;
 }
+
+constexpr auto BishopTable   = init_magic_table<BISHOP, 0x228>(BishopMagicsInit);
+constexpr auto KnightTable   = init_magic_table<KNIGHT, 0x380>(KnightMagicsInit);
+constexpr auto KnightToTable = init_magic_table<KNIGHT_TO, 0x3E0>(KnightToMagicsInit);
+
+}  // namespace
+
+
+constexpr std::array<uint8_t, 1 << 16> PopCnt16 = [] {
+    std::array<uint8_t, 1 << 16> t{};
+    for (unsigned i = 1; i < (1 << 16); ++i)
+        t[i] = uint8_t(t[i >> 1] + (i & 1));
+    return t;
+}();
+
+constexpr std::array<std::array<uint8_t, SQUARE_NB>, SQUARE_NB> SquareDistance = [] {
+    std::array<std::array<uint8_t, SQUARE_NB>, SQUARE_NB> t{};
+    for (Square s1 = SQ_A0; s1 <= SQ_I9; ++s1)
+        for (Square s2 = SQ_A0; s2 <= SQ_I9; ++s2)
+            t[s1][s2] = uint8_t(square_distance(s1, s2));
+    return t;
+}();
+
+constexpr std::array<Bitboard, SQUARE_NB> SquareBB = [] {
+    std::array<Bitboard, SQUARE_NB> t{};
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+        t[s] = make_bb(s);
+    return t;
+}();
+
+// Computes the rank and file attacks of rooks and cannons for every occupancy of
+// the inner squares of the line, see RankAttacks in bitboard.h.
+constexpr std::array<std::array<std::array<Bitboard, 1 << (FILE_NB - 2)>, SQUARE_NB>, 2>
+  RankAttacks = [] {
+      std::array<std::array<std::array<Bitboard, 1 << (FILE_NB - 2)>, SQUARE_NB>, 2> t{};
+      for (Square s = SQ_A0; s <= SQ_I9; ++s)
+          for (unsigned occ = 0; occ < (1 << (FILE_NB - 2)); ++occ)
+          {
+              int shift    = FILE_NB * rank_of(s);
+              t[0][s][occ] = Bitboard(line_attack<ROOK>(file_of(s), FILE_NB, occ << 1)) << shift;
+              t[1][s][occ] = Bitboard(line_attack<CANNON>(file_of(s), FILE_NB, occ << 1)) << shift;
+          }
+      return t;
+  }();
+
+constexpr std::array<std::array<std::array<Bitboard, 1 << (RANK_NB - 2)>, SQUARE_NB>, 2>
+  FileAttacks = [] {
+      std::array<std::array<std::array<Bitboard, 1 << (RANK_NB - 2)>, SQUARE_NB>, 2> t{};
+      for (Square s = SQ_A0; s <= SQ_I9; ++s)
+          for (unsigned occ = 0; occ < (1 << (RANK_NB - 2)); ++occ)
+          {
+              File f = file_of(s);
+              assert(unsigned((file_squares(f, occ << 1) * FileMagics[f]) >> 120) == occ);
+              t[0][s][occ] = file_squares(f, line_attack<ROOK>(rank_of(s), RANK_NB, occ << 1));
+              t[1][s][occ] = file_squares(f, line_attack<CANNON>(rank_of(s), RANK_NB, occ << 1));
+          }
+      return t;
+  }();
+
+constexpr std::array<Magic, SQUARE_NB> BishopMagics =
+  init_magics<BISHOP>(BishopTable.data(), BishopMagicsInit);
+constexpr std::array<Magic, SQUARE_NB> KnightMagics =
+  init_magics<KNIGHT>(KnightTable.data(), KnightMagicsInit);
+constexpr std::array<Magic, SQUARE_NB> KnightToMagics =
+  init_magics<KNIGHT_TO>(KnightToTable.data(), KnightToMagicsInit);
+
+constexpr std::array<std::array<Bitboard, SQUARE_NB>, PIECE_TYPE_NB> PseudoAttacks = [] {
+    std::array<std::array<Bitboard, SQUARE_NB>, PIECE_TYPE_NB> t{};
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+    {
+        t[ROOK][s]   = RankAttacks[0][s][0] | FileAttacks[0][s][0];
+        t[BISHOP][s] = lame_leaper_attack<BISHOP>(s, 0);
+        t[KNIGHT][s] = lame_leaper_attack<KNIGHT>(s, 0);
+
+        // Only generate pseudo attacks in the palace squares for king and advisor
+        if (Palace & make_bb(s))
+        {
+            for (int step : {NORTH, SOUTH, WEST, EAST})
+                t[KING][s] |= safe_destination(s, step);
+            t[KING][s] &= Palace;
+
+            for (int step : {NORTH_WEST, NORTH_EAST, SOUTH_WEST, SOUTH_EAST})
+                t[ADVISOR][s] |= safe_destination(s, step);
+            t[ADVISOR][s] &= Palace;
+        }
+    }
+    return t;
+}();
+
+constexpr std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB> PawnAttacks = [] {
+    std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB> t{};
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+    {
+        t[WHITE][s] = pawn_attacks_bb<WHITE>(s);
+        t[BLACK][s] = pawn_attacks_bb<BLACK>(s);
+    }
+    return t;
+}();
+
+constexpr std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB> PawnAttacksTo = [] {
+    std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB> t{};
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+    {
+        t[WHITE][s] = pawn_attacks_to_bb<WHITE>(s);
+        t[BLACK][s] = pawn_attacks_to_bb<BLACK>(s);
+    }
+    return t;
+}();
+
+constexpr std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB> LineBB = [] {
+    std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB> t{};
+    for (Square s1 = SQ_A0; s1 <= SQ_I9; ++s1)
+        for (Square s2 = SQ_A0; s2 <= SQ_I9; ++s2)
+            if (PseudoAttacks[ROOK][s1] & make_bb(s2))
+                t[s1][s2] =
+                  (PseudoAttacks[ROOK][s1] & PseudoAttacks[ROOK][s2]) | make_bb(s1) | make_bb(s2);
+    return t;
+}();
+
+constexpr std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB> BetweenBB = [] {
+    std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB> t{};
+    for (Square s1 = SQ_A0; s1 <= SQ_I9; ++s1)
+        for (Square s2 = SQ_A0; s2 <= SQ_I9; ++s2)
+        {
+            // The squares strictly between s1 and s2 on a rank or file
+            if (PseudoAttacks[ROOK][s1] & make_bb(s2))
+            {
+                Direction d = rank_of(s1) == rank_of(s2) ? (s2 > s1 ? EAST : WEST)
+                                                         : (s2 > s1 ? NORTH : SOUTH);
+                for (Square s = s1 + d; s != s2; s += d)
+                    t[s1][s2] |= make_bb(s);
+            }
+
+            if (PseudoAttacks[KNIGHT][s1] & make_bb(s2))
+                t[s1][s2] |= lame_leaper_path<KNIGHT_TO>(Direction(s2 - s1), s1);
+
+            t[s1][s2] |= make_bb(s2);
+        }
+    return t;
+}();
+
+
+// Returns an ASCII representation of a bitboard suitable
+// to be printed to standard output. Useful for debugging.
+std::string Bitboards::pretty(Bitboard b) {
+
+    std::string s = "+---+---+---+---+---+---+---+---+---+\n";
+
+    for (Rank r = RANK_9; r >= RANK_0; --r)
+    {
+        for (File f = FILE_A; f <= FILE_I; ++f)
+            s += b & make_square(f, r) ? "| X " : "|   ";
+
+        s += "| " + std::to_string(r) + "\n+---+---+---+---+---+---+---+---+---+\n";
+    }
+    s += "  a   b   c   d   e   f   g   h   i\n";
+
+    return s;
 }
 
 }  // namespace Stockfish
@@ -20,6 +20,7 @@
 #define BITBOARD_H_INCLUDED
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
@@ -32,7 +33,6 @@ namespace Stockfish {
 
 namespace Bitboards {
 
-void        init();
 std::string pretty(Bitboard b);
 
 }  // namespace Stockfish::Bitboards
@@ -67,40 +67,81 @@ constexpr Bitboard HalfBB[2]  = {Rank0BB | Rank1BB | Rank2BB | Rank3BB | Rank4BB
 constexpr Bitboard PawnBB[2]  = {HalfBB[BLACK] | ((Rank3BB | Rank4BB) & PawnFileBB),
                                  HalfBB[WHITE] | ((Rank6BB | Rank5BB) & PawnFileBB)};
 
-extern uint8_t PopCnt16[1 << 16];
-extern uint8_t SquareDistance[SQUARE_NB][SQUARE_NB];
-
-extern Bitboard SquareBB[SQUARE_NB];
-extern Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
-extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-extern Bitboard PawnAttacksTo[COLOR_NB][SQUARE_NB];
+extern const std::array<uint8_t, 1 << 16>                          PopCnt16;
+extern const std::array<std::array<uint8_t, SQUARE_NB>, SQUARE_NB> SquareDistance;
+
+extern const std::array<Bitboard, SQUARE_NB>                            SquareBB;
+extern const std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB>     BetweenBB;
+extern const std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB>     LineBB;
+extern const std::array<std::array<Bitboard, SQUARE_NB>, PIECE_TYPE_NB> PseudoAttacks;
+extern const std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB>      PawnAttacks;
+extern const std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB>      PawnAttacksTo;
+
+// Rook and cannon attacks along a rank only depend on the occupancy of that rank,
+// and along a file only on the occupancy of that file. So instead of magic
+// bitboards over both lines, which would need about 35 MB of tables, they are
+// looked up separately, by the occupancy of the inner squares of the line.
+// The tables are indexed by [isCannon][square][occupancy] and together take
+// about 1 MB.
+extern const std::array<std::array<std::array<Bitboard, 1 << (FILE_NB - 2)>, SQUARE_NB>, 2>
+  RankAttacks;
+extern const std::array<std::array<std::array<Bitboard, 1 << (RANK_NB - 2)>, SQUARE_NB>, 2>
+  FileAttacks;
+
+// Multiplying the inner squares of file A by FileMagic moves rank r to bit
+// 119 + r. The partial products never overlap, so the top 8 bits of the product
+// are exactly the occupancy of ranks 1 to 8.
+constexpr Bitboard FileInnerBB = FileABB & ~Rank0BB & ~Rank9BB;
+constexpr Bitboard FileMagic   = [] {
+    Bitboard m = 0;
+    for (int r = 1; r < RANK_NB - 1; ++r)
+        m |= Bitboard(1) << (119 - 8 * r);
+    return m;
+}();
+
+// The same for the other files. The lowest bit of FileMagic is 55, so it can be
+// shifted right instead of shifting the occupancy left.
+constexpr std::array<Bitboard, FILE_NB> FileInnerMasks = [] {
+    std::array<Bitboard, FILE_NB> a{};
+    for (int f = 0; f < FILE_NB; ++f)
+        a[f] = FileInnerBB << f;
+    return a;
+}();
+constexpr std::array<Bitboard, FILE_NB> FileMagics = [] {
+    std::array<Bitboard, FILE_NB> a{};
+    for (int f = 0; f < FILE_NB; ++f)
+        a[f] = FileMagic >> f;
+    return a;
+}();
 
 int popcount(Bitboard b);  // required for 128 bit pext
 
 // Magic holds all magic bitboards relevant data for a single square
 struct Magic {
-    Bitboard  mask;
-    Bitboard  magic;
-    Bitboard* attacks;
-    unsigned  shift;
-
-    // Compute the attack's index using the 'magic bitboards' approach
+    Bitboard        mask;
+    Bitboard        magic;
+    const Bitboard* attacks;
+    unsigned        shift;
+
+    // Compute the attack's index using the 'magic bitboards' approach. Without
+    // pext only the upper 64 bits of the 128 bit product are needed, so they are
+    // computed directly and 'shift' is relative to bit 64.
     unsigned index(Bitboard occupied) const {
 
         if (HasPext)
             return unsigned(pext(occupied, mask, shift));
 
-        return unsigned(((occupied & mask) * magic) >> shift);
+        Bitboard b  = occupied & mask;
+        uint64_t lo = uint64_t(b), mlo = uint64_t(magic);
+        uint64_t hi = uint64_t((Bitboard(lo) * mlo) >> 64) + lo * uint64_t(magic >> 64)
+                    + uint64_t(b >> 64) * mlo;
+        return unsigned(hi >> shift);
     }
 };
 
-extern Magic RookMagics[SQUARE_NB];
-extern Magic CannonMagics[SQUARE_NB];
-extern Magic BishopMagics[SQUARE_NB];
-extern Magic KnightMagics[SQUARE_NB];
-extern Magic KnightToMagics[SQUARE_NB];
+extern const std::array<Magic, SQUARE_NB> BishopMagics;
+extern const std::array<Magic, SQUARE_NB> KnightMagics;
+extern const std::array<Magic, SQUARE_NB> KnightToMagics;
 
 inline Bitboard square_bb(Square s) {
     assert(is_ok(s));
@@ -159,7 +200,7 @@ constexpr Bitboard shift(Bitboard b) {
 // from the squares in the given bitboard.
 template<Color C>
 constexpr Bitboard pawn_attacks_bb(Square s) {
-    Bitboard b      = square_bb(s);
+    Bitboard b      = Bitboard(1) << s;
     Bitboard attack = shift < C == WHITE ? NORTH : SOUTH > (b);
     if ((C == WHITE && rank_of(s) > RANK_4) || (C == BLACK && rank_of(s) < RANK_5))
         attack |= shift<WEST>(b) | shift<EAST>(b);
@@ -177,7 +218,7 @@ inline Bitboard pawn_attacks_bb(Color c, Square s) {
 // of the given color in there, it can attack the square s
 template<Color C>
 constexpr Bitboard pawn_attacks_to_bb(Square s) {
-    Bitboard b      = square_bb(s);
+    Bitboard b      = Bitboard(1) << s;
     Bitboard attack = shift < C == WHITE ? SOUTH : NORTH > (b);
     if ((C == WHITE && rank_of(s) > RANK_4) || (C == BLACK && rank_of(s) < RANK_5))
         attack |= shift<WEST>(b) | shift<EAST>(b);
@@ -245,6 +286,47 @@ inline int distance<Square>(Square x, Square y) {
 inline int edge_distance(File f) { return std::min(f, File(FILE_I - f)); }
 inline int edge_distance(Rank r) { return std::min(r, Rank(RANK_9 - r)); }
 
+// Returns whether a piece of the given color and type may ever stand on the
+// square: kings and advisors are confined to the palace, bishops to their seven
+// points, and pawns never move back.
+inline bool can_stand(Color c, PieceType pt, Square s) {
+
+    const int f = file_of(s), r = c == WHITE ? rank_of(s) : RANK_9 - rank_of(s);
+
+    switch (pt)
+    {
+    case KING :
+        return bool(Palace & HalfBB[c] & s);
+    case ADVISOR :
+        return bool(Palace & HalfBB[c] & s) && (f + r) % 2;
+    case BISHOP :
+        return r <= RANK_4 && f % 2 == 0 && r % 2 == 0 && (f / 2 + r / 2) % 2;
+    case PAWN :
+        return bool(PawnBB[c] & s);
+    default :
+        return true;
+    }
+}
+
+
+// Returns the rook or cannon attacks from the given square, see RankAttacks
+template<PieceType Pt>
+inline Bitboard line_attacks_bb(Square s, Bitboard occupied) {
+
+    static_assert(Pt == ROOK || Pt == CANNON);
+    constexpr int C = Pt == CANNON;
+
+    const File f = file_of(s);
+    const Rank r = rank_of(s);
+
+    // The inner squares of a rank never cross the two 64 bit halves
+    uint64_t half    = r < RANK_7 ? uint64_t(occupied) : uint64_t(occupied >> 64);
+    unsigned rankOcc = unsigned(half >> ((FILE_NB * r + 1) & 63)) & ((1 << (FILE_NB - 2)) - 1);
+    unsigned fileOcc = unsigned(((occupied & FileInnerMasks[f]) * FileMagics[f]) >> 120);
+
+    return RankAttacks[C][s][rankOcc] | FileAttacks[C][s][fileOcc];
+}
+
 
 // Returns the pseudo attacks of the given piece type
 // assuming an empty board.
@@ -267,9 +349,9 @@ inline Bitboard attacks_bb(Square s, Bitboard occupied) {
     switch (Pt)
     {
     case ROOK :
-        return RookMagics[s].attacks[RookMagics[s].index(occupied)];
+        return line_attacks_bb<ROOK>(s, occupied);
     case CANNON :
-        return CannonMagics[s].attacks[CannonMagics[s].index(occupied)];
+        return line_attacks_bb<CANNON>(s, occupied);
     case BISHOP :
         return BishopMagics[s].attacks[BishopMagics[s].index(occupied)];
     case KNIGHT :
@@ -317,6 +399,12 @@ inline int popcount(Bitboard b) {
     return PopCnt16[v.u[0]] + PopCnt16[v.u[1]] + PopCnt16[v.u[2]] + PopCnt16[v.u[3]]
          + PopCnt16[v.u[4]] + PopCnt16[v.u[5]] + PopCnt16[v.u[6]] + PopCnt16[v.u[7]];
 
+#elif defined(USE_NEON) && USE_NEON >= 8 && !defined(_MSC_VER)
+
+    // One vector count over both halves instead of two scalar ones
+    uint64x2_t v = vcombine_u64(vcreate_u64(uint64_t(b)), vcreate_u64(uint64_t(b >> 64)));
+    return vaddvq_u8(vcntq_u8(vreinterpretq_u8_u64(v)));
+
 #elif defined(_MSC_VER)
 
     return int(_mm_popcnt_u64(b._Word[1])) + int(_mm_popcnt_u64(b._Word[0]));
@@ -0,0 +1,143 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "book.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include "memory.h"
+#include "position.h"
+
+namespace Stockfish {
+
+namespace {
+
+bool key_less(const BookEntry& a, const BookEntry& b) { return a.key < b.key; }
+
+}  // namespace
+
+bool Book::load(const std::string& file) {
+
+    clear();
+
+    size_t size = 0;
+    void*  mem  = map_file(file, size);
+
+    if (!mem)
+        return false;
+
+    if (size % sizeof(BookEntry))
+    {
+        unmap_file(mem, size);
+        return false;
+    }
+
+    entries     = static_cast<BookEntry*>(mem);
+    count       = size / sizeof(BookEntry);
+    mappingSize = size;
+
+    // The mapping is copy-on-write, so this doesn't touch the file. Only the
+    // pages which actually move stop being shared with the page cache.
+    if (!std::is_sorted(entries, entries + count, key_less))
+        std::sort(entries, entries + count, key_less);
+
+    return true;
+}
+
+void Book::clear() {
+
+    unmap_file(entries, mappingSize);
+    entries = nullptr;
+    count   = 0;
+}
+
+const BookEntry* Book::probe(const Position& pos) const {
+
+    const BookEntry  key{pos.key(), 0, 0, 0, 0};
+    const BookEntry* best = nullptr;
+
+    for (auto e = std::lower_bound(entries, entries + count, key, key_less);
+         e != entries + count && e->key == key.key; ++e)
+    {
+        Move m(e->move);
+
+        // The file may come from anywhere, check the move before using it
+        if (!m.is_ok() || !is_ok(m.from_sq()) || !is_ok(m.to_sq()))
+            continue;
+
+        if ((!best || e->weight > best->weight
+             || (e->weight == best->weight && e->depth > best->depth))
+            && pos.pseudo_legal(m) && pos.legal(m))
+            best = e;
+    }
+
+    return best;
+}
+
+bool Book::insert(const std::string& file, const BookEntry& entry) {
+
+    std::fstream fs(file, std::ios::binary | std::ios::in | std::ios::out);
+
+    if (!fs)
+    {
+        std::ofstream ofs(file, std::ios::binary);
+        ofs.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        return bool(ofs);
+    }
+
+    fs.seekg(0, std::ios::end);
+    const size_t size = size_t(fs.tellg());
+
+    if (size % sizeof(BookEntry))
+        return false;
+
+    auto read_at = [&](size_t idx, BookEntry* to, size_t n) {
+        fs.seekg(std::streamoff(idx * sizeof(BookEntry)));
+        fs.read(reinterpret_cast<char*>(to), std::streamsize(n * sizeof(BookEntry)));
+    };
+
+    // Binary search for the first entry with a greater key, reading only the
+    // entries it looks at
+    size_t lo = 0, hi = size / sizeof(BookEntry);
+    while (lo < hi && fs)
+    {
+        const size_t mid = (lo + hi) / 2;
+        BookEntry    e;
+        read_at(mid, &e, 1);
+
+        if (key_less(entry, e))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    // Then write the entry there, followed by the ones it moves up
+    std::vector<BookEntry> tail(size / sizeof(BookEntry) - lo + 1);
+    tail[0] = entry;
+    read_at(lo, tail.data() + 1, tail.size() - 1);
+
+    fs.seekp(std::streamoff(lo * sizeof(BookEntry)));
+    fs.write(reinterpret_cast<const char*>(tail.data()),
+             std::streamsize(tail.size() * sizeof(BookEntry)));
+
+    return bool(fs);
+}
+
+}  // namespace Stockfish
@@ -0,0 +1,76 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+
+namespace Stockfish {
+
+class Position;
+
+// An entry of a book file. The file is a flat array of entries in native byte
+// order, sorted by key, which is mapped in memory and searched in place. Keys
+// are the ones of Position::key() and moves the uint16 of the internal Move.
+// There may be several entries for one key, the one with the highest weight,
+// then depth, is played.
+struct BookEntry {
+    std::uint64_t key;
+    std::uint16_t move;
+    std::uint16_t weight;
+    std::int16_t  value;  // Internal units, from the point of view of the side to move
+    std::uint16_t depth;  // 0 if the entry doesn't come from a search
+};
+
+static_assert(sizeof(BookEntry) == 16, "Book files use 16 bytes per entry");
+
+class Book {
+   public:
+    Book() = default;
+    Book(const Book&)            = delete;
+    Book& operator=(const Book&) = delete;
+    ~Book() { clear(); }
+
+    // Maps the file, returns false if it can't be read. An unsorted file is
+    // sorted in the mapping only.
+    bool load(const std::string& file);
+    void clear();
+
+    size_t size() const { return count; }
+
+    // The entry to play in the position, nullptr if there is none with a legal move
+    const BookEntry* probe(const Position& pos) const;
+
+    // Adds an entry to the file, creating it if needed. The entry goes after
+    // those with the same key or a lower one, so a sorted file stays sorted.
+    static bool insert(const std::string& file, const BookEntry& entry);
+
+   private:
+    BookEntry* entries = nullptr;
+    size_t     count   = 0;
+    size_t     mappingSize = 0;
+};
+
+}  // namespace Stockfish
+
+#endif  // #ifndef BOOK_H_INCLUDED
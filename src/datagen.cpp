@@ -0,0 +1,270 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "datagen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "engine.h"
+#include "external/zip.h"
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "uci.h"
+
+namespace Stockfish::Datagen {
+
+namespace {
+
+constexpr auto StartFEN = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w";
+
+// Appends whole games to the file, which is a zip archive with a single entry
+// when its name ends with .zip. The games of all threads go through the mutex,
+// so their positions are never interleaved.
+class Writer {
+   public:
+    explicit Writer(const std::string& file) {
+        const bool zipped = file.size() > 4 && file.compare(file.size() - 4, 4, ".zip") == 0;
+
+        if (!zipped)
+        {
+            ofs.open(file, std::ios::binary | std::ios::app);
+            return;
+        }
+
+        zip = zip_open(file.c_str(), ZIP_DEFAULT_COMPRESSION_LEVEL, 'w');
+
+        const size_t      slash = file.find_last_of("/\\");
+        const size_t      first = slash == std::string::npos ? 0 : slash + 1;
+        const std::string entry = file.substr(first, file.size() - 4 - first) + ".bin";
+
+        if (zip && zip_entry_open(zip, entry.c_str()) < 0)
+        {
+            zip_close(zip);
+            zip = nullptr;
+        }
+    }
+
+    ~Writer() {
+        if (zip)
+        {
+            zip_entry_close(zip);
+            zip_close(zip);
+        }
+    }
+
+    bool is_open() const { return zip || ofs.is_open(); }
+
+    bool write(const std::vector<PackedPosition>& game) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const size_t bytes = game.size() * sizeof(PackedPosition);
+
+        if (zip)
+            return zip_entry_write(zip, game.data(), bytes) == 0;
+
+        ofs.write(reinterpret_cast<const char*>(game.data()), std::streamsize(bytes));
+        return bool(ofs);
+    }
+
+   private:
+    std::mutex    mutex;
+    std::ofstream ofs;
+    zip_t*        zip = nullptr;
+};
+
+// Plays one game and returns its positions, with the result filled in
+std::vector<PackedPosition>
+play_game(SearchSession& session, Search::RootMove& best, const Params& params, PRNG& rng) {
+
+    StateListPtr                states(new StateList);
+    Position                    pos;
+    std::vector<std::string>    moves;
+    std::vector<PackedPosition> game;
+    Value                       result = VALUE_DRAW;  // For the side to move at the end
+
+    pos.set(StartFEN, &states->back());
+
+    while (true)
+    {
+        const MoveList<LEGAL> legal(pos);
+
+        // Having no legal move loses in xiangqi, stalemate included
+        if (!legal.size())
+        {
+            result = -VALUE_MATE;
+            break;
+        }
+
+        if (pos.rule_judge(result) || pos.game_ply() >= params.maxPly)
+            break;
+
+        Move move;
+
+        if (pos.game_ply() < params.randomPlies)
+            move = *(legal.begin() + rng.rand<size_t>() % legal.size());
+        else
+        {
+            Search::LimitsType limits;
+            limits.startTime = now();
+            limits.depth     = params.nodes ? 0 : params.depth;
+            limits.nodes     = params.nodes;
+
+            session.set_position(StartFEN, moves);
+            session.go(limits);
+            session.wait_for_search_finished();
+
+            if (std::abs(best.score) >= params.evalLimit)
+            {
+                result = best.score;
+                break;
+            }
+
+            move = best.pv[0];
+            game.push_back(pack(pos, best.score, move));
+        }
+
+        moves.push_back(UCIEngine::move(move));
+        states->emplace_back();
+        pos.do_move(move, states->back());
+    }
+
+    // The result is for the side to move of the last position
+    const Color last = pos.side_to_move();
+    const int   sign = (result > 0) - (result < 0);
+
+    for (auto& p : game)
+        p.result = std::int8_t(p.position.sideToMove == last ? sign : -sign);
+
+    return game;
+}
+
+}  // namespace
+
+PackedPosition pack(const Position& pos, Value score, Move move) {
+
+    PackedPosition p{};
+
+    p.position = pos.pack();
+    p.score    = std::int16_t(std::clamp(score, -VALUE_INFINITE, VALUE_INFINITE));
+    p.move     = move.raw();
+    return p;
+}
+
+std::string unpack(const PackedPosition& p) {
+
+    StateInfo st;
+    Position  pos;
+    return pos.set(p.position, &st).fen();
+}
+
+bool generate(Engine&                                 engine,
+              const Params&                           params,
+              std::function<void(const std::string&)> report) {
+
+    Writer writer(params.file);
+
+    if (!writer.is_open())
+    {
+        report("Failed to open " + params.file);
+        return false;
+    }
+
+    const size_t concurrency =
+      std::min(params.games, params.concurrency ? params.concurrency
+                                                : size_t(int(engine.get_options()["Threads"])));
+
+    std::atomic<size_t> gamesStarted{0}, gamesDone{0}, positions{0};
+    std::atomic<bool>   failed{false};
+    std::mutex          reportMutex;
+    const TimePoint     start = now();
+
+    auto progress = [&](size_t games) {
+        const TimePoint    elapsed = std::max(now() - start, TimePoint(1));
+        std::ostringstream ss;
+        ss << games << " games, " << positions << " positions, "
+           << positions * 1000 / size_t(elapsed) << " positions/s";
+        report(ss.str());
+    };
+
+    // One session per game played at once, each with the best root move of its
+    // searches, which is written by the session's thread before the search
+    // counts as finished.
+    std::deque<Search::RootMove>                best;
+    std::vector<std::unique_ptr<SearchSession>> sessions;
+
+    for (size_t i = 0; i < concurrency; ++i)
+    {
+        Search::RootMove& rootMove = best.emplace_back(Move::none());
+
+        Search::SearchManager::UpdateContext ctx;
+        ctx.onUpdateNoMoves = [](const auto&) {};
+        ctx.onUpdateFull    = [](const auto&) {};
+        ctx.onIter          = [](const auto&) {};
+        ctx.onBestmove      = [](std::string_view, std::string_view) {};
+        ctx.onResult        = [&rootMove](const Position&, const Search::RootMove& rm, Depth) {
+            rootMove = rm;
+        };
+
+        sessions.push_back(engine.create_session(1, params.hashMb, std::move(ctx)));
+    }
+
+    std::vector<std::thread> drivers;
+
+    for (size_t i = 0; i < concurrency; ++i)
+        drivers.emplace_back([&, i] {
+            PRNG rng(now() ^ (0x9E3779B97F4A7C15ULL * (i + 1)));
+
+            while (!failed && gamesStarted++ < params.games)
+            {
+                const auto game = play_game(*sessions[i], best[i], params, rng);
+
+                if (!writer.write(game))
+                    failed = true;
+
+                positions += game.size();
+
+                if (size_t done = ++gamesDone; done % 100 == 0 && done < params.games)
+                {
+                    std::lock_guard<std::mutex> lock(reportMutex);
+                    progress(done);
+                }
+            }
+        });
+
+    for (auto& d : drivers)
+        d.join();
+
+    if (failed)
+        report("Failed to write " + params.file);
+
+    progress(gamesDone);
+    return !failed;
+}
+
+}  // namespace Stockfish::Datagen
@@ -0,0 +1,75 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATAGEN_H_INCLUDED
+#define DATAGEN_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "position.h"
+#include "types.h"
+
+namespace Stockfish {
+
+class Engine;
+
+namespace Datagen {
+
+// A position of a self-play game with the result of its search and of the
+// game. The stream written by generate() is a plain array of these, in native
+// byte order.
+struct PackedPosition {
+    Position::Packed position;
+    std::int16_t     score;   // Search score for the side to move, in internal units
+    std::uint16_t    move;    // Best move of the search, see Move::raw()
+    std::int8_t      result;  // For the side to move: 1 win, 0 draw, -1 loss
+    std::uint8_t     padding[3];
+};
+
+static_assert(sizeof(PackedPosition) == 40, "PackedPosition must be 40 bytes");
+
+PackedPosition pack(const Position& pos, Value score, Move move);
+std::string    unpack(const PackedPosition& p);  // Returns the FEN of the position
+
+struct Params {
+    std::string   file        = "selfplay.bin";  // Compressed with a .zip extension
+    size_t        games       = 1000;
+    size_t        concurrency = 0;   // Games played at once, 0 for the Threads option
+    size_t        hashMb      = 16;  // Per game
+    int           depth       = 8;
+    std::uint64_t nodes       = 0;  // When set, replaces the depth limit
+    int           randomPlies = 8;  // Random moves played first, which are not written
+    int           maxPly      = 400;
+    int           evalLimit   = 3000;  // Games are adjudicated beyond this score
+};
+
+// Plays self-play games on search sessions of the engine, each with one thread
+// and its own hash, and writes their positions. Progress and the final report
+// are sent to the callback. Returns false if the file can't be written.
+bool generate(Engine&                                 engine,
+              const Params&                           params,
+              std::function<void(const std::string&)> report);
+
+}  // namespace Datagen
+
+}  // namespace Stockfish
+
+#endif  // #ifndef DATAGEN_H_INCLUDED
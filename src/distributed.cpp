@@ -0,0 +1,558 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "distributed.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include "position.h"
+#include "tt.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace Stockfish::Distributed {
+
+#ifndef _WIN32
+
+namespace {
+
+enum class Message : std::uint32_t {
+    Position,  // The FEN, a newline, and the moves separated by spaces
+    Go,        // Search the last position until told to stop
+    Stop,
+    Entries,  // An array of Entry
+    Hello     // The secret, the first message of a coordinator
+};
+
+struct Header {
+    std::uint32_t type, size;
+};
+
+constexpr size_t MaxMessageSize = 64 * 1024 * 1024;
+constexpr size_t MaxHelloSize   = 1024;  // Until the coordinator has sent the secret
+constexpr size_t EntriesPerMsg  = 4096;
+constexpr int    PollMs         = 10;
+
+    #ifdef MSG_NOSIGNAL
+constexpr int SendFlags = MSG_NOSIGNAL;  // A closed peer must not kill the process
+    #else
+constexpr int SendFlags = 0;
+    #endif
+
+// A message as sent, a Header and its payload
+std::string frame(Message type, const std::string& payload = "") {
+
+    const Header header{std::uint32_t(type), std::uint32_t(payload.size())};
+    return std::string(reinterpret_cast<const char*>(&header), sizeof(header)) + payload;
+}
+
+// Compares the secrets in a time which doesn't depend on where they differ
+bool same_secret(const std::string& secret, const char* data, size_t size) {
+
+    unsigned diff = secret.size() != size;
+    for (size_t i = 0; i < size; ++i)
+        diff |= unsigned(secret[i % secret.size()] ^ data[i]);
+
+    return !diff;
+}
+
+}  // namespace
+
+// A TCP connection carrying messages, each a Header and its payload. Sends may
+// come from any thread, receives only from the one polling the socket.
+class Connection {
+   public:
+    explicit Connection(int socket) :
+        fd(socket) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    #ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    #endif
+    }
+
+    ~Connection() { close(fd); }
+
+    bool send(Message type, const void* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const Header header{std::uint32_t(type), std::uint32_t(size)};
+        return alive && write(&header, sizeof(header)) && write(data, size);
+    }
+
+    // Sends messages already made by frame()
+    bool send(const std::string& frames) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        return alive && write(frames.data(), frames.size());
+    }
+
+    // Reads what has arrived and passes each complete message to f. Returns
+    // false once the connection is closed or broken.
+    template<typename F>
+    bool receive(F&& f) {
+        char          buffer[64 * 1024];
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+
+        if (n <= 0)
+            return alive = false;
+
+        in.insert(in.end(), buffer, buffer + n);
+
+        size_t pos = 0;
+        while (in.size() - pos >= sizeof(Header))
+        {
+            Header header;
+            std::memcpy(&header, in.data() + pos, sizeof(header));
+
+            if (header.size > maxSize)
+                return alive = false;
+
+            if (in.size() - pos - sizeof(header) < header.size)
+                break;
+
+            f(Message(header.type), in.data() + pos + sizeof(header), size_t(header.size));
+            pos += sizeof(header) + header.size;
+        }
+
+        in.erase(in.begin(), in.begin() + std::ptrdiff_t(pos));
+        return true;
+    }
+
+    const int         fd;
+    std::atomic<bool> alive{true};
+    size_t            maxSize = MaxMessageSize;
+
+   private:
+    bool write(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+
+        while (size)
+        {
+            const ssize_t n = ::send(fd, p, size, SendFlags);
+            if (n <= 0)
+                return alive = false;
+
+            p += n;
+            size -= size_t(n);
+        }
+        return true;
+    }
+
+    std::mutex        mutex;
+    std::vector<char> in;
+};
+
+namespace {
+
+// Whether an entry is one which a host could have shared. The move may still not
+// be legal in the position, but the search checks the moves of the table anyway.
+bool is_valid(const Entry& e) {
+
+    const Move m(e.move);
+
+    return e.bound == BOUND_EXACT && e.depth >= ShareMinDepth && e.depth < MAX_PLY
+        && std::abs(e.value) <= VALUE_MATE
+        && (e.eval == VALUE_NONE || std::abs(e.eval) < VALUE_MATE_IN_MAX_PLY)
+        && (m == Move::none() || (m.is_ok() && is_ok(m.from_sq()) && is_ok(m.to_sq())));
+}
+
+// Writes the received entries which are deeper than what the table has for
+// their position. As with the writes of the local threads, races are harmless.
+void store(TranspositionTable& tt, const char* data, size_t size) {
+
+    for (size_t i = 0; i + sizeof(Entry) <= size; i += sizeof(Entry))
+    {
+        Entry e;
+        std::memcpy(&e, data + i, sizeof(e));
+
+        if (!is_valid(e))
+            continue;
+
+        auto [ttHit, ttData, ttWriter] = tt.probe(e.key);
+
+        if (!ttHit || ttData.depth < e.depth)
+            ttWriter.write(e.key, Value(e.value), true, Bound(e.bound), Depth(e.depth),
+                           Move(e.move), Value(e.eval), tt.generation());
+    }
+}
+
+void send_entries(Connection& c, const std::vector<Entry>& entries) {
+
+    for (size_t i = 0; i < entries.size(); i += EntriesPerMsg)
+    {
+        const size_t n = std::min(EntriesPerMsg, entries.size() - i);
+        if (!c.send(Message::Entries, entries.data() + i, n * sizeof(Entry)))
+            return;
+    }
+}
+
+// Opens a connection to a "host:port", nullptr on failure
+std::unique_ptr<Connection> connect_to(const std::string& address) {
+
+    const size_t colon = address.find_last_of(':');
+    if (colon == std::string::npos)
+        return nullptr;
+
+    const std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+
+    addrinfo hints{}, *list = nullptr;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &list) != 0)
+        return nullptr;
+
+    int fd = -1;
+    for (addrinfo* a = list; a && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+
+        if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(list);
+    return fd < 0 ? nullptr : std::make_unique<Connection>(fd);
+}
+
+}  // namespace
+
+Coordinator::Coordinator(TranspositionTable& table, Outbox& box) :
+    tt(table),
+    outbox(box) {}
+
+Coordinator::~Coordinator() { disconnect(); }
+
+std::string Coordinator::connect(const std::string& hosts, const std::string& secret) {
+
+    disconnect();
+
+    if (hosts.find_first_not_of(" ,") != std::string::npos && secret.empty())
+        return "Cluster disabled, ClusterSecret must be set first";
+
+    std::string list = hosts;
+    std::replace(list.begin(), list.end(), ',', ' ');
+
+    std::istringstream is(list);
+    std::ostringstream failed;
+    std::string        address;
+    size_t             tried = 0;
+
+    while (is >> address)
+    {
+        ++tried;
+
+        auto c = connect_to(address);
+
+        if (c && c->send(frame(Message::Hello, secret)))
+            peers.push_back(std::move(c));
+        else
+            failed << " " << address;
+    }
+
+    if (!tried)
+        return "Cluster disabled";
+
+    if (!peers.empty() && pipe(wake) == 0)
+    {
+        fcntl(wake[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake[1], F_SETFL, O_NONBLOCK);
+
+        exit   = false;
+        thread = std::thread(&Coordinator::loop, this);
+    }
+    else
+        peers.clear();
+
+    std::string report =
+      "Connected to " + std::to_string(peers.size()) + " of " + std::to_string(tried) + " hosts";
+
+    return failed.str().empty() ? report : report + ", failed:" + failed.str();
+}
+
+void Coordinator::disconnect() {
+
+    if (thread.joinable())
+    {
+        exit = true;
+        thread.join();
+    }
+
+    for (int& fd : wake)
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+
+    peers.clear();
+    posted.clear();
+    outbox.take();
+}
+
+void Coordinator::start(const std::string& fen, const std::vector<std::string>& moves) {
+
+    std::string position = fen + "\n";
+    for (const auto& m : moves)
+        position += m + " ";
+
+    outbox.take();  // Left over from the last search
+
+    post(frame(Message::Position, position) + frame(Message::Go));
+}
+
+void Coordinator::stop() { post(frame(Message::Stop)); }
+
+void Coordinator::post(const std::string& messages) {
+
+    if (peers.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(postMutex);
+
+    posted += messages;
+    [[maybe_unused]] ssize_t n = write(wake[1], "", 1);  // May fail if already awake
+}
+
+// Sends the posted messages, receives the entries of the other hosts and sends
+// them ours, until disconnect()
+void Coordinator::loop() {
+
+    std::vector<pollfd> fds;
+    for (auto& c : peers)
+        fds.push_back({c->fd, POLLIN, 0});
+
+    fds.push_back({wake[0], POLLIN, 0});
+
+    while (!exit)
+    {
+        if (poll(fds.data(), nfds_t(fds.size()), PollMs) > 0)
+            for (size_t i = 0; i < peers.size(); ++i)
+                if (fds[i].revents
+                    && !peers[i]->receive([&](Message type, const char* data, size_t size) {
+                           if (type == Message::Entries)
+                               store(tt, data, size);
+                       }))
+                    fds[i].fd = -1;  // Ignored by poll() from now on
+
+        if (fds.back().revents)
+        {
+            char buffer[64];
+            while (read(wake[0], buffer, sizeof(buffer)) > 0)
+            {}
+        }
+
+        std::string messages;
+        {
+            std::lock_guard<std::mutex> lock(postMutex);
+            messages.swap(posted);
+        }
+
+        if (!messages.empty())
+            for (auto& c : peers)
+                c->send(messages);
+
+        const auto entries = outbox.take();
+
+        if (!entries.empty())
+            for (auto& c : peers)
+                send_entries(*c, entries);
+    }
+}
+
+bool serve(int                                     port,
+           const std::string&                      address,
+           const std::string&                      secret,
+           TranspositionTable&                     tt,
+           Outbox&                                 outbox,
+           const Handlers&                         handlers,
+           std::function<void(const std::string&)> report) {
+
+    if (secret.empty())
+    {
+        report("ClusterSecret must be set first");
+        return false;
+    }
+
+    addrinfo hints{}, *list = nullptr;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+
+    int listener = -1;
+
+    if (getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &list) == 0)
+    {
+        for (addrinfo* a = list; a && listener < 0; a = a->ai_next)
+        {
+            listener = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (listener < 0)
+                continue;
+
+            int one = 1, zero = 0;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+            // With "::" take the IPv4 connections as well
+            if (a->ai_family == AF_INET6)
+                setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+
+            if (bind(listener, a->ai_addr, a->ai_addrlen) != 0 || listen(listener, 1) != 0)
+            {
+                close(listener);
+                listener = -1;
+            }
+        }
+
+        freeaddrinfo(list);
+    }
+
+    const std::string where = address + " port " + std::to_string(port);
+
+    if (listener < 0)
+    {
+        report("Failed to listen on " + where);
+        return false;
+    }
+
+    report("Waiting for a coordinator on " + where);
+
+    while (true)
+    {
+        const int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+
+        Connection  c(fd);
+        std::string fen;
+        bool        searching = false, accepted = false, rejected = false;
+
+        c.maxSize = MaxHelloSize;
+
+        auto dispatch = [&](Message type, const char* data, size_t size) {
+            if (rejected)
+                return;
+
+            if (!accepted)
+            {
+                accepted = type == Message::Hello && same_secret(secret, data, size);
+                rejected = !accepted;
+
+                if (accepted)
+                {
+                    c.maxSize = MaxMessageSize;
+                    report("Coordinator connected");
+                }
+            }
+            else if (type == Message::Position)
+            {
+                std::istringstream       is(std::string(data, size));
+                std::vector<std::string> moves;
+                std::string              move;
+
+                std::getline(is, fen);
+                while (is >> move)
+                    moves.push_back(move);
+
+                if (Position::is_valid(fen))
+                    handlers.position(fen, moves);
+                else
+                    report("Invalid position from the coordinator: " + fen);
+            }
+            else if (type == Message::Go && !searching)
+            {
+                searching = true;
+                handlers.go();
+            }
+            else if (type == Message::Stop && searching)
+            {
+                searching = false;
+                handlers.stop();
+            }
+            else if (type == Message::Entries)
+                store(tt, data, size);
+        };
+
+        pollfd p{fd, POLLIN, 0};
+
+        while (!rejected)
+        {
+            if (poll(&p, 1, PollMs) > 0 && p.revents && !c.receive(dispatch))
+                break;
+
+            if (accepted)
+                send_entries(c, outbox.take());
+        }
+
+        if (searching)
+            handlers.stop();
+
+        outbox.take();
+        report(accepted ? "Coordinator disconnected" : "Rejected a connection without the secret");
+    }
+}
+
+#else
+
+class Connection {};
+
+Coordinator::Coordinator(TranspositionTable& table, Outbox& box) :
+    tt(table),
+    outbox(box) {}
+
+Coordinator::~Coordinator() {}
+
+std::string Coordinator::connect(const std::string& hosts, const std::string&) {
+    return hosts.empty() ? "Cluster disabled" : "Cluster mode is not supported on Windows";
+}
+
+void Coordinator::start(const std::string&, const std::vector<std::string>&) {}
+void Coordinator::stop() {}
+void Coordinator::disconnect() {}
+void Coordinator::loop() {}
+void Coordinator::post(const std::string&) {}
+
+bool serve(int,
+           const std::string&,
+           const std::string&,
+           TranspositionTable&,
+           Outbox&,
+           const Handlers&,
+           std::function<void(const std::string&)> report) {
+    report("Cluster mode is not supported on Windows");
+    return false;
+}
+
+#endif
+
+}  // namespace Stockfish::Distributed
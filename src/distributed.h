@@ -0,0 +1,147 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DISTRIBUTED_H_INCLUDED
+#define DISTRIBUTED_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+namespace Stockfish {
+
+class TranspositionTable;
+
+// A search spread over several hosts. The main host runs the engine as usual,
+// the others run the "cluster" command and search whatever position the main
+// host searches, for as long as it does. Each host has its own threads and
+// hash, and they share the deep exact entries of their transposition tables,
+// so the work is split the way the threads of one host split it. The bestmove
+// and the info lines only come from the main host.
+//
+// A coordinator is only accepted if it first sends the secret the host was
+// given, and what it sends is checked before use. The traffic is not encrypted,
+// so the hosts should still be on a trusted network.
+namespace Distributed {
+
+// Exact entries of this depth or more are sent to the other hosts
+constexpr Depth ShareMinDepth = 8;
+
+// A transposition table entry as sent between hosts, in native byte order,
+// with its value already adjusted for storage, see value_to_tt() in search.cpp
+struct Entry {
+    Key           key;
+    std::int16_t  value, eval;
+    std::uint16_t move;
+    std::uint8_t  depth, bound;
+};
+
+static_assert(sizeof(Entry) == 16, "Entry must be 16 bytes");
+
+// The entries the search threads want to share, until the connection loop
+// sends them in a batch. The oldest ones are kept if they pile up.
+class Outbox {
+   public:
+    void push(const Entry& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entries.size() < MaxPending)
+            entries.push_back(e);
+    }
+
+    std::vector<Entry> take() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Entry>          taken;
+        taken.swap(entries);
+        return taken;
+    }
+
+   private:
+    static constexpr size_t MaxPending = 1 << 16;
+
+    std::mutex         mutex;
+    std::vector<Entry> entries;
+};
+
+class Connection;
+
+// The main host side. It starts and stops the searches of the other hosts
+// along with its own, and exchanges entries with them from a thread of its own.
+class Coordinator {
+   public:
+    Coordinator(TranspositionTable& tt, Outbox& outbox);
+    ~Coordinator();
+
+    Coordinator(const Coordinator&)            = delete;
+    Coordinator& operator=(const Coordinator&) = delete;
+
+    // Connects to the hosts of a list of "host:port", separated by spaces or
+    // commas, instead of the current ones, and sends them the secret. Returns a
+    // report for the user.
+    std::string connect(const std::string& hosts, const std::string& secret);
+    size_t      size() const { return peers.size(); }
+
+    // These only queue the messages for the thread of the coordinator, so that
+    // they never wait on the network
+    void start(const std::string& fen, const std::vector<std::string>& moves);
+    void stop();
+
+   private:
+    void disconnect();
+    void loop();
+    void post(const std::string& messages);
+
+    TranspositionTable&                      tt;
+    Outbox&                                  outbox;
+    std::vector<std::unique_ptr<Connection>> peers;
+    std::thread                              thread;
+    std::atomic<bool>                        exit{false};
+    std::mutex                               postMutex;
+    std::string                              posted;              // Messages to send, in order
+    int                                      wake[2] = {-1, -1};  // A pipe which wakes loop()
+};
+
+// What a host run by a coordinator does with its commands
+struct Handlers {
+    std::function<void(const std::string& fen, const std::vector<std::string>& moves)> position;
+    std::function<void()> go, stop;
+};
+
+// The other side: accepts coordinators on the port of the given address, one at
+// a time, and runs their commands once they have sent the secret. Only returns,
+// with false, if there is no secret or the port can't be listened on.
+bool serve(int                                     port,
+           const std::string&                      address,
+           const std::string&                      secret,
+           TranspositionTable&                     tt,
+           Outbox&                                 outbox,
+           const Handlers&                         handlers,
+           std::function<void(const std::string&)> report);
+
+}  // namespace Distributed
+
+}  // namespace Stockfish
+
+#endif  // #ifndef DISTRIBUTED_H_INCLUDED
@@ -18,9 +18,11 @@
 
 #include "engine.h"
 
+#include <algorithm>
 #include <cassert>
-#include <deque>
+#include <cstdlib>
 #include <iosfwd>
+#include <istream>
 #include <memory>
 #include <ostream>
 #include <sstream>
@@ -30,10 +32,12 @@
 
 #include "evaluate.h"
 #include "misc.h"
+#include "movegen.h"
 #include "nnue/network.h"
 #include "perft.h"
 #include "position.h"
 #include "search.h"
+#include "tablebase.h"
 #include "types.h"
 #include "uci.h"
 #include "ucioption.h"
@@ -45,10 +49,95 @@ namespace NN = Eval::NNUE;
 constexpr auto StartFEN  = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w";
 constexpr int  MaxHashMB = Is64Bit ? 33554432 : 2048;
 
+namespace {
+
+// Plays the moves on the position from the given one on, stopping at the first
+// illegal one, and returns how many were played. capSq is set to the square of
+// the last move played if it was a capture.
+template<typename ToMove, typename T>
+size_t play_moves(Position&             pos,
+                  StateListPtr&         states,
+                  const std::vector<T>& moves,
+                  size_t                first,
+                  Square&               capSq,
+                  ToMove                to_move) {
+    size_t played = first;
+    for (; played < moves.size(); ++played)
+    {
+        auto m = to_move(moves[played]);
+
+        if (m == Move::none())
+            break;
+
+        states->emplace_back();
+        pos.do_move(m, states->back());
+
+        capSq          = SQ_NONE;
+        DirtyPiece& dp = states->back().dirtyPiece;
+        if (dp.dirty_num > 1 && dp.to[1] == SQ_NONE)
+            capSq = m.to_sq();
+    }
+
+    return played - first;
+}
+
+// Empties the states for a new position, reusing the ones of the last position
+// or search when they are free, so that a new position allocates nothing.
+void reset_states(StateListPtr& states, ThreadPool& threads) {
+
+    if (!states.get())
+        states = threads.reclaim_setup_states();
+
+    if (states.get())
+        states->clear();
+    else
+        states = StateListPtr(new StateList);
+}
+
+// Sets up the position after the given moves, and returns the square of the
+// piece which was just captured, if any. When the moves extend the game set up
+// last time, only the new ones are played. The states of the game, and with them
+// the repetition and chase history, are kept instead of being rebuilt, which on
+// a long game saves replaying it on every move.
+Square setup_position(Position&                       pos,
+                      StateListPtr&                   states,
+                      ThreadPool&                     threads,
+                      GameSetup&                      game,
+                      Square                          capSq,
+                      const std::string&              fen,
+                      const std::vector<std::string>& moves) {
+
+    const bool extends = fen == game.fen && moves.size() >= game.moves.size()
+                      && std::equal(game.moves.begin(), game.moves.end(), moves.begin());
+
+    // A search owns the states it was started on, take them back after it
+    if (extends && !states.get())
+        states = threads.reclaim_setup_states();
+
+    if (!extends || !states.get())
+    {
+        reset_states(states, threads);
+        pos.set(fen, &states->back());
+
+        game  = {fen, {}};
+        capSq = SQ_NONE;
+    }
+
+    const size_t first  = game.moves.size();
+    const size_t played = play_moves(pos, states, moves, first, capSq, [&](const std::string& m) {
+        return UCIEngine::to_move(pos, m);
+    });
+
+    game.moves.insert(game.moves.end(), moves.begin() + first, moves.begin() + first + played);
+
+    return capSq;
+}
+}
+
 Engine::Engine(std::string path) :
     binaryDirectory(CommandLine::get_binary_directory(path)),
     numaContext(NumaConfig::from_system()),
-    states(new std::deque<StateInfo>(1)),
+    states(new StateList),
     threads(),
     network(numaContext, NN::Network({EvalFileDefaultName, "None", ""})) {
     pos.set(StartFEN, &states->back());
@@ -65,54 +154,185 @@ Engine::Engine(std::string path) :
     });
 
     options["Threads"] << Option(1, 1, 1024, [this](const Option&) {
-        resize_threads();
+        resize_threads(true);
         return thread_binding_information_as_string();
     });
 
     options["Hash"] << Option(16, 1, MaxHashMB, [this](const Option& o) {
         set_tt_size(o);
-        return std::nullopt;
+        return options["LargePages"] == "transparent"
+               ? std::nullopt
+               : std::optional<std::string>(large_pages_information_as_string());
     });
 
+    options["LargePages"] << Option("transparent var transparent var 2MB var 1GB", "transparent",
+                                    [this](const Option& o) {
+                                        set_max_huge_page(o == "1GB"   ? size_t(1) << 30
+                                                          : o == "2MB" ? size_t(1) << 21
+                                                                       : 0);
+                                        resize_threads();
+                                        threads.wait_for_clearing();
+                                        install_loaded_network();
+                                        network.modify_and_replicate(
+                                          [](NN::Network& n) { n.reallocate(); });
+                                        return large_pages_information_as_string();
+                                    });
+
+    options["HashPlacement"] << Option("slices var slices var interleave", "slices",
+                                       [this](const Option&) {
+                                           set_tt_size(options["Hash"]);
+                                           return numa_config_information_as_string();
+                                       });
+
     options["Clear Hash"] << Option([this](const Option&) {
         search_clear();
         return std::nullopt;
     });
+    options["HashFile"] << Option("");
+    options["Save Hash"] << Option([this](const Option&) -> std::optional<std::string> {
+        const std::string file = options["HashFile"];
+        if (file.empty())
+            return "HashFile is not set";
+        return save_tt(file) ? "Hash saved to " + file : "Failed to save hash to " + file;
+    });
+    options["Load Hash"] << Option([this](const Option&) -> std::optional<std::string> {
+        const std::string file = options["HashFile"];
+        if (file.empty())
+            return "HashFile is not set";
+        return load_tt(file) ? "Hash loaded from " + file
+                             : "Failed to load hash from " + file
+                                 + " (missing file or different Hash size)";
+    });
+    options["PerftHash"] << Option(16, 0, MaxHashMB);
+    options["EvalCache"] << Option(0, 0, 1024);
+    options["Deterministic"] << Option(false, [this](const Option&) {
+        resize_threads();
+        return std::nullopt;
+    });
+    options["ABDADA"] << Option(false);
+    options["PrefetchAhead"] << Option(0, 0, 8);
     options["Ponder"] << Option(false);
+    options["BackgroundAnalysis"] << Option(false);
+    options["ResumeAnalysis"] << Option(false);
     options["MultiPV"] << Option(1, 1, MAX_MOVES);
+    options["MultiPVMode"] << Option("separate var separate var shared", "separate");
+    options["UCI_ShowWDL"] << Option(false);
+    options["MateSolver"] << Option(false);
+    options["MateHash"] << Option(16, 1, MaxHashMB);
     options["Move Overhead"] << Option(10, 0, 5000);
     options["nodestime"] << Option(0, 0, 10000);
+    options["TimeModel"] << Option("classic var classic var predictive", "classic");
+    options["BookFile"] << Option("", [this](const Option& o) -> std::optional<std::string> {
+        const std::string file = o;
+        wait_for_search_finished();
+        if (file.empty())
+        {
+            book.clear();
+            return std::nullopt;
+        }
+        return book.load(file) ? "Book " + file + " has " + std::to_string(book.size()) + " entries"
+                               : "Failed to load book " + file;
+    });
+    options["BookLearn"] << Option(false);
+    options["TablebasePath"] << Option("", [this](const Option& o) {
+        wait_for_search_finished();
+        return std::optional<std::string>("Found " + std::to_string(Tablebases::init(o))
+                                          + " tablebases");
+    });
+    options["TablebaseProbeLimit"] << Option(Tablebases::MaxPieces, 0, Tablebases::MaxPieces);
     options["EvalFile"] << Option(EvalFileDefaultName, [this](const Option& o) {
-        load_network(o);
+        load_network_in_background(o);
         return std::nullopt;
     });
+    options["SharedNetwork"] << Option(false, [this](const Option& o) {
+        set_network_sharing(o);
+        return std::nullopt;
+    });
+    options["ClusterSecret"] << Option("");
+    options["ClusterHosts"] << Option("", [this](const Option& o) {
+        wait_for_search_finished();
+        const std::string report = cluster.connect(o, options["ClusterSecret"]);
+        threads.clusterOutbox    = cluster.size() ? &clusterOutbox : nullptr;
+        return std::optional<std::string>(report);
+    });
+
+    updateContext.onResult = [this](const Position& rootPos, const Search::RootMove& rm,
+                                    Depth depth) { book_learn(rootPos, rm, depth); };
+    updateContext.onInfoString = [this](const std::string& s) {
+        if (onInfoString)
+            onInfoString(s);
+    };
 
     load_network(options["EvalFile"]);
     resize_threads();
 }
 
-std::uint64_t Engine::perft(const std::string& fen, Depth depth) {
+std::uint64_t Engine::perft(
+  const std::string& fen, Depth depth, const Benchmark::PerftCallback& onRootMove) {
     verify_network();
+    wait_for_search_finished();
 
-    return Benchmark::perft(fen, depth);
+    return Benchmark::perft(fen, depth, threads, size_t(int(options["PerftHash"])), onRootMove);
 }
 
 void Engine::go(Search::LimitsType& limits) {
     assert(limits.perft == 0);
-    verify_network();
+
+    if (networkLoaded)
+    {
+        wait_for_search_finished();
+        install_loaded_network();
+    }
+
+    verify_network_in_use(true);
     limits.capSq = capSq;
 
-    threads.start_thinking(pos, states, limits);
+    // Pondering and infinite searches already use the time after the best move
+    const bool background =
+      options["BackgroundAnalysis"] && !limits.ponderMode && !limits.infinite;
+
+    // The last search may still be adding its result to the book, see book_learn()
+    wait_for_search_finished();
+
+    if (book.size() && !limits.ponderMode && !limits.infinite && !limits.mate)
+    {
+        const BookEntry*  e    = book.probe(pos);
+        const std::string move = e ? UCIEngine::move(Move(e->move)) : "";
+
+        if (e
+            && (limits.searchmoves.empty()
+                || std::count(limits.searchmoves.begin(), limits.searchmoves.end(), move)))
+        {
+            if (onInfoString)
+                onInfoString("book hit " + move + " weight " + std::to_string(e->weight));
+            updateContext.onBestmove(move, "");
+            return;
+        }
+
+        if (onInfoString)
+            onInfoString("book miss");
+    }
+
+    // The other hosts of the cluster search the same game until the bestmove
+    if (cluster.size())
+        cluster.start(game.fen.empty() ? pos.fen() : game.fen, game.moves);
+
+    threads.start_thinking(pos, states, limits, background);
+}
+void Engine::stop() {
+    threads.stop_background();
+    threads.stop = true;
 }
-void Engine::stop() { threads.stop = true; }
 
+// Clears the hash and the histories in the background, see wait_for_search_clear()
 void Engine::search_clear() {
     wait_for_search_finished();
 
-    tt.clear(threads);
-    threads.clear();
+    threads.start_clearing(&tt);
 }
 
+void Engine::wait_for_search_clear() { threads.wait_for_clearing(); }
+
 void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)>&& f) {
     updateContext.onUpdateNoMoves = std::move(f);
 }
@@ -126,92 +346,346 @@ void Engine::set_on_iter(std::function<void(const Engine::InfoIter&)>&& f) {
 }
 
 void Engine::set_on_bestmove(std::function<void(std::string_view, std::string_view)>&& f) {
-    updateContext.onBestmove = std::move(f);
+    updateContext.onBestmove = [this, f = std::move(f)](std::string_view bestmove,
+                                                        std::string_view ponder) {
+        f(bestmove, ponder);
+        cluster.stop();
+    };
+}
+
+void Engine::set_on_verify_network(std::function<void(std::string_view)>&& f) {
+    onVerifyNetwork = std::move(f);
+}
+
+std::string Engine::generate_tablebase(const std::string& material) {
+    wait_for_search_finished();
+
+    return Tablebases::generate(options["TablebasePath"], material);
+}
+
+// Runs the searches of a coordinator, see Distributed::serve(). The entries of
+// the deep exact nodes are shared while doing so.
+bool Engine::serve_cluster(int port, const std::string& address) {
+    wait_for_search_finished();
+
+    Distributed::Handlers handlers;
+    handlers.position = [this](const std::string& fen, const std::vector<std::string>& moves) {
+        set_position(fen, moves);
+    };
+    handlers.go = [this]() {
+        Search::LimitsType limits;
+        limits.startTime = now();
+        limits.infinite  = 1;
+        go(limits);
+    };
+    handlers.stop = [this]() {
+        stop();
+        wait_for_search_finished();
+    };
+
+    threads.clusterOutbox = &clusterOutbox;
+
+    const bool ok = Distributed::serve(port, address, options["ClusterSecret"], tt, clusterOutbox,
+                                       handlers, [this](const std::string& s) {
+                                           if (onInfoString)
+                                               onInfoString(s);
+                                       });
+    threads.clusterOutbox = nullptr;
+    return ok;
+}
+
+void Engine::set_on_info_string(std::function<void(const std::string&)>&& f) {
+    onInfoString = std::move(f);
 }
 
-void Engine::wait_for_search_finished() { threads.main_thread()->wait_for_search_finished(); }
+// Called by the main search thread with the result of each search, once the
+// best move has been sent. With BookLearn, the result is inserted into the book
+// file, which is then mapped again so that it is used from the next move on.
+void Engine::book_learn(const Position& rootPos, const Search::RootMove& rm, Depth depth) {
+
+    const std::string file = options["BookFile"];
+
+    if (!options["BookLearn"] || file.empty() || depth <= 0 || rm.pv[0] == Move::none())
+        return;
+
+    const int       value = std::clamp(int(rm.score), -VALUE_INFINITE, int(VALUE_INFINITE));
+    const BookEntry entry{rootPos.key(), rm.pv[0].raw(), 1, std::int16_t(value),
+                          std::uint16_t(depth)};
+
+    // The mapping would see the entries move under it
+    book.clear();
+
+    if (!Book::insert(file, entry) && onInfoString)
+        onInfoString("Failed to write to book " + file);
+
+    if (!book.load(file) && onInfoString)
+        onInfoString("Failed to load book " + file);
+}
+
+void Engine::wait_for_search_finished() {
+    threads.stop_background();
+    threads.main_thread()->wait_for_search_finished();
+    threads.wait_for_clearing();
+}
 
 void Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
-    // Drop the old state and create a new one
-    states = StateListPtr(new std::deque<StateInfo>(1));
-    pos.set(fen, &states->back());
+    // Let the background search give back the states it runs on
+    threads.stop_background();
+
+    capSq = setup_position(pos, states, threads, game, capSq, fen, moves);
+}
 
+void Engine::set_position(const Piece              board[SQUARE_NB],
+                          Color                    us,
+                          int                      rule60,
+                          int                      gamePly,
+                          const std::vector<Move>& moves) {
+    reset_states(states, threads);
+    pos.set(board, us, rule60, gamePly, &states->back());
+
+    game  = {};
     capSq = SQ_NONE;
-    for (const auto& move : moves)
+    play_moves(pos, states, moves, 0, capSq,
+               [&](Move m) { return is_legal(pos, m) ? m : Move::none(); });
+}
+
+// The session copies the options of the engine, so later changes don't affect it.
+// All of them are copied, without their actions, so that none which the search
+// reads can be missing. Its threads are never bound to NUMA nodes: with many
+// small sessions they would otherwise all end up on the first node.
+std::unique_ptr<SearchSession>
+Engine::create_session(size_t                               threadCount,
+                       size_t                               hashMb,
+                       Search::SearchManager::UpdateContext ctx) {
+    auto session = std::make_unique<SearchSession>(network, std::move(ctx));
+
+    for (const auto& [name, option] : options.options_map)
     {
-        auto m = UCIEngine::to_move(pos, move);
+        Option copy    = option;
+        copy.on_change = nullptr;
+        session->options[name] << copy;
+    }
 
-        if (m == Move::none())
-            break;
+    session->options["Threads"] << Option(double(threadCount), 1, 1024);
+    session->options["NumaPolicy"] << Option("none");
 
-        states->emplace_back();
-        pos.do_move(m, states->back());
+    session->threads.set(
+      numaContext.get_numa_config(),
+      {session->options, session->threads, session->tt, session->network},
+      session->updateContext);
+    session->tt.resize(hashMb, session->threads, false);
 
-        capSq          = SQ_NONE;
-        DirtyPiece& dp = states->back().dirtyPiece;
-        if (dp.dirty_num > 1 && dp.to[1] == SQ_NONE)
-            capSq = m.to_sq();
-    }
+    return session;
 }
 
 // modifiers
 
 void Engine::set_numa_config_from_option(const std::string& o) {
-    if (o == "auto" || o == "system")
+    // A network being loaded is replicated for the current configuration
+    wait_for_search_finished();
+    install_loaded_network();
+
+    // A "+hybrid" or "+pcores" suffix chooses how the cores of hybrid processors are used
+    const auto [policy, corePolicy] = NumaConfig::split_core_class_policy(o);
+
+    if (policy == "auto" || policy == "system")
     {
-        numaContext.set_numa_config(NumaConfig::from_system());
+        numaContext.set_numa_config(NumaConfig::from_system(true, corePolicy));
     }
-    else if (o == "hardware")
+    else if (policy == "hardware")
     {
         // Don't respect affinity set in the system.
-        numaContext.set_numa_config(NumaConfig::from_system(false));
+        numaContext.set_numa_config(NumaConfig::from_system(false, corePolicy));
     }
-    else if (o == "none")
+    else if (policy == "none")
     {
         numaContext.set_numa_config(NumaConfig{});
     }
     else
     {
-        numaContext.set_numa_config(NumaConfig::from_string(o));
+        numaContext.set_numa_config(NumaConfig::from_string(policy, corePolicy));
     }
 
     // Force reallocation of threads in case affinities need to change.
     resize_threads();
 }
 
-void Engine::resize_threads() {
+void Engine::resize_threads(bool keepWorkers) {
+    threads.stop_background();
     threads.wait_for_search_finished();
-    threads.set(numaContext.get_numa_config(), {options, threads, tt, network}, updateContext);
 
-    // Reallocate the hash with the new threadpool size
-    set_tt_size(options["Hash"]);
+    // Reallocate the hash with the new threadpool size, unless the threads were
+    // kept and so are its pages, where they were first touched.
+    if (!threads.set(numaContext.get_numa_config(), {options, threads, tt, network}, updateContext,
+                     keepWorkers))
+        set_tt_size(options["Hash"]);
 }
 
 void Engine::set_tt_size(size_t mb) {
     wait_for_search_finished();
-    tt.resize(mb, threads);
+    tt.resize(mb, threads, options["HashPlacement"] == "interleave");
+}
+
+bool Engine::save_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.save(file);
+}
+
+bool Engine::load_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.load(file, threads);
 }
 
 void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
 
 // network related
 
-void Engine::verify_network() const { network->verify(options["EvalFile"]); }
+bool Engine::verify_network(bool exitOnError) {
+    if (networkLoader.joinable())
+    {
+        wait_for_search_finished();
+        install_loaded_network();
+    }
+
+    return verify_network_in_use(exitOnError);
+}
+
+// Unlike verify_network(), leaves a network being loaded to the next go
+bool Engine::verify_network_in_use(bool exitOnError) const {
+    if (network->verify(networkFile, onVerifyNetwork))
+        return true;
+
+    if (!exitOnError)
+        return false;
+
+    const std::string msg = "ERROR: The engine will be terminated now.";
+
+    if (onVerifyNetwork)
+        onVerifyNetwork(msg);
+    else
+        sync_cout << "info string " << msg << sync_endl;
+
+    exit(EXIT_FAILURE);
+}
+
+bool Engine::network_loaded() const { return network->is_loaded(networkFile); }
 
 void Engine::load_network(const std::string& file) {
+    install_loaded_network();
+
+    threads.wait_for_clearing();
     network.modify_and_replicate(
       [this, &file](NN::Network& network_) { network_.load(binaryDirectory, file); });
+    networkFile = file;
     threads.clear();
 }
 
+// Reads and replicates the network while the current one is still used, even
+// by a running search, and then leaves it to the next go to switch to it. The
+// workers refresh what they derive from the network when they notice the switch.
+// Without a usable network in use, such as when EvalFile is set right at startup,
+// there is nothing to keep running and the network is loaded at once.
+void Engine::load_network_in_background(const std::string& file) {
+    if (!network->is_loaded(networkFile))
+    {
+        load_network(file);
+        return;
+    }
+
+    if (networkLoader.joinable())
+        networkLoader.join();  // The network it loaded, if any, is replaced below
+
+    networkLoaded = false;
+    loadingFile   = file;
+
+    networkLoader = std::thread([this, file]() {
+        NN::Network loaded({EvalFileDefaultName, "None", ""});
+        loaded.load(binaryDirectory, file);
+
+        if (loaded.is_loaded(file))
+            network.stage(std::move(loaded));
+        else
+            network.discard_staged();
+
+        networkLoaded = true;
+    });
+}
+
+// Switches to the network loaded in the background, if any, waiting for it if
+// needed. Must not be called during a search. The network in use is kept if the
+// load failed.
+void Engine::install_loaded_network() {
+    if (!networkLoader.joinable())
+        return;
+
+    networkLoader.join();
+    networkLoaded = false;
+
+    if (network.swap_staged())
+        networkFile = loadingFile;
+
+    else if (onVerifyNetwork)
+        onVerifyNetwork("Failed to load the network " + loadingFile + ", still using "
+                        + networkFile);
+}
+
 void Engine::save_network(const std::optional<std::string>& file) {
+    wait_for_search_finished();
+    install_loaded_network();
+
     network.modify_and_replicate([&file](NN::Network& network_) { network_.save(file); });
 }
 
+void Engine::set_network_sharing(bool enabled) {
+    wait_for_search_finished();
+    install_loaded_network();
+
+    if (enabled)
+        network.set_replicator(
+          [](const NN::Network& source, NumaIndex n) { return source.clone_shared(n); });
+    else
+        network.set_replicator(nullptr);
+}
+
+void Engine::save_network_mapped(const std::string& file) {
+    wait_for_search_finished();
+    install_loaded_network();
+
+    network->save_mapped(file);
+}
+
+// search sessions
+
+SearchSession::SearchSession(const NumaReplicated<Eval::NNUE::Network>& net,
+                             Search::SearchManager::UpdateContext       ctx) :
+    states(new StateList),
+    network(net),
+    updateContext(std::move(ctx)) {
+    pos.set(StartFEN, &states->back());
+    capSq = SQ_NONE;
+}
+
+void SearchSession::go(Search::LimitsType& limits) {
+    assert(limits.perft == 0);
+    limits.capSq = capSq;
+
+    threads.start_thinking(pos, states, limits);
+}
+
+void SearchSession::stop() { threads.stop = true; }
+
+void SearchSession::wait_for_search_finished() {
+    threads.main_thread()->wait_for_search_finished();
+}
+
+void SearchSession::set_position(const std::string& fen, const std::vector<std::string>& moves) {
+    capSq = setup_position(pos, states, threads, game, capSq, fen, moves);
+}
+
 // utility functions
 
-void Engine::trace_eval() const {
-    StateListPtr trace_states(new std::deque<StateInfo>(1));
+void Engine::trace_eval() {
+    StateListPtr trace_states(new StateList);
     Position     p;
     p.set(pos.fen(), &trace_states->back());
 
@@ -220,12 +694,138 @@ void Engine::trace_eval() const {
     sync_cout << "\n" << Eval::trace(p, *network) << sync_endl;
 }
 
+Value Engine::evaluate() {
+    verify_network();
+
+    if (pos.checkers())
+        return VALUE_NONE;
+
+    if (!evalCaches)
+    {
+        evalAccumulators = std::make_unique<NN::AccumulatorStack>();
+        evalCaches       = std::make_unique<NN::AccumulatorCaches>(*network);
+    }
+    else if (evalNetworkVersion != network.get_version())
+        evalCaches->clear(*network);
+
+    evalNetworkVersion = network.get_version();
+    evalAccumulators->reset();
+
+    return Eval::evaluate(*network, pos, *evalAccumulators, *evalCaches, VALUE_ZERO);
+}
+
+std::vector<Benchmark::MicroResult> Engine::microbench() {
+    verify_network();
+    wait_for_search_finished();
+
+    return Benchmark::run_microbench(*network, threads);
+}
+
+// Labels the positions of the input, one FEN per line, with their static
+// evaluation and, if asked, the value of a quiescence search. Each line of the
+// output is "fen,eval[,qsearch]" in internal units, eval being "none" when in
+// check. Each chunk of lines is split between the threads while the main thread
+// reads the next one. Returns the number of positions.
+size_t Engine::label(std::istream& in, std::ostream& out, bool qsearch) {
+    verify_network();
+    wait_for_search_finished();
+
+    constexpr size_t PerThread = 1024;
+
+    struct Slice {
+        std::vector<Position>  positions = std::vector<Position>(PerThread);
+        std::vector<StateInfo> states    = std::vector<StateInfo>(PerThread);
+        std::vector<Value>     evals, qsearches;
+    };
+
+    // The quiescence searches run on threads of their own, so that they neither
+    // fill the hash of the engine nor change the histories of its workers
+    const auto  session = qsearch ? create_session(threads.num_threads(), 16, {}) : nullptr;
+    ThreadPool& pool    = session ? session->threads : threads;
+
+    const size_t             threadCount = pool.num_threads();
+    std::vector<Slice>       slices(threadCount);
+    std::vector<std::string> lines, next;
+    size_t                   count = 0;
+
+    auto read_chunk = [&](std::vector<std::string>& chunk) {
+        chunk.clear();
+        for (std::string line; chunk.size() < threadCount * PerThread && std::getline(in, line);)
+            if (!line.empty())
+                chunk.push_back(std::move(line));
+    };
+
+    read_chunk(lines);
+
+    while (!lines.empty())
+    {
+        const size_t perThread = (lines.size() + threadCount - 1) / threadCount;
+
+        for (size_t t = 0; t < threadCount; ++t)
+            pool.run_on_thread(t, [&, t] {
+                Search::Worker&              worker = *(pool.begin() + t)->get()->worker;
+                Slice&                       slice  = slices[t];
+                std::vector<const Position*> quiet;
+
+                const size_t first = std::min(t * perThread, lines.size());
+                const size_t last  = std::min(first + perThread, lines.size());
+
+                slice.evals.assign(last - first, VALUE_NONE);
+                slice.qsearches.assign(last - first, VALUE_NONE);
+
+                for (size_t i = first; i < last; ++i)
+                {
+                    Position& p = slice.positions[i - first];
+                    p.set(lines[i], &slice.states[i - first]);
+
+                    if (!p.checkers())
+                        quiet.push_back(&p);
+                }
+
+                const std::vector<Value> evals = worker.evaluate_batch(quiet);
+
+                for (size_t i = 0; i < quiet.size(); ++i)
+                    slice.evals[quiet[i] - slice.positions.data()] = evals[i];
+
+                if (qsearch)
+                    for (size_t i = first; i < last; ++i)
+                        slice.qsearches[i - first] =
+                          worker.qsearch_root(slice.positions[i - first]);
+            });
+
+        read_chunk(next);
+
+        for (size_t t = 0; t < threadCount; ++t)
+            pool.wait_on_thread(t);
+
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            const Slice& slice = slices[i / perThread];
+            const Value  eval  = slice.evals[i % perThread];
+
+            out << lines[i] << ',' << (eval == VALUE_NONE ? "none" : std::to_string(eval));
+            if (qsearch)
+                out << ',' << slice.qsearches[i % perThread];
+            out << '\n';
+        }
+
+        count += lines.size();
+        std::swap(lines, next);
+    }
+
+    out.flush();
+    return count;
+}
+
 const OptionsMap& Engine::get_options() const { return options; }
 OptionsMap&       Engine::get_options() { return options; }
 
 std::string Engine::fen() const { return pos.fen(); }
 
-void Engine::flip() { pos.flip(); }
+void Engine::flip() {
+    pos.flip();
+    game = {};
+}
 
 std::string Engine::visualize() const {
     std::stringstream ss;
@@ -252,7 +852,35 @@ std::string Engine::get_numa_config_as_string() const {
 
 std::string Engine::numa_config_information_as_string() const {
     auto cfgStr = get_numa_config_as_string();
-    return "Available Processors: " + cfgStr;
+
+    // The hash is first touched by the search threads, so its pages are only
+    // spread over the nodes the threads are bound to.
+    size_t nodesUsed = 0;
+    for (auto&& [current, total] : get_bound_thread_count_by_numa_node())
+        nodesUsed += current > 0;
+
+    std::string placement = options["HashPlacement"] == "interleave" ? "interleaved" : "sliced";
+    placement += nodesUsed ? " over " + std::to_string(nodesUsed) + " NUMA node(s)"
+                           : ", threads not bound";
+
+    std::string info = "Available Processors: " + cfgStr + "\n" + "Hash Placement: " + placement;
+
+    const NumaConfig& cfg = numaContext.get_numa_config();
+    if (cfg.is_hybrid())
+        info += "\nEfficiency Cores: " + cfg.efficiency_cpus_to_string();
+
+    return info;
+}
+
+// The page size the big tables actually got, see the LargePages option
+std::string Engine::large_pages_information_as_string() const {
+    auto page = [](size_t size) {
+        return size ? std::to_string(size >> 20) + "MB" : std::string("transparent");
+    };
+
+    return "Huge pages: hash " + page(tt.huge_page_size()) + ", network "
+         + page(network->huge_page_size()) + ", threads "
+         + page(huge_page_size(threads.main_thread()->worker.get()));
 }
 
 std::string Engine::thread_binding_information_as_string() const {
@@ -276,4 +904,79 @@ std::string Engine::thread_binding_information_as_string() const {
     return ss.str();
 }
 
+// Reports the telemetry counters of each thread and their sum, either as plain
+// text or as a single JSON line. Can be called while a search is running.
+// Sums up the telemetry counters of all threads
+Search::StatsSnapshot Engine::search_stats_total() const {
+    Search::StatsSnapshot total{};
+
+    for (const auto& s : threads.search_stats())
+    {
+        total.nodes += s.nodes;
+        total.ttHits += s.ttHits;
+        total.qsearchNodes += s.qsearchNodes;
+        total.evaluations += s.evaluations;
+        total.evalCacheHits += s.evalCacheHits;
+        total.nnueRefreshes += s.nnueRefreshes;
+        total.nnueUpdates += s.nnueUpdates;
+        total.nnueRefreshFeatures += s.nnueRefreshFeatures;
+        for (int i = 0; i < Search::SearchStats::CutoffSlots; ++i)
+            total.cutoffs[i] += s.cutoffs[i];
+    }
+
+    return total;
+}
+
+std::string Engine::search_stats(bool json) const {
+    auto                        stats = threads.search_stats();
+    const Search::StatsSnapshot total = search_stats_total();
+
+    auto format = [json](std::ostream& os, const Search::StatsSnapshot& s) {
+        const char* sep = json ? "\":" : " ";
+        const char* q   = json ? "\"" : "";
+        const char* del = json ? "," : " ";
+
+        os << q << "nodes" << sep << s.nodes << del << q << "tthits" << sep << s.ttHits << del
+           << q << "qnodes" << sep << s.qsearchNodes << del << q << "evals" << sep
+           << s.evaluations << del << q << "evalcachehits" << sep << s.evalCacheHits << del << q
+           << "refreshes" << sep << s.nnueRefreshes << del << q << "refreshfeatures" << sep
+           << s.nnueRefreshFeatures << del << q << "updates" << sep << s.nnueUpdates << del << q
+           << "cutoffs" << sep << (json ? "[" : "");
+
+        for (int i = 0; i < Search::SearchStats::CutoffSlots; ++i)
+            os << (i ? del : "") << s.cutoffs[i];
+
+        os << (json ? "]" : "");
+    };
+
+    std::stringstream ss;
+
+    if (json)
+    {
+        ss << "{\"threads\":[";
+        for (size_t i = 0; i < stats.size(); ++i)
+        {
+            ss << (i ? ",{" : "{");
+            format(ss, stats[i]);
+            ss << "}";
+        }
+        ss << "],\"total\":{";
+        format(ss, total);
+        ss << "}}";
+    }
+    else
+    {
+        for (size_t i = 0; i < stats.size(); ++i)
+        {
+            ss << "thread " << i << " ";
+            format(ss, stats[i]);
+            ss << "\n";
+        }
+        ss << "total ";
+        format(ss, total);
+    }
+
+    return ss.str();
+}
+
 }
@@ -19,14 +19,21 @@
 #ifndef ENGINE_H_INCLUDED
 #define ENGINE_H_INCLUDED
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <iosfwd>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+#include "benchmark.h"
+#include "book.h"
+#include "distributed.h"
 #include "nnue/network.h"
 #include "numa.h"
 #include "position.h"
@@ -38,6 +45,49 @@
 
 namespace Stockfish {
 
+// The game set up by the last position command, see setup_position() in engine.cpp
+struct GameSetup {
+    std::string              fen;
+    std::vector<std::string> moves;  // Only the ones which were played
+};
+
+// A search session has its own position, threads and transposition table, but
+// shares the network of the engine which created it, see Engine::create_session().
+// It allows running many independent searches in one process.
+class SearchSession {
+   public:
+    SearchSession(const NumaReplicated<Eval::NNUE::Network>& net,
+                  Search::SearchManager::UpdateContext       ctx);
+
+    SearchSession(const SearchSession&)            = delete;
+    SearchSession& operator=(const SearchSession&) = delete;
+
+    ~SearchSession() { wait_for_search_finished(); }
+
+    // non blocking call to start searching
+    void go(Search::LimitsType&);
+    void stop();
+    void wait_for_search_finished();
+    void set_position(const std::string& fen, const std::vector<std::string>& moves);
+
+    size_t num_threads() const { return threads.num_threads(); }
+
+   private:
+    friend class Engine;
+
+    Position     pos;
+    StateListPtr states;
+    Square       capSq;
+    GameSetup    game;
+
+    OptionsMap                                 options;
+    ThreadPool                                 threads;
+    TranspositionTable                         tt;
+    const NumaReplicated<Eval::NNUE::Network>& network;
+
+    Search::SearchManager::UpdateContext updateContext;
+};
+
 class Engine {
    public:
     using InfoShort = Search::InfoShort;
@@ -52,25 +102,40 @@ class Engine {
     Engine& operator=(const Engine&) = delete;
     Engine& operator=(Engine&&)      = delete;
 
-    ~Engine() { wait_for_search_finished(); }
+    ~Engine() {
+        wait_for_search_finished();
+        if (networkLoader.joinable())
+            networkLoader.join();
+    }
 
-    std::uint64_t perft(const std::string& fen, Depth depth);
+    // counts the leaf nodes, passing each root move with its count to onRootMove
+    std::uint64_t perft(const std::string& fen, Depth depth, const Benchmark::PerftCallback&);
 
     // non blocking call to start searching
     void go(Search::LimitsType&);
     // non blocking call to stop searching
     void stop();
 
-    // blocking call to wait for search to finish
+    // blocking call to wait for search to finish, and for search_clear()
     void wait_for_search_finished();
+    // blocking call to wait for search_clear() only, it doesn't stop a search
+    void wait_for_search_clear();
     // set a new position, moves are in UCI format
     void set_position(const std::string& fen, const std::vector<std::string>& moves);
+    // same, from a board given square by square and moves in internal format
+    void set_position(const Piece              board[SQUARE_NB],
+                      Color                    us,
+                      int                      rule60,
+                      int                      gamePly,
+                      const std::vector<Move>& moves);
 
     // modifiers
 
     void set_numa_config_from_option(const std::string& o);
-    void resize_threads();
+    void resize_threads(bool keepWorkers = false);
     void set_tt_size(size_t mb);
+    bool save_tt(const std::string& file);
+    bool load_tt(const std::string& file);
     void set_ponderhit(bool);
     void search_clear();
 
@@ -78,16 +143,35 @@ class Engine {
     void set_on_update_full(std::function<void(const InfoFull&)>&&);
     void set_on_iter(std::function<void(const InfoIter&)>&&);
     void set_on_bestmove(std::function<void(std::string_view, std::string_view)>&&);
+    void set_on_verify_network(std::function<void(std::string_view)>&&);
+    void set_on_info_string(std::function<void(const std::string&)>&&);
+
+    // creates a session sharing the network, with its own threads and hash
+    std::unique_ptr<SearchSession>
+    create_session(size_t threadCount, size_t hashMb, Search::SearchManager::UpdateContext ctx);
 
     // network related
 
-    void verify_network() const;
+    // reports the network in use, and without a usable one terminates the process,
+    // or returns false if exitOnError is false. A network still being loaded for
+    // EvalFile is waited for and used from now on.
+    bool verify_network(bool exitOnError = true);
+    bool network_loaded() const;
     void load_network(const std::string& file);
     void save_network(const std::optional<std::string>& file);
+    void save_network_mapped(const std::string& file);
+    void set_network_sharing(bool enabled);
+
+    // generates an endgame table, see tablebase.h
+    std::string generate_tablebase(const std::string& material);
+
+    // searches for a coordinator on another host, see distributed.h
+    bool serve_cluster(int port, const std::string& address);
 
     // utility functions
 
-    void trace_eval() const;
+    void  trace_eval();
+    Value evaluate();  // Static eval of the current position, VALUE_NONE if in check
 
     const OptionsMap& get_options() const;
     OptionsMap&       get_options();
@@ -99,6 +183,11 @@ class Engine {
     std::string                            get_numa_config_as_string() const;
     std::string                            numa_config_information_as_string() const;
     std::string                            thread_binding_information_as_string() const;
+    std::string                            large_pages_information_as_string() const;
+    std::string                            search_stats(bool json) const;
+    Search::StatsSnapshot                  search_stats_total() const;
+    std::vector<Benchmark::MicroResult>    microbench();
+    size_t                                 label(std::istream& in, std::ostream& out, bool qsearch);
 
    private:
     const std::string binaryDirectory;
@@ -108,13 +197,36 @@ class Engine {
     Position     pos;
     StateListPtr states;
     Square       capSq;
+    GameSetup    game;
 
     OptionsMap                          options;
     ThreadPool                          threads;
     TranspositionTable                  tt;
     NumaReplicated<Eval::NNUE::Network> network;
-
-    Search::SearchManager::UpdateContext updateContext;
+    std::string                         networkFile;  // What the network in use was loaded from
+    Book                                book;
+    Distributed::Outbox                 clusterOutbox;
+    Distributed::Coordinator            cluster{tt, clusterOutbox};
+
+    Search::SearchManager::UpdateContext    updateContext;
+    std::function<void(std::string_view)>   onVerifyNetwork;
+    std::function<void(const std::string&)> onInfoString;
+
+    // Used by evaluate(), with the version of the network the caches were set for
+    std::unique_ptr<Eval::NNUE::AccumulatorStack>  evalAccumulators;
+    std::unique_ptr<Eval::NNUE::AccumulatorCaches> evalCaches;
+    std::uint64_t                                  evalNetworkVersion = 0;
+
+    // A network loaded in the background, which replaces the one in use at the next go
+    std::thread       networkLoader;
+    std::atomic<bool> networkLoaded{false};
+    std::string       loadingFile;
+
+    void load_network_in_background(const std::string& file);
+    void install_loaded_network();
+    bool verify_network_in_use(bool exitOnError) const;
+
+    void book_learn(const Position& rootPos, const Search::RootMove& rm, Depth depth);
 };
 
 }  // namespace Stockfish
@@ -22,13 +22,16 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <memory>
 #include <sstream>
 #include <tuple>
+#include <vector>
 
 #include "nnue/network.h"
 #include "nnue/nnue_misc.h"
+#include "perf.h"
 #include "position.h"
 #include "types.h"
 #include "uci.h"
@@ -36,18 +39,13 @@
 
 namespace Stockfish {
 
-// Evaluate is the evaluator for the outer world. It returns a static evaluation
-// of the position from the point of view of the side to move.
-Value Eval::evaluate(const Eval::NNUE::Network& network,
-                     const Position&            pos,
-                     NNUE::AccumulatorCaches&   caches,
-                     int                        optimism) {
+namespace {
 
-    assert(!pos.checkers());
+// Combines the two parts of the network output into the final evaluation
+Value blend(const Position& pos, int psqt, int positional, int optimism) {
 
-    auto [psqt, positional] = network.evaluate(pos, &caches.cache);
-    Value nnue              = psqt + positional;
-    int   nnueComplexity    = std::abs(psqt - positional);
+    Value nnue           = psqt + positional;
+    int   nnueComplexity = std::abs(psqt - positional);
 
     // Blend optimism and eval with nnue complexity
     optimism += optimism * nnueComplexity / 372;
@@ -64,6 +62,86 @@ Value Eval::evaluate(const Eval::NNUE::Network& network,
 
     return v;
 }
+}
+
+// Evaluate is the evaluator for the outer world. It returns a static evaluation
+// of the position from the point of view of the side to move.
+Value Eval::evaluate(const Eval::NNUE::Network& network,
+                     const Position&            pos,
+                     NNUE::AccumulatorStack&    accumulators,
+                     NNUE::AccumulatorCaches&   caches,
+                     int                        optimism,
+                     EvalCache*                 evalCache) {
+
+    assert(!pos.checkers());
+
+    const Perf::Scope<Perf::Nnue> perfScope;
+
+    const Key key = pos.state()->key;
+    int       psqt, positional;
+
+    if (const EvalCache::Entry* e = evalCache ? evalCache->probe(key) : nullptr)
+    {
+        ++evalCache->hits;
+        psqt       = e->psqt;
+        positional = e->positional;
+    }
+    else
+    {
+        std::tie(psqt, positional) = network.evaluate(pos, accumulators, &caches.cache);
+        if (evalCache)
+            evalCache->save(key, psqt, positional);
+    }
+
+    return blend(pos, psqt, positional, optimism);
+}
+
+// Evaluates unrelated positions at once with the batched network API, which
+// is faster than evaluating them one by one. None of them may be in check.
+std::vector<Value> Eval::evaluate_batch(const Eval::NNUE::Network&          network,
+                                        const std::vector<const Position*>& positions,
+                                        NNUE::AccumulatorStack&             accumulators,
+                                        NNUE::AccumulatorCaches&            caches) {
+
+    const auto         outputs = network.evaluate_batch(positions, accumulators, &caches.cache);
+    std::vector<Value> values(positions.size());
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        assert(!positions[i]->checkers());
+
+        const auto [psqt, positional] = outputs[i];
+        values[i]                     = blend(*positions[i], psqt, positional, VALUE_ZERO);
+    }
+
+    return values;
+}
+
+void Eval::EvalCache::resize(size_t mbSize) {
+
+    const size_t newCount = mbSize * 1024 * 1024 / sizeof(Entry);
+
+    if (newCount == count)
+        return;
+
+    table.reset();
+    count = 0;
+
+    if (newCount)
+    {
+        table = make_unique_large_page<Entry[]>(newCount);
+        count = newCount;
+    }
+
+    clear();
+}
+
+void Eval::EvalCache::clear() {
+
+    if (count)
+        std::memset(table.get(), 0, count * sizeof(Entry));
+    hits.reset();
+}
 
 // Like evaluate(), but instead of returning a value, it returns
 // a string (suitable for outputting to stdout) that contains the detailed
@@ -74,21 +152,23 @@ std::string Eval::trace(Position& pos, const Eval::NNUE::Network& network) {
     if (pos.checkers())
         return "Final evaluation: none (in check)";
 
-    auto caches = std::make_unique<Eval::NNUE::AccumulatorCaches>(network);
+    // The trace only needs the position and one removal on top of it
+    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>(2);
+    auto caches       = std::make_unique<Eval::NNUE::AccumulatorCaches>(network);
 
     std::stringstream ss;
     ss << std::showpoint << std::noshowpos << std::fixed << std::setprecision(2);
 
-    ss << '\n' << NNUE::trace(pos, network, *caches) << '\n';
+    ss << '\n' << NNUE::trace(pos, network, *accumulators, *caches) << '\n';
 
     ss << std::showpoint << std::showpos << std::fixed << std::setprecision(2) << std::setw(15);
 
-    auto [psqt, positional] = network.evaluate(pos, &caches->cache);
+    auto [psqt, positional] = network.evaluate(pos, *accumulators, &caches->cache);
     Value v                 = psqt + positional;
     v                       = pos.side_to_move() == WHITE ? v : -v;
     ss << "NNUE evaluation        " << 0.01 * UCIEngine::to_cp(v, pos) << " (white side)\n";
 
-    v = evaluate(network, pos, *caches, VALUE_ZERO);
+    v = evaluate(network, pos, *accumulators, *caches, VALUE_ZERO);
     v = pos.side_to_move() == WHITE ? v : -v;
     ss << "Final evaluation       " << 0.01 * UCIEngine::to_cp(v, pos) << " (white side)";
     ss << " [with scaled NNUE, ...]";
@@ -19,8 +19,13 @@
 #ifndef EVALUATE_H_INCLUDED
 #define EVALUATE_H_INCLUDED
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
+#include "memory.h"
+#include "misc.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -37,15 +42,60 @@ namespace Eval {
 
 namespace NNUE {
 class Network;
+class AccumulatorStack;
 struct AccumulatorCaches;
 }
 
+// EvalCache remembers the raw network output of recently evaluated positions,
+// so that a position searched again after its TT entry has been overwritten, or
+// in the next MultiPV line, does not need another forward pass. Each search
+// thread owns one, it is keyed by the position key without the rule60 part
+// since the network does not see the move counter.
+class EvalCache {
+   public:
+    struct Entry {
+        Key          key;
+        std::int32_t psqt, positional;
+    };
+
+    void resize(size_t mbSize);
+    void clear();
+
+    const Entry* probe(Key key) const {
+        if (!count)
+            return nullptr;
+
+        const Entry& e = entry(key);
+        return e.key == key ? &e : nullptr;
+    }
+
+    void save(Key key, std::int32_t psqt, std::int32_t positional) {
+        if (count)
+            entry(key) = {key, psqt, positional};
+    }
+
+    RelaxedCounter hits;
+
+   private:
+    Entry& entry(Key key) const { return table[mul_hi64(key, count)]; }
+
+    LargePagePtr<Entry[]> table;
+    size_t                count = 0;
+};
+
 std::string trace(Position& pos, const Eval::NNUE::Network& network);
 
 Value evaluate(const NNUE::Network&           network,
                const Position&                pos,
+               Eval::NNUE::AccumulatorStack&  accumulators,
                Eval::NNUE::AccumulatorCaches& caches,
-               int                            optimism);
+               int                            optimism,
+               EvalCache*                     evalCache = nullptr);
+
+std::vector<Value> evaluate_batch(const NNUE::Network&                network,
+                                  const std::vector<const Position*>& positions,
+                                  Eval::NNUE::AccumulatorStack&       accumulators,
+                                  Eval::NNUE::AccumulatorCaches&      caches);
 
 }  // namespace Eval
 
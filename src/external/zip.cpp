@@ -1718,6 +1718,66 @@ int zip_entry_extract(
     return (mz_zip_reader_extract_to_callback(pzip, idx, on_extract, arg, 0)) ? 0 : ZIP_EINVIDX;
 }
 
+struct zip_entry_reader_t {
+    mz_zip_reader_extract_iter_state* iter;
+};
+
+struct zip_entry_reader_t* zip_entry_reader_open(struct zip_t* zip) {
+    mz_zip_archive*            pzip   = NULL;
+    struct zip_entry_reader_t* reader = NULL;
+
+    if (!zip)
+    {
+        // zip_t handler is not initialized
+        return NULL;
+    }
+
+    pzip = &(zip->archive);
+    if (pzip->m_zip_mode != MZ_ZIP_MODE_READING || zip->entry.index < (ssize_t) 0)
+    {
+        // the entry is not found or we do not have read access
+        return NULL;
+    }
+
+    reader = (struct zip_entry_reader_t*) calloc((size_t) 1, sizeof(struct zip_entry_reader_t));
+    if (!reader)
+    {
+        return NULL;
+    }
+
+    reader->iter = mz_zip_reader_extract_iter_new(pzip, (mz_uint) zip->entry.index, 0);
+    if (!reader->iter)
+    {
+        CLEANUP(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+size_t zip_entry_reader_read(struct zip_entry_reader_t* reader, void* buf, size_t bufsize) {
+    if (!reader)
+    {
+        return 0;
+    }
+
+    return mz_zip_reader_extract_iter_read(reader->iter, buf, bufsize);
+}
+
+int zip_entry_reader_close(struct zip_entry_reader_t* reader) {
+    mz_bool ok;
+
+    if (!reader)
+    {
+        return ZIP_ENOINIT;
+    }
+
+    ok = mz_zip_reader_extract_iter_free(reader->iter);
+    CLEANUP(reader);
+
+    return ok ? 0 : ZIP_EFREAD;
+}
+
 ssize_t zip_entries_total(struct zip_t* zip) {
     if (!zip)
     {
@@ -367,6 +367,47 @@ zip_entry_extract(struct zip_t* zip,
                   size_t (*on_extract)(void* arg, uint64_t offset, const void* data, size_t size),
                   void* arg);
 
+/**
+ * @struct zip_entry_reader_t
+ *
+ * This data structure is used to extract a zip entry piece by piece.
+ */
+struct zip_entry_reader_t;
+
+/**
+ * Opens a reader which extracts the current zip entry as it is read, without
+ * a buffer for the whole entry.
+ *
+ * @param zip zip archive handler.
+ *
+ * @return the reader handler, NULL on error.
+ */
+extern ZIP_EXPORT struct zip_entry_reader_t* zip_entry_reader_open(struct zip_t* zip);
+
+/**
+ * Extracts the next bytes of the zip entry.
+ *
+ * @param reader reader handler.
+ * @param buf output buffer.
+ * @param bufsize output buffer size (in bytes).
+ *
+ * @return the number of bytes extracted, less than bufsize only at the end
+ *         of the entry or on error.
+ */
+extern ZIP_EXPORT size_t zip_entry_reader_read(struct zip_entry_reader_t* reader,
+                                               void*                      buf,
+                                               size_t                     bufsize);
+
+/**
+ * Closes the reader.
+ *
+ * @param reader reader handler.
+ *
+ * @return the return code - 0 on success, negative number (< 0) on error
+ *         (e.g. the entry is corrupted).
+ */
+extern ZIP_EXPORT int zip_entry_reader_close(struct zip_entry_reader_t* reader);
+
 /**
  * Returns the number of all entries (files and directories) in the zip archive.
  *
@@ -0,0 +1,186 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The main() of a fat binary, built by "make fat". The whole engine is compiled
+// once for each architecture of FAT_ARCHS, each copy in a namespace of its own
+// and with its own entry, fat_main_<arch>(). The copies are linked together
+// with their global constructors moved to a section of their own, fat_init_<arch>,
+// so that only the constructors of the copy which runs are called: the others
+// may use instructions this CPU doesn't have.
+//
+// The architecture is chosen from CPUID once at startup, and can be forced
+// with the PIKAFISH_ARCH environment variable, e.g. PIKAFISH_ARCH=x86-64-avx2.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using InitFunc = void (*)();
+
+extern "C" const char* fat_dispatch_info();
+
+#define FAT_VARIANT(id) \
+    extern "C" int      fat_main_##id(int, char*[]); \
+    extern "C" InitFunc __start_fat_init_##id[] __attribute__((weak)); \
+    extern "C" InitFunc __stop_fat_init_##id[] __attribute__((weak));
+
+#define FAT_ENTRY(id, name, supported) \
+    {name, supported, fat_main_##id, __start_fat_init_##id, __stop_fat_init_##id},
+
+#ifdef FAT_HAS_x86_64_vnni512
+FAT_VARIANT(x86_64_vnni512)
+#endif
+#ifdef FAT_HAS_x86_64_vnni256
+FAT_VARIANT(x86_64_vnni256)
+#endif
+#ifdef FAT_HAS_x86_64_avx512
+FAT_VARIANT(x86_64_avx512)
+#endif
+#ifdef FAT_HAS_x86_64_avxvnni
+FAT_VARIANT(x86_64_avxvnni)
+#endif
+#ifdef FAT_HAS_x86_64_bmi2
+FAT_VARIANT(x86_64_bmi2)
+#endif
+#ifdef FAT_HAS_x86_64_avx2
+FAT_VARIANT(x86_64_avx2)
+#endif
+#ifdef FAT_HAS_x86_64_sse41_popcnt
+FAT_VARIANT(x86_64_sse41_popcnt)
+#endif
+#ifdef FAT_HAS_x86_64_ssse3
+FAT_VARIANT(x86_64_ssse3)
+#endif
+#ifdef FAT_HAS_x86_64
+FAT_VARIANT(x86_64)
+#endif
+
+namespace {
+
+struct Variant {
+    const char* name;
+    bool (*supported)();
+    int (*run)(int, char*[]);
+    InitFunc* initBegin;
+    InitFunc* initEnd;
+};
+
+// pext is microcoded, and much slower than its emulation, before Zen 3
+[[maybe_unused]] bool fast_pext() {
+    return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1")
+        && !__builtin_cpu_is("znver2");
+}
+
+[[maybe_unused]] bool has_avx512() {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && fast_pext();
+}
+
+[[maybe_unused]] bool has_vnni512() {
+    return has_avx512() && __builtin_cpu_supports("avx512vnni")
+        && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl");
+}
+
+// The best first, the last one must run anywhere
+const Variant Variants[] = {
+#ifdef FAT_HAS_x86_64_vnni512
+  FAT_ENTRY(x86_64_vnni512, "x86-64-vnni512", has_vnni512)
+#endif
+#ifdef FAT_HAS_x86_64_vnni256
+  FAT_ENTRY(x86_64_vnni256, "x86-64-vnni256", has_vnni512)
+#endif
+#ifdef FAT_HAS_x86_64_avx512
+  FAT_ENTRY(x86_64_avx512, "x86-64-avx512", has_avx512)
+#endif
+#ifdef FAT_HAS_x86_64_avxvnni
+  FAT_ENTRY(x86_64_avxvnni, "x86-64-avxvnni",
+            [] { return __builtin_cpu_supports("avxvnni") && fast_pext(); })
+#endif
+#ifdef FAT_HAS_x86_64_bmi2
+  FAT_ENTRY(x86_64_bmi2,
+            "x86-64-bmi2",
+            [] { return __builtin_cpu_supports("avx2") && fast_pext(); })
+#endif
+#ifdef FAT_HAS_x86_64_avx2
+  FAT_ENTRY(x86_64_avx2,
+            "x86-64-avx2",
+            [] { return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi"); })
+#endif
+#ifdef FAT_HAS_x86_64_sse41_popcnt
+  FAT_ENTRY(x86_64_sse41_popcnt,
+            "x86-64-sse41-popcnt",
+            [] { return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt"); })
+#endif
+#ifdef FAT_HAS_x86_64_ssse3
+  FAT_ENTRY(x86_64_ssse3, "x86-64-ssse3", [] { return __builtin_cpu_supports("ssse3"); })
+#endif
+#ifdef FAT_HAS_x86_64
+  FAT_ENTRY(x86_64, "x86-64", [] { return true; })
+#endif
+};
+
+std::string dispatchInfo;
+
+const Variant& select() {
+
+    const Variant* best = nullptr;
+    for (const auto& v : Variants)
+        if (!best && v.supported())
+            best = &v;
+
+    const char* forced = std::getenv("PIKAFISH_ARCH");
+
+    if (forced && *forced)
+    {
+        for (const auto& v : Variants)
+            if (!std::strcmp(v.name, forced))
+            {
+                dispatchInfo = std::string(v.name) + " (forced by PIKAFISH_ARCH, CPUID gives "
+                             + (best ? best->name : "none") + ")";
+                return v;
+            }
+
+        std::cerr << "Unknown PIKAFISH_ARCH " << forced << ", ignored" << std::endl;
+    }
+
+    if (!best)
+        best = &Variants[sizeof(Variants) / sizeof(Variant) - 1];
+
+    dispatchInfo = std::string(best->name) + " (from CPUID, built for";
+    for (const auto& v : Variants)
+        dispatchInfo += std::string(" ") + v.name;
+    dispatchInfo += ")";
+
+    return *best;
+}
+
+}  // namespace
+
+extern "C" const char* fat_dispatch_info() { return dispatchInfo.c_str(); }
+
+int main(int argc, char* argv[]) {
+
+    __builtin_cpu_init();
+
+    const Variant& v = select();
+
+    for (InitFunc* f = v.initBegin; f != v.initEnd; ++f)
+        (*f)();
+
+    return v.run(argc, argv);
+}
@@ -25,99 +25,6 @@ namespace Stockfish {
 // clang-format off
 // Use precomputed magics if pext is not available,
 // since the magics generation is very slow.
-constexpr Bitboard RookMagicsInit[SQUARE_NB] = {
-    B(0x4040000414000A40, 0x8A08C0010C100400),
-    B(0x0520004802000020, 0x2000030408010008),
-    B(0x7040010400065040, 0x0018400000034001),
-    B(0x4300008808100040, 0x40084200E4040004),
-    B(0x0400200200400100, 0x40080001000000A8),
-    B(0x4040010001200049, 0x0019808808840100),
-    B(0x064002A0C000410B, 0x000500000A200000),
-    B(0x0200000900040084, 0x0800810000064000),
-    B(0x0080010400860A02, 0x0000088000400121),
-    B(0x50002000085A0000, 0x20483041002001DA),
-    B(0x028A500012000060, 0x8010000120101204),
-    B(0x4000400110002040, 0x80200022A0040210),
-    B(0x0440400101000080, 0x0900010040080000),
-    B(0x00BA800080818008, 0x4200500401000200),
-    B(0x0000800200084010, 0x0401000800000080),
-    B(0x184080009024A104, 0x0008050004000002),
-    B(0x0100400440900010, 0x818280000022A200),
-    B(0x0C10800001200900, 0x460480A042200120),
-    B(0x002060100004C392, 0x80005840C0080300),
-    B(0x8220008400204000, 0x2000102800008000),
-    B(0x0A18002400004000, 0x0800900002004000),
-    B(0x2008201000302020, 0x0010000010A50000),
-    B(0x008C001000240020, 0x0204000012008000),
-    B(0x0000020008008010, 0x0440100426200020),
-    B(0x1080010004108002, 0x1002100000008000),
-    B(0x6000008000020214, 0x0914040403015061),
-    B(0x2008004000048A18, 0x4042004008010228),
-    B(0xA830100008000480, 0x5C30400000000020),
-    B(0x000802080C000180, 0x001000000000C440),
-    B(0x0291680010002120, 0x8010800920000040),
-    B(0x2011020008002040, 0x0002400A40020401),
-    B(0x10000400B0004000, 0x0901801002010000),
-    B(0x0800900100040008, 0x2020020200010020),
-    B(0x0000600008000800, 0x010200004A020081),
-    B(0x2002086040001220, 0x1044048420402100),
-    B(0x2211008020002101, 0x0900080840008104),
-    B(0x1101242108040004, 0x40400000000000A4),
-    B(0x2400040084220000, 0x4000040080400000),
-    B(0x0280200080840040, 0x0020000000041430),
-    B(0x0018000050080010, 0x4008080020908008),
-    B(0x000CA10000240004, 0x1000400840186000),
-    B(0x0880100400800200, 0x08020800A4820106),
-    B(0x0060400481080021, 0x0400118200101410),
-    B(0x0000002004200004, 0x0800440048300881),
-    B(0x2A10040440300009, 0x0100200500281502),
-    B(0x0E02A42800150200, 0x1080000000090A20),
-    B(0x8088040004004B00, 0x0420000082128104),
-    B(0x2008200142000200, 0x0810004000800C00),
-    B(0x4201200200042200, 0x0448004200020402),
-    B(0x0100800301A01800, 0x1820080200070042),
-    B(0x018C800081016800, 0x0122140050100A01),
-    B(0x0101200040000200, 0x0200004001841220),
-    B(0x0000A00020000200, 0x010000100D104000),
-    B(0x0040400002C28400, 0x0040408008400070),
-    B(0x0000200800008021, 0x0000100842001000),
-    B(0x8020003100028004, 0x4000900100000C0A),
-    B(0x0008000080004000, 0x40001000400000C0),
-    B(0x004A020008008001, 0x0002020004000A02),
-    B(0x0200800200401004, 0x0008100020004001),
-    B(0x0002800200204004, 0x0004006044000080),
-    B(0x2103200040000401, 0x0001000400008440),
-    B(0x09200810A0408408, 0x0002240400061000),
-    B(0x510000124AA00304, 0x000080200A180001),
-    B(0x0122080208004100, 0x0080004090048080),
-    B(0x0010080001000301, 0x10C0020084001001),
-    B(0x0100040084040084, 0x0200040010800200),
-    B(0x0010400A000500A0, 0x3500022D10085010),
-    B(0x1006810000140020, 0x0080010408102004),
-    B(0x6000200040002000, 0x2280024883004800),
-    B(0x0220400020041000, 0x8100020000001000),
-    B(0x000006004C410409, 0x0400058000400040),
-    B(0x00000110041804A2, 0x2600010000002884),
-    B(0x81001A0204100A02, 0x0121000000006000),
-    B(0x000408000C0000A0, 0x6002600310000000),
-    B(0x0000780020840010, 0x6000400000440008),
-    B(0x0230812012001020, 0x200080008A100080),
-    B(0x6822020000102000, 0x0480400048000100),
-    B(0x100C800041002000, 0x10010010C4000081),
-    B(0x0000400240012013, 0x0A04800040002001),
-    B(0x48080204A0022011, 0x0102000000000800),
-    B(0x0108000810041000, 0x2021000000880002),
-    B(0x1001842002002200, 0x0008A04000200202),
-    B(0x0840100008042060, 0x4002082000040000),
-    B(0x0430C22040410001, 0x0010002000004B80),
-    B(0x4410088281000201, 0x8208002000000208),
-    B(0x4000800034408080, 0x04280080002004B0),
-    B(0x0000E00010400004, 0x0400002000048022),
-    B(0x0000400040000170, 0x0204414000000408),
-    B(0x0000004500402202, 0x1043010000048108),
-    B(0x211A200001280000, 0x8608902000084008)
-};
-
 constexpr Bitboard BishopMagicsInit[SQUARE_NB] = {
     B(0x00376C0000480001, 0x0880010041200001),
     B(0x0017E20100000000, 0x0001000000000000),
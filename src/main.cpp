@@ -27,11 +27,12 @@
 
 using namespace Stockfish;
 
-int main(int argc, char* argv[]) {
+namespace {
+
+int run(int argc, char* argv[]) {
 
     std::cout << engine_info() << std::endl;
 
-    Bitboards::init();
     Position::init();
 
     UCIEngine uci(argc, argv);
@@ -42,3 +43,13 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
+
+}  // namespace
+
+#ifdef FAT_ENTRY
+// The entry of this architecture in a fat binary, called by the main() of fat.cpp
+extern "C" int FAT_ENTRY(int argc, char* argv[]);
+extern "C" int FAT_ENTRY(int argc, char* argv[]) { return run(argc, argv); }
+#else
+int main(int argc, char* argv[]) { return run(argc, argv); }
+#endif
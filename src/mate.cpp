@@ -0,0 +1,324 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mate.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "memory.h"
+#include "movegen.h"
+#include "position.h"
+
+namespace Stockfish::Mate {
+
+namespace {
+
+constexpr uint32_t Infinite   = 1u << 30;
+constexpr size_t   BucketSize = 4;
+constexpr uint64_t StopPeriod = 4096;  // Nodes between two calls of the stop callback
+
+uint32_t add(uint32_t a, uint32_t b) { return std::min(a + b, Infinite); }
+
+}  // namespace
+
+// The proof and disproof numbers of a node for the attacker. A proven node is
+// a mate in dist plies, with move the shortest mate or the longest defence.
+struct Solver::Numbers {
+    uint32_t pn, dn;
+    int      dist;
+    Move     move;
+};
+
+// A proof holds for any number of plies left down to its dist, a disproof for
+// any up to its left, and other numbers only for their left.
+struct Solver::Entry {
+    Key      key;
+    uint32_t pn, dn;
+    int16_t  left, dist;
+    Move     move;
+};
+
+struct Solver::Child {
+    Move    move;
+    Numbers n;
+};
+
+Solver::Solver(size_t mbSize) {
+
+    if (mbSize)
+        resize(mbSize);
+}
+
+Solver::~Solver() { aligned_large_pages_free(entries); }
+
+void Solver::resize(size_t mbSize) {
+
+    if (mbSize == tableMb)
+        return;
+
+    aligned_large_pages_free(entries);
+
+    const size_t buckets = std::max(mbSize * 1024 * 1024 / sizeof(Entry) / BucketSize, size_t(1));
+
+    tableMb    = mbSize;
+    entryCount = buckets * BucketSize;
+    entries    = static_cast<Entry*>(aligned_large_pages_alloc(entryCount * sizeof(Entry)));
+
+    if (!entries)
+        entryCount = 0;
+
+    clear();
+}
+
+void Solver::clear() {
+
+    if (entries)
+        std::memset(static_cast<void*>(entries), 0, entryCount * sizeof(Entry));
+}
+
+bool Solver::lookup(Key key, int left, Numbers& n) const {
+
+    if (!entryCount)
+        return false;
+
+    const Entry* bucket = entries + key % (entryCount / BucketSize) * BucketSize;
+
+    for (size_t i = 0; i < BucketSize; ++i)
+        if (bucket[i].key == key)
+        {
+            const Entry& e = bucket[i];
+
+            if (!e.pn ? e.dist > left : !e.dn ? e.left < left : e.left != left)
+                return false;
+
+            n = {e.pn, e.dn, e.dist, e.move};
+            return true;
+        }
+
+    return false;
+}
+
+void Solver::store(Key key, int left, const Numbers& n) {
+
+    if (!entryCount)
+        return;
+
+    Entry* bucket  = entries + key % (entryCount / BucketSize) * BucketSize;
+    Entry* replace = bucket;
+
+    // Replace the entry of the position, else an empty one, else the one which
+    // took the least work, keeping the proofs and disproofs.
+    auto work = [](const Entry& e) {
+        return !e.key ? 0 : !e.pn || !e.dn ? Infinite : add(e.pn, e.dn);
+    };
+
+    for (size_t i = 0; i < BucketSize; ++i)
+    {
+        if (bucket[i].key == key)
+        {
+            replace = &bucket[i];
+            break;
+        }
+
+        if (work(bucket[i]) < work(*replace))
+            replace = &bucket[i];
+    }
+
+    *replace = {key, n.pn, n.dn, int16_t(left), int16_t(n.dist), n.move};
+}
+
+// Fills the moves of the node with the numbers of their positions: the attacker
+// plays its legal checks and the defender its legal evasions. The checks are
+// taken from all the moves, as generate<QUIET_CHECKS>() leaves out some of them,
+// like the direct checks of a blocker moving along the line of a discovered one.
+size_t Solver::expand(Position& pos, int ply, int left, Child* children) {
+
+    const bool attacking = pos.side_to_move() == attacker;
+    ExtMove    moves[MAX_MOVES];
+    StateInfo  st;
+    size_t     count = 0;
+
+    assert(attacking || pos.checkers());
+
+    ExtMove* end =
+      pos.checkers() ? generate<EVASIONS>(pos, moves) : generate<PSEUDO_LEGAL>(pos, moves);
+
+    for (ExtMove* m = moves; m != end; ++m)
+    {
+        if (!pos.legal(*m) || (attacking && !pos.gives_check(*m)))
+            continue;
+
+        Child& c = children[count++];
+        c.move   = *m;
+
+        pos.do_move(*m, st);
+
+        Value result = VALUE_NONE;
+
+        if (pos.rule_judge(result, ply + 1) || result != VALUE_NONE)
+            c.n = {Infinite, 0, 0, Move::none()};
+
+        else if (lookup(pos.key(), left - 1, c.n))
+        {}
+
+        // A defence is initially as hard to prove as it has evasions
+        else if (attacking)
+        {
+            const size_t evasions = count_legal_moves(pos);
+
+            c.n = !evasions     ? Numbers{0, Infinite, 0, Move::none()}
+                : left - 1 == 0 ? Numbers{Infinite, 0, 0, Move::none()}
+                                : Numbers{uint32_t(evasions), 1, 0, Move::none()};
+        }
+        else
+            c.n = {1, 1, 0, Move::none()};
+
+        pos.undo_move(*m);
+    }
+
+    return count;
+}
+
+// The depth-first proof-number search of a node, until its numbers reach one
+// of the thresholds. The attacker minimizes the proof numbers of its moves and
+// the defender their disproof numbers, and the search always goes down the
+// most promising move, for as long as it stays better than the second one.
+Solver::Numbers Solver::search(Position& pos, int ply, int left, uint32_t thPn, uint32_t thDn) {
+
+    if (++nodes % StopPeriod == 0 && (*stopCallback)(nodes))
+        stopped = true;
+
+    const bool attacking = pos.side_to_move() == attacker;
+    Child      children[MAX_MOVES];
+    StateInfo  st;
+    Numbers    n;
+
+    const size_t count = expand(pos, ply, left, children);
+
+    // In terms of the side to move, which minimizes its number and sums the
+    // other one of its moves
+    auto mine   = [=](const Numbers& x) { return attacking ? x.pn : x.dn; };
+    auto theirs = [=](const Numbers& x) { return attacking ? x.dn : x.pn; };
+
+    const uint32_t thMine = attacking ? thPn : thDn, thTheirs = attacking ? thDn : thPn;
+
+    while (true)
+    {
+        uint32_t min = Infinite, second = Infinite, sum = 0;
+        Child*   best = nullptr;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t v = mine(children[i].n);
+
+            sum = add(sum, theirs(children[i].n));
+
+            if (v < min)
+            {
+                second = min;
+                min    = v;
+                best   = &children[i];
+            }
+            else if (v < second)
+                second = v;
+        }
+
+        n.pn   = attacking ? min : sum;
+        n.dn   = attacking ? sum : min;
+        n.dist = 0;
+        n.move = Move::none();
+
+        if (min >= thMine || sum >= thTheirs || stopped)
+            break;
+
+        const uint32_t childMine   = std::min(thMine, second + 1);
+        const uint32_t childTheirs = thTheirs - sum + theirs(best->n);
+
+        pos.do_move(best->move, st);
+        best->n = attacking ? search(pos, ply + 1, left - 1, childMine, childTheirs)
+                            : search(pos, ply + 1, left - 1, childTheirs, childMine);
+        pos.undo_move(best->move);
+    }
+
+    if (stopped)
+        return n;
+
+    // A mate takes the shortest proven move of the attacker, against the longest
+    // defence.
+    if (!n.pn)
+        for (size_t i = 0; i < count; ++i)
+            if (!children[i].n.pn
+                && (n.move == Move::none()
+                    || (attacking ? children[i].n.dist + 1 < n.dist
+                                  : children[i].n.dist + 1 > n.dist)))
+            {
+                n.dist = children[i].n.dist + 1;
+                n.move = children[i].move;
+            }
+
+    store(pos.key(), left, n);
+    return n;
+}
+
+int Solver::solve(Position&                            pos,
+                  int                                  moves,
+                  std::vector<Move>&                   pv,
+                  const std::function<bool(uint64_t)>& stop) {
+
+    const int left = std::min(2 * moves - 1, MAX_PLY - 1);
+
+    pv.clear();
+
+    if (left < 1)
+        return 0;
+
+    // The numbers are those of the attacker
+    if (attacker != pos.side_to_move())
+        clear();
+
+    attacker     = pos.side_to_move();
+    stopCallback = &stop;
+    stopped      = false;
+
+    const Numbers root = search(pos, 0, left, Infinite, Infinite);
+
+    if (stopped || root.pn)
+        return 0;
+
+    // Follow the mate down the table, which may have lost the end of it
+    StateInfo states[MAX_PLY];
+    Numbers   n = root;
+
+    while (n.move != Move::none() && is_legal(pos, n.move))
+    {
+        pos.do_move(n.move, states[pv.size()]);
+        pv.push_back(n.move);
+
+        if (!lookup(pos.key(), left - int(pv.size()), n) || n.pn)
+            break;
+    }
+
+    for (auto it = pv.rbegin(); it != pv.rend(); ++it)
+        pos.undo_move(*it);
+
+    return root.dist;
+}
+
+}  // namespace Stockfish::Mate
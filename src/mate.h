@@ -0,0 +1,90 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MATE_H_INCLUDED
+#define MATE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "types.h"
+
+namespace Stockfish {
+
+class Position;
+
+namespace Mate {
+
+// A df-pn (depth-first proof-number) solver for mates by consecutive checks, as
+// most xiangqi puzzles are: the side to move at the root only plays checks, and
+// the other side all its evasions. The repetitions are judged by rule_judge(),
+// and any of them is a failure for the attacker, so that a perpetual check is
+// never a mate and that no proof depends on the path to a position.
+class Solver {
+
+   public:
+    explicit Solver(size_t mbSize = 0);
+    ~Solver();
+
+    Solver(const Solver&)            = delete;
+    Solver& operator=(const Solver&) = delete;
+
+    // The table is only reallocated if its size changes, and only cleared by
+    // clear() or when the attacker changes, see solve().
+    void resize(size_t mbSize);
+    void clear();
+
+    // Looks for a mate in at most the given number of moves. Returns its length
+    // in plies, 0 if there is none or if the search was stopped, and its line
+    // in pv as far as the table still has it. The callback is called now and
+    // then with the nodes searched so far, and stops the search by returning
+    // true. Entries are kept from one call to the next, so that looking for
+    // shorter and shorter mates, or again after a move, is cheap.
+    int solve(Position&                            pos,
+              int                                  moves,
+              std::vector<Move>&                   pv,
+              const std::function<bool(uint64_t)>& stop);
+
+    uint64_t nodes_searched() const { return nodes; }
+
+   private:
+    struct Entry;
+    struct Child;
+    struct Numbers;
+
+    Numbers search(Position& pos, int ply, int left, uint32_t thPn, uint32_t thDn);
+    size_t  expand(Position& pos, int ply, int left, Child* children);
+    bool    lookup(Key key, int left, Numbers& n) const;
+    void    store(Key key, int left, const Numbers& n);
+
+    Entry*                               entries    = nullptr;
+    size_t                               entryCount = 0;
+    size_t                               tableMb    = 0;
+    Color                                attacker   = COLOR_NB;
+    uint64_t                             nodes   = 0;
+    bool                                 stopped = false;
+    const std::function<bool(uint64_t)>* stopCallback;
+};
+
+}  // namespace Mate
+
+}  // namespace Stockfish
+
+#endif  // #ifndef MATE_H_INCLUDED
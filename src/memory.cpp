@@ -18,14 +18,23 @@
 
 #include "memory.h"
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #if __has_include("features.h")
     #include <features.h>
 #endif
 
-#if defined(__linux__) && !defined(__ANDROID__)
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <sys/file.h>
     #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) \
@@ -184,10 +193,103 @@ void* aligned_large_pages_alloc(size_t allocSize) {
     return mem;
 }
 
+void set_max_huge_page(size_t) {}
+
+size_t huge_page_size(const void*) { return 0; }
+
 #else
 
+    #if defined(__linux__) && defined(MAP_HUGETLB)
+        #ifndef MAP_HUGE_SHIFT
+            #define MAP_HUGE_SHIFT 26
+        #endif
+
+namespace {
+
+constexpr size_t HugePageSizes[] = {size_t(1) << 30, size_t(1) << 21};  // Biggest first
+
+std::atomic<size_t> maxHugePage{0};  // 0 for transparent huge pages only
+
+// The blocks mapped from a hugetlb pool, with their size and page size, which
+// are needed to unmap them
+std::mutex                                    hugeBlocksMutex;
+std::map<void*, std::pair<size_t, size_t>> hugeBlocks;
+
+// Maps the memory from a hugetlb pool, on the biggest enabled page size which
+// wastes at most an eighth of the size when rounding up to whole pages. The
+// pages are reserved by mmap(), so a pool which is too small makes it fail
+// instead of the first access.
+void* hugetlb_alloc(size_t size) {
+
+    for (size_t page : HugePageSizes)
+    {
+        const size_t rounded = (size + page - 1) / page * page;
+
+        if (page > maxHugePage || rounded - size > size / 8)
+            continue;
+
+        int log2 = 0;
+        while ((size_t(1) << log2) < page)
+            ++log2;
+
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2 << MAP_HUGE_SHIFT);
+        void*     mem   = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+        if (mem != MAP_FAILED)
+        {
+            std::lock_guard<std::mutex> lock(hugeBlocksMutex);
+            hugeBlocks[mem] = {rounded, page};
+            return mem;
+        }
+    }
+
+    return nullptr;
+}
+
+// Returns false if mem was not mapped by hugetlb_alloc()
+bool hugetlb_free(void* mem) {
+
+    std::pair<size_t, size_t> block;
+    {
+        std::lock_guard<std::mutex> lock(hugeBlocksMutex);
+        auto                        it = hugeBlocks.find(mem);
+        if (it == hugeBlocks.end())
+            return false;
+
+        block = it->second;
+        hugeBlocks.erase(it);
+    }
+
+    munmap(mem, block.first);
+    return true;
+}
+
+}  // namespace
+
+void set_max_huge_page(size_t bytes) { maxHugePage = bytes; }
+
+size_t huge_page_size(const void* mem) {
+    std::lock_guard<std::mutex> lock(hugeBlocksMutex);
+    auto                        it = hugeBlocks.find(const_cast<void*>(mem));
+    return it == hugeBlocks.end() ? 0 : it->second.second;
+}
+
+    #else
+
+void set_max_huge_page(size_t) {}
+
+size_t huge_page_size(const void*) { return 0; }
+
+    #endif
+
 void* aligned_large_pages_alloc(size_t allocSize) {
 
+    #if defined(__linux__) && defined(MAP_HUGETLB)
+    if (maxHugePage)
+        if (void* mem = hugetlb_alloc(allocSize))
+            return mem;
+    #endif
+
     #if defined(__linux__)
     constexpr size_t alignment = 2 * 1024 * 1024;  // assumed 2MB page size
     #else
@@ -223,7 +325,212 @@ void aligned_large_pages_free(void* mem) {
 
 #else
 
-void aligned_large_pages_free(void* mem) { std_aligned_free(mem); }
+void aligned_large_pages_free(void* mem) {
+
+    #if defined(__linux__) && defined(MAP_HUGETLB)
+    if (mem && hugetlb_free(mem))
+        return;
+    #endif
+
+    std_aligned_free(mem);
+}
+
+#endif
+
+
+// map_file() maps a file privately, so that pages are shared with the page cache
+// (and with other processes mapping the same file) until they are written to.
+
+#if defined(_WIN32)
+
+void* map_file(const std::string& path, size_t& size) {
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER fileSize;
+    HANDLE        mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMapping(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+
+    CloseHandle(file);
+    if (!mapping)
+        return nullptr;
+
+    void* mem = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+
+    size = mem ? size_t(fileSize.QuadPart) : 0;
+    return mem;
+}
+
+void unmap_file(void* mem, size_t) {
+
+    if (mem)
+        UnmapViewOfFile(mem);
+}
+
+#else
+
+void* map_file(const std::string& path, size_t& size) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat st;
+    void*       mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        mem = mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    size = size_t(st.st_size);
+    return mem;
+}
+
+    #if !defined(__ANDROID__)
+namespace {
+
+// The mappings of shared memory segments, with the descriptor holding the shared
+// lock of the process on the segment and the name of the segment.
+std::mutex                                   sharedMutex;
+std::map<void*, std::pair<int, std::string>> sharedMappings;
+
+}  // namespace
+    #endif
+
+void unmap_file(void* mem, size_t size) {
+
+    if (!mem)
+        return;
+
+    munmap(mem, size);
+
+    #if !defined(__ANDROID__)
+    std::lock_guard<std::mutex> lock(sharedMutex);
+
+    auto it = sharedMappings.find(mem);
+    if (it == sharedMappings.end())
+        return;
+
+    // The last process to use the segment removes it
+    auto [fd, name] = it->second;
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+        shm_unlink(name.c_str());
+
+    close(fd);
+    sharedMappings.erase(it);
+    #endif
+}
+
+#endif
+
+
+// map_shared_memory() uses POSIX shared memory, where available. Creation is
+// exclusive, so exactly one process initializes the contents of a segment. It
+// holds an exclusive lock on the segment meanwhile, and then marks the contents
+// as complete after their end. The other processes hold a shared lock for as
+// long as they use the segment: a segment they find incomplete once they get
+// the lock was left by a creator which died, and is made again.
+
+#if defined(_WIN32) || defined(__ANDROID__)
+
+void* map_shared_memory(const std::string&, size_t, const std::function<void(void*)>&) {
+    return nullptr;
+}
+
+#else
+
+namespace {
+
+constexpr uint64_t SegmentComplete = 0x70696b6166697368;
+
+// Whether the segment holds complete contents of the given size, with the
+// shared lock of the caller. Waits for a creator which didn't size it yet.
+bool segment_complete(int fd, size_t size) {
+
+    struct stat st;
+    uint64_t    mark = 0;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        if (flock(fd, LOCK_SH) != 0 || fstat(fd, &st) != 0)
+            return false;
+
+        if (st.st_size)
+            break;
+
+        flock(fd, LOCK_UN);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return size_t(st.st_size) == size + sizeof(mark)
+        && pread(fd, &mark, sizeof(mark), off_t(size)) == sizeof(mark) && mark == SegmentComplete;
+}
+
+}  // namespace
+
+void* map_shared_memory(const std::string&                name,
+                        size_t                            size,
+                        const std::function<void(void*)>& init) {
+
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd != -1)
+        {
+            void* mem = MAP_FAILED;
+            if (flock(fd, LOCK_EX) == 0 && ftruncate(fd, off_t(size + sizeof(uint64_t))) == 0)
+                mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (mem == MAP_FAILED)
+            {
+                close(fd);
+                shm_unlink(name.c_str());
+                return nullptr;
+            }
+
+            init(mem);
+            munmap(mem, size);
+
+            if (pwrite(fd, &SegmentComplete, sizeof(SegmentComplete), off_t(size))
+                  != sizeof(SegmentComplete)
+                || flock(fd, LOCK_SH) != 0)
+            {
+                close(fd);
+                shm_unlink(name.c_str());
+                return nullptr;
+            }
+        }
+        else if ((fd = shm_open(name.c_str(), O_RDONLY, 0)) == -1)
+            return nullptr;
+
+        else if (!segment_complete(fd, size))
+        {
+            close(fd);
+            shm_unlink(name.c_str());
+            continue;
+        }
+
+        void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (mem == MAP_FAILED)
+        {
+            close(fd);
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        sharedMappings[mem] = {fd, name};
+        return mem;
+    }
+
+    return nullptr;
+}
 
 #endif
 }  // namespace Stockfish
@@ -22,8 +22,10 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <new>
+#include <string>
 #include <type_traits>
 #include <utility>
 
@@ -37,6 +39,23 @@ void  std_aligned_free(void* ptr);
 void* aligned_large_pages_alloc(size_t size);
 // nop if mem == nullptr
 void aligned_large_pages_free(void* mem);
+// On Linux, lets aligned_large_pages_alloc() take explicit huge pages of up to
+// the given size (2MB or 1GB) from the hugetlb pools, before falling back to
+// transparent huge pages. 0 only uses the latter. Affects later allocations.
+void set_max_huge_page(size_t bytes);
+// size of the hugetlb pages mem is on, 0 if it was not allocated from a pool
+size_t huge_page_size(const void* mem);
+// private, writable (copy-on-write) mapping of a whole file, nullptr on failure
+void* map_file(const std::string& path, size_t& size);
+// nop if mem == nullptr
+void unmap_file(void* mem, size_t size);
+// private, writable (copy-on-write) mapping of a named shared memory segment,
+// created and filled by init() if it does not exist yet, or if its creator died
+// before filling it. The last process to release the segment removes it.
+// nullptr if unsupported or on failure. Must be released with unmap_file().
+void* map_shared_memory(const std::string&                name,
+                        size_t                            size,
+                        const std::function<void(void*)>& init);
 
 // frees memory which was placed there with placement new.
 // works for both single objects and arrays of unknown bound
@@ -154,6 +173,51 @@ std::enable_if_t<std::is_array_v<T>, LargePagePtr<T>> make_unique_large_page(siz
     return LargePagePtr<T>(memory);
 }
 
+//
+//
+// large page or file mapping backed unique ptr
+//
+//
+
+// Deleter for objects which live either in large page memory or inside a file
+// mapping obtained with map_file(), in which case the whole mapping is released.
+template<typename T>
+struct MappableDeleter {
+    void*  mapping     = nullptr;
+    size_t mappingSize = 0;
+
+    void operator()(T* ptr) const {
+        if (!mapping)
+            return memory_deleter<T>(ptr, aligned_large_pages_free);
+
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "Objects inside a file mapping are never destructed");
+        unmap_file(mapping, mappingSize);
+    }
+};
+
+template<typename T>
+using MappablePtr = std::unique_ptr<T, MappableDeleter<T>>;
+
+template<typename T, typename... Args>
+MappablePtr<T> make_unique_mappable(Args&&... args) {
+    static_assert(alignof(T) <= 4096,
+                  "aligned_large_pages_alloc() may fail for such a big alignment requirement of T");
+
+    T* obj = memory_allocator<T>(aligned_large_pages_alloc, std::forward<Args>(args)...);
+
+    return MappablePtr<T>(obj);
+}
+
+// Takes ownership of a mapping returned by map_file(), with the object placed
+// at the given byte offset. The caller guarantees the bytes form a valid T.
+template<typename T>
+MappablePtr<T> make_mapped(void* mapping, size_t mappingSize, size_t offset) {
+    T* obj = reinterpret_cast<T*>(static_cast<char*>(mapping) + offset);
+    ASSERT_ALIGNED(obj, alignof(T));
+    return MappablePtr<T>(obj, MappableDeleter<T>{mapping, mappingSize});
+}
+
 //
 //
 // aligned unique ptr
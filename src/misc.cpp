@@ -22,6 +22,7 @@
 #include <cctype>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -34,6 +35,11 @@
 #include "types.h"
 #include "external/zip.h"
 
+#ifdef FAT_BINARY
+// Which architecture of the fat binary runs, and why, see fat.cpp
+extern "C" const char* fat_dispatch_info();
+#endif
+
 namespace Stockfish {
 
 namespace {
@@ -228,8 +234,16 @@ std::string compiler_info() {
     compiler += "(undefined architecture)";
 #endif
 
+#if defined(FAT_BINARY)
+    compiler += "\nFat binary dispatch        : ";
+    compiler += fat_dispatch_info();
+#endif
+
     compiler += "\nCompilation settings       : ";
     compiler += (Is64Bit ? "64bit" : "32bit");
+#if defined(USE_AVX512ICL)
+    compiler += " AVX512ICL";
+#endif
 #if defined(USE_VNNI)
     compiler += " VNNI";
 #endif
@@ -258,6 +272,15 @@ std::string compiler_info() {
     compiler += " NEON";
 #endif
 
+#if defined(FT_WEIGHTS_8)
+    compiler += " FT_WEIGHTS_8";
+#endif
+#if defined(USE_PERF_COUNTERS)
+    compiler += " PERF_COUNTERS";
+#endif
+#if defined(USE_TRACE)
+    compiler += " TRACE";
+#endif
 #if !defined(NDEBUG)
     compiler += " DEBUG";
 #endif
@@ -359,21 +382,154 @@ void dbg_print() {
 }
 
 
+namespace {
+
+std::mutex                ioMutex;
+std::atomic<AsyncOutput*> activeOutput{nullptr};
+
+}
+
 // Used to serialize access to std::cout
 // to avoid multiple threads writing at the same time.
 std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 
-    static std::mutex m;
-
     if (sc == IO_LOCK)
-        m.lock();
+    {
+        if (AsyncOutput* output = activeOutput.load())
+            output->flush();
+
+        ioMutex.lock();
+    }
 
     if (sc == IO_UNLOCK)
-        m.unlock();
+        ioMutex.unlock();
 
     return os;
 }
 
+AsyncOutput::AsyncOutput() :
+    ring(std::make_unique<Entry[]>(Capacity)) {
+    thread = std::thread(&AsyncOutput::idle_loop, this);
+
+    AsyncOutput* none = nullptr;
+    activeOutput.compare_exchange_strong(none, this);
+}
+
+AsyncOutput::~AsyncOutput() {
+    AsyncOutput* self = this;
+    activeOutput.compare_exchange_strong(self, nullptr);
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        exit = true;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void AsyncOutput::post(Kind kind, size_t key, std::string&& line) {
+
+    std::lock_guard<std::mutex> producer(postMutex);
+
+    const size_t h = head.load(std::memory_order_relaxed);
+
+    while (h - tail.load(std::memory_order_acquire) == Capacity)
+    {
+        if (kind == CurrMove)
+            return;
+
+        std::this_thread::yield();
+    }
+
+    ring[h & (Capacity - 1)] = {kind, key, std::move(line)};
+    head.store(h + 1, std::memory_order_seq_cst);
+
+    // Pairs with the store to sleeping before the writer checks for new lines
+    if (sleeping.load(std::memory_order_seq_cst))
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        cv.notify_one();
+    }
+}
+
+void AsyncOutput::flush() {
+
+    const size_t target = head.load(std::memory_order_acquire);
+
+    if (written.load(std::memory_order_acquire) >= target)
+        return;
+
+    std::unique_lock<std::mutex> lk(mutex);
+    writtenCv.wait(lk, [&] { return written.load(std::memory_order_acquire) >= target; });
+}
+
+void AsyncOutput::idle_loop() {
+
+    std::vector<Entry> batch;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            sleeping.store(true, std::memory_order_seq_cst);
+            cv.wait(lk, [&] { return exit || head.load(std::memory_order_seq_cst) != tail; });
+            sleeping.store(false, std::memory_order_relaxed);
+
+            if (exit && head.load() == tail)
+                return;
+        }
+
+        // Take everything posted so far, so that it can be coalesced
+        const size_t h = head.load(std::memory_order_acquire);
+        for (size_t t = tail.load(std::memory_order_relaxed); t != h; ++t)
+            batch.emplace_back(std::move(ring[t & (Capacity - 1)]));
+        tail.store(h, std::memory_order_release);
+
+        write(batch);
+        batch.clear();
+
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            written.store(h, std::memory_order_release);
+        }
+        writtenCv.notify_all();
+    }
+}
+
+void AsyncOutput::write(std::vector<Entry>& batch) {
+
+    // Walking backwards, a coalescable line is dropped if a later one of the
+    // same kind and key is written before the next plain line.
+    std::vector<bool> keep(batch.size(), true);
+    std::vector<Entry*> later;
+
+    for (size_t i = batch.size(); i-- > 0;)
+    {
+        Entry& e = batch[i];
+
+        if (e.kind == Line)
+        {
+            later.clear();
+            continue;
+        }
+
+        for (const Entry* l : later)
+            if (l->kind == e.kind && (e.kind == CurrMove || l->key == e.key))
+                keep[i] = false;
+
+        if (keep[i])
+            later.push_back(&e);
+    }
+
+    std::string out;
+    for (size_t i = 0; i < batch.size(); ++i)
+        if (keep[i])
+            out += batch[i].line;
+
+    std::lock_guard<std::mutex> lk(ioMutex);
+    std::cout << out << std::flush;
+}
+
 void sync_cout_start() { std::cout << IO_LOCK; }
 void sync_cout_end() { std::cout << IO_UNLOCK; }
 
@@ -472,25 +628,47 @@ std::string CommandLine::get_working_directory() {
     return workingDirectory;
 }
 
-std::stringstream read_zipped_nnue(const std::string& fpath) {
-    void*  buf     = NULL;
-    size_t bufsize = 0;
+ZipEntryStream::ZipEntryStream(const std::string& fpath) :
+    std::istream(nullptr),
+    buffer(fpath) {
+    rdbuf(&buffer);
+}
+
+ZipEntryStream::Buffer::Buffer(const std::string& fpath) {
+    zip = zip_open(fpath.c_str(), 0, 'r');
 
-    struct zip_t* zip = zip_open(fpath.c_str(), 0, 'r');
-    if (zip_entries_total(zip) == 1)
+    if (zip_entries_total(zip) == 1 && zip_entry_openbyindex(zip, 0) == 0)
+        reader = zip_entry_reader_open(zip);
+}
+
+ZipEntryStream::Buffer::~Buffer() {
+    if (reader)
     {
-        zip_entry_openbyindex(zip, 0);
-        { zip_entry_read(zip, &buf, &bufsize); }
+        zip_entry_reader_close(reader);
         zip_entry_close(zip);
     }
     zip_close(zip);
+}
 
-    std::stringstream ss;
-    if (buf)
-        ss.write((const char*) buf, bufsize);
-    free(buf);
+size_t ZipEntryStream::Buffer::inflate(char* s, size_t n) {
+    return reader ? zip_entry_reader_read(reader, s, n) : 0;
+}
+
+ZipEntryStream::Buffer::int_type ZipEntryStream::Buffer::underflow() {
+    const size_t n = inflate(chunk, sizeof(chunk));
+    setg(chunk, chunk, chunk + n);
+
+    return n ? traits_type::to_int_type(chunk[0]) : traits_type::eof();
+}
+
+std::streamsize ZipEntryStream::Buffer::xsgetn(char* s, std::streamsize n) {
+
+    // First what is left of the last chunk, then the rest straight into s
+    const std::streamsize buffered = std::min(n, std::streamsize(egptr() - gptr()));
+    std::memcpy(s, gptr(), size_t(buffered));
+    gbump(int(buffered));
 
-    return ss;
+    return buffered + std::streamsize(inflate(s + buffered, size_t(n - buffered)));
 }
 
 }  // namespace Stockfish
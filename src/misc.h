@@ -20,19 +20,29 @@
 #define MISC_H_INCLUDED
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <iosfwd>
+#include <istream>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <streambuf>
 #include <string>
+#include <thread>
 #include <vector>
 
 #define stringify2(x) #x
 #define stringify(x) stringify2(x)
 
+struct zip_t;
+struct zip_entry_reader_t;
+
 namespace Stockfish {
 
 std::string engine_info(bool to_uci = false);
@@ -47,7 +57,33 @@ void start_logger(const std::string& fname);
 
 size_t str_to_size_t(const std::string& s);
 
-std::stringstream read_zipped_nnue(const std::string& fpath);
+// Reads the only entry of a zip archive, inflating it as it is read, so that
+// there is never a copy of the whole content: large reads go straight to the
+// buffer of the caller. The stream fails at once if the file isn't such an archive.
+class ZipEntryStream: public std::istream {
+   public:
+    explicit ZipEntryStream(const std::string& fpath);
+
+   private:
+    class Buffer: public std::streambuf {
+       public:
+        explicit Buffer(const std::string& fpath);
+        ~Buffer() override;
+
+       protected:
+        int_type        underflow() override;
+        std::streamsize xsgetn(char* s, std::streamsize n) override;
+
+       private:
+        size_t inflate(char* s, size_t n);
+
+        zip_t*              zip    = nullptr;
+        zip_entry_reader_t* reader = nullptr;
+        char                chunk[64 * 1024];
+    };
+
+    Buffer buffer;
+};
 
 #if defined(__linux__)
 
@@ -117,6 +153,58 @@ std::ostream& operator<<(std::ostream&, SyncCout);
 void sync_cout_start();
 void sync_cout_end();
 
+// AsyncOutput writes the posted messages from a dedicated thread, so the search never
+// waits on a slow pipe. A message is written as is, so text lines include their newline.
+// They go through a single-producer ring buffer. Most come from the main search thread,
+// but info strings can come from any thread, so the producers take turns on a mutex,
+// which is uncontended while only the search posts. When the writer falls behind, an
+// info message is dropped if a newer one for the same multipv is already waiting, as
+// are stale currmove messages. Other messages, bestmove among them, are never dropped
+// or reordered. While an instance exists, sync_cout first waits for the messages
+// already posted, so output from other threads keeps its place too.
+class AsyncOutput {
+   public:
+    enum Kind : uint8_t {
+        Line,      // Always written
+        Info,      // Superseded by a later Info with the same key
+        CurrMove,  // Superseded by a later CurrMove, or dropped if the buffer is full
+    };
+
+    AsyncOutput();
+    ~AsyncOutput();
+
+    AsyncOutput(const AsyncOutput&)            = delete;
+    AsyncOutput& operator=(const AsyncOutput&) = delete;
+
+    void post(Kind kind, size_t key, std::string&& line);
+    void flush();  // Blocks until all the lines posted so far are written
+
+   private:
+    struct Entry {
+        Kind        kind;
+        size_t      key;
+        std::string line;
+    };
+
+    static constexpr size_t Capacity = 1024;  // Must be a power of 2
+
+    void idle_loop();
+    void write(std::vector<Entry>& batch);
+
+    std::unique_ptr<Entry[]> ring;
+    std::mutex               postMutex;  // Held by the producer in post()
+
+    alignas(64) std::atomic<size_t> head{0};  // Next slot to fill, written by the producer
+    alignas(64) std::atomic<size_t> tail{0};  // Next slot to read, written by the writer
+    alignas(64) std::atomic<size_t> written{0};
+    std::atomic_bool sleeping{false};
+
+    std::mutex              mutex;
+    std::condition_variable cv, writtenCv;
+    bool                    exit = false;
+    std::thread             thread;
+};
+
 // True if and only if the binary is compiled on a little-endian machine
 static inline const union {
     uint32_t i;
@@ -141,6 +229,22 @@ class ValueList {
 };
 
 
+// A counter which is only ever written by one thread, but may be read by any
+// other at any time. Incrementing it is a relaxed load and store instead of an
+// atomic read-modify-write, so it costs the same as a plain integer.
+class RelaxedCounter {
+
+   public:
+    void     operator++() { *this += 1; }
+    void     operator+=(uint64_t n) { value.store(load() + n, std::memory_order_relaxed); }
+    uint64_t load() const { return value.load(std::memory_order_relaxed); }
+    void     reset() { value.store(0, std::memory_order_relaxed); }
+
+   private:
+    std::atomic<uint64_t> value{0};
+};
+
+
 // xorshift64star Pseudo-Random Number Generator
 // This class is based on original code written and dedicated
 // to the public domain by Sebastiano Vigna (2014).
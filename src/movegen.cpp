@@ -21,12 +21,40 @@
 #include <cassert>
 
 #include "bitboard.h"
+#include "perf.h"
 #include "position.h"
 
 namespace Stockfish {
 
 namespace {
 
+// Returns the destination squares of the pseudo-legal moves of the given
+// type for the piece on 'from', with the exception of the QUIET_CHECKS filter.
+template<Color Us, PieceType Pt, GenType Type>
+Bitboard move_targets(const Position& pos, Square from, Bitboard target) {
+
+    Bitboard b = 0;
+    if constexpr (Pt != CANNON)
+        b = (Pt != PAWN ? attacks_bb<Pt>(from, pos.pieces()) : pawn_attacks_bb(Us, from))
+          & target;
+    else
+    {
+        // Generate cannon capture moves.
+        if (Type != QUIETS && Type != QUIET_CHECKS)
+            b |= attacks_bb<CANNON>(from, pos.pieces()) & pos.pieces(~Us);
+
+        // Generate cannon quite moves.
+        if (Type != CAPTURES)
+            b |= attacks_bb<ROOK>(from, pos.pieces()) & ~pos.pieces();
+
+        // Restrict to target if in evasion generation
+        if (Type == EVASIONS)
+            b &= target;
+    }
+
+    return b;
+}
+
 template<Color Us, PieceType Pt, GenType Type>
 ExtMove* generate_moves(const Position& pos, ExtMove* moveList, Bitboard target) {
 
@@ -37,24 +65,7 @@ ExtMove* generate_moves(const Position& pos, ExtMove* moveList, Bitboard target)
     while (bb)
     {
         Square   from = pop_lsb(bb);
-        Bitboard b    = 0;
-        if constexpr (Pt != CANNON)
-            b = (Pt != PAWN ? attacks_bb<Pt>(from, pos.pieces()) : pawn_attacks_bb(Us, from))
-              & target;
-        else
-        {
-            // Generate cannon capture moves.
-            if (Type != QUIETS && Type != QUIET_CHECKS)
-                b |= attacks_bb<CANNON>(from, pos.pieces()) & pos.pieces(~Us);
-
-            // Generate cannon quite moves.
-            if (Type != CAPTURES)
-                b |= attacks_bb<ROOK>(from, pos.pieces()) & ~pos.pieces();
-
-            // Restrict to target if in evasion generation
-            if (Type == EVASIONS)
-                b &= target;
-        }
+        Bitboard b    = move_targets<Us, Pt, Type>(pos, from, target);
 
         // To check, you either move freely a blocker or make a direct check.
         if constexpr (Type == QUIET_CHECKS)
@@ -103,6 +114,91 @@ ExtMove* generate_all(const Position& pos, ExtMove* moveList) {
     return moveList;
 }
 
+// Counts the legal moves among the given pseudo-legal moves of the piece on
+// 'from'. Unless a slow check is needed, legal() accepts every move of a piece
+// which is not a blocker for its king, except onto the screen squares of an
+// enemy cannon, so those are counted at once.
+int count_legal(const Position& pos, Square from, Bitboard b) {
+
+    if (!pos.state()->needSlowCheck && !(pos.blockers_for_king(pos.side_to_move()) & from)
+        && type_of(pos.piece_on(from)) != KING)
+        return popcount(b & ~pos.screen_squares());
+
+    int cnt = 0;
+    while (b)
+        cnt += pos.legal(Move(from, pop_lsb(b)));
+    return cnt;
+}
+
+template<Color Us, PieceType Pt, GenType Type>
+int count_moves(const Position& pos, Bitboard target) {
+
+    int cnt = 0;
+
+    for (Bitboard bb = pos.pieces(Us, Pt); bb;)
+    {
+        Square from = pop_lsb(bb);
+        cnt += count_legal(pos, from, move_targets<Us, Pt, Type>(pos, from, target));
+    }
+
+    return cnt;
+}
+
+template<Color Us, GenType Type>
+int count_moves(const Position& pos, Bitboard target) {
+    return count_moves<Us, ROOK, Type>(pos, target) + count_moves<Us, ADVISOR, Type>(pos, target)
+         + count_moves<Us, CANNON, Type>(pos, target) + count_moves<Us, PAWN, Type>(pos, target)
+         + count_moves<Us, KNIGHT, Type>(pos, target)
+         + count_moves<Us, BISHOP, Type>(pos, target);
+}
+
+// Same as generate<LEGAL>, but only counts the moves. The candidates are the
+// same as those of generate<EVASIONS> or generate<PSEUDO_LEGAL>, so that the
+// fast paths of legal() give the same answers.
+template<Color Us>
+int count_legal_moves(const Position& pos) {
+
+    const Square ksq = pos.king_square(Us);
+
+    if (!pos.checkers() || more_than_one(pos.checkers()))
+        return count_moves<Us, PSEUDO_LEGAL>(pos, ~pos.pieces(Us))
+             + count_legal(pos, ksq, attacks_bb<KING>(ksq) & ~pos.pieces(Us));
+
+    Square    checksq = lsb(pos.checkers());
+    PieceType pt      = type_of(pos.piece_on(checksq));
+
+    // King evasions, see generate<EVASIONS>
+    Bitboard b = attacks_bb<KING>(ksq) & ~pos.pieces(Us);
+    if (pt == ROOK || pt == CANNON)
+        b &= ~line_bb(checksq, ksq) | pos.pieces(~Us);
+
+    int cnt = count_legal(pos, ksq, b);
+
+    // Moving away the hurdle of a cannon
+    if (pt == CANNON)
+    {
+        Bitboard hurdle = between_bb(ksq, checksq) & pos.pieces(Us);
+        if (hurdle)
+        {
+            Square hurdleSq = pop_lsb(hurdle);
+            pt              = type_of(pos.piece_on(hurdleSq));
+            if (pt == PAWN)
+                b = pawn_attacks_bb(Us, hurdleSq) & ~line_bb(checksq, hurdleSq) & ~pos.pieces(Us);
+            else if (pt == CANNON)
+                b = (attacks_bb<ROOK>(hurdleSq, pos.pieces()) & ~line_bb(checksq, hurdleSq)
+                     & ~pos.pieces())
+                  | (attacks_bb<CANNON>(hurdleSq, pos.pieces()) & pos.pieces(~Us));
+            else
+                b = attacks_bb(pt, hurdleSq, pos.pieces()) & ~line_bb(checksq, hurdleSq)
+                  & ~pos.pieces(Us);
+            cnt += count_legal(pos, hurdleSq, b);
+        }
+    }
+
+    // Blocking evasions or captures of the checking piece
+    return cnt + count_moves<Us, EVASIONS>(pos, between_bb(ksq, checksq) & ~pos.pieces(Us));
+}
+
 }  // namespace
 
 
@@ -117,6 +213,8 @@ ExtMove* generate(const Position& pos, ExtMove* moveList) {
 
     static_assert(Type != LEGAL && Type != EVASIONS, "Unsupported type in generate()");
 
+    const Perf::Scope<Perf::MoveGen> perfScope;
+
     return pos.side_to_move() == WHITE ? generate_all<WHITE, Type>(pos, moveList)
                                        : generate_all<BLACK, Type>(pos, moveList);
 }
@@ -136,6 +234,8 @@ ExtMove* generate<EVASIONS>(const Position& pos, ExtMove* moveList) {
 
     assert(bool(pos.checkers()));
 
+    const Perf::Scope<Perf::MoveGen> perfScope;
+
     // If there are more than one checker, use slow version
     if (more_than_one(pos.checkers()))
         return generate<PSEUDO_LEGAL>(pos, moveList);
@@ -203,4 +303,59 @@ ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList) {
     return moveList;
 }
 
+
+// Returns the number of legal moves, without building a move list
+size_t count_legal_moves(const Position& pos) {
+    return size_t(pos.side_to_move() == WHITE ? count_legal_moves<WHITE>(pos)
+                                              : count_legal_moves<BLACK>(pos));
+}
+
+
+bool is_legal(const Position& pos, Move m) {
+
+    if (!m.is_ok() || !pos.pseudo_legal(m))
+        return false;
+
+    if (!pos.checkers() || type_of(pos.moved_piece(m)) == KING)
+        return pos.legal(m);
+
+    // Any non-king move may come here, so always use the slow check
+    const Color    us       = pos.side_to_move();
+    const Bitboard occupied = (pos.pieces() ^ m.from_sq()) | m.to_sq();
+    return !(pos.checkers_to(~us, pos.king_square(us), occupied) & ~square_bb(m.to_sq()));
+}
+
+LegalMoves::LegalMoves(const Position& p) :
+    pos(p),
+    pieces(p.pieces(p.side_to_move())),
+    targets(0),
+    from(SQ_NONE) {}
+
+Move LegalMoves::next() {
+
+    while (true)
+    {
+        while (targets)
+        {
+            Move m(from, pop_lsb(targets));
+            if (is_legal(pos, m))
+                return m;
+        }
+
+        if (!pieces)
+            return Move::none();
+
+        // Pseudo-legal destinations of the next piece, as in Position::pseudo_legal()
+        from = pop_lsb(pieces);
+
+        const Color     us = pos.side_to_move();
+        const PieceType pt = type_of(pos.piece_on(from));
+
+        targets = pt == PAWN   ? pawn_attacks_bb(us, from) & ~pos.pieces(us)
+                : pt == CANNON ? (attacks_bb<ROOK>(from, pos.pieces()) & ~pos.pieces())
+                                   | (attacks_bb<CANNON>(from, pos.pieces()) & pos.pieces(~us))
+                               : attacks_bb(pt, from, pos.pieces()) & ~pos.pieces(us);
+    }
+}
+
 }  // namespace Stockfish
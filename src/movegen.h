@@ -52,6 +52,28 @@ inline bool operator<(const ExtMove& f, const ExtMove& s) { return f.value < s.v
 template<GenType>
 ExtMove* generate(const Position& pos, ExtMove* moveList);
 
+size_t count_legal_moves(const Position& pos);
+
+// Tests whether any move, e.g. one parsed from user input, is legal.
+// Position::legal() needs moves from the generator when in check.
+bool is_legal(const Position& pos, Move m);
+
+// LegalMoves yields the legal moves one at a time, generating them piece by
+// piece, so that a caller which stops early doesn't pay for the others.
+class LegalMoves {
+
+   public:
+    explicit LegalMoves(const Position& p);
+
+    // Returns Move::none() when there are no more moves
+    Move next();
+
+   private:
+    const Position& pos;
+    Bitboard        pieces, targets;
+    Square          from;
+};
+
 // The MoveList struct wraps the generate() function and returns a convenient
 // list of moves. Using MoveList is sometimes preferable to directly calling
 // the lower level generate() function.
@@ -24,7 +24,9 @@
 #include <utility>
 
 #include "bitboard.h"
+#include "misc.h"
 #include "position.h"
+#include "tt.h"
 
 namespace Stockfish {
 
@@ -74,6 +76,24 @@ void partial_insertion_sort(ExtMove* begin, ExtMove* end, int limit) {
         }
 }
 
+// The number of quiets picked before sorting the others
+constexpr int LazyPicks = 2;
+
+// Moves the moves from the limit up after the first move, in the order they come,
+// and returns the end of them. This leaves every move at the place where
+// partial_insertion_sort() puts it, except that the ones up to the returned end
+// are yet to be sorted, which select<Lazy>() does as they are picked.
+ExtMove* partition_from_limit(ExtMove* begin, ExtMove* end, int limit) {
+
+    ExtMove* sortedEnd = begin;
+
+    for (ExtMove* p = begin + 1; p < end; ++p)
+        if (p->value >= limit)
+            std::swap(*p, *++sortedEnd);
+
+    return std::min(sortedEnd + 1, end);
+}
+
 }  // namespace
 
 
@@ -222,6 +242,23 @@ void MovePicker::score() {
     }
 }
 
+// Prefetches the TT clusters of the moves following the one at cur, those which
+// were not prefetched yet. The moves are those in the current order, which the
+// lazy picks may still change. Only the capture and quiet stages prefetch, as
+// their moves are generated ones: each of them sets prefetchedTo to the start of
+// its moves, while the refutations and the evasions leave it to nullptr.
+void MovePicker::prefetch_next() {
+
+    if (!prefetchedTo)
+        return;
+
+    ExtMove* last = std::min(cur + 1 + prefetchCount, endMoves);
+
+    for (prefetchedTo = std::max(prefetchedTo, cur + 1); prefetchedTo < last; ++prefetchedTo)
+        if (prefetchedTo->is_ok() && *prefetchedTo != ttMove)
+            prefetch(prefetchTT->first_entry(pos.key_after(*prefetchedTo)));
+}
+
 // Returns the next move satisfying a predicate function.
 // It never returns the TT move.
 template<MovePicker::PickType T, typename Pred>
@@ -232,8 +269,33 @@ Move MovePicker::select(Pred filter) {
         if constexpr (T == Best)
             std::swap(*cur, *std::max_element(cur, endMoves));
 
+        // The first few moves yet to be sorted are picked one at a time, each the
+        // first best of them, keeping the order of the others. This gives the
+        // order of a stable sort, and the other moves are sorted at once only if
+        // the node goes on: most nodes pick only a few quiets.
+        else if constexpr (T == Lazy)
+            if (cur < endGoodQuiets)
+            {
+                if (cur - endBadCaptures < LazyPicks)
+                {
+                    ExtMove *best = std::max_element(cur, endGoodQuiets), tmp = *best;
+                    std::move_backward(cur, best, best + 1);
+                    *cur = tmp;
+                }
+                else
+                {
+                    partial_insertion_sort(cur, endGoodQuiets, std::numeric_limits<int>::min());
+                    endGoodQuiets = cur;
+                }
+            }
+
         if (*cur != ttMove && filter())
+        {
+            if (prefetchCount)
+                prefetch_next();
+
             return *cur++;
+        }
 
         cur++;
     }
@@ -261,8 +323,8 @@ top:
     case CAPTURE_INIT :
     case PROBCUT_INIT :
     case QCAPTURE_INIT :
-        cur = endBadCaptures = moves;
-        endMoves             = generate<CAPTURES>(pos, cur);
+        cur = endBadCaptures = prefetchedTo = moves;
+        endMoves                            = generate<CAPTURES>(pos, cur);
 
         score<CAPTURES>();
         partial_insertion_sort(cur, endMoves, std::numeric_limits<int>::min());
@@ -278,8 +340,9 @@ top:
             return *(cur - 1);
 
         // Prepare the pointers to loop over the refutations array
-        cur      = std::begin(refutations);
-        endMoves = std::end(refutations);
+        cur          = std::begin(refutations);
+        endMoves     = std::end(refutations);
+        prefetchedTo = nullptr;
 
         // If the countermove is the same as a killer, skip it
         if (refutations[0] == refutations[2] || refutations[1] == refutations[2])
@@ -299,31 +362,35 @@ top:
     case QUIET_INIT :
         if (!skipQuiets)
         {
-            cur      = endBadCaptures;
+            cur          = endBadCaptures;
+            prefetchedTo = cur;
             endMoves = beginBadQuiets = endBadQuiets = generate<QUIETS>(pos, cur);
 
             score<QUIETS>();
-            partial_insertion_sort(cur, endMoves, quiet_threshold(depth));
+            endGoodQuiets = partition_from_limit(cur, endMoves, quiet_threshold(depth));
         }
 
         ++stage;
         [[fallthrough]];
 
     case GOOD_QUIET :
-        if (!skipQuiets && select<Next>([&]() {
+        if (!skipQuiets && select<Lazy>([&]() {
                 return *cur != refutations[0] && *cur != refutations[1] && *cur != refutations[2];
             }))
         {
             if ((cur - 1)->value > -8000 || (cur - 1)->value <= quiet_threshold(depth))
                 return *(cur - 1);
 
-            // Remaining quiets are bad
+            // Remaining quiets are bad, sorted as they are now picked in order
             beginBadQuiets = cur - 1;
+            if (cur < endGoodQuiets)
+                partial_insertion_sort(cur, endGoodQuiets, std::numeric_limits<int>::min());
         }
 
         // Prepare the pointers to loop over the bad captures
-        cur      = moves;
-        endMoves = endBadCaptures;
+        cur          = moves;
+        endMoves     = endBadCaptures;
+        prefetchedTo = cur;
 
         ++stage;
         [[fallthrough]];
@@ -333,8 +400,9 @@ top:
             return *(cur - 1);
 
         // Prepare the pointers to loop over the bad quiets
-        cur      = beginBadQuiets;
-        endMoves = endBadQuiets;
+        cur          = beginBadQuiets;
+        endMoves     = endBadQuiets;
+        prefetchedTo = cur;
 
         ++stage;
         [[fallthrough]];
@@ -373,8 +441,9 @@ top:
         [[fallthrough]];
 
     case QCHECK_INIT :
-        cur      = moves;
-        endMoves = generate<QUIET_CHECKS>(pos, cur);
+        cur          = moves;
+        endMoves     = generate<QUIET_CHECKS>(pos, cur);
+        prefetchedTo = cur;
 
         ++stage;
         [[fallthrough]];
@@ -34,7 +34,18 @@
 
 namespace Stockfish {
 
-constexpr int PAWN_HISTORY_SIZE        = 512;    // has to be a power of 2
+class TranspositionTable;
+
+// With COMPACT_HISTORY the tables of each thread take half the memory, see
+// cont_hist_piece(). This helps the cache when running many threads.
+#ifdef COMPACT_HISTORY
+constexpr int PAWN_HISTORY_SIZE   = 128;  // has to be a power of 2
+constexpr int CONT_HISTORY_PIECES = PIECE_TYPE_NB;
+#else
+constexpr int PAWN_HISTORY_SIZE   = 512;  // has to be a power of 2
+constexpr int CONT_HISTORY_PIECES = PIECE_NB;
+#endif
+
 constexpr int CORRECTION_HISTORY_SIZE  = 16384;  // has to be a power of 2
 constexpr int CORRECTION_HISTORY_LIMIT = 1024;
 
@@ -54,6 +65,17 @@ inline int pawn_structure_index(const Position& pos) {
     return pos.pawn_key() & ((T == Normal ? PAWN_HISTORY_SIZE : CORRECTION_HISTORY_SIZE) - 1);
 }
 
+// The index of the piece of the previous move in a continuation history. The
+// compact layout drops its color: the piece of the current move keeps it, and
+// its color matches the previous one only when they are two plies apart.
+constexpr int cont_hist_piece(Piece pc) {
+#ifdef COMPACT_HISTORY
+    return type_of(pc);
+#else
+    return pc;
+#endif
+}
+
 // StatsEntry stores the stat table value. It is usually a number but could
 // be a move or even a nested history. We use a class instead of a naked value
 // to directly call history update operator<<() on the entry so to use stats
@@ -132,7 +154,7 @@ using PieceToHistory = Stats<int16_t, 29952, PIECE_NB, SQUARE_NB>;
 // the current one given a previous one. The nested history table is based on
 // PieceToHistory instead of ButterflyBoards.
 // (~63 elo)
-using ContinuationHistory = Stats<PieceToHistory, NOT_USED, PIECE_NB, SQUARE_NB>;
+using ContinuationHistory = Stats<PieceToHistory, NOT_USED, CONT_HISTORY_PIECES, SQUARE_NB>;
 
 // PawnHistory is addressed by the pawn structure and a move's [piece][to]
 using PawnHistory = Stats<int16_t, 8192, PAWN_HISTORY_SIZE, PIECE_NB, SQUARE_NB>;
@@ -151,7 +173,8 @@ class MovePicker {
 
     enum PickType {
         Next,
-        Best
+        Best,
+        Lazy
     };
 
    public:
@@ -176,6 +199,13 @@ class MovePicker {
     MovePicker(const Position&, Move, int, const CapturePieceToHistory*);
     Move next_move(bool skipQuiets = false);
 
+    // Prefetches the TT clusters of the given number of moves after each move
+    // returned, so that the memory accesses overlap with the search of it.
+    void prefetch_ahead(const TranspositionTable& tt, int count) {
+        prefetchTT    = &tt;
+        prefetchCount = count;
+    }
+
    private:
     template<PickType T, typename Pred>
     Move select(Pred);
@@ -183,6 +213,7 @@ class MovePicker {
     void     score();
     ExtMove* begin() { return cur; }
     ExtMove* end() { return endMoves; }
+    void     prefetch_next();
 
     const Position&              pos;
     const ButterflyHistory*      mainHistory;
@@ -190,11 +221,15 @@ class MovePicker {
     const PieceToHistory**       continuationHistory;
     const PawnHistory*           pawnHistory;
     Move                         ttMove;
+    const TranspositionTable*    prefetchTT    = nullptr;
+    int                          prefetchCount = 0;
     ExtMove refutations[3], *cur, *endMoves, *endBadCaptures, *beginBadQuiets, *endBadQuiets;
-    int     stage;
-    int     threshold;
-    Depth   depth;
-    ExtMove moves[MAX_MOVES];
+    ExtMove* endGoodQuiets;
+    ExtMove* prefetchedTo = nullptr;  // See prefetch_next()
+    int      stage;
+    int      threshold;
+    Depth    depth;
+    ExtMove  moves[MAX_MOVES];
 };
 
 }  // namespace Stockfish
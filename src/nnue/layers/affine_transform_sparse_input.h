@@ -38,6 +38,38 @@
 namespace Stockfish::Eval::NNUE::Layers {
 
 #if (USE_SSSE3 | (USE_NEON >= 8))
+    #if defined(USE_AVX512ICL)
+// Find indices of nonzero numbers in an int32_t array. The indices of a whole
+// chunk are compressed in a register and stored as a full vector, of which only
+// the first popcount entries are kept.
+template<const IndexType InputDimensions>
+void find_nnz(const std::int32_t* input, std::uint16_t* out, IndexType& count_out) {
+    constexpr IndexType SimdWidthIn  = 16;  // 512 bits / 32 bits
+    constexpr IndexType SimdWidthOut = 32;  // 512 bits / 16 bits
+    constexpr IndexType NumChunks    = InputDimensions / SimdWidthOut;
+    static_assert(InputDimensions % SimdWidthOut == 0);
+
+    const __m512i increment = _mm512_set1_epi16(SimdWidthOut);
+    __m512i base = _mm512_set_epi16(31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16,
+                                    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+    IndexType count = 0;
+    for (IndexType i = 0; i < NumChunks; ++i)
+    {
+        const __m512i inputV0 = _mm512_load_si512(input + i * 2 * SimdWidthIn);
+        const __m512i inputV1 = _mm512_load_si512(input + i * 2 * SimdWidthIn + SimdWidthIn);
+
+        const __mmask32 nnzMask = __mmask32(_mm512_test_epi32_mask(inputV0, inputV0))
+                                | __mmask32(_mm512_test_epi32_mask(inputV1, inputV1)) << 16;
+
+        // Avoid _mm512_mask_compressstoreu_epi16(), which is microcoded on Zen 4
+        _mm512_storeu_si512(out + count, _mm512_maskz_compress_epi16(nnzMask, base));
+        count += popcount(nnzMask);
+        base = _mm512_add_epi16(base, increment);
+    }
+    count_out = count;
+}
+    #else
 alignas(CacheLineSize) static inline const
   std::array<std::array<std::uint16_t, 8>, 256> lookup_indices = []() {
       std::array<std::array<std::uint16_t, 8>, 256> v{};
@@ -54,41 +86,41 @@ alignas(CacheLineSize) static inline const
 // Find indices of nonzero numbers in an int32_t array
 template<const IndexType InputDimensions>
 void find_nnz(const std::int32_t* input, std::uint16_t* out, IndexType& count_out) {
-    #if defined(USE_SSSE3)
-        #if defined(USE_AVX512) || defined(USE_AVX512F)
+        #if defined(USE_SSSE3)
+            #if defined(USE_AVX512) || defined(USE_AVX512F)
     using vec_t = __m512i;
-            #define vec_nnz(a) _mm512_cmpgt_epi32_mask(a, _mm512_setzero_si512())
-        #elif defined(USE_AVX2)
+                #define vec_nnz(a) _mm512_cmpgt_epi32_mask(a, _mm512_setzero_si512())
+            #elif defined(USE_AVX2)
     using vec_t = __m256i;
-            #if defined(USE_VNNI) && !defined(USE_AVXVNNI)
-                #define vec_nnz(a) _mm256_cmpgt_epi32_mask(a, _mm256_setzero_si256())
-            #else
+                #if defined(USE_VNNI) && !defined(USE_AVXVNNI)
+                    #define vec_nnz(a) _mm256_cmpgt_epi32_mask(a, _mm256_setzero_si256())
+                #else
+                    #define vec_nnz(a) \
+                        _mm256_movemask_ps( \
+                          _mm256_castsi256_ps(_mm256_cmpgt_epi32(a, _mm256_setzero_si256())))
+                #endif
+            #elif defined(USE_SSSE3)
+    using vec_t = __m128i;
                 #define vec_nnz(a) \
-                    _mm256_movemask_ps( \
-                      _mm256_castsi256_ps(_mm256_cmpgt_epi32(a, _mm256_setzero_si256())))
+                    _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, _mm_setzero_si128())))
             #endif
-        #elif defined(USE_SSSE3)
-    using vec_t = __m128i;
-            #define vec_nnz(a) \
-                _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, _mm_setzero_si128())))
-        #endif
     using vec128_t = __m128i;
-        #define vec128_zero _mm_setzero_si128()
-        #define vec128_set_16(a) _mm_set1_epi16(a)
-        #define vec128_load(a) _mm_load_si128(a)
-        #define vec128_storeu(a, b) _mm_storeu_si128(a, b)
-        #define vec128_add(a, b) _mm_add_epi16(a, b)
-    #elif defined(USE_NEON)
+            #define vec128_zero _mm_setzero_si128()
+            #define vec128_set_16(a) _mm_set1_epi16(a)
+            #define vec128_load(a) _mm_load_si128(a)
+            #define vec128_storeu(a, b) _mm_storeu_si128(a, b)
+            #define vec128_add(a, b) _mm_add_epi16(a, b)
+        #elif defined(USE_NEON)
     using vec_t                        = uint32x4_t;
     static const std::uint32_t Mask[4] = {1, 2, 4, 8};
-        #define vec_nnz(a) vaddvq_u32(vandq_u32(vtstq_u32(a, a), vld1q_u32(Mask)))
+            #define vec_nnz(a) vaddvq_u32(vandq_u32(vtstq_u32(a, a), vld1q_u32(Mask)))
     using vec128_t                     = uint16x8_t;
-        #define vec128_zero vdupq_n_u16(0)
-        #define vec128_set_16(a) vdupq_n_u16(a)
-        #define vec128_load(a) vld1q_u16(reinterpret_cast<const std::uint16_t*>(a))
-        #define vec128_storeu(a, b) vst1q_u16(reinterpret_cast<std::uint16_t*>(a), b)
-        #define vec128_add(a, b) vaddq_u16(a, b)
-    #endif
+            #define vec128_zero vdupq_n_u16(0)
+            #define vec128_set_16(a) vdupq_n_u16(a)
+            #define vec128_load(a) vld1q_u16(reinterpret_cast<const std::uint16_t*>(a))
+            #define vec128_storeu(a, b) vst1q_u16(reinterpret_cast<std::uint16_t*>(a), b)
+            #define vec128_add(a, b) vaddq_u16(a, b)
+        #endif
     constexpr IndexType InputSimdWidth = sizeof(vec_t) / sizeof(std::int32_t);
     // Inputs are processed InputSimdWidth at a time and outputs are processed 8 at a time so we process in chunks of max(InputSimdWidth, 8)
     constexpr IndexType ChunkSize       = std::max<IndexType>(InputSimdWidth, 8);
@@ -121,12 +153,13 @@ void find_nnz(const std::int32_t* input, std::uint16_t* out, IndexType& count_ou
     }
     count_out = count;
 }
-    #undef vec_nnz
-    #undef vec128_zero
-    #undef vec128_set_16
-    #undef vec128_load
-    #undef vec128_storeu
-    #undef vec128_add
+        #undef vec_nnz
+        #undef vec128_zero
+        #undef vec128_set_16
+        #undef vec128_load
+        #undef vec128_storeu
+        #undef vec128_add
+    #endif
 #endif
 
 // Sparse input implementation
@@ -157,6 +190,16 @@ class AffineTransformSparseInput {
 
     using OutputBuffer = OutputType[PaddedOutputDimensions];
 
+    static constexpr IndexType NumInputChunks =
+      ceil_to_multiple<IndexType>(InputDimensions, 8) / ChunkSize;
+
+    // Indices of the nonzero blocks of ChunkSize inputs. They only depend on the
+    // input, so one extraction can be shared by the layer stacks of a net.
+    struct NonZeroInputs {
+        std::uint16_t indices[NumInputChunks];
+        IndexType     count;
+    };
+
     // Hash value embedded in the evaluation file
     static constexpr std::uint32_t get_hash_value(std::uint32_t prevHash) {
         std::uint32_t hashValue = 0xCC03DAE4u;
@@ -197,8 +240,27 @@ class AffineTransformSparseInput {
 
         return !stream.fail();
     }
+    static void find_nonzero_inputs([[maybe_unused]] const InputType* input, NonZeroInputs& nnz) {
+#if (USE_SSSE3 | (USE_NEON >= 8))
+        find_nnz<NumInputChunks>(reinterpret_cast<const std::int32_t*>(input), nnz.indices,
+                                 nnz.count);
+#else
+        nnz.count = 0;
+#endif
+    }
+
     // Forward propagation
     void propagate(const InputType* input, OutputType* output) const {
+        NonZeroInputs nnz;
+        find_nonzero_inputs(input, nnz);
+        propagate(input, nnz, output);
+    }
+
+    // Forward propagation with the nonzero blocks of the input already known,
+    // as found by find_nonzero_inputs().
+    void propagate(const InputType*                      input,
+                   [[maybe_unused]] const NonZeroInputs& nnz,
+                   OutputType*                           output) const {
 
 #if (USE_SSSE3 | (USE_NEON >= 8))
     #if defined(USE_AVX512) || defined(USE_AVX512F)
@@ -229,24 +291,18 @@ class AffineTransformSparseInput {
     #endif
         static constexpr IndexType OutputSimdWidth = sizeof(outvec_t) / sizeof(OutputType);
 
-        constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / ChunkSize;
-        constexpr IndexType NumRegs   = OutputDimensions / OutputSimdWidth;
-        std::uint16_t       nnz[NumChunks];
-        IndexType           count;
+        constexpr IndexType NumRegs = OutputDimensions / OutputSimdWidth;
 
         const auto input32 = reinterpret_cast<const std::int32_t*>(input);
 
-        // Find indices of nonzero 32-bit blocks
-        find_nnz<NumChunks>(input32, nnz, count);
-
         const outvec_t* biasvec = reinterpret_cast<const outvec_t*>(biases);
         outvec_t        acc[NumRegs];
         for (IndexType k = 0; k < NumRegs; ++k)
             acc[k] = biasvec[k];
 
-        for (IndexType j = 0; j < count; ++j)
+        for (IndexType j = 0; j < nnz.count; ++j)
         {
-            const auto    i  = nnz[j];
+            const auto    i  = nnz.indices[j];
             const invec_t in = vec_set_32(input32[i]);
             const auto    col =
               reinterpret_cast<const invec_t*>(&weights[i * OutputDimensions * ChunkSize]);
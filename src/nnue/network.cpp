@@ -15,12 +15,19 @@
 
 #include "network.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <memory>
 #include <optional>
+#include <string_view>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
@@ -56,13 +63,57 @@ bool write_parameters(std::ostream& stream, const T& reference) {
     return reference.write_parameters(stream);
 }
 
+// Weight permutations and scramblings applied on load depend on the target,
+// so a memory mapped net is only usable by builds with the same layout.
+constexpr std::uint32_t MappedLayout = 0
+#if defined(USE_AVX512) || defined(USE_AVX512F)
+                                     | 1 << 0
+#endif
+#if defined(USE_AVX2)
+                                     | 1 << 1
+#endif
+#if defined(USE_SSSE3)
+                                     | 1 << 2
+#endif
+#if defined(USE_SSE2)
+                                     | 1 << 3
+#endif
+#if defined(USE_VNNI) && !defined(USE_AVXVNNI)
+                                     | 1 << 4
+#endif
+#if defined(USE_NEON_DOTPROD)
+                                     | 1 << 5
+#endif
+#if defined(USE_NEON)
+                                     | (USE_NEON & 0xFF) << 8
+#endif
+  ;
+
+constexpr std::size_t MappedAlignment = 4096;
+
+struct MappedHeader {
+    std::uint32_t version;
+    std::uint32_t hash;
+    std::uint32_t layout;
+    std::uint32_t descSize;
+    std::uint64_t transformerSize;
+    std::uint64_t architectureSize;
+};
+
+// The feature transformer starts on a page boundary right after the header
+// and the description, and is directly followed by the layer stacks.
+constexpr std::size_t mapped_transformer_offset(std::size_t descSize) {
+    return (sizeof(MappedHeader) + descSize + MappedAlignment - 1) / MappedAlignment
+         * MappedAlignment;
+}
+
 }  // namespace Detail
 
 Network::Network(const Network& other) :
     evalFile(other.evalFile) {
 
     if (other.featureTransformer)
-        featureTransformer = make_unique_large_page<FeatureTransformer>(*other.featureTransformer);
+        featureTransformer = make_unique_mappable<FeatureTransformer>(*other.featureTransformer);
 
     network = make_unique_aligned<NetworkArchitecture[]>(LayerStacks);
 
@@ -75,7 +126,7 @@ Network::Network(const Network& other) :
 Network& Network::operator=(const Network& other) {
     evalFile = other.evalFile;
 
-    featureTransformer = make_unique_large_page<FeatureTransformer>(*other.featureTransformer);
+    featureTransformer = make_unique_mappable<FeatureTransformer>(*other.featureTransformer);
 
     network = make_unique_aligned<NetworkArchitecture[]>(LayerStacks);
 
@@ -87,6 +138,14 @@ Network& Network::operator=(const Network& other) {
     return *this;
 }
 
+// Moves the feature transformer, by far the biggest part, to memory allocated
+// afresh, to follow a change of the LargePages option. A mapped network stays
+// in its mapping.
+void Network::reallocate() {
+    if (featureTransformer && !featureTransformer.get_deleter().mapping)
+        featureTransformer = make_unique_mappable<FeatureTransformer>(*featureTransformer);
+}
+
 void Network::load(const std::string& rootDirectory, std::string evalfilePath) {
 #if defined(DEFAULT_NNUE_DIRECTORY)
     std::vector<std::string> dirs = {"", rootDirectory, stringify(DEFAULT_NNUE_DIRECTORY)};
@@ -137,7 +196,68 @@ bool Network::save(const std::optional<std::string>& filename) const {
 }
 
 
-NetworkOutput Network::evaluate(const Position& pos, AccumulatorCaches::Cache* cache) const {
+// Writes the net as it is currently laid out in memory, so that it can be
+// mapped back by load_mapped() without any parsing or copying.
+bool Network::save_mapped(const std::string& filename) const {
+    std::string msg;
+
+    if (evalFile.current.empty() || evalFile.current == "None")
+    {
+        msg = "Failed to export a mapped net. No net is loaded";
+        sync_cout << msg << sync_endl;
+        return false;
+    }
+
+    std::vector<char> image(mapped_size());
+    write_mapped(image.data());
+
+    std::ofstream stream(filename, std::ios_base::binary);
+    stream.write(image.data(), image.size());
+
+    bool saved = bool(stream);
+    msg = saved ? "Mapped network saved successfully to " + filename : "Failed to export a net";
+
+    sync_cout << msg << sync_endl;
+    return saved;
+}
+
+
+// Returns a copy whose parameters live in a shared memory segment named after
+// the net, so that processes using the same net on the same node share a single
+// copy. The first process to get there fills the segment, others attach to it.
+// Falls back to a private copy if shared memory is not available.
+Network Network::clone_shared(std::size_t node) const {
+    if (!featureTransformer || evalFile.current == "None")
+        return Network(*this);
+
+    const std::string_view ftBytes(reinterpret_cast<const char*>(featureTransformer.get()),
+                                   sizeof(FeatureTransformer));
+    const std::string_view netBytes(reinterpret_cast<const char*>(network.get()),
+                                    sizeof(NetworkArchitecture) * LayerStacks);
+    const std::size_t      contentHash = std::hash<std::string_view>{}(ftBytes) * 31
+                                  + std::hash<std::string_view>{}(netBytes);
+
+    std::ostringstream name;
+    name << "/pikafish-" << std::hex << Network::hash << "-" << Detail::MappedLayout << "-"
+         << contentHash << std::dec << "-" << node;
+
+    const std::size_t size = mapped_size();
+    const auto        init = [this](void* mem) { write_mapped(static_cast<char*>(mem)); };
+
+    if (void* mapping = map_shared_memory(name.str(), size, init))
+    {
+        Network copy(evalFile);
+        if (copy.attach_mapped(mapping, size).has_value())
+            return copy;
+    }
+
+    return Network(*this);
+}
+
+
+NetworkOutput Network::evaluate(const Position&           pos,
+                                AccumulatorStack&         accumulators,
+                                AccumulatorCaches::Cache* cache) const {
     // We manually align the arrays on the stack because with gcc < 9.3
     // overaligning stack variables with alignas() doesn't work correctly.
 
@@ -156,14 +276,124 @@ NetworkOutput Network::evaluate(const Position& pos, AccumulatorCaches::Cache* c
     ASSERT_ALIGNED(transformedFeatures, alignment);
 
     const int  bucket     = (pos.count<ALL_PIECES>() - 1) / 4;
-    const auto psqt       = featureTransformer->transform(pos, cache, transformedFeatures, bucket);
+    const auto psqt =
+      featureTransformer->transform(pos, accumulators, cache, transformedFeatures, bucket);
     const auto positional = network[bucket].propagate(transformedFeatures);
 
     return {static_cast<Value>(psqt / OutputScale), static_cast<Value>(positional / OutputScale)};
 }
 
 
-void Network::verify(std::string evalfilePath) const {
+// Evaluates several unrelated positions at once, using accumulators as scratch
+// space. All feature transforms are done first, then the positions are
+// propagated together, see propagate_batch().
+std::vector<NetworkOutput> Network::evaluate_batch(const std::vector<const Position*>& positions,
+                                                   AccumulatorStack&         accumulators,
+                                                   AccumulatorCaches::Cache* cache) const {
+
+    const std::size_t                n = positions.size();
+    std::vector<TransformedFeatures> features(n);
+    std::vector<int>                 buckets(n);
+    std::vector<NetworkOutput>       outputs(n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const Position& pos = *positions[i];
+
+        buckets[i] = (pos.count<ALL_PIECES>() - 1) / 4;
+
+        accumulators.reset();
+        const auto psqt =
+          featureTransformer->transform(pos, accumulators, cache, features[i].data, buckets[i]);
+        std::get<0>(outputs[i]) = static_cast<Value>(psqt / OutputScale);
+    }
+
+    propagate_batch(features, buckets, outputs);
+
+    return outputs;
+}
+
+
+// Evaluates the position with each piece of the list removed in turn, see
+// FeatureTransformer::transform_removal(), from the computed accumulator of the
+// position at the top of the stack. The board is left as it was.
+std::vector<NetworkOutput> Network::evaluate_removals(Position&                  pos,
+                                                      const std::vector<Square>& squares,
+                                                      AccumulatorStack&          accumulators,
+                                                      AccumulatorCaches::Cache*  cache) const {
+
+    const std::size_t                n = squares.size();
+    std::vector<TransformedFeatures> features(n);
+    std::vector<int>                 buckets(n);
+    std::vector<NetworkOutput>       outputs(n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const Square sq = squares[i];
+        const Piece  pc = pos.piece_on(sq);
+
+        pos.remove_piece(sq);
+        accumulators.push();
+
+        buckets[i]      = (pos.count<ALL_PIECES>() - 1) / 4;
+        const auto psqt = featureTransformer->transform_removal(pos, sq, pc, accumulators, cache,
+                                                                features[i].data, buckets[i]);
+        std::get<0>(outputs[i]) = static_cast<Value>(psqt / OutputScale);
+
+        accumulators.pop();
+        pos.put_piece(pc, sq);
+    }
+
+    propagate_batch(features, buckets, outputs);
+
+    return outputs;
+}
+
+
+// Propagates transformed features through their layer stacks, and stores the
+// results as the positional part of the outputs. The nonzero transformed features
+// are all found first, then the inputs are grouped by layer stack, so that the
+// weights of each stack are brought into the cache only once for the whole batch.
+void Network::propagate_batch(const std::vector<TransformedFeatures>& features,
+                              const std::vector<int>&                 buckets,
+                              std::vector<NetworkOutput>&             outputs) const {
+
+    const std::size_t                               n = features.size();
+    std::vector<NetworkArchitecture::NonZeroInputs> nonZeros(n);
+    std::vector<std::size_t>                        order(n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        ASSERT_ALIGNED(features[i].data, CacheLineSize);
+
+        order[i] = i;
+        NetworkArchitecture::find_nonzero_inputs(features[i].data, nonZeros[i]);
+    }
+
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) { return buckets[a] < buckets[b]; });
+
+    for (std::size_t i : order)
+    {
+        const auto positional = network[buckets[i]].propagate(features[i].data, nonZeros[i]);
+        std::get<1>(outputs[i]) = static_cast<Value>(positional / OutputScale);
+    }
+}
+
+
+bool Network::is_loaded(std::string evalfilePath) const {
+    if (evalfilePath.empty())
+        evalfilePath = evalFile.defaultName;
+
+    return evalFile.current == evalfilePath;
+}
+
+std::size_t Network::huge_page_size() const {
+    return Stockfish::huge_page_size(featureTransformer.get());
+}
+
+bool Network::verify(std::string                                  evalfilePath,
+                     const std::function<void(std::string_view)>& f) const {
     if (evalfilePath.empty())
         evalfilePath = evalFile.defaultName;
 
@@ -178,30 +408,41 @@ void Network::verify(std::string evalfilePath) const {
           "The default net can be downloaded from: "
           "https://github.com/official-pikafish/Networks/releases/download/master-net/"
           + evalFile.defaultName;
-        std::string msg5 = "The engine will be terminated now.";
-
-        sync_cout << "info string ERROR: " << msg1 << sync_endl;
-        sync_cout << "info string ERROR: " << msg2 << sync_endl;
-        sync_cout << "info string ERROR: " << msg3 << sync_endl;
-        sync_cout << "info string ERROR: " << msg4 << sync_endl;
-        sync_cout << "info string ERROR: " << msg5 << sync_endl;
-        exit(EXIT_FAILURE);
+
+        if (f)
+            f("ERROR: " + msg1 + '\n' + "ERROR: " + msg2 + '\n' + "ERROR: " + msg3 + '\n'
+              + "ERROR: " + msg4);
+        else
+            for (const auto& msg : {msg1, msg2, msg3, msg4})
+                sync_cout << "info string ERROR: " << msg << sync_endl;
+
+        return false;
+    }
+
+    if (f)
+    {
+        size_t size = sizeof(*featureTransformer) + sizeof(NetworkArchitecture) * LayerStacks;
+        f("NNUE evaluation using " + evalfilePath + " (" + std::to_string(size / (1024 * 1024))
+          + "MiB, (" + std::to_string(featureTransformer->InputDimensions) + ", "
+          + std::to_string(TransformedFeatureDimensions) + ", "
+          + std::to_string(NetworkArchitecture::FC_0_OUTPUTS) + ", "
+          + std::to_string(NetworkArchitecture::FC_1_OUTPUTS) + ", 1))");
     }
 
-    size_t size = sizeof(*featureTransformer) + sizeof(NetworkArchitecture) * LayerStacks;
-    sync_cout << "info string NNUE evaluation using " << evalfilePath << " ("
-              << size / (1024 * 1024) << "MiB, (" << featureTransformer->InputDimensions << ", "
-              << TransformedFeatureDimensions << ", " << NetworkArchitecture::FC_0_OUTPUTS << ", "
-              << NetworkArchitecture::FC_1_OUTPUTS << ", 1))" << sync_endl;
+    return true;
 }
 
 
-void Network::hint_common_access(const Position& pos, AccumulatorCaches::Cache* cache) const {
-    featureTransformer->hint_common_access(pos, cache);
+void Network::hint_common_access(const Position&           pos,
+                                 AccumulatorStack&         accumulators,
+                                 AccumulatorCaches::Cache* cache) const {
+    featureTransformer->hint_common_access(pos, accumulators, cache);
 }
 
 
-NnueEvalTrace Network::trace_evaluate(const Position& pos, AccumulatorCaches::Cache* cache) const {
+NnueEvalTrace Network::trace_evaluate(const Position&           pos,
+                                      AccumulatorStack&         accumulators,
+                                      AccumulatorCaches::Cache* cache) const {
     // We manually align the arrays on the stack because with gcc < 9.3
     // overaligning stack variables with alignas() doesn't work correctly.
     constexpr uint64_t alignment = CacheLineSize;
@@ -218,13 +459,19 @@ NnueEvalTrace Network::trace_evaluate(const Position& pos, AccumulatorCaches::Ca
 
     ASSERT_ALIGNED(transformedFeatures, alignment);
 
-    NnueEvalTrace t{};
+    NnueEvalTrace                      t{};
+    NetworkArchitecture::NonZeroInputs nnz;
     t.correctBucket = (pos.count<ALL_PIECES>() - 1) / 4;
     for (IndexType bucket = 0; bucket < LayerStacks; ++bucket)
     {
         const auto materialist =
-          featureTransformer->transform(pos, cache, transformedFeatures, bucket);
-        const auto positional = network[bucket].propagate(transformedFeatures);
+          featureTransformer->transform(pos, accumulators, cache, transformedFeatures, bucket);
+
+        // Only the psqt part depends on the bucket, the transformed features do not
+        if (bucket == 0)
+            NetworkArchitecture::find_nonzero_inputs(transformedFeatures, nnz);
+
+        const auto positional = network[bucket].propagate(transformedFeatures, nnz);
 
         t.psqt[bucket]       = static_cast<Value>(materialist / OutputScale);
         t.positional[bucket] = static_cast<Value>(positional / OutputScale);
@@ -235,8 +482,13 @@ NnueEvalTrace Network::trace_evaluate(const Position& pos, AccumulatorCaches::Ca
 
 
 void Network::load_user_net(const std::string& dir, const std::string& evalfilePath) {
-    std::stringstream sstream     = read_zipped_nnue(dir + evalfilePath);
-    auto              description = load(sstream);
+    auto description = load_mapped(dir + evalfilePath);
+
+    if (!description.has_value())
+    {
+        ZipEntryStream stream(dir + evalfilePath);
+        description = load(stream);
+    }
 
     if (!description.has_value())
     {
@@ -252,8 +504,83 @@ void Network::load_user_net(const std::string& dir, const std::string& evalfileP
 }
 
 
+// Maps a net written by save_mapped(). The feature transformer is used in place,
+// only the small layer stacks are copied out of the mapping.
+std::optional<std::string> Network::load_mapped(const std::string& path) {
+    std::size_t size    = 0;
+    void*       mapping = map_file(path, size);
+
+    return mapping ? attach_mapped(mapping, size) : std::nullopt;
+}
+
+
+// Takes ownership of a mapping holding a net in the format of save_mapped(),
+// or releases it if the format does not match this build.
+std::optional<std::string> Network::attach_mapped(void* mapping, std::size_t size) {
+    Detail::MappedHeader header{};
+    if (size >= sizeof(header))
+        std::memcpy(&header, mapping, sizeof(header));
+
+    const std::size_t offset = Detail::mapped_transformer_offset(header.descSize);
+
+    if (header.version != MappedVersion || header.hash != Network::hash
+        || header.layout != Detail::MappedLayout
+        || header.transformerSize != sizeof(FeatureTransformer)
+        || header.architectureSize != sizeof(NetworkArchitecture)
+        || size != offset + sizeof(FeatureTransformer) + sizeof(NetworkArchitecture) * LayerStacks)
+    {
+        unmap_file(mapping, size);
+        return std::nullopt;
+    }
+
+    const char* base = static_cast<const char*>(mapping);
+    std::string description(base + sizeof(header), header.descSize);
+
+    network = make_unique_aligned<NetworkArchitecture[]>(LayerStacks);
+    std::memcpy(static_cast<void*>(network.get()), base + offset + sizeof(FeatureTransformer),
+                sizeof(NetworkArchitecture) * LayerStacks);
+
+    featureTransformer = make_mapped<FeatureTransformer>(mapping, size, offset);
+
+    return description;
+}
+
+
+std::size_t Network::mapped_size() const {
+    return Detail::mapped_transformer_offset(evalFile.netDescription.size())
+         + sizeof(FeatureTransformer) + sizeof(NetworkArchitecture) * LayerStacks;
+}
+
+
+// Writes the mapped image to dst, which must hold mapped_size() bytes. The
+// header goes last, so that an image left incomplete is never taken as valid.
+void Network::write_mapped(char* dst) const {
+    static_assert(std::is_trivially_copyable_v<FeatureTransformer>);
+    static_assert(std::is_trivially_copyable_v<NetworkArchitecture>);
+
+    const std::string& desc   = evalFile.netDescription;
+    const std::size_t  offset = Detail::mapped_transformer_offset(desc.size());
+
+    Detail::MappedHeader header{MappedVersion,
+                                Network::hash,
+                                Detail::MappedLayout,
+                                std::uint32_t(desc.size()),
+                                sizeof(FeatureTransformer),
+                                sizeof(NetworkArchitecture)};
+
+    std::memset(dst, 0, offset);
+    std::memcpy(dst + sizeof(header), desc.data(), desc.size());
+    std::memcpy(dst + offset, featureTransformer.get(), sizeof(FeatureTransformer));
+    std::memcpy(dst + offset + sizeof(FeatureTransformer), network.get(),
+                sizeof(NetworkArchitecture) * LayerStacks);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(dst, &header, sizeof(header));
+}
+
+
 void Network::initialize() {
-    featureTransformer = make_unique_large_page<FeatureTransformer>();
+    featureTransformer = make_unique_mappable<FeatureTransformer>();
     network            = make_unique_aligned<NetworkArchitecture[]>(LayerStacks);
 }
 
@@ -307,9 +634,12 @@ bool Network::read_parameters(std::istream& stream, std::string& netDescription)
     std::uint32_t hashValue;
     if (!read_header(stream, &hashValue, &netDescription))
         return false;
-    if (hashValue != Network::hash)
+    if (hashValue != get_hash_value(false) && hashValue != get_hash_value(true))
         return false;
-    if (!Detail::read_parameters(stream, *featureTransformer))
+
+    const bool packed = hashValue == get_hash_value(true);
+    if (read_little_endian<std::uint32_t>(stream) != FeatureTransformer::get_hash_value(packed)
+        || !featureTransformer->read_parameters(stream, packed))
         return false;
     for (std::size_t i = 0; i < LayerStacks; ++i)
     {
@@ -16,11 +16,15 @@
 #ifndef NETWORK_H_INCLUDED
 #define NETWORK_H_INCLUDED
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <vector>
 
 #include "../memory.h"
 #include "../position.h"
@@ -51,16 +55,48 @@ class Network {
 
     void load(const std::string& rootDirectory, std::string evalfilePath);
     bool save(const std::optional<std::string>& filename) const;
+    bool save_mapped(const std::string& filename) const;
+
+    Network clone_shared(std::size_t node) const;
+    void    reallocate();
+
+    NetworkOutput evaluate(const Position&           pos,
+                           AccumulatorStack&         accumulators,
+                           AccumulatorCaches::Cache* cache) const;
+    std::vector<NetworkOutput> evaluate_batch(const std::vector<const Position*>& positions,
+                                              AccumulatorStack&                   accumulators,
+                                              AccumulatorCaches::Cache*           cache) const;
+    std::vector<NetworkOutput> evaluate_removals(Position&                  pos,
+                                                 const std::vector<Square>& squares,
+                                                 AccumulatorStack&          accumulators,
+                                                 AccumulatorCaches::Cache*  cache) const;
+
+    void hint_common_access(const Position&           pos,
+                            AccumulatorStack&         accumulators,
+                            AccumulatorCaches::Cache* cache) const;
+
+    bool          verify(std::string                                  evalfilePath,
+                         const std::function<void(std::string_view)>& callback) const;
+    bool          is_loaded(std::string evalfilePath) const;
+    std::size_t   huge_page_size() const;
+    NnueEvalTrace trace_evaluate(const Position&           pos,
+                                 AccumulatorStack&         accumulators,
+                                 AccumulatorCaches::Cache* cache) const;
 
-    NetworkOutput evaluate(const Position& pos, AccumulatorCaches::Cache* cache) const;
-
-    void hint_common_access(const Position& pos, AccumulatorCaches::Cache* cache) const;
+   private:
+    struct alignas(CacheLineSize) TransformedFeatures {
+        TransformedFeatureType data[FeatureTransformer::BufferSize];
+    };
 
-    void          verify(std::string evalfilePath) const;
-    NnueEvalTrace trace_evaluate(const Position& pos, AccumulatorCaches::Cache* cache) const;
+    void propagate_batch(const std::vector<TransformedFeatures>&,
+                         const std::vector<int>& buckets,
+                         std::vector<NetworkOutput>&) const;
 
-   private:
-    void load_user_net(const std::string&, const std::string&);
+    void                       load_user_net(const std::string&, const std::string&);
+    std::optional<std::string> load_mapped(const std::string&);
+    std::optional<std::string> attach_mapped(void*, std::size_t);
+    std::size_t                mapped_size() const;
+    void                       write_mapped(char*) const;
 
     void initialize();
 
@@ -74,14 +110,19 @@ class Network {
     bool write_parameters(std::ostream&, const std::string&) const;
 
     // Input feature converter
-    LargePagePtr<FeatureTransformer> featureTransformer;
+    MappablePtr<FeatureTransformer> featureTransformer;
 
     // Evaluation function
     AlignedPtr<NetworkArchitecture[]> network;
 
     EvalFile evalFile;
 
-    // Hash value of evaluation function structure
+    // Hash value of evaluation function structure, for nets with packed
+    // feature transformer weights or not. Both can be loaded by any build.
+    static constexpr std::uint32_t get_hash_value(bool packed) {
+        return FeatureTransformer::get_hash_value(packed) ^ NetworkArchitecture::get_hash_value();
+    }
+
     static constexpr std::uint32_t hash =
       FeatureTransformer::get_hash_value() ^ NetworkArchitecture::get_hash_value();
 
@@ -21,8 +21,13 @@
 #ifndef NNUE_ACCUMULATOR_H_INCLUDED
 #define NNUE_ACCUMULATOR_H_INCLUDED
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
+#include "../misc.h"
+#include "../types.h"
 #include "nnue_architecture.h"
 #include "nnue_common.h"
 
@@ -40,12 +45,75 @@ struct alignas(CacheLineSize) Accumulator {
 };
 
 
+// AccumulatorStack holds one accumulator per ply of the line currently being
+// searched, kept apart from StateInfo so that positions which are never
+// evaluated do not carry the NNUE storage around. Entry 0 belongs to the
+// position the stack was reset at; entry i to the position reached after i
+// further moves. The DirtyPiece describing each of those moves is still
+// stored in the corresponding StateInfo.
+class AccumulatorStack {
+   public:
+    static constexpr std::size_t MaxSize = MAX_PLY + 10;
+
+    // A smaller stack only suits short lines, like those of the NNUE trace
+    explicit AccumulatorStack(std::size_t capacity = MaxSize) :
+        accumulators(capacity) {
+        reset();
+    }
+
+    // Starts a new line at the current position, discarding all accumulators
+    void reset() {
+        size_ = 1;
+        invalidate();
+    }
+
+    // Called after each do_move() and do_null_move()
+    void push() {
+        assert(size_ < accumulators.size());
+        ++size_;
+        invalidate();
+    }
+
+    // Called after each undo_move() and undo_null_move()
+    void pop() {
+        assert(size_ > 1);
+        --size_;
+    }
+
+    // Marks the accumulator of the current position as stale, e.g. after the
+    // board has been modified in place.
+    void invalidate() { latest().computed[WHITE] = latest().computed[BLACK] = false; }
+
+    std::size_t size() const { return size_; }
+
+    Accumulator&       latest() { return accumulators[size_ - 1]; }
+    const Accumulator& latest() const { return accumulators[size_ - 1]; }
+
+    Accumulator&       operator[](std::size_t idx) { return accumulators[idx]; }
+    const Accumulator& operator[](std::size_t idx) const { return accumulators[idx]; }
+
+    // How often an accumulator was rebuilt from the cache or updated
+    // incrementally, counted per perspective, and how many features the
+    // rebuilds applied on top of their cache entries.
+    RelaxedCounter refreshes, updates, refreshFeatures;
+
+   private:
+    std::vector<Accumulator> accumulators;
+    std::size_t              size_;
+};
+
+
 // AccumulatorCaches struct provides per-thread accumulator caches, where each
 // cache contains multiple entries for each of the possible king squares.
 // When the accumulator needs to be refreshed, the cached entry is used to more
 // efficiently update the accumulator, instead of rebuilding it from scratch.
 // This idea, was first described by Luecx (author of Koivisto) and
 // is commonly referred to as "Finny Tables".
+//
+// With COMPACT_FINNY each perspective only has a few entries, each holding the
+// king bucket and advisor-bishop count it was last used for, and a miss takes
+// the least recently used one. The whole cache then fits in the L2 cache, at
+// the price of rebuilding an entry from the biases after a miss.
 struct AccumulatorCaches {
 
     template<typename Network>
@@ -71,6 +139,61 @@ struct AccumulatorCaches {
             }
         };
 
+        // The king squares of the palace times the advisor-bishop counts
+        static constexpr int Indices = 9 * 3 * 3;
+
+        // entry() returns the entry of a perspective for such an index. In a
+        // compact cache, an entry taken over from another index is cleared first.
+
+#ifdef COMPACT_FINNY
+        static constexpr int Slots = 8;
+
+        template<typename Network>
+        void clear(const Network& network) {
+            for (auto& set : sets)
+            {
+                for (int i = 0; i < Slots; ++i)
+                {
+                    set.entries[i].clear(network.featureTransformer->biases);
+                    set.index[i]   = -1;
+                    set.lastUse[i] = 0;
+                }
+                set.clock = 0;
+            }
+        }
+
+        template<Color Perspective>
+        Entry& entry(int index, const BiasType* biases) {
+
+            auto& set = sets[Perspective];
+            int   lru = 0;
+
+            for (int i = 0; i < Slots; ++i)
+            {
+                if (set.index[i] == index)
+                {
+                    set.lastUse[i] = ++set.clock;
+                    return set.entries[i];
+                }
+
+                if (set.lastUse[i] < set.lastUse[lru])
+                    lru = i;
+            }
+
+            set.entries[lru].clear(biases);
+            set.index[lru]   = index;
+            set.lastUse[lru] = ++set.clock;
+            return set.entries[lru];
+        }
+
+        struct Set {
+            Entry    entries[Slots];
+            int      index[Slots];
+            uint64_t lastUse[Slots], clock;
+        };
+
+        Set sets[COLOR_NB];
+#else
         template<typename Network>
         void clear(const Network& network) {
             for (auto& entries1D : entries)
@@ -78,10 +201,13 @@ struct AccumulatorCaches {
                     entry.clear(network.featureTransformer->biases);
         }
 
+        template<Color Perspective>
+        Entry& entry(int index, const BiasType*) {
+            return entries[index][Perspective];
+        }
 
-        std::array<Entry, COLOR_NB>& operator[](int index) { return entries[index]; }
-
-        std::array<std::array<Entry, COLOR_NB>, 9 * 3 * 3> entries;
+        std::array<std::array<Entry, COLOR_NB>, Indices> entries;
+#endif
     };
 
     template<typename Network>
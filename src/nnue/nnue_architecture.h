@@ -82,7 +82,22 @@ struct NetworkArchitecture {
             && fc_2.write_parameters(stream);
     }
 
+    using NonZeroInputs = decltype(fc_0)::NonZeroInputs;
+
+    // The nonzero blocks of the transformed features, as read by fc_0
+    static void find_nonzero_inputs(const TransformedFeatureType* transformedFeatures,
+                                    NonZeroInputs&                nnz) {
+        decltype(fc_0)::find_nonzero_inputs(transformedFeatures, nnz);
+    }
+
     std::int32_t propagate(const TransformedFeatureType* transformedFeatures) {
+        NonZeroInputs nnz;
+        find_nonzero_inputs(transformedFeatures, nnz);
+        return propagate(transformedFeatures, nnz);
+    }
+
+    std::int32_t propagate(const TransformedFeatureType* transformedFeatures,
+                           const NonZeroInputs&          nnz) {
         struct alignas(CacheLineSize) Buffer {
             alignas(CacheLineSize) decltype(fc_0)::OutputBuffer fc_0_out;
             alignas(CacheLineSize) decltype(ac_sqr_0)::OutputType
@@ -104,7 +119,7 @@ struct NetworkArchitecture {
         alignas(CacheLineSize) static thread_local Buffer buffer;
 #endif
 
-        fc_0.propagate(transformedFeatures, buffer.fc_0_out);
+        fc_0.propagate(transformedFeatures, nnz, buffer.fc_0_out);
         ac_sqr_0.propagate(buffer.fc_0_out, buffer.ac_sqr_0_out);
         ac_0.propagate(buffer.fc_0_out, buffer.ac_0_out);
         std::memcpy(buffer.ac_sqr_0_out + FC_0_OUTPUTS, buffer.ac_0_out,
@@ -51,6 +51,10 @@ namespace Stockfish::Eval::NNUE {
 // Version of the evaluation file
 constexpr std::uint32_t Version = 0x7AF32F20u;
 
+// Version of the memory mapped evaluation file, which stores the parameters
+// exactly as they are laid out in memory by the build that exported it
+constexpr std::uint32_t MappedVersion = 0x7AF32F21u;
+
 // Constant used in evaluation value calculation
 constexpr int OutputScale     = 16;
 constexpr int WeightScaleBits = 6;
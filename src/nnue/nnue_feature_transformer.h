@@ -27,7 +27,9 @@
 #include <cstring>
 #include <iosfwd>
 #include <utility>
+#include <vector>
 
+#include "../memory.h"
 #include "../position.h"
 #include "../types.h"
 #include "nnue_accumulator.h"
@@ -40,6 +42,16 @@ using BiasType       = std::int16_t;
 using WeightType     = std::int16_t;
 using PSQTWeightType = std::int32_t;
 
+// Building with FT_WEIGHTS_8 (make ftweights=8) stores the weights of the
+// feature transformer in 8 bits with a power of two scale per feature, which
+// halves the memory read by the accumulator updates. They are widened back to
+// WeightType when loaded into registers.
+#if defined(FT_WEIGHTS_8)
+using StoredWeightType = std::int8_t;
+#else
+using StoredWeightType = WeightType;
+#endif
+
 // If vector instructions are enabled, we update and refresh the
 // accumulator tile by tile such that each tile fits in the CPU's
 // vector registers.
@@ -61,6 +73,8 @@ using psqt_vec_t = __m256i;
     #define vec_max_16(a, b) _mm512_max_epi16(a, b)
     #define vec_min_16(a, b) _mm512_min_epi16(a, b)
     #define vec_slli_16(a, b) _mm512_slli_epi16(a, b)
+    #define vec_load_8_to_16(a) \
+        _mm512_cvtepi8_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(a)))
     // Inverse permuted at load time
     #define vec_packus_16(a, b) _mm512_packus_epi16(a, b)
     #define vec_load_psqt(a) _mm256_load_si256(a)
@@ -93,6 +107,12 @@ using psqt_vec_t = __m256i;
         __builtin_shufflevector(_mm256_slli_epi16(__builtin_shufflevector(a, a, 0, 1, 2, 3), b), \
                                 _mm256_slli_epi16(__builtin_shufflevector(a, a, 4, 5, 6, 7), b), \
                                 0, 1, 2, 3, 4, 5, 6, 7)
+    #define vec_load_8_to_16(a) \
+        _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_cvtepi8_epi16( \
+                             _mm_load_si128(reinterpret_cast<const __m128i*>(a)))), \
+                           _mm256_cvtepi8_epi16( \
+                             _mm_load_si128(reinterpret_cast<const __m128i*>(a) + 1)), \
+                           1)
     // Inverse permuted at load time
     #define vec_packus_16(a, b) vec_op(_mm256_packus_epi16, a, b)
     #define vec_load_psqt(a) _mm256_load_si256(a)
@@ -116,6 +136,8 @@ using psqt_vec_t = __m256i;
     #define vec_max_16(a, b) _mm256_max_epi16(a, b)
     #define vec_min_16(a, b) _mm256_min_epi16(a, b)
     #define vec_slli_16(a, b) _mm256_slli_epi16(a, b)
+    #define vec_load_8_to_16(a) \
+        _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(a)))
     // Inverse permuted at load time
     #define vec_packus_16(a, b) _mm256_packus_epi16(a, b)
     #define vec_load_psqt(a) _mm256_load_si256(a)
@@ -139,6 +161,10 @@ using psqt_vec_t = __m128i;
     #define vec_max_16(a, b) _mm_max_epi16(a, b)
     #define vec_min_16(a, b) _mm_min_epi16(a, b)
     #define vec_slli_16(a, b) _mm_slli_epi16(a, b)
+    #define vec_load_8_to_16(a) \
+        _mm_srai_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)), \
+                                         _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a))), \
+                       8)
     #define vec_packus_16(a, b) _mm_packus_epi16(a, b)
     #define vec_load_psqt(a) (*(a))
     #define vec_store_psqt(a, b) *(a) = (b)
@@ -162,6 +188,7 @@ using psqt_vec_t = int32x4_t;
     #define vec_max_16(a, b) vmaxq_s16(a, b)
     #define vec_min_16(a, b) vminq_s16(a, b)
     #define vec_slli_16(a, b) vshlq_s16(a, vec_set_16(b))
+    #define vec_load_8_to_16(a) vmovl_s8(vld1_s8(reinterpret_cast<const int8_t*>(a)))
     #define vec_packus_16(a, b) reinterpret_cast<vec_t>(vcombine_u8(vqmovun_s16(a), vqmovun_s16(b)))
     #define vec_load_psqt(a) (*(a))
     #define vec_store_psqt(a, b) *(a) = (b)
@@ -249,9 +276,12 @@ class FeatureTransformer {
     // Size of forward propagation buffer
     static constexpr std::size_t BufferSize = OutputDimensions * sizeof(OutputType);
 
-    // Hash value embedded in the evaluation file
-    static constexpr std::uint32_t get_hash_value() {
-        return FeatureSet::HashValue ^ (OutputDimensions * 2);
+    static constexpr bool PackedWeights = sizeof(StoredWeightType) == 1;
+
+    // Hash value embedded in the evaluation file, packed nets store the weights
+    // in 8 bits with a shift per feature.
+    static constexpr std::uint32_t get_hash_value(bool packed = PackedWeights) {
+        return FeatureSet::HashValue ^ (OutputDimensions * 2) ^ (packed ? 0x8A3E5C01u : 0u);
     }
 
     static void order_packs([[maybe_unused]] uint64_t* v) {
@@ -282,7 +312,10 @@ class FeatureTransformer {
 #endif
     }
 
-    void permute_weights([[maybe_unused]] void (*order_fn)(uint64_t*)) const {
+    // The permutation and scaling are done on 16 bit weights, before packing
+    // them on load and after unpacking them on save.
+    void permute_weights([[maybe_unused]] WeightType* weightsIn,
+                         [[maybe_unused]] void (*order_fn)(uint64_t*)) const {
 #if defined(USE_AVX2)
     #if defined(USE_AVX512) || defined(USE_AVX512F)
         constexpr IndexType di = 16;
@@ -295,8 +328,7 @@ class FeatureTransformer {
 
         for (IndexType j = 0; j < InputDimensions; ++j)
         {
-            uint64_t* w =
-              reinterpret_cast<uint64_t*>(const_cast<WeightType*>(&weights[j * HalfDimensions]));
+            uint64_t* w = reinterpret_cast<uint64_t*>(&weightsIn[j * HalfDimensions]);
             for (IndexType i = 0; i < HalfDimensions * sizeof(WeightType) / sizeof(uint64_t);
                  i += di)
                 order_fn(&w[i]);
@@ -304,10 +336,10 @@ class FeatureTransformer {
 #endif
     }
 
-    inline void scale_weights(bool read) const {
+    inline void scale_weights(WeightType* weightsIn, bool read) const {
         for (IndexType j = 0; j < InputDimensions; ++j)
         {
-            WeightType* w = const_cast<WeightType*>(&weights[j * HalfDimensions]);
+            WeightType* w = &weightsIn[j * HalfDimensions];
             for (IndexType i = 0; i < HalfDimensions; ++i)
                 w[i] = read ? w[i] * 2 : w[i] / 2;
         }
@@ -317,44 +349,153 @@ class FeatureTransformer {
             b[i] = read ? b[i] * 2 : b[i] / 2;
     }
 
-    // Read network parameters
-    bool read_parameters(std::istream& stream) {
+    // Quantizes a row of weights to 8 bits with the smallest shift that keeps
+    // them in range. This is exact for the rows of a packed net.
+    static int pack_row(const WeightType* w, std::int8_t* packed) {
+        const int lo = *std::min_element(w, w + HalfDimensions);
+        const int hi = *std::max_element(w, w + HalfDimensions);
+
+        int shift = 0;
+        while ((hi + (1 << shift >> 1)) >> shift > 127 || (lo + (1 << shift >> 1)) >> shift < -128)
+            ++shift;
+
+        const int maxPacked = std::min(127, 32767 >> shift);
+        for (IndexType i = 0; i < HalfDimensions; ++i)
+            packed[i] =
+              std::int8_t(std::clamp((w[i] + (1 << shift >> 1)) >> shift, -128, maxPacked));
+
+        return shift;
+    }
+
+    static void unpack_row(const std::int8_t* packed, int shift, WeightType* w) {
+        for (IndexType i = 0; i < HalfDimensions; ++i)
+            w[i] = WeightType(packed[i] * (1 << shift));
+    }
+
+    static void read_packed_weights(std::istream& stream, WeightType* w) {
+        std::vector<std::int8_t> shifts(InputDimensions), packed(HalfDimensions * InputDimensions);
+
+        read_leb_128<std::int8_t>(stream, shifts.data(), InputDimensions);
+        read_leb_128<std::int8_t>(stream, packed.data(), HalfDimensions * InputDimensions);
+
+        for (IndexType j = 0; j < InputDimensions && !stream.fail(); ++j)
+        {
+            if (shifts[j] < 0 || shifts[j] > 15)
+                stream.setstate(std::ios::failbit);
+            else
+                unpack_row(&packed[j * HalfDimensions], shifts[j], &w[j * HalfDimensions]);
+        }
+    }
+
+    static void write_packed_weights(std::ostream& stream, const WeightType* w) {
+        std::vector<std::int8_t> shifts(InputDimensions), packed(HalfDimensions * InputDimensions);
+
+        for (IndexType j = 0; j < InputDimensions; ++j)
+            shifts[j] = std::int8_t(pack_row(&w[j * HalfDimensions], &packed[j * HalfDimensions]));
+
+        write_leb_128<std::int8_t>(stream, shifts.data(), InputDimensions);
+        write_leb_128<std::int8_t>(stream, packed.data(), HalfDimensions * InputDimensions);
+    }
+
+    // Read network parameters, the weights of the file may be packed or not
+    // independently of the format used in memory.
+    bool read_parameters(std::istream& stream, bool packed = PackedWeights) {
+
+        AlignedPtr<WideRow[]> buffer;
+        WeightType*           wide = wide_weights(buffer);
 
         read_leb_128<BiasType>(stream, biases, HalfDimensions);
-        read_leb_128<WeightType>(stream, weights, HalfDimensions * InputDimensions);
+        if (packed)
+            read_packed_weights(stream, wide);
+        else
+            read_leb_128<WeightType>(stream, wide, HalfDimensions * InputDimensions);
         read_leb_128<PSQTWeightType>(stream, psqtWeights, PSQTBuckets * InputDimensions);
 
-        permute_weights(inverse_order_packs);
-        scale_weights(true);
+        permute_weights(wide, inverse_order_packs);
+        scale_weights(wide, true);
+
+#if defined(FT_WEIGHTS_8)
+        for (IndexType j = 0; j < InputDimensions; ++j)
+            weightShifts[j] =
+              std::uint8_t(pack_row(&wide[j * HalfDimensions], &weights[j * HalfDimensions]));
+#endif
         return !stream.fail();
     }
 
-    // Write network parameters
+    // Write network parameters, in the format used in memory
     bool write_parameters(std::ostream& stream) const {
 
-        permute_weights(order_packs);
-        scale_weights(false);
+        AlignedPtr<WideRow[]> buffer;
+        WeightType*           wide = wide_weights(buffer);
+
+#if defined(FT_WEIGHTS_8)
+        for (IndexType j = 0; j < InputDimensions; ++j)
+            unpack_row(&weights[j * HalfDimensions], weightShifts[j], &wide[j * HalfDimensions]);
+#endif
+        permute_weights(wide, order_packs);
+        scale_weights(wide, false);
 
         write_leb_128<BiasType>(stream, biases, HalfDimensions);
-        write_leb_128<WeightType>(stream, weights, HalfDimensions * InputDimensions);
+        if (PackedWeights)
+            write_packed_weights(stream, wide);
+        else
+            write_leb_128<WeightType>(stream, wide, HalfDimensions * InputDimensions);
         write_leb_128<PSQTWeightType>(stream, psqtWeights, PSQTBuckets * InputDimensions);
 
-        permute_weights(inverse_order_packs);
-        scale_weights(true);
+        permute_weights(wide, inverse_order_packs);
+        scale_weights(wide, true);
         return !stream.fail();
     }
 
     // Convert input features
     std::int32_t transform(const Position&           pos,
+                           AccumulatorStack&         accumulators,
                            AccumulatorCaches::Cache* cache,
                            OutputType*               output,
                            int                       bucket) const {
-        update_accumulator<WHITE>(pos, cache);
-        update_accumulator<BLACK>(pos, cache);
+        update_accumulator<WHITE>(pos, accumulators, cache);
+        update_accumulator<BLACK>(pos, accumulators, cache);
 
-        const Color perspectives[2]  = {pos.side_to_move(), ~pos.side_to_move()};
-        const auto& accumulation     = pos.state()->accumulator.accumulation;
-        const auto& psqtAccumulation = pos.state()->accumulator.psqtAccumulation;
+        return transform(pos.side_to_move(), accumulators.latest(), output, bucket);
+    }
+
+    // Like transform(), for the position without the piece pc, which the caller
+    // has just removed from square sq of pos. The accumulator below the top of
+    // the stack must be the computed one of the position with the piece. The top
+    // one is found from it by subtracting the feature of the piece, except for
+    // the perspective of the color of the piece when it is an advisor or a
+    // bishop: all its features depend on their count, so it is refreshed.
+    std::int32_t transform_removal(const Position&           pos,
+                                   Square                    sq,
+                                   Piece                     pc,
+                                   AccumulatorStack&         accumulators,
+                                   AccumulatorCaches::Cache* cache,
+                                   OutputType*               output,
+                                   int                       bucket) const {
+        assert(accumulators.size() > 1 && pos.piece_on(sq) == NO_PIECE);
+
+        update_accumulator_removal<WHITE>(pos, sq, pc, accumulators, cache);
+        update_accumulator_removal<BLACK>(pos, sq, pc, accumulators, cache);
+
+        return transform(pos.side_to_move(), accumulators.latest(), output, bucket);
+    }
+
+    void hint_common_access(const Position&           pos,
+                            AccumulatorStack&         accumulators,
+                            AccumulatorCaches::Cache* cache) const {
+        hint_common_access_for_perspective<WHITE>(pos, accumulators, cache);
+        hint_common_access_for_perspective<BLACK>(pos, accumulators, cache);
+    }
+
+   private:
+    std::int32_t transform(Color              stm,
+                           const Accumulator& accumulator,
+                           OutputType*        output,
+                           int                bucket) const {
+
+        const Color perspectives[2]  = {stm, ~stm};
+        const auto& accumulation     = accumulator.accumulation;
+        const auto& psqtAccumulation = accumulator.psqtAccumulation;
 
         const auto psqt =
           (psqtAccumulation[perspectives[0]][bucket] - psqtAccumulation[perspectives[1]][bucket])
@@ -425,51 +566,82 @@ class FeatureTransformer {
         return psqt;
     }  // end of function transform()
 
-    void hint_common_access(const Position& pos, AccumulatorCaches::Cache* cache) const {
-        hint_common_access_for_perspective<WHITE>(pos, cache);
-        hint_common_access_for_perspective<BLACK>(pos, cache);
-    }
-
-   private:
+    // Returns the stack index of the newest accumulator usable as the starting
+    // point of an incremental update, or of the position to refresh.
     template<Color Perspective>
-    [[nodiscard]] std::pair<StateInfo*, StateInfo*>
-    try_find_computed_accumulator(const Position& pos) const {
+    [[nodiscard]] std::size_t
+    try_find_computed_accumulator(const Position& pos, const AccumulatorStack& accumulators) const {
         // Look for a usable accumulator of an earlier position. We keep track
         // of the estimated gain in terms of features to be added/subtracted.
-        StateInfo *st = pos.state(), *next = nullptr;
-        int        gain = FeatureSet::refresh_cost(pos);
-        while (st->previous && !st->accumulator.computed[Perspective])
+        const StateInfo* st   = pos.state();
+        std::size_t      idx  = accumulators.size() - 1;
+        int              gain = FeatureSet::refresh_cost(pos);
+        while (idx > 0 && !accumulators[idx].computed[Perspective])
         {
             // This governs when a full feature refresh is needed and how many
             // updates are better than just one full refresh.
             if (FeatureSet::requires_refresh(st, Perspective)
                 || (gain -= FeatureSet::update_cost(st) + 1) < 0)
                 break;
-            next = st;
-            st   = st->previous;
+            st = st->previous;
+            --idx;
         }
-        return {st, next};
+        return idx;
     }
 
-    // NOTE: The parameter states_to_update is an array of position states.
-    //       All states must be sequential, that is states_to_update[i] must either be reachable
-    //       by repeatedly applying ->previous from states_to_update[i+1].
-    //       computed_st must be reachable by repeatedly applying ->previous on
-    //       states_to_update[0].
+    // When several moves are fused into one update, a feature may be added by
+    // one of them and removed by another, e.g. when a piece moves twice or a
+    // moved piece gets captured. Such pairs cancel out, so we drop them from both
+    // lists instead of adding and subtracting the same weight column.
+    static void cancel_common_indices(FeatureSet::IndexList& removed,
+                                      FeatureSet::IndexList& added) {
+        FeatureSet::IndexList remaining;
+        bool                  cancelled[FeatureSet::MaxActiveDimensions] = {};
+
+        for (const auto index : removed)
+        {
+            std::size_t j = 0;
+            while (j < added.size() && (cancelled[j] || added[j] != index))
+                ++j;
+
+            if (j < added.size())
+                cancelled[j] = true;
+            else
+                remaining.push_back(index);
+        }
+
+        removed   = remaining;
+        remaining = FeatureSet::IndexList();
+
+        for (std::size_t j = 0; j < added.size(); ++j)
+            if (!cancelled[j])
+                remaining.push_back(added[j]);
+
+        added = remaining;
+    }
+
+    // NOTE: The parameter indices_to_update holds stack indices in increasing
+    //       order, all greater than computed, the last one being the top of the
+    //       stack. The dirty pieces of the moves in between are found by walking
+    //       back the StateInfo chain from the current position.
     template<Color Perspective, size_t N>
-    void update_accumulator_incremental(const Position& pos,
-                                        StateInfo*      computed_st,
-                                        StateInfo*      states_to_update[N]) const {
+    void update_accumulator_incremental(const Position&   pos,
+                                        AccumulatorStack& accumulators,
+                                        std::size_t       computed,
+                                        std::size_t       indices_to_update[N]) const {
         static_assert(N > 0);
+        assert(indices_to_update[N - 1] == accumulators.size() - 1);
         assert([&]() {
             for (size_t i = 0; i < N; ++i)
             {
-                if (states_to_update[i] == nullptr)
+                if (indices_to_update[i] <= (i == 0 ? computed : indices_to_update[i - 1]))
                     return false;
             }
             return true;
         }());
 
+        accumulators.updates += N;
+
 #ifdef VECTOR
         // Gcc-10.2 unnecessarily spills AVX2 registers if this array
         // is defined in the VECTOR code below, once in each branch
@@ -488,35 +660,39 @@ class FeatureTransformer {
         // updates with more added/removed features than MaxActiveDimensions.
         FeatureSet::IndexList removed[N], added[N];
 
+        const StateInfo* st2 = pos.state();
+        std::size_t      idx = accumulators.size() - 1;
+
         for (int i = N - 1; i >= 0; --i)
         {
-            states_to_update[i]->accumulator.computed[Perspective] = true;
+            accumulators[indices_to_update[i]].computed[Perspective] = true;
 
-            const StateInfo* end_state = i == 0 ? computed_st : states_to_update[i - 1];
+            const std::size_t end = i == 0 ? computed : indices_to_update[i - 1];
 
-            for (StateInfo* st2 = states_to_update[i]; st2 != end_state; st2 = st2->previous)
+            // All moves in between are fused into a single update of the target
+            const bool fused = idx > end + 1;
+
+            for (; idx > end; --idx, st2 = st2->previous)
                 FeatureSet::append_changed_indices<Perspective>(ksq, ab, st2->dirtyPiece,
                                                                 removed[i], added[i]);
+
+            if (fused)
+                cancel_common_indices(removed[i], added[i]);
         }
 
-        StateInfo* st = computed_st;
+        const Accumulator* st = &accumulators[computed];
 
         // Now update the accumulators listed in states_to_update[], where the last element is a sentinel.
 #ifdef VECTOR
 
         if (N == 1 && (removed[0].size() == 1 || removed[0].size() == 2) && added[0].size() == 1)
         {
-            assert(states_to_update[0]);
-
-            auto accIn =
-              reinterpret_cast<const vec_t*>(&st->accumulator.accumulation[Perspective][0]);
+            auto accIn  = reinterpret_cast<const vec_t*>(&st->accumulation[Perspective][0]);
             auto accOut = reinterpret_cast<vec_t*>(
-              &states_to_update[0]->accumulator.accumulation[Perspective][0]);
+              &accumulators[indices_to_update[0]].accumulation[Perspective][0]);
 
-            const IndexType offsetR0 = HalfDimensions * removed[0][0];
-            auto            columnR0 = reinterpret_cast<const vec_t*>(&weights[offsetR0]);
-            const IndexType offsetA  = HalfDimensions * added[0][0];
-            auto            columnA  = reinterpret_cast<const vec_t*>(&weights[offsetA]);
+            const auto columnR0 = weight_column(removed[0][0], 0);
+            const auto columnA  = weight_column(added[0][0], 0);
 
             if (removed[0].size() == 1)
             {
@@ -526,8 +702,7 @@ class FeatureTransformer {
             }
             else
             {
-                const IndexType offsetR1 = HalfDimensions * removed[0][1];
-                auto            columnR1 = reinterpret_cast<const vec_t*>(&weights[offsetR1]);
+                const auto columnR1 = weight_column(removed[0][1], 0);
 
                 for (IndexType k = 0; k < HalfDimensions * sizeof(std::int16_t) / sizeof(vec_t);
                      ++k)
@@ -535,10 +710,10 @@ class FeatureTransformer {
                                            vec_add_16(columnR0[k], columnR1[k]));
             }
 
-            auto accPsqtIn = reinterpret_cast<const psqt_vec_t*>(
-              &st->accumulator.psqtAccumulation[Perspective][0]);
+            auto accPsqtIn =
+              reinterpret_cast<const psqt_vec_t*>(&st->psqtAccumulation[Perspective][0]);
             auto accPsqtOut = reinterpret_cast<psqt_vec_t*>(
-              &states_to_update[0]->accumulator.psqtAccumulation[Perspective][0]);
+              &accumulators[indices_to_update[0]].psqtAccumulation[Perspective][0]);
 
             const IndexType offsetPsqtR0 = PSQTBuckets * removed[0][0];
             auto columnPsqtR0 = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[offsetPsqtR0]);
@@ -569,8 +744,8 @@ class FeatureTransformer {
             for (IndexType j = 0; j < HalfDimensions / TileHeight; ++j)
             {
                 // Load accumulator
-                auto accTileIn = reinterpret_cast<const vec_t*>(
-                  &st->accumulator.accumulation[Perspective][j * TileHeight]);
+                auto accTileIn =
+                  reinterpret_cast<const vec_t*>(&st->accumulation[Perspective][j * TileHeight]);
                 for (IndexType k = 0; k < NumRegs; ++k)
                     acc[k] = vec_load(&accTileIn[k]);
 
@@ -579,8 +754,7 @@ class FeatureTransformer {
                     // Difference calculation for the deactivated features
                     for (const auto index : removed[i])
                     {
-                        const IndexType offset = HalfDimensions * index + j * TileHeight;
-                        auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                        const auto column = weight_column(index, j * TileHeight);
                         for (IndexType k = 0; k < NumRegs; ++k)
                             acc[k] = vec_sub_16(acc[k], column[k]);
                     }
@@ -588,15 +762,14 @@ class FeatureTransformer {
                     // Difference calculation for the activated features
                     for (const auto index : added[i])
                     {
-                        const IndexType offset = HalfDimensions * index + j * TileHeight;
-                        auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                        const auto column = weight_column(index, j * TileHeight);
                         for (IndexType k = 0; k < NumRegs; ++k)
                             acc[k] = vec_add_16(acc[k], column[k]);
                     }
 
                     // Store accumulator
-                    auto accTileOut = reinterpret_cast<vec_t*>(
-                      &states_to_update[i]->accumulator.accumulation[Perspective][j * TileHeight]);
+                    auto& accOut     = accumulators[indices_to_update[i]].accumulation[Perspective];
+                    auto  accTileOut = reinterpret_cast<vec_t*>(&accOut[j * TileHeight]);
                     for (IndexType k = 0; k < NumRegs; ++k)
                         vec_store(&accTileOut[k], acc[k]);
                 }
@@ -606,7 +779,7 @@ class FeatureTransformer {
             {
                 // Load accumulator
                 auto accTilePsqtIn = reinterpret_cast<const psqt_vec_t*>(
-                  &st->accumulator.psqtAccumulation[Perspective][j * PsqtTileHeight]);
+                  &st->psqtAccumulation[Perspective][j * PsqtTileHeight]);
                 for (std::size_t k = 0; k < NumPsqtRegs; ++k)
                     psqt[k] = vec_load_psqt(&accTilePsqtIn[k]);
 
@@ -632,8 +805,8 @@ class FeatureTransformer {
 
                     // Store accumulator
                     auto accTilePsqtOut = reinterpret_cast<psqt_vec_t*>(
-                      &states_to_update[i]
-                         ->accumulator.psqtAccumulation[Perspective][j * PsqtTileHeight]);
+                      &accumulators[indices_to_update[i]]
+                         .psqtAccumulation[Perspective][j * PsqtTileHeight]);
                     for (std::size_t k = 0; k < NumPsqtRegs; ++k)
                         vec_store_psqt(&accTilePsqtOut[k], psqt[k]);
                 }
@@ -642,55 +815,104 @@ class FeatureTransformer {
 #else
         for (IndexType i = 0; i < N; ++i)
         {
-            std::memcpy(states_to_update[i]->accumulator.accumulation[Perspective],
-                        st->accumulator.accumulation[Perspective],
+            Accumulator& acc = accumulators[indices_to_update[i]];
+
+            std::memcpy(acc.accumulation[Perspective], st->accumulation[Perspective],
                         HalfDimensions * sizeof(BiasType));
 
             for (std::size_t k = 0; k < PSQTBuckets; ++k)
-                states_to_update[i]->accumulator.psqtAccumulation[Perspective][k] =
-                  st->accumulator.psqtAccumulation[Perspective][k];
+                acc.psqtAccumulation[Perspective][k] = st->psqtAccumulation[Perspective][k];
 
-            st = states_to_update[i];
+            st = &acc;
 
             // Difference calculation for the deactivated features
             for (const auto index : removed[i])
             {
-                const IndexType offset = HalfDimensions * index;
-
                 for (IndexType j = 0; j < HalfDimensions; ++j)
-                    st->accumulator.accumulation[Perspective][j] -= weights[offset + j];
+                    acc.accumulation[Perspective][j] -= weight(index, j);
 
                 for (std::size_t k = 0; k < PSQTBuckets; ++k)
-                    st->accumulator.psqtAccumulation[Perspective][k] -=
-                      psqtWeights[index * PSQTBuckets + k];
+                    acc.psqtAccumulation[Perspective][k] -= psqtWeights[index * PSQTBuckets + k];
             }
 
             // Difference calculation for the activated features
             for (const auto index : added[i])
             {
-                const IndexType offset = HalfDimensions * index;
-
                 for (IndexType j = 0; j < HalfDimensions; ++j)
-                    st->accumulator.accumulation[Perspective][j] += weights[offset + j];
+                    acc.accumulation[Perspective][j] += weight(index, j);
 
                 for (std::size_t k = 0; k < PSQTBuckets; ++k)
-                    st->accumulator.psqtAccumulation[Perspective][k] +=
-                      psqtWeights[index * PSQTBuckets + k];
+                    acc.psqtAccumulation[Perspective][k] += psqtWeights[index * PSQTBuckets + k];
             }
         }
 #endif
     }
 
     template<Color Perspective>
-    void update_accumulator_refresh(const Position& pos, AccumulatorCaches::Cache* cache) const {
+    void update_accumulator_removal(const Position&           pos,
+                                    Square                    sq,
+                                    Piece                     pc,
+                                    AccumulatorStack&         accumulators,
+                                    AccumulatorCaches::Cache* cache) const {
+
+        if (color_of(pc) == Perspective && (type_of(pc) == ADVISOR || type_of(pc) == BISHOP))
+        {
+            update_accumulator_refresh<Perspective>(pos, accumulators, cache);
+            return;
+        }
+
+        ++accumulators.updates;
+
+        const Square ksq   = pos.king_square(Perspective);
+        const int    ab    = pos.count<ADVISOR>(Perspective) * 3 + pos.count<BISHOP>(Perspective);
+        const auto   index = FeatureSet::make_index<Perspective>(sq, pc, ksq, ab);
+
+        const Accumulator& in  = accumulators[accumulators.size() - 2];
+        Accumulator&       out = accumulators.latest();
+
+        assert(in.computed[Perspective]);
+        out.computed[Perspective] = true;
+
+#ifdef VECTOR
+        auto accIn  = reinterpret_cast<const vec_t*>(&in.accumulation[Perspective][0]);
+        auto accOut = reinterpret_cast<vec_t*>(&out.accumulation[Perspective][0]);
+
+        const auto column = weight_column(index, 0);
+        for (IndexType k = 0; k < HalfDimensions * sizeof(std::int16_t) / sizeof(vec_t); ++k)
+            accOut[k] = vec_sub_16(accIn[k], column[k]);
+
+        auto accPsqtIn  = reinterpret_cast<const psqt_vec_t*>(&in.psqtAccumulation[Perspective][0]);
+        auto accPsqtOut = reinterpret_cast<psqt_vec_t*>(&out.psqtAccumulation[Perspective][0]);
+
+        auto columnPsqt = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[PSQTBuckets * index]);
+        for (std::size_t k = 0; k < PSQTBuckets * sizeof(std::int32_t) / sizeof(psqt_vec_t); ++k)
+            accPsqtOut[k] = vec_sub_psqt_32(accPsqtIn[k], columnPsqt[k]);
+#else
+        for (IndexType j = 0; j < HalfDimensions; ++j)
+            out.accumulation[Perspective][j] = in.accumulation[Perspective][j] - weight(index, j);
+
+        for (std::size_t k = 0; k < PSQTBuckets; ++k)
+            out.psqtAccumulation[Perspective][k] =
+              in.psqtAccumulation[Perspective][k] - psqtWeights[index * PSQTBuckets + k];
+#endif
+    }
+
+    // Refreshes use the tiles of the incremental updates. A single pass over all 32 registers
+    // on AVX-512 was measured slower, so there is no dedicated refresh tiling.
+    template<Color Perspective>
+    void update_accumulator_refresh(const Position&           pos,
+                                    AccumulatorStack&         accumulators,
+                                    AccumulatorCaches::Cache* cache) const {
         assert(cache != nullptr);
 
+        ++accumulators.refreshes;
+
         const Square ksq = pos.king_square(Perspective);
         const int    ab  = pos.count<ADVISOR>(Perspective) * 3 + pos.count<BISHOP>(Perspective);
 
-        auto& entry = (*cache)[FeatureSet::KingCacheMaps[ksq] * 9 + ab][Perspective];
+        auto& entry = cache->entry<Perspective>(FeatureSet::KingCacheMaps[ksq] * 9 + ab, biases);
 
-        auto& accumulator                 = pos.state()->accumulator;
+        auto& accumulator                 = accumulators.latest();
         accumulator.computed[Perspective] = true;
 
         FeatureSet::IndexList removed, added;
@@ -717,6 +939,8 @@ class FeatureTransformer {
             }
         }
 
+        accumulators.refreshFeatures += removed.size() + added.size();
+
 #ifdef VECTOR
         vec_t      acc[NumRegs];
         psqt_vec_t psqt[NumPsqtRegs];
@@ -733,30 +957,22 @@ class FeatureTransformer {
             int i = 0;
             for (; i < int(std::min(removed.size(), added.size())); ++i)
             {
-                IndexType       indexR  = removed[i];
-                const IndexType offsetR = HalfDimensions * indexR + j * TileHeight;
-                auto            columnR = reinterpret_cast<const vec_t*>(&weights[offsetR]);
-                IndexType       indexA  = added[i];
-                const IndexType offsetA = HalfDimensions * indexA + j * TileHeight;
-                auto            columnA = reinterpret_cast<const vec_t*>(&weights[offsetA]);
+                const auto columnR = weight_column(removed[i], j * TileHeight);
+                const auto columnA = weight_column(added[i], j * TileHeight);
 
                 for (unsigned k = 0; k < NumRegs; ++k)
                     acc[k] = vec_add_16(acc[k], vec_sub_16(columnA[k], columnR[k]));
             }
             for (; i < int(removed.size()); ++i)
             {
-                IndexType       index  = removed[i];
-                const IndexType offset = HalfDimensions * index + j * TileHeight;
-                auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                const auto column = weight_column(removed[i], j * TileHeight);
 
                 for (unsigned k = 0; k < NumRegs; ++k)
                     acc[k] = vec_sub_16(acc[k], column[k]);
             }
             for (; i < int(added.size()); ++i)
             {
-                IndexType       index  = added[i];
-                const IndexType offset = HalfDimensions * index + j * TileHeight;
-                auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                const auto column = weight_column(added[i], j * TileHeight);
 
                 for (unsigned k = 0; k < NumRegs; ++k)
                     acc[k] = vec_add_16(acc[k], column[k]);
@@ -807,18 +1023,16 @@ class FeatureTransformer {
 
         for (const auto index : removed)
         {
-            const IndexType offset = HalfDimensions * index;
             for (IndexType j = 0; j < HalfDimensions; ++j)
-                entry.accumulation[j] -= weights[offset + j];
+                entry.accumulation[j] -= weight(index, j);
 
             for (std::size_t k = 0; k < PSQTBuckets; ++k)
                 entry.psqtAccumulation[k] -= psqtWeights[index * PSQTBuckets + k];
         }
         for (const auto index : added)
         {
-            const IndexType offset = HalfDimensions * index;
             for (IndexType j = 0; j < HalfDimensions; ++j)
-                entry.accumulation[j] += weights[offset + j];
+                entry.accumulation[j] += weight(index, j);
 
             for (std::size_t k = 0; k < PSQTBuckets; ++k)
                 entry.psqtAccumulation[k] += psqtWeights[index * PSQTBuckets + k];
@@ -843,6 +1057,7 @@ class FeatureTransformer {
 
     template<Color Perspective>
     void hint_common_access_for_perspective(const Position&           pos,
+                                            AccumulatorStack&         accumulators,
                                             AccumulatorCaches::Cache* cache) const {
 
         // Works like update_accumulator, but performs less work.
@@ -851,60 +1066,116 @@ class FeatureTransformer {
         // Look for a usable accumulator of an earlier position. We keep track
         // of the estimated gain in terms of features to be added/subtracted.
         // Fast early exit.
-        if (pos.state()->accumulator.computed[Perspective])
+        if (accumulators.latest().computed[Perspective])
             return;
 
-        auto [oldest_st, _] = try_find_computed_accumulator<Perspective>(pos);
+        const std::size_t oldest = try_find_computed_accumulator<Perspective>(pos, accumulators);
 
-        if (oldest_st->accumulator.computed[Perspective])
+        if (accumulators[oldest].computed[Perspective])
         {
             // Only update current position accumulator to minimize work.
-            StateInfo* states_to_update[1] = {pos.state()};
-            update_accumulator_incremental<Perspective, 1>(pos, oldest_st, states_to_update);
+            std::size_t indices_to_update[1] = {accumulators.size() - 1};
+            update_accumulator_incremental<Perspective, 1>(pos, accumulators, oldest,
+                                                           indices_to_update);
         }
         else
-            update_accumulator_refresh<Perspective>(pos, cache);
+            update_accumulator_refresh<Perspective>(pos, accumulators, cache);
     }
 
     template<Color Perspective>
-    void update_accumulator(const Position& pos, AccumulatorCaches::Cache* cache) const {
+    void update_accumulator(const Position&           pos,
+                            AccumulatorStack&         accumulators,
+                            AccumulatorCaches::Cache* cache) const {
 
-        auto [oldest_st, next] = try_find_computed_accumulator<Perspective>(pos);
+        const std::size_t oldest = try_find_computed_accumulator<Perspective>(pos, accumulators);
+        const std::size_t last   = accumulators.size() - 1;
 
-        if (oldest_st->accumulator.computed[Perspective])
+        if (accumulators[oldest].computed[Perspective])
         {
-            if (next == nullptr)
+            if (oldest == last)
                 return;
 
-            // Now update the accumulators listed in states_to_update[], where the last element is a sentinel.
+            // Now update the accumulators listed in indices_to_update[].
             // Currently we update 2 accumulators.
             //     1. for the current position
             //     2. the next accumulator after the computed one
             // The heuristic may change in the future.
-            if (next == pos.state())
+            if (oldest + 1 == last)
             {
-                StateInfo* states_to_update[1] = {next};
+                std::size_t indices_to_update[1] = {last};
 
-                update_accumulator_incremental<Perspective, 1>(pos, oldest_st, states_to_update);
+                update_accumulator_incremental<Perspective, 1>(pos, accumulators, oldest,
+                                                               indices_to_update);
             }
             else
             {
-                StateInfo* states_to_update[2] = {next, pos.state()};
+                std::size_t indices_to_update[2] = {oldest + 1, last};
 
-                update_accumulator_incremental<Perspective, 2>(pos, oldest_st, states_to_update);
+                update_accumulator_incremental<Perspective, 2>(pos, accumulators, oldest,
+                                                               indices_to_update);
             }
         }
         else
         {
-            update_accumulator_refresh<Perspective>(pos, cache);
+            update_accumulator_refresh<Perspective>(pos, accumulators, cache);
+        }
+    }
+
+    // The weights as 16 bit values, in a buffer allocated here if they are
+    // stored in 8 bits.
+    struct alignas(CacheLineSize) WideRow {
+        WeightType weights[HalfDimensions];
+    };
+
+    WeightType* wide_weights([[maybe_unused]] AlignedPtr<WideRow[]>& buffer) const {
+#if defined(FT_WEIGHTS_8)
+        buffer = make_unique_aligned<WideRow[]>(InputDimensions);
+        return reinterpret_cast<WeightType*>(buffer.get());
+#else
+        return const_cast<WeightType*>(weights);
+#endif
+    }
+
+    int weight_shift([[maybe_unused]] IndexType index) const {
+#if defined(FT_WEIGHTS_8)
+        return weightShifts[index];
+#else
+        return 0;
+#endif
+    }
+
+    WeightType weight(IndexType index, IndexType i) const {
+        return WeightType(weights[HalfDimensions * index + i] * (1 << weight_shift(index)));
+    }
+
+#ifdef VECTOR
+    // The weights of a feature from the given offset, read one vector at a time
+    struct WeightColumn {
+        const StoredWeightType* w;
+        int                     shift;
+
+        vec_t operator[](IndexType k) const {
+    #if defined(FT_WEIGHTS_8)
+            return vec_slli_16(vec_load_8_to_16(&w[k * sizeof(vec_t) / 2]), shift);
+    #else
+            return reinterpret_cast<const vec_t*>(w)[k];
+    #endif
         }
+    };
+
+    WeightColumn weight_column(IndexType index, IndexType offset) const {
+        return {&weights[HalfDimensions * index + offset], weight_shift(index)};
     }
+#endif
 
     friend struct AccumulatorCaches::Cache;
 
     alignas(CacheLineSize) BiasType biases[HalfDimensions];
-    alignas(CacheLineSize) WeightType weights[HalfDimensions * InputDimensions];
+    alignas(CacheLineSize) StoredWeightType weights[HalfDimensions * InputDimensions];
     alignas(CacheLineSize) PSQTWeightType psqtWeights[InputDimensions * PSQTBuckets];
+#if defined(FT_WEIGHTS_8)
+    std::uint8_t weightShifts[InputDimensions];
+#endif
 };
 
 }  // namespace Stockfish::Eval::NNUE
@@ -20,6 +20,7 @@
 
 #include "nnue_misc.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -27,6 +28,7 @@
 #include <sstream>
 #include <string_view>
 #include <tuple>
+#include <vector>
 
 #include "../position.h"
 #include "../types.h"
@@ -42,9 +44,10 @@ constexpr std::string_view PieceToChar(" RACPNBK racpnbk");
 
 void hint_common_parent_position(const Position&    pos,
                                  const Network&     network,
+                                 AccumulatorStack&  accumulators,
                                  AccumulatorCaches& caches) {
 
-    network.hint_common_access(pos, &caches.cache);
+    network.hint_common_access(pos, accumulators, &caches.cache);
 }
 
 namespace {
@@ -100,7 +103,10 @@ void format_cp_aligned_dot(Value v, std::stringstream& stream, const Position& p
 
 // Returns a string with the value of each piece on a board,
 // and a table for (PSQT, Layers) values bucket by bucket.
-std::string trace(Position& pos, const Eval::NNUE::Network& network, AccumulatorCaches& caches) {
+std::string trace(Position&                 pos,
+                  const Eval::NNUE::Network& network,
+                  AccumulatorStack&          accumulators,
+                  AccumulatorCaches&         caches) {
 
     std::stringstream ss;
 
@@ -126,10 +132,19 @@ std::string trace(Position& pos, const Eval::NNUE::Network& network, Accumulator
 
     // We estimate the value of each piece by doing a differential evaluation from
     // the current base eval, simulating the removal of the piece from its square.
-    auto [psqt, positional] = network.evaluate(pos, &caches.cache);
+    // The removals are updates of the accumulator of the position, evaluated together.
+    accumulators.reset();
+    auto [psqt, positional] = network.evaluate(pos, accumulators, &caches.cache);
     Value base              = psqt + positional;
     base                    = pos.side_to_move() == WHITE ? base : -base;
 
+    std::vector<Square> removed;
+    for (Square sq = SQ_A0; sq < SQUARE_NB; ++sq)
+        if (pos.piece_on(sq) != NO_PIECE && type_of(pos.piece_on(sq)) != KING)
+            removed.push_back(sq);
+
+    const auto outputs = network.evaluate_removals(pos, removed, accumulators, &caches.cache);
+
     for (File f = FILE_A; f <= FILE_I; ++f)
         for (Rank r = RANK_0; r <= RANK_9; ++r)
         {
@@ -137,22 +152,13 @@ std::string trace(Position& pos, const Eval::NNUE::Network& network, Accumulator
             Piece  pc = pos.piece_on(sq);
             Value  v  = VALUE_NONE;
 
-            if (pc != NO_PIECE && type_of(pc) != KING)
+            const auto it = std::find(removed.begin(), removed.end(), sq);
+            if (it != removed.end())
             {
-                auto st = pos.state();
-
-                pos.remove_piece(sq);
-                st->accumulator.computed[WHITE] = false;
-                st->accumulator.computed[BLACK] = false;
-
-                std::tie(psqt, positional) = network.evaluate(pos, &caches.cache);
+                std::tie(psqt, positional) = outputs[it - removed.begin()];
                 Value eval                 = psqt + positional;
                 eval                       = pos.side_to_move() == WHITE ? eval : -eval;
                 v                          = base - eval;
-
-                pos.put_piece(pc, sq);
-                st->accumulator.computed[WHITE] = false;
-                st->accumulator.computed[BLACK] = false;
             }
 
             writeSquare(f, r, pc, v);
@@ -163,7 +169,7 @@ std::string trace(Position& pos, const Eval::NNUE::Network& network, Accumulator
         ss << board[row] << '\n';
     ss << '\n';
 
-    auto t = network.trace_evaluate(pos, &caches.cache);
+    auto t = network.trace_evaluate(pos, accumulators, &caches.cache);
 
     ss << " NNUE network contributions "
        << (pos.side_to_move() == WHITE ? "(White to move)" : "(Black to move)") << std::endl
@@ -51,11 +51,16 @@ struct NnueEvalTrace {
 };
 
 class Network;
+class AccumulatorStack;
 struct AccumulatorCaches;
 
-std::string trace(Position& pos, const Network& network, AccumulatorCaches& caches);
+std::string trace(Position&          pos,
+                  const Network&     network,
+                  AccumulatorStack&  accumulators,
+                  AccumulatorCaches& caches);
 void        hint_common_parent_position(const Position&    pos,
                                         const Network&     network,
+                                        AccumulatorStack&  accumulators,
                                         AccumulatorCaches& caches);
 
 }  // namespace Stockfish::Eval::NNUE
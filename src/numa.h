@@ -437,6 +437,15 @@ class NumaReplicatedAccessToken {
     NumaIndex n;
 };
 
+// How the threads use the two kinds of cores of hybrid processors (Intel P/E-cores, ARM
+// big.LITTLE), selected with a "+hybrid" or "+pcores" suffix on the NumaPolicy, see
+// NumaConfig::split_core_class_policy(). On other processors all of them act like Any.
+enum class CoreClassPolicy {
+    Any,                // Every processor of a NUMA node is the same
+    PreferPerformance,  // Fill the performance cores of each node first, main thread included
+    PerformanceOnly     // Leave out the efficiency cores
+};
+
 // Designed as immutable, because there is no good reason to alter an already existing config
 // in a way that doesn't require recreating it completely, and it would be complex and expensive
 // to maintain class invariants.
@@ -463,7 +472,8 @@ class NumaConfig {
     // On Linux we read from standardized kernel sysfs, with a fallback to single NUMA node.
     // On Windows we utilize GetNumaProcessorNodeEx, which has its quirks, see
     // comment for Windows implementation of get_process_affinity
-    static NumaConfig from_system([[maybe_unused]] bool respectProcessAffinity = true) {
+    static NumaConfig from_system([[maybe_unused]] bool respectProcessAffinity = true,
+                                  CoreClassPolicy corePolicy = CoreClassPolicy::Any) {
         NumaConfig cfg = empty();
 
 #if defined(__linux__) && !defined(__ANDROID__)
@@ -617,6 +627,8 @@ class NumaConfig {
         if (!respectProcessAffinity)
             cfg.customAffinity = true;
 
+        cfg.apply_core_class_policy(corePolicy);
+
         return cfg;
     }
 
@@ -624,7 +636,8 @@ class NumaConfig {
     // ','-separated cpu indices
     // supports "first-last" range syntax for cpu indices
     // For example "0-15,128-143:16-31,144-159:32-47,160-175:48-63,176-191"
-    static NumaConfig from_string(const std::string& s) {
+    static NumaConfig from_string(const std::string& s,
+                                  CoreClassPolicy   corePolicy = CoreClassPolicy::Any) {
         NumaConfig cfg = empty();
 
         NumaIndex n = 0;
@@ -645,9 +658,118 @@ class NumaConfig {
 
         cfg.customAffinity = true;
 
+        cfg.apply_core_class_policy(corePolicy);
+
         return cfg;
     }
 
+    // Splits a NumaPolicy value into the policy proper and its core class suffix,
+    // for example "auto+hybrid" or "0-7:8-15+pcores".
+    static std::pair<std::string, CoreClassPolicy>
+    split_core_class_policy(const std::string& s) {
+        const size_t plus = s.rfind('+');
+        if (plus != std::string::npos)
+        {
+            const std::string suffix = s.substr(plus + 1);
+            if (suffix == "hybrid")
+                return {s.substr(0, plus), CoreClassPolicy::PreferPerformance};
+            if (suffix == "pcores")
+                return {s.substr(0, plus), CoreClassPolicy::PerformanceOnly};
+        }
+
+        return {s, CoreClassPolicy::Any};
+    }
+
+    // Queries the system for the processors which are efficiency cores, i.e. not of the
+    // fastest core class. Empty when all cores are alike or the information is missing.
+    static std::set<CpuIndex> get_efficiency_cpus() {
+        std::set<CpuIndex> cpus;
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+        // Intel hybrid processors have a separate PMU for each core type
+        auto atomCpusStr = read_file_to_string("/sys/devices/cpu_atom/cpus");
+        if (atomCpusStr.has_value())
+        {
+            remove_whitespace(*atomCpusStr);
+            for (size_t c : indices_from_shortened_string(*atomCpusStr))
+                cpus.insert(c);
+
+            return cpus;
+        }
+
+        // Otherwise (ARM big.LITTLE) the scheduler capacity of the cores tells them apart
+        // https://www.kernel.org/doc/Documentation/ABI/testing/sysfs-devices-system-cpu
+        std::map<CpuIndex, size_t> capacityByCpu;
+        size_t                     maxCapacity = 0;
+        for (CpuIndex c = 0; c < SYSTEM_THREADS_NB; ++c)
+        {
+            auto capacityStr = read_file_to_string("/sys/devices/system/cpu/cpu"
+                                                   + std::to_string(c) + "/cpu_capacity");
+            if (!capacityStr.has_value())
+                continue;
+
+            remove_whitespace(*capacityStr);
+            if (capacityStr->empty())
+                continue;
+
+            capacityByCpu[c] = str_to_size_t(*capacityStr);
+            maxCapacity      = std::max(maxCapacity, capacityByCpu[c]);
+        }
+
+        for (auto&& [c, capacity] : capacityByCpu)
+            if (capacity < maxCapacity)
+                cpus.insert(c);
+
+#elif defined(_WIN64)
+
+        DWORD length = 0;
+        if (GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length)
+            || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+            return cpus;
+
+        auto buffer = std::make_unique<char[]>(length);
+        if (!GetLogicalProcessorInformationEx(
+              RelationProcessorCore,
+              reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.get()), &length))
+            return cpus;
+
+        // A core with a higher efficiency class has greater performance and less efficiency
+        std::map<CpuIndex, BYTE> classByCpu;
+        BYTE                     maxClass = 0;
+        for (DWORD offset = 0; offset < length;)
+        {
+            const auto info =
+              reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.get() + offset);
+
+    #if defined(NTDDI_WIN10_VB)
+            const BYTE efficiencyClass = info->Processor.EfficiencyClass;
+    #else
+            const BYTE efficiencyClass = 0;  // Not declared by older SDKs, all cores alike
+    #endif
+            maxClass = std::max(maxClass, efficiencyClass);
+
+            for (WORD g = 0; g < info->Processor.GroupCount; ++g)
+            {
+                const GROUP_AFFINITY& affinity = info->Processor.GroupMask[g];
+                for (BYTE number = 0; number < WIN_PROCESSOR_GROUP_SIZE; ++number)
+                    if (affinity.Mask & (KAFFINITY(1) << number))
+                        classByCpu[static_cast<CpuIndex>(affinity.Group) * WIN_PROCESSOR_GROUP_SIZE
+                                   + number] = efficiencyClass;
+            }
+
+            offset += info->Size;
+        }
+
+        for (auto&& [c, efficiencyClass] : classByCpu)
+            if (efficiencyClass < maxClass)
+                cpus.insert(c);
+
+#endif
+
+        return cpus;
+    }
+
     NumaConfig(const NumaConfig&)            = delete;
     NumaConfig(NumaConfig&&)                 = default;
     NumaConfig& operator=(const NumaConfig&) = delete;
@@ -664,6 +786,19 @@ class NumaConfig {
 
     CpuIndex num_cpus() const { return nodeByCpu.size(); }
 
+    // True if the performance cores are preferred, see CoreClassPolicy::PreferPerformance
+    bool is_hybrid() const { return !efficiencyCpus.empty(); }
+
+    CpuIndex num_performance_cpus_in_numa_node(NumaIndex n) const {
+        assert(n < nodes.size());
+        CpuIndex count = 0;
+        for (CpuIndex c : nodes[n])
+            count += efficiencyCpus.count(c) == 0;
+        return count;
+    }
+
+    std::string efficiency_cpus_to_string() const { return cpus_to_string(efficiencyCpus); }
+
     bool requires_memory_replication() const { return customAffinity || nodes.size() > 1; }
 
     std::string to_string() const {
@@ -675,34 +810,7 @@ class NumaConfig {
             if (!isFirstNode)
                 str += ":";
 
-            bool isFirstSet = true;
-            auto rangeStart = cpus.begin();
-            for (auto it = cpus.begin(); it != cpus.end(); ++it)
-            {
-                auto next = std::next(it);
-                if (next == cpus.end() || *next != *it + 1)
-                {
-                    // cpus[i] is at the end of the range (may be of size 1)
-                    if (!isFirstSet)
-                        str += ",";
-
-                    const CpuIndex last = *it;
-
-                    if (it != rangeStart)
-                    {
-                        const CpuIndex first = *rangeStart;
-
-                        str += std::to_string(first);
-                        str += "-";
-                        str += std::to_string(last);
-                    }
-                    else
-                        str += std::to_string(last);
-
-                    rangeStart = next;
-                    isFirstSet = false;
-                }
-            }
+            str += cpus_to_string(cpus);
 
             isFirstNode = false;
         }
@@ -725,6 +833,10 @@ class NumaConfig {
         if (customAffinity)
             return true;
 
+        // Only bound threads can be kept on the performance cores.
+        if (is_hybrid())
+            return true;
+
         // We obviously can't distribute a single thread, so a single thread should never be bound.
         if (numThreads <= 1)
             return false;
@@ -760,6 +872,14 @@ class NumaConfig {
         }
         else
         {
+            // On hybrid processors an efficiency core counts for a fraction of a performance core
+            constexpr float EfficiencyCoreWeight = 0.5f;
+            auto            capacity             = [&](NumaIndex n) {
+                const CpuIndex numPerformance = num_performance_cpus_in_numa_node(n);
+                return static_cast<float>(numPerformance)
+                     + EfficiencyCoreWeight * static_cast<float>(nodes[n].size() - numPerformance);
+            };
+
             std::vector<size_t> occupation(nodes.size(), 0);
             for (CpuIndex c = 0; c < numThreads; ++c)
             {
@@ -767,8 +887,7 @@ class NumaConfig {
                 float     bestNodeFill = std::numeric_limits<float>::max();
                 for (NumaIndex n = 0; n < nodes.size(); ++n)
                 {
-                    float fill =
-                      static_cast<float>(occupation[n] + 1) / static_cast<float>(nodes[n].size());
+                    float fill = static_cast<float>(occupation[n] + 1) / capacity(n);
                     // NOTE: Do we want to perhaps fill the first available node up to 50% first before considering other nodes?
                     //       Probably not, because it would interfere with running multiple instances. We basically shouldn't
                     //       favor any particular node.
@@ -786,10 +905,18 @@ class NumaConfig {
         return ns;
     }
 
-    NumaReplicatedAccessToken bind_current_thread_to_numa_node(NumaIndex n) const {
+    // With performanceCoresOnly the thread is bound to the performance cores of the node,
+    // if it has any, instead of the whole node.
+    NumaReplicatedAccessToken
+    bind_current_thread_to_numa_node(NumaIndex n, bool performanceCoresOnly = false) const {
         if (n >= nodes.size() || nodes[n].size() == 0)
             std::exit(EXIT_FAILURE);
 
+        std::set<CpuIndex> cpus = nodes[n];
+        if (performanceCoresOnly && num_performance_cpus_in_numa_node(n) > 0)
+            for (CpuIndex c : efficiencyCpus)
+                cpus.erase(c);
+
 #if defined(__linux__) && !defined(__ANDROID__)
 
         cpu_set_t* mask = CPU_ALLOC(highestCpuIndex + 1);
@@ -800,7 +927,7 @@ class NumaConfig {
 
         CPU_ZERO_S(masksize, mask);
 
-        for (CpuIndex c : nodes[n])
+        for (CpuIndex c : cpus)
             CPU_SET_S(c, masksize, mask);
 
         const int status = sched_setaffinity(0, masksize, mask);
@@ -835,7 +962,7 @@ class NumaConfig {
             for (WORD i = 0; i < numProcGroups; ++i)
                 groupAffinities[i].Group = i;
 
-            for (CpuIndex c : nodes[n])
+            for (CpuIndex c : cpus)
             {
                 const size_t procGroupIndex     = c / WIN_PROCESSOR_GROUP_SIZE;
                 const size_t idxWithinProcGroup = c % WIN_PROCESSOR_GROUP_SIZE;
@@ -873,9 +1000,9 @@ class NumaConfig {
             GROUP_AFFINITY affinity;
             std::memset(&affinity, 0, sizeof(GROUP_AFFINITY));
             // We use an ordered set so we're guaranteed to get the smallest cpu number here.
-            const size_t forcedProcGroupIndex = *(nodes[n].begin()) / WIN_PROCESSOR_GROUP_SIZE;
+            const size_t forcedProcGroupIndex = *(cpus.begin()) / WIN_PROCESSOR_GROUP_SIZE;
             affinity.Group                    = static_cast<WORD>(forcedProcGroupIndex);
-            for (CpuIndex c : nodes[n])
+            for (CpuIndex c : cpus)
             {
                 const size_t procGroupIndex     = c / WIN_PROCESSOR_GROUP_SIZE;
                 const size_t idxWithinProcGroup = c % WIN_PROCESSOR_GROUP_SIZE;
@@ -918,6 +1045,7 @@ class NumaConfig {
     std::vector<std::set<CpuIndex>> nodes;
     std::map<CpuIndex, NumaIndex>   nodeByCpu;
     CpuIndex                        highestCpuIndex;
+    std::set<CpuIndex>              efficiencyCpus;  // Only with CoreClassPolicy::PreferPerformance
 
     bool customAffinity;
 
@@ -935,6 +1063,77 @@ class NumaConfig {
             if (!cpus.empty())
                 newNodes.emplace_back(std::move(cpus));
         nodes = std::move(newNodes);
+
+        // The remaining nodes may have been renumbered
+        for (NumaIndex n = 0; n < nodes.size(); ++n)
+            for (CpuIndex c : nodes[n])
+                nodeByCpu[c] = n;
+    }
+
+    void apply_core_class_policy(CoreClassPolicy corePolicy) {
+        if (corePolicy == CoreClassPolicy::Any)
+            return;
+
+        std::set<CpuIndex> cpus;
+        for (CpuIndex c : get_efficiency_cpus())
+            if (is_cpu_assigned(c))
+                cpus.insert(c);
+
+        // Nothing to choose from if the cores we have are all of the same class
+        if (cpus.empty() || cpus.size() == num_cpus())
+            return;
+
+        if (corePolicy == CoreClassPolicy::PerformanceOnly)
+        {
+            for (CpuIndex c : cpus)
+            {
+                nodes[nodeByCpu[c]].erase(c);
+                nodeByCpu.erase(c);
+            }
+
+            remove_empty_numa_nodes();
+
+            // The threads have to be bound to keep them off the efficiency cores.
+            customAffinity = true;
+        }
+        else
+            efficiencyCpus = std::move(cpus);
+    }
+
+    // "first-last" ranges of consecutive cpus, separated by ','
+    static std::string cpus_to_string(const std::set<CpuIndex>& cpus) {
+        std::string str;
+
+        bool isFirstSet = true;
+        auto rangeStart = cpus.begin();
+        for (auto it = cpus.begin(); it != cpus.end(); ++it)
+        {
+            auto next = std::next(it);
+            if (next == cpus.end() || *next != *it + 1)
+            {
+                // cpus[i] is at the end of the range (may be of size 1)
+                if (!isFirstSet)
+                    str += ",";
+
+                const CpuIndex last = *it;
+
+                if (it != rangeStart)
+                {
+                    const CpuIndex first = *rangeStart;
+
+                    str += std::to_string(first);
+                    str += "-";
+                    str += std::to_string(last);
+                }
+                else
+                    str += std::to_string(last);
+
+                rangeStart = next;
+                isFirstSet = false;
+            }
+        }
+
+        return str;
     }
 
     // Returns true if successful
@@ -1040,7 +1239,7 @@ class NumaReplicatedBase {
 template<typename T>
 class NumaReplicated: public NumaReplicatedBase {
    public:
-    using ReplicatorFuncType = std::function<T(const T&)>;
+    using ReplicatorFuncType = std::function<T(const T&, NumaIndex)>;
 
     NumaReplicated(NumaReplicationContext& ctx) :
         NumaReplicatedBase(ctx) {
@@ -1089,6 +1288,26 @@ class NumaReplicated: public NumaReplicatedBase {
         replicate_from(std::move(*source));
     }
 
+    // Replicates a new value aside, replacing any staged before, while the
+    // current instances stay in use. May be called from another thread than
+    // the users of the instances, but not concurrently with the other modifiers.
+    void stage(T&& source) { staged = replicate(std::move(source)); }
+    void discard_staged() { staged.clear(); }
+
+    // Replaces the instances with the staged ones, if any
+    bool swap_staged() {
+        if (staged.empty())
+            return false;
+
+        instances = std::exchange(staged, {});
+        ++version;
+        return true;
+    }
+
+    // Changes whenever the instances are replaced, so that the data derived
+    // from them can be refreshed lazily.
+    std::uint64_t get_version() const { return version; }
+
     void on_numa_config_changed() override {
         // Use the first one as the source. It doesn't matter which one we use, because they all must
         // be identical, but the first one is guaranteed to exist.
@@ -1096,28 +1315,53 @@ class NumaReplicated: public NumaReplicatedBase {
         replicate_from(std::move(*source));
     }
 
+    // Replaces the plain copy used to create the instances. The replicator runs on
+    // the target node and is used even when no replication is required, so that
+    // it can provide storage shared with other processes. nullptr restores copying.
+    void set_replicator(ReplicatorFuncType f) {
+        replicator = std::move(f);
+        on_numa_config_changed();
+    }
+
    private:
-    std::vector<std::unique_ptr<T>> instances;
+    std::vector<std::unique_ptr<T>> instances, staged;
+    ReplicatorFuncType              replicator;
+    std::uint64_t                   version = 0;
 
     void replicate_from(T&& source) {
         instances.clear();
+        instances = replicate(std::move(source));
+        ++version;
+    }
+
+    std::vector<std::unique_ptr<T>> replicate(T&& source) const {
+        std::vector<std::unique_ptr<T>> result;
 
         const NumaConfig& cfg = get_numa_config();
         if (cfg.requires_memory_replication())
         {
             for (NumaIndex n = 0; n < cfg.num_numa_nodes(); ++n)
             {
-                cfg.execute_on_numa_node(
-                  n, [this, &source]() { instances.emplace_back(std::make_unique<T>(source)); });
+                cfg.execute_on_numa_node(n, [this, &result, &source, n]() {
+                    result.emplace_back(
+                      std::make_unique<T>(replicator ? replicator(source, n) : source));
+                });
             }
         }
+        else if (replicator)
+        {
+            assert(cfg.num_numa_nodes() == 1);
+            result.emplace_back(std::make_unique<T>(replicator(source, 0)));
+        }
         else
         {
             assert(cfg.num_numa_nodes() == 1);
             // We take advantage of the fact that replication is not required
             // and reuse the source value, avoiding one copy operation.
-            instances.emplace_back(std::make_unique<T>(std::move(source)));
+            result.emplace_back(std::make_unique<T>(std::move(source)));
         }
+
+        return result;
     }
 };
 
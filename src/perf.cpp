@@ -0,0 +1,313 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "perf.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace Stockfish::Perf {
+
+namespace {
+
+constexpr const char* EventNames[EVENT_NB] = {"cycles",      "instructions", "l1d-misses",
+                                              "llc-misses",  "dtlb-misses",  "branch-misses",
+                                              "cpu-ms"};
+
+constexpr const char* RegionNames[REGION_NB] = {"movegen", "nnue", "tt-probe"};
+
+std::mutex totalMutex;
+Snapshot   programTotal;
+
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+
+// The counters of a thread, one file descriptor per event, and the counts of
+// the regions so far. The overhead is what the reads of an empty region count,
+// to be taken off each measured one.
+struct ThreadCounters {
+    int    fd[EVENT_NB];
+    bool   opened = false;
+    Counts region[REGION_NB], regionStart, overhead;
+
+    ~ThreadCounters() {
+        if (opened)
+            for (int f : fd)
+                if (f >= 0)
+                    close(f);
+    }
+
+    void   open();
+    Counts read() const;
+};
+
+thread_local ThreadCounters counters;
+
+int open_event(uint32_t type, uint64_t config) {
+
+    perf_event_attr attr{};
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+constexpr uint64_t read_misses(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// The events are opened one by one rather than as a group, so that the ones
+// the CPU or the kernel doesn't have are only left unknown.
+void ThreadCounters::open() {
+
+    const std::pair<uint32_t, uint64_t> events[EVENT_NB] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HW_CACHE, read_misses(PERF_COUNT_HW_CACHE_L1D)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HW_CACHE, read_misses(PERF_COUNT_HW_CACHE_DTLB)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}};
+
+    for (int e = 0; e < EVENT_NB; ++e)
+    {
+        fd[e] = open_event(events[e].first, events[e].second);
+
+        // The CPU time of a region is mostly the system calls reading it
+        for (auto& r : region)
+            r.value[e] = fd[e] >= 0 && e != TaskClock ? 0 : -1;
+    }
+
+    opened = true;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        const Counts start = read(), d = read() - start;
+
+        for (int e = 0; e < EVENT_NB; ++e)
+            if (d.value[e] >= 0)
+                overhead.value[e] = i ? std::min(overhead.value[e], d.value[e]) : d.value[e];
+    }
+}
+
+// The counts so far, scaled up when the kernel had to share the PMU between
+// more events than it has counters.
+Counts ThreadCounters::read() const {
+
+    Counts c;
+
+    for (int e = 0; e < EVENT_NB; ++e)
+    {
+        uint64_t v[3];  // Count, time enabled, time running
+
+        if (fd[e] < 0 || ::read(fd[e], v, sizeof(v)) != sizeof(v) || !v[2])
+            continue;
+
+        c.value[e] = v[1] == v[2] ? int64_t(v[0]) : int64_t(double(v[0]) * v[1] / v[2]);
+    }
+
+    return c;
+}
+
+#endif
+
+}  // namespace
+
+// An unknown count is taken as 0 next to a known one
+Counts& Counts::operator+=(const Counts& c) {
+
+    for (int e = 0; e < EVENT_NB; ++e)
+        if (c.value[e] >= 0)
+            value[e] = std::max(value[e], int64_t(0)) + c.value[e];
+
+    return *this;
+}
+
+// An unknown count is taken as 0 next to a known one
+Counts Counts::operator-(const Counts& c) const {
+
+    Counts d;
+
+    for (int e = 0; e < EVENT_NB; ++e)
+        if (value[e] >= 0)
+            d.value[e] = value[e] - std::max(c.value[e], int64_t(0));
+
+    return d;
+}
+
+bool Counts::known() const {
+
+    for (auto v : value)
+        if (v >= 0)
+            return true;
+
+    return false;
+}
+
+Snapshot& Snapshot::operator+=(const Snapshot& s) {
+
+    total += s.total;
+    for (int r = 0; r < REGION_NB; ++r)
+        region[r] += s.region[r];
+
+    return *this;
+}
+
+Snapshot Snapshot::operator-(const Snapshot& s) const {
+
+    Snapshot d;
+
+    d.total = total - s.total;
+    for (int r = 0; r < REGION_NB; ++r)
+        d.region[r] = region[r] - s.region[r];
+
+    return d;
+}
+
+Snapshot snapshot() {
+
+    Snapshot s;
+
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+    if (!counters.opened)
+        counters.open();
+
+    s.total = counters.read();
+    for (int r = 0; r < REGION_NB; ++r)
+        s.region[r] = counters.region[r];
+#endif
+
+    return s;
+}
+
+void add_to_total(const Snapshot& s) {
+
+    std::lock_guard<std::mutex> lock(totalMutex);
+    programTotal += s;
+}
+
+Snapshot total() {
+
+    std::lock_guard<std::mutex> lock(totalMutex);
+    return programTotal;
+}
+
+std::string format(const Counts& c) {
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2);
+
+    for (int e = 0; e < EVENT_NB; ++e)
+    {
+        if (c.value[e] < 0)
+            continue;
+
+        ss << (ss.tellp() ? " " : "") << EventNames[e] << ' ';
+
+        if (e == TaskClock)
+            ss << double(c.value[e]) / 1e6;
+        else
+            ss << c.value[e];
+
+        if (e == Instructions && c.value[Cycles] > 0)
+            ss << " ipc " << double(c.value[Instructions]) / c.value[Cycles];
+    }
+
+    return ss.str();
+}
+
+std::vector<std::string> report(const std::vector<Snapshot>& threads) {
+
+    std::vector<std::string> lines;
+    Snapshot                 sum;
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        sum += threads[i];
+
+        if (threads.size() > 1 && threads[i].total.known())
+            lines.push_back("perf thread " + std::to_string(i) + " " + format(threads[i].total));
+    }
+
+    if (!sum.total.known())
+        return lines;
+
+    lines.push_back("perf total " + format(sum.total));
+
+    for (int r = 0; r < REGION_NB; ++r)
+        if (sum.region[r].known())
+        {
+            std::ostringstream ss;
+            ss << "perf region " << RegionNames[r] << " " << format(sum.region[r]);
+
+            if (sum.total.value[Cycles] > 0 && sum.region[r].value[Cycles] >= 0)
+                ss << " cycles-share " << std::fixed << std::setprecision(1)
+                   << 100.0 * sum.region[r].value[Cycles] / sum.total.value[Cycles] << "%";
+
+            lines.push_back(ss.str());
+        }
+
+    return lines;
+}
+
+namespace Detail {
+
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+
+void enter() {
+
+    if (counters.opened)
+        counters.regionStart = counters.read();
+}
+
+void leave(Region r) {
+
+    if (!counters.opened)
+        return;
+
+    const Counts d = counters.read() - counters.regionStart;
+
+    for (int e = 0; e < EVENT_NB; ++e)
+        if (d.value[e] >= 0 && counters.region[r].value[e] >= 0)
+            counters.region[r].value[e] +=
+              std::max(d.value[e] - std::max(counters.overhead.value[e], int64_t(0)), int64_t(0))
+              * SamplePeriod;
+}
+
+#else
+
+void enter() {}
+void leave(Region) {}
+
+#endif
+
+}  // namespace Detail
+
+}  // namespace Stockfish::Perf
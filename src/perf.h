@@ -0,0 +1,134 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PERF_H_INCLUDED
+#define PERF_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hardware performance counters of the search threads, read with Linux
+// perf_event_open() in builds with perfcounters=yes (USE_PERF_COUNTERS). Each
+// thread counts its own events, and the Region markers split the hardware ones
+// between move generation, NNUE evaluation and TT probing. Without the build flag, or
+// where the system counts nothing, all the counts are unknown and nothing is
+// reported.
+namespace Stockfish::Perf {
+
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+constexpr bool Enabled = true;
+#else
+constexpr bool Enabled = false;
+#endif
+
+enum Event {
+    Cycles,
+    Instructions,
+    L1DMisses,
+    LLCMisses,
+    DTLBMisses,
+    BranchMisses,
+    TaskClock,  // In nanoseconds, counted even without a PMU, but not by regions
+    EVENT_NB
+};
+
+enum Region {
+    MoveGen,
+    Nnue,
+    TTProbe,
+    REGION_NB
+};
+
+// The counts of the events, -1 for the ones which are unknown
+struct Counts {
+    int64_t value[EVENT_NB];
+
+    Counts() {
+        for (auto& v : value)
+            v = -1;
+    }
+
+    Counts& operator+=(const Counts& c);
+    Counts  operator-(const Counts& c) const;
+    bool    known() const;
+};
+
+// All that was counted on a thread: its events, and the part of them spent
+// in each region, estimated from a sample of the passes through it.
+struct Snapshot {
+    Counts total, region[REGION_NB];
+
+    Snapshot& operator+=(const Snapshot& s);
+    Snapshot  operator-(const Snapshot& s) const;
+};
+
+// The counts of the calling thread since it first called snapshot(), which
+// opens its counters.
+Snapshot snapshot();
+
+// Adds the counts of a search thread to the ones since the start of the
+// program, which total() returns: bench reports the difference.
+void     add_to_total(const Snapshot& s);
+Snapshot total();
+
+// The counts on one line, like "cycles 1000 instructions 2000 ipc 2.00 ...",
+// and the info lines of the given threads, of their total and of the regions.
+std::string              format(const Counts& c);
+std::vector<std::string> report(const std::vector<Snapshot>& threads);
+
+namespace Detail {
+
+// Passes through a region between two measured ones, so that reading the
+// counters costs little: the measured passes are scaled up by this.
+constexpr uint32_t SamplePeriod = 1024;
+
+void enter();
+void leave(Region r);
+
+inline thread_local uint32_t ticks[REGION_NB];
+
+}  // namespace Detail
+
+// Marks the scope of a region on the calling thread. Regions don't nest in
+// one another, except a region in itself, as only the outermost one counts.
+template<Region R>
+class Scope {
+   public:
+#if defined(USE_PERF_COUNTERS) && defined(__linux__)
+    Scope() {
+        if ((sampled = !depth++ && ++Detail::ticks[R] % Detail::SamplePeriod == 0))
+            Detail::enter();
+    }
+    ~Scope() {
+        --depth;
+        if (sampled)
+            Detail::leave(R);
+    }
+
+   private:
+    static inline thread_local int depth = 0;
+    bool                           sampled;
+#else
+    Scope() {}
+#endif
+};
+
+}  // namespace Stockfish::Perf
+
+#endif  // #ifndef PERF_H_INCLUDED
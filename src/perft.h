@@ -19,26 +19,98 @@
 #ifndef PERFT_H_INCLUDED
 #define PERFT_H_INCLUDED
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
 
+#include "benchmark.h"
+#include "memory.h"
+#include "misc.h"
 #include "movegen.h"
 #include "position.h"
+#include "thread.h"
 #include "types.h"
 #include "uci.h"
 
 namespace Stockfish::Benchmark {
 
+// A lock-free cache of perft subtree counts, shared by all threads. Each entry
+// stores its key xor-ed with its data, so that an entry torn by concurrent
+// writes fails verification instead of returning a wrong count.
+class PerftTable {
+
+   public:
+    explicit PerftTable(size_t mbSize) :
+        entryCount(mbSize * 1024 * 1024 / sizeof(Entry)),
+        entries(static_cast<Entry*>(aligned_large_pages_alloc(entryCount * sizeof(Entry)))) {
+        if (entries)
+            std::memset(static_cast<void*>(entries), 0, entryCount * sizeof(Entry));
+        else
+            entryCount = 0;
+    }
+    ~PerftTable() { aligned_large_pages_free(entries); }
+
+    PerftTable(const PerftTable&)            = delete;
+    PerftTable& operator=(const PerftTable&) = delete;
+
+    bool probe(Key key, Depth depth, uint64_t& nodes) const {
+        if (!entryCount)
+            return false;
+
+        const Entry&   e    = entry(key, depth);
+        const uint64_t data = e.data.load(std::memory_order_relaxed);
+
+        if ((e.check.load(std::memory_order_relaxed) ^ data) != key
+            || (data & 0xFF) != uint64_t(depth))
+            return false;
+
+        nodes = data >> 8;
+        return true;
+    }
+
+    void store(Key key, Depth depth, uint64_t nodes) {
+        if (!entryCount)
+            return;
+
+        Entry&         e    = entry(key, depth);
+        const uint64_t data = (nodes << 8) | uint64_t(depth);
+
+        e.check.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+
+   private:
+    struct Entry {
+        std::atomic<uint64_t> check, data;
+    };
+
+    Entry& entry(Key key, Depth depth) const {
+        return entries[mul_hi64(key ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL), entryCount)];
+    }
+
+    size_t entryCount;
+    Entry* entries;
+};
+
+
 // Utility to verify move generation. All the leaf nodes up
 // to the given depth are generated and counted, and the sum is returned.
 template<bool Root>
-uint64_t perft(Position& pos, Depth depth) {
+uint64_t perft(Position& pos, Depth depth, PerftTable* table, const PerftCallback& onRootMove) {
 
     StateInfo st;
-    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
     uint64_t   cnt, nodes = 0;
     const bool leaf = (depth == 2);
 
+    // The 60 move rule doesn't affect move generation, so use the plain key
+    const bool cached = !Root && table && depth >= 2;
+    if (cached && table->probe(pos.state()->key, depth, nodes))
+        return nodes;
+
     for (const auto& m : MoveList<LEGAL>(pos))
     {
         if (Root && depth <= 1)
@@ -46,22 +118,110 @@ uint64_t perft(Position& pos, Depth depth) {
         else
         {
             pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - 1);
+            cnt = leaf ? count_legal_moves(pos) : perft<false>(pos, depth - 1, table, onRootMove);
             nodes += cnt;
             pos.undo_move(m);
         }
-        if (Root)
-            sync_cout << UCIEngine::move(m) << ": " << cnt << sync_endl;
+        if (Root && onRootMove)
+            onRootMove(UCIEngine::move(m), cnt);
     }
+
+    if (cached)
+        table->store(pos.state()->key, depth, nodes);
+
     return nodes;
 }
 
-inline uint64_t perft(const std::string& fen, Depth depth) {
-    StateListPtr states(new std::deque<StateInfo>(1));
+inline uint64_t perft(const std::string& fen, Depth depth, const PerftCallback& onRootMove) {
+    StateListPtr states(new StateList);
     Position     p;
     p.set(fen, &states->back());
 
-    return perft<true>(p, depth);
+    return perft<true>(p, depth, nullptr, onRootMove);
+}
+
+// Parallel version of perft. The tree is split into the subtrees after each
+// root move, or after each pair of moves when deep enough, and the threads of
+// the pool take the next unclaimed subtree until none are left. When hashMb is
+// not zero, subtree counts are cached in a table shared by all threads.
+inline uint64_t perft(const std::string&   fen,
+                      Depth                depth,
+                      ThreadPool&          threads,
+                      size_t               hashMb,
+                      const PerftCallback& onRootMove) {
+
+    if (depth <= 2 || (threads.num_threads() <= 1 && !hashMb))
+        return perft(fen, depth, onRootMove);
+
+    struct Subtree {
+        size_t   root;
+        Move     moves[2];
+        int      length;
+        uint64_t nodes;
+    };
+
+    StateListPtr states(new StateList);
+    Position     pos;
+    pos.set(fen, &states->back());
+
+    std::vector<Move>    rootMoves;
+    std::vector<Subtree> subtrees;
+    StateInfo            st;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        rootMoves.push_back(m);
+        pos.do_move(m, st);
+        for (const auto& m2 : MoveList<LEGAL>(pos))
+            subtrees.push_back({rootMoves.size() - 1, {m, m2}, 2, 0});
+        pos.undo_move(m);
+    }
+
+    std::unique_ptr<PerftTable> table(hashMb ? new PerftTable(hashMb) : nullptr);
+    std::atomic<size_t>         next{0};
+    const size_t                threadCount = threads.num_threads();
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.run_on_thread(i, [&]() {
+            StateListPtr threadStates(new StateList);
+            Position     p;
+            StateInfo    sts[2];
+            p.set(fen, &threadStates->back());
+
+            size_t idx;
+            while ((idx = next.fetch_add(1, std::memory_order_relaxed)) < subtrees.size())
+            {
+                Subtree&    s = subtrees[idx];
+                const Depth d = depth - s.length;
+
+                for (int j = 0; j < s.length; ++j)
+                    p.do_move(s.moves[j], sts[j]);
+
+                s.nodes = d == 1 ? count_legal_moves(p) : perft<false>(p, d, table.get(), nullptr);
+
+                for (int j = s.length - 1; j >= 0; --j)
+                    p.undo_move(s.moves[j]);
+            }
+        });
+    }
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+
+    std::vector<uint64_t> rootNodes(rootMoves.size(), 0);
+    for (const auto& s : subtrees)
+        rootNodes[s.root] += s.nodes;
+
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        if (onRootMove)
+            onRootMove(UCIEngine::move(rootMoves[i]), rootNodes[i]);
+        nodes += rootNodes[i];
+    }
+
+    return nodes;
 }
 }
 
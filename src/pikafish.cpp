@@ -0,0 +1,270 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pikafish.h"
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "engine.h"
+#include "misc.h"
+#include "position.h"
+#include "score.h"
+#include "search.h"
+#include "types.h"
+#include "uci.h"
+
+using namespace Stockfish;
+
+struct pikafish_engine {
+    explicit pikafish_engine(const char* path) :
+        engine(path ? path : "") {}
+
+    Engine engine;
+};
+
+namespace {
+
+constexpr auto StartFEN = "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w";
+
+std::once_flag initialized;
+
+// Fills the fields shared by both kinds of search updates
+pikafish_info to_info(const Engine::InfoShort& i) {
+    pikafish_info info{};
+
+    info.depth = i.depth;
+
+    if (i.score.is<Score::Mate>())
+    {
+        int plies        = i.score.get<Score::Mate>().plies;
+        info.score_kind  = PIKAFISH_SCORE_MATE;
+        info.score_value = (plies > 0 ? plies + 1 : plies) / 2;
+    }
+    else
+    {
+        info.score_kind  = PIKAFISH_SCORE_CP;
+        info.score_value = i.score.get<Score::InternalUnits>().value;
+    }
+
+    info.bound = info.wdl = info.pv = "";
+
+    return info;
+}
+
+// The engine terminates without a usable network, so check for one first. Only a
+// failure is reported here, the call itself reports the network in use.
+bool check_network(pikafish_engine* e) {
+    return e->engine.network_loaded() || e->engine.verify_network(false);
+}
+
+}  // namespace
+
+extern "C" {
+
+pikafish_engine* pikafish_create(const char* path) {
+    std::call_once(initialized, [] { Position::init(); });
+
+    auto* e = new pikafish_engine(path);
+
+    // The engine calls every listener unconditionally, so install silent ones
+    pikafish_set_on_update_no_moves(e, nullptr, nullptr);
+    pikafish_set_on_update_full(e, nullptr, nullptr);
+    pikafish_set_on_iter(e, nullptr, nullptr);
+    pikafish_set_on_bestmove(e, nullptr, nullptr);
+
+    return e;
+}
+
+void pikafish_destroy(pikafish_engine* e) { delete e; }
+
+int pikafish_set_option(pikafish_engine* e, const char* name, const char* value) {
+    auto& options = e->engine.get_options();
+
+    if (!options.count(name))
+        return -1;
+
+    e->engine.wait_for_search_finished();
+
+    options[name] = std::string(value ? value : "");
+    return 0;
+}
+
+void pikafish_set_position(pikafish_engine*   e,
+                           const char*        fen,
+                           const char* const* moves,
+                           size_t             moveCount) {
+    e->engine.set_position(fen ? fen : StartFEN,
+                           std::vector<std::string>(moves, moves + moveCount));
+}
+
+int pikafish_go(pikafish_engine* e, const pikafish_limits* l) {
+    if (!check_network(e))
+        return -1;
+
+    Search::LimitsType limits;
+
+    limits.startTime = now();
+
+    if (l)
+    {
+        limits.time[WHITE] = l->wtime;
+        limits.time[BLACK] = l->btime;
+        limits.inc[WHITE]  = l->winc;
+        limits.inc[BLACK]  = l->binc;
+        limits.movetime    = l->movetime;
+        limits.movestogo   = l->movestogo;
+        limits.depth       = l->depth;
+        limits.mate        = l->mate;
+        limits.nodes       = l->nodes;
+        limits.infinite    = l->infinite;
+        limits.ponderMode  = l->ponder;
+    }
+    else
+        limits.infinite = 1;
+
+    e->engine.go(limits);
+    return 0;
+}
+
+void pikafish_stop(pikafish_engine* e) { e->engine.stop(); }
+
+void pikafish_ponderhit(pikafish_engine* e) { e->engine.set_ponderhit(false); }
+
+void pikafish_wait(pikafish_engine* e) { e->engine.wait_for_search_finished(); }
+
+void pikafish_new_game(pikafish_engine* e) { e->engine.search_clear(); }
+
+uint64_t pikafish_perft(
+  pikafish_engine* e, const char* fen, int depth, pikafish_perft_cb f, void* user) {
+    if (!check_network(e))
+        return 0;
+
+    const auto onRootMove = [f, user](std::string_view move, uint64_t n) {
+        if (f)
+            f(user, std::string(move).c_str(), n);
+    };
+
+    return e->engine.perft(fen ? fen : StartFEN, depth, onRootMove);
+}
+
+int pikafish_evaluate(pikafish_engine* e, int* cp) {
+    if (!check_network(e))
+        return -2;
+
+    Value v = e->engine.evaluate();
+
+    if (v == VALUE_NONE)
+        return -1;
+
+    // The conversion to centipawns depends on the material on the board
+    StateInfo st;
+    Position  pos;
+    pos.set(e->engine.fen(), &st);
+
+    *cp = UCIEngine::to_cp(v, pos);
+    return 0;
+}
+
+int pikafish_material(const char* fen) {
+    std::call_once(initialized, [] { Position::init(); });
+
+    StateInfo st;
+    Position  pos;
+    pos.set(fen ? fen : StartFEN, &st);
+
+    return UCIEngine::material(pos);
+}
+
+void pikafish_to_cp(const int* values, const int* materials, int* cp, size_t n) {
+    UCIEngine::to_cp(values, materials, cp, n);
+}
+
+void pikafish_to_wdl(const int* values, const int* materials, int* wdl, size_t n) {
+    UCIEngine::wdl(values, materials, wdl, n);
+}
+
+size_t pikafish_fen(pikafish_engine* e, char* buffer, size_t size) {
+    const std::string fen = e->engine.fen();
+
+    if (buffer && fen.size() < size)
+        std::memcpy(buffer, fen.c_str(), fen.size() + 1);
+
+    return fen.size();
+}
+
+void pikafish_set_on_update_no_moves(pikafish_engine* e, pikafish_info_cb f, void* user) {
+    e->engine.set_on_update_no_moves([f, user](const Engine::InfoShort& i) {
+        if (f)
+        {
+            pikafish_info info = to_info(i);
+            f(user, &info);
+        }
+    });
+}
+
+void pikafish_set_on_update_full(pikafish_engine* e, pikafish_info_cb f, void* user) {
+    e->engine.set_on_update_full([f, user](const Engine::InfoFull& i) {
+        if (!f)
+            return;
+
+        // The string views are not zero terminated
+        const std::string bound(i.bound), wdl(i.wdl), pv(i.pv);
+        pikafish_info     info = to_info(i);
+
+        info.seldepth = i.selDepth;
+        info.multipv  = int(i.multiPV);
+        info.bound    = bound.c_str();
+        info.wdl      = wdl.c_str();
+        info.time_ms  = i.timeMs;
+        info.nodes    = i.nodes;
+        info.nps      = i.nps;
+        info.tbhits   = i.tbHits;
+        info.hashfull = i.hashfull;
+        info.pv       = pv.c_str();
+
+        f(user, &info);
+    });
+}
+
+void pikafish_set_on_iter(pikafish_engine* e, pikafish_iter_cb f, void* user) {
+    e->engine.set_on_iter([f, user](const Engine::InfoIter& i) {
+        if (f)
+            f(user, i.depth, std::string(i.currmove).c_str(), int(i.currmovenumber));
+    });
+}
+
+void pikafish_set_on_bestmove(pikafish_engine* e, pikafish_bestmove_cb f, void* user) {
+    e->engine.set_on_bestmove([f, user](std::string_view bestmove, std::string_view ponder) {
+        if (f)
+            f(user, std::string(bestmove).c_str(), std::string(ponder).c_str());
+    });
+}
+
+void pikafish_set_on_verify_network(pikafish_engine* e, pikafish_message_cb f, void* user) {
+    if (f)
+        e->engine.set_on_verify_network(
+          [f, user](std::string_view msg) { f(user, std::string(msg).c_str()); });
+    else
+        e->engine.set_on_verify_network(nullptr);
+}
+
+}  // extern "C"
@@ -0,0 +1,137 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// C interface of the engine, for programs embedding libpikafish (see the
+// 'library' target of the Makefile) instead of talking UCI to a process.
+//
+// An engine handle owns its position, threads, hash and network. Calls on one
+// handle must not overlap, except pikafish_stop() which may be called while
+// another thread runs a search. Callbacks are invoked from the search thread,
+// and the strings they get are only valid until they return.
+//
+// Without a usable network, a call needing one reports the error through the
+// verify_network callback and fails, where the engine would terminate.
+
+#ifndef PIKAFISH_H_INCLUDED
+#define PIKAFISH_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIKAFISH_API_VERSION 3
+
+typedef struct pikafish_engine pikafish_engine;
+
+typedef struct pikafish_limits {
+    int64_t  wtime, btime, winc, binc;  // Milliseconds
+    int64_t  movetime;                  // Milliseconds
+    int      movestogo, depth, mate;
+    uint64_t nodes;
+    int      infinite, ponder;
+} pikafish_limits;
+
+enum {
+    PIKAFISH_SCORE_CP   = 0,
+    PIKAFISH_SCORE_MATE = 1  // value is in moves, negative if getting mated
+};
+
+typedef struct pikafish_info {
+    int         depth;
+    int         score_kind;  // PIKAFISH_SCORE_CP or PIKAFISH_SCORE_MATE
+    int         score_value;
+    int         seldepth;       // The fields below are only set by the update_full callback
+    int         multipv;
+    const char* bound;          // "", "lowerbound" or "upperbound"
+    const char* wdl;            // "" unless UCI_ShowWDL is set, else "w d l" in permille
+    uint64_t    time_ms;
+    uint64_t    nodes;
+    uint64_t    nps;
+    uint64_t    tbhits;
+    int         hashfull;
+    const char* pv;  // Moves in UCI format separated by spaces
+} pikafish_info;
+
+typedef void (*pikafish_info_cb)(void* user, const pikafish_info* info);
+typedef void (*pikafish_iter_cb)(void* user, int depth, const char* currmove, int currmovenumber);
+typedef void (*pikafish_bestmove_cb)(void* user, const char* bestmove, const char* ponder);
+typedef void (*pikafish_message_cb)(void* user, const char* message);
+typedef void (*pikafish_perft_cb)(void* user, const char* move, uint64_t nodes);
+
+// Creates an engine with the default options. The path is the one of the
+// executable or library, used to find the network, and may be NULL.
+pikafish_engine* pikafish_create(const char* path);
+void             pikafish_destroy(pikafish_engine* engine);
+
+// Returns 0 on success, -1 if the option does not exist
+int pikafish_set_option(pikafish_engine* engine, const char* name, const char* value);
+
+// Sets the position from a FEN, NULL for the start position, followed by moves
+// in UCI format. Playing stops at the first illegal move.
+void pikafish_set_position(pikafish_engine*   engine,
+                           const char*        fen,
+                           const char* const* moves,
+                           size_t             moveCount);
+
+// Starts searching the current position and returns at once. A NULL limits is
+// an infinite search. The bestmove callback is called when the search ends.
+// Returns 0 on success, -1 without a usable network.
+int  pikafish_go(pikafish_engine* engine, const pikafish_limits* limits);
+void pikafish_stop(pikafish_engine* engine);
+void pikafish_ponderhit(pikafish_engine* engine);
+void pikafish_wait(pikafish_engine* engine);  // Blocks until the search has finished
+void pikafish_new_game(pikafish_engine* engine);  // Clears in the background, see pikafish_wait()
+
+// Counts the leaf nodes from the given position, NULL for the start position.
+// The callback, if not NULL, gets each root move in UCI format with its count.
+// Returns 0 without a usable network.
+uint64_t pikafish_perft(
+  pikafish_engine* engine, const char* fen, int depth, pikafish_perft_cb f, void* user);
+
+// Static evaluation of the current position in centipawns, from the point of
+// view of the side to move. Returns 0 on success, -1 if the side to move is in
+// check, where there is no static evaluation, and -2 without a usable network.
+int pikafish_evaluate(pikafish_engine* engine, int* cp);
+
+// Conversion of scores in internal units to centipawns and to win, draw and
+// loss permille triplets (3 ints per score in wdl), like the engine does for
+// its output. The conversion depends on the material on the board, given per
+// score as returned by pikafish_material(). These need no engine handle.
+int  pikafish_material(const char* fen);
+void pikafish_to_cp(const int* values, const int* materials, int* cp, size_t n);
+void pikafish_to_wdl(const int* values, const int* materials, int* wdl, size_t n);
+
+// Writes the FEN of the current position, returns its length without the
+// terminating zero. Nothing is written if size is too small.
+size_t pikafish_fen(pikafish_engine* engine, char* buffer, size_t size);
+
+// Callbacks, a NULL function removes the previous one
+void pikafish_set_on_update_no_moves(pikafish_engine* engine, pikafish_info_cb f, void* user);
+void pikafish_set_on_update_full(pikafish_engine* engine, pikafish_info_cb f, void* user);
+void pikafish_set_on_iter(pikafish_engine* engine, pikafish_iter_cb f, void* user);
+void pikafish_set_on_bestmove(pikafish_engine* engine, pikafish_bestmove_cb f, void* user);
+void pikafish_set_on_verify_network(pikafish_engine* engine, pikafish_message_cb f, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // #ifndef PIKAFISH_H_INCLUDED
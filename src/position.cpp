@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <charconv>
 #include <cstddef>
 #include <cstring>
 #include <iomanip>
@@ -91,10 +92,76 @@ void Position::init() {
 }
 
 
+bool Position::is_valid(const Piece squares[SQUARE_NB], Color us) {
+
+    constexpr int MaxCount[PIECE_TYPE_NB] = {0, 2, 2, 2, 5, 2, 2, 1};
+
+    int count[COLOR_NB][PIECE_TYPE_NB] = {};
+
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+    {
+        const Piece pc = squares[s];
+
+        if (pc == NO_PIECE)
+            continue;
+
+        if (pc < W_ROOK || pc > B_KING || type_of(pc) < ROOK || type_of(pc) > KING
+            || !can_stand(color_of(pc), type_of(pc), s)
+            || ++count[color_of(pc)][type_of(pc)] > MaxCount[type_of(pc)])
+            return false;
+    }
+
+    if (count[WHITE][KING] != 1 || count[BLACK][KING] != 1)
+        return false;
+
+    StateInfo st;
+    Position  pos;
+    pos.set(squares, us, 0, 0, &st);
+
+    return !pos.checkers_to(us, pos.king_square(~us));
+}
+
+bool Position::is_valid(std::string_view fenStr) {
+
+    std::istringstream is{std::string(fenStr)};
+    std::string        board, side, unused;
+    Piece              squares[SQUARE_NB];
+    int                f = FILE_A, r = RANK_9;
+    size_t             idx;
+
+    std::fill(squares, squares + SQUARE_NB, NO_PIECE);
+
+    if (!(is >> board >> side) || (side != "w" && side != "b"))
+        return false;
+
+    for (char c : board)
+    {
+        if (c == '/' && f == FILE_NB && r > RANK_0)
+            f = FILE_A, --r;
+
+        else if (c >= '1' && c <= '9' && f + (c - '0') <= FILE_NB)
+            f += c - '0';
+
+        else if (c != ' ' && (idx = PieceToChar.find(c)) != string::npos && f < FILE_NB)
+            squares[make_square(File(f++), Rank(r))] = Piece(idx);
+
+        else
+            return false;
+    }
+
+    // The halfmove clock and the move number follow two unused fields, see set().
+    // A field which is not a number reads as 0, one out of range as the limit.
+    int rule60 = 0, move = 1;
+    is >> unused >> unused >> rule60 >> move;
+
+    return f == FILE_NB && r == RANK_0 && rule60 >= 0 && rule60 <= 120 && move >= 0
+        && move <= 1 << 20 && is_valid(squares, side == "w" ? WHITE : BLACK);
+}
+
 // Initializes the position object with the given FEN string.
 // This function is not very robust - make sure that input FENs are correct,
 // this is assumed to be the responsibility of the GUI.
-Position& Position::set(const string& fenStr, StateInfo* si) {
+Position& Position::set(std::string_view fenStr, StateInfo* si) {
     /*
    A FEN string defines a particular position using only the ASCII character set.
 
@@ -119,27 +186,25 @@ Position& Position::set(const string& fenStr, StateInfo* si) {
       incremented after Black's move.
 */
 
-    unsigned char      token;
-    size_t             idx;
-    Square             sq = SQ_A9;
-    std::istringstream ss(fenStr);
+    const char* p   = fenStr.data();
+    const char* end = p + fenStr.size();
+    Square      sq  = SQ_A9;
+    size_t      idx;
 
     std::memset(this, 0, sizeof(Position));
     std::memset(si, 0, sizeof(StateInfo));
     st = si;
 
-    ss >> std::noskipws;
-
     // 1. Piece placement
-    while ((ss >> token) && !isspace(token))
+    for (; p < end && !isspace(*p); ++p)
     {
-        if (isdigit(token))
-            sq += (token - '0') * EAST;  // Advance the given number of files
+        if (isdigit(*p))
+            sq += (*p - '0') * EAST;  // Advance the given number of files
 
-        else if (token == '/')
+        else if (*p == '/')
             sq += 2 * SOUTH;
 
-        else if ((idx = PieceToChar.find(token)) != string::npos)
+        else if ((idx = PieceToChar.find(*p)) != string::npos)
         {
             put_piece(Piece(idx), sq);
             if (type_of(Piece(idx)) == KING)
@@ -148,19 +213,32 @@ Position& Position::set(const string& fenStr, StateInfo* si) {
         }
     }
 
-    // 2. Active color
-    ss >> token;
-    sideToMove = (token == 'w' ? WHITE : BLACK);
-    ss >> token;
+    // 2. Active color, the character right after the separator
+    sideToMove = p + 1 < end && p[1] == 'w' ? WHITE : BLACK;
+    p          = std::min(p + 3, end);
 
-    while ((ss >> token) && !isspace(token))
-        ;
+    // Skip the two unused fields, each with its separator
+    for (int field = 0; field < 2; ++field)
+    {
+        while (p < end && !isspace(*p))
+            ++p;
+        p = std::min(p + 1, end);
+    }
 
-    while ((ss >> token) && !isspace(token))
-        ;
+    // 3-4. Halfmove clock and fullmove number, a field which is not a number
+    // ends the parsing
+    int* fields[] = {&st->rule60, &gamePly};
 
-    // 3-4. Halfmove clock and fullmove number
-    ss >> std::skipws >> st->rule60 >> gamePly;
+    for (int* field : fields)
+    {
+        while (p < end && isspace(*p))
+            ++p;
+
+        auto [next, ec] = std::from_chars(p + (p < end && *p == '+'), end, *field);
+        if (ec != std::errc())
+            break;
+        p = next;
+    }
 
     // Convert from fullmove starting from 1 to gamePly starting from 0,
     // handle also common incorrect FEN with fullmove = 0.
@@ -174,6 +252,50 @@ Position& Position::set(const string& fenStr, StateInfo* si) {
 }
 
 
+// Initializes the position from its compact encoding, see pack()
+Position& Position::set(const Packed& packed, StateInfo* si) {
+
+    Piece squares[SQUARE_NB];
+    int   n = 0;
+
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+        squares[s] = packed.occupied[s / 8] & (1 << (s % 8))
+                     ? Piece((packed.pieces[n / 2] >> (4 * (n++ % 2))) & 0xF)
+                     : NO_PIECE;
+
+    return set(squares, Color(packed.sideToMove), packed.rule60, packed.gamePly, si);
+}
+
+
+// Initializes the position from a board given square by square, as sent by
+// binary protocol clients, without going through a FEN string.
+Position&
+Position::set(const Piece squares[SQUARE_NB], Color us, int rule60, int ply, StateInfo* si) {
+
+    std::memset(this, 0, sizeof(Position));
+    std::memset(si, 0, sizeof(StateInfo));
+    st = si;
+
+    for (Square s = SQ_A0; s < SQUARE_NB; ++s)
+        if (squares[s] != NO_PIECE)
+        {
+            put_piece(squares[s], s);
+            if (type_of(squares[s]) == KING)
+                kingSquare[color_of(squares[s])] = s;
+        }
+
+    sideToMove = us;
+    st->rule60 = rule60;
+    gamePly    = ply;
+
+    set_state();
+
+    assert(pos_is_ok());
+
+    return *this;
+}
+
+
 // Sets king attacks to detect if a move gives check
 void Position::set_check_info() const {
 
@@ -182,9 +304,20 @@ void Position::set_check_info() const {
 
     Square ksq = king_square(~sideToMove);
 
-    // We have to take special cares about the cannon and checks
-    st->needSlowCheck = more_than_one(checkers())
-                     || (attacks_bb<ROOK>(king_square(sideToMove)) & pieces(~sideToMove, CANNON));
+    // We have to take special cares about the cannon and checks. Out of check,
+    // the enemy cannons facing our king only need the squares where one of our
+    // pieces would become their screen, see legal().
+    Square   ourKsq  = king_square(sideToMove);
+    Bitboard cannons = attacks_bb<ROOK>(ourKsq) & pieces(~sideToMove, CANNON);
+
+    st->needSlowCheck = more_than_one(checkers()) || (checkers() && cannons);
+    st->screenSquares = 0;
+
+    for (Bitboard hollow = cannons & attacks_bb<ROOK>(ourKsq, pieces()); hollow;)
+    {
+        Square s = pop_lsb(hollow);
+        st->screenSquares |= between_bb(ourKsq, s) ^ s;
+    }
 
     st->checkSquares[PAWN]   = pawn_attacks_to_bb(sideToMove, ksq);
     st->checkSquares[KNIGHT] = attacks_bb<KNIGHT_TO>(ksq, pieces());
@@ -239,34 +372,65 @@ void Position::set_state() const {
 // Returns a FEN representation of the position.
 string Position::fen() const {
 
-    int                emptyCnt;
-    std::ostringstream ss;
+    char buffer[MaxFenLength];
+    return string(buffer, fen(buffer));
+}
+
+
+// Writes the FEN into the buffer, without allocating, and returns its length
+size_t Position::fen(char* buffer) const {
+
+    char* p = buffer;
 
     for (Rank r = RANK_9; r >= RANK_0; --r)
     {
         for (File f = FILE_A; f <= FILE_I; ++f)
         {
-            for (emptyCnt = 0; f <= FILE_I && empty(make_square(f, r)); ++f)
+            int emptyCnt = 0;
+            for (; f <= FILE_I && empty(make_square(f, r)); ++f)
                 ++emptyCnt;
 
             if (emptyCnt)
-                ss << emptyCnt;
+                *p++ = char('0' + emptyCnt);
 
             if (f <= FILE_I)
-                ss << PieceToChar[piece_on(make_square(f, r))];
+                *p++ = PieceToChar[piece_on(make_square(f, r))];
         }
 
         if (r > RANK_0)
-            ss << '/';
+            *p++ = '/';
     }
 
-    ss << (sideToMove == WHITE ? " w " : " b ");
+    std::memcpy(p, sideToMove == WHITE ? " w - - " : " b - - ", 7);
+    p += 7;
+
+    p    = std::to_chars(p, buffer + MaxFenLength, st->rule60).ptr;
+    *p++ = ' ';
+    p    = std::to_chars(p, buffer + MaxFenLength, 1 + (gamePly - (sideToMove == BLACK)) / 2).ptr;
+
+    return size_t(p - buffer);
+}
+
 
-    ss << '-';
+// Returns the compact encoding of the position, from which set() restores it
+// like from its FEN.
+Position::Packed Position::pack() const {
 
-    ss << " - " << st->rule60 << " " << 1 + (gamePly - (sideToMove == BLACK)) / 2;
+    Packed p{};
+    int    n = 0;
 
-    return ss.str();
+    for (Square s = SQ_A0; s <= SQ_I9; ++s)
+        if (Piece pc = piece_on(s); pc != NO_PIECE)
+        {
+            p.occupied[s / 8] |= 1 << (s % 8);
+            p.pieces[n / 2] |= pc << (4 * (n % 2));
+            ++n;
+        }
+
+    p.gamePly    = std::uint16_t(gamePly);
+    p.rule60     = std::uint8_t(st->rule60);
+    p.sideToMove = std::uint8_t(sideToMove);
+    return p;
 }
 
 
@@ -348,14 +512,21 @@ bool Position::legal(Move m) const {
         return !(checkers_to(~us, to, occupied));
 
     // If we don't need slow check. A non-king move is always legal when either:
-    // 1. Not moving a pinned piece.
-    // 2. Moving a pinned non-cannon piece and aligned with king.
-    // 3. Moving a pinned cannon and aligned with king but it's not a capture move.
-    if (!st->needSlowCheck
-        && (!(blockers_for_king(us) & from)
-            || (((type_of(piece_on(from)) != CANNON) || !capture(m))
-                && aligned(from, to, king_square(us)))))
-        return true;
+    // 1. Not moving a pinned piece, nor putting a screen in front of a cannon.
+    // 2. Moving a pinned non-cannon piece and aligned with king, with no enemy
+    //    cannon facing the king, whose screens may capture along the line.
+    // 3. Moving a pinned cannon and aligned with king but it's not a capture move,
+    //    with no enemy cannon facing the king either.
+    if (!st->needSlowCheck)
+    {
+        if (!(blockers_for_king(us) & from))
+            return !(screen_squares() & to);
+
+        if (((type_of(piece_on(from)) != CANNON) || !capture(m))
+            && aligned(from, to, king_square(us))
+            && !(attacks_bb<ROOK>(king_square(us)) & pieces(~us, CANNON)))
+            return true;
+    }
 
     // A non-king move is legal if the king is not under attack after the move.
     return !(checkers_to(~us, king_square(us), occupied) & ~square_bb(to));
@@ -412,13 +583,19 @@ bool Position::gives_check(Move m) const {
     else if (check_squares(pt) & to)
         return true;
 
-    // Is there a discovered check?
-    if (attacks_bb<ROOK>(ksq) & pieces(sideToMove, CANNON))
-        return bool(checkers_to(sideToMove, ksq, (pieces() ^ from) | to) & ~square_bb(from));
-    else if ((blockers_for_king(~sideToMove) & from) && !aligned(from, to, ksq))
+    // Is there a discovered check? Only a blocker leaving the line of a slider,
+    // the screens of a cannon or the leg of a knight gives one, as a piece moving
+    // into the line of a cannon with no screen is a direct check above. A blocker
+    // moving along the line keeps it blocked, unless our cannons face the king:
+    // a screen may capture the other one, and a cannon may jump out of the line.
+    if (!(blockers_for_king(~sideToMove) & from))
+        return false;
+
+    if (!aligned(from, to, ksq))
         return true;
 
-    return false;
+    return (attacks_bb<ROOK>(ksq) & pieces(sideToMove, CANNON))
+        && (checkers_to(sideToMove, ksq, (pieces() ^ from) | to) & ~square_bb(from));
 }
 
 
@@ -443,6 +620,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
     st             = &newSt;
     st->move       = m;
 
+    st->chasedReady[WHITE] = st->chasedReady[BLACK] = false;
+
     // Increment ply counters. Clamp to 10 checks for each side in rule 60
     // In particular, rule60 will be reset to zero later on in case of a capture.
     ++gamePly;
@@ -456,10 +635,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
     ++st->pliesFromNull;
 
     // Used by NNUE
-    st->accumulator.computed[WHITE] = false;
-    st->accumulator.computed[BLACK] = false;
-    auto& dp                        = st->dirtyPiece;
-    dp.dirty_num                    = 1;
+    auto& dp     = st->dirtyPiece;
+    dp.dirty_num = 1;
 
     Color  us       = sideToMove;
     Color  them     = ~us;
@@ -579,7 +756,7 @@ void Position::do_null_move(StateInfo& newSt, TranspositionTable& tt) {
     // Update the bloom filter
     ++filter[st->key];
 
-    std::memcpy(&newSt, st, offsetof(StateInfo, accumulator));
+    std::memcpy(&newSt, st, offsetof(StateInfo, dirtyPiece));
 
     newSt.previous = st;
     st             = &newSt;
@@ -587,8 +764,6 @@ void Position::do_null_move(StateInfo& newSt, TranspositionTable& tt) {
     st->dirtyPiece.dirty_num               = 0;  // Avoid checks in UpdateAccumulator()
     st->dirtyPiece.requires_refresh[WHITE] = false;
     st->dirtyPiece.requires_refresh[BLACK] = false;
-    st->accumulator.computed[WHITE]        = false;
-    st->accumulator.computed[BLACK]        = false;
 
     st->key ^= Zobrist::side;
     ++st->rule60;
@@ -828,10 +1003,29 @@ bool Position::chase_legal(Move m) const {
 }
 
 
-// Calculates the chase information for a given color.
+// Calculates the chase information for a given color, as a mask of the ids of
+// the chased pieces. The chased squares only depend on the position, so they are
+// kept in the state and repeated adjudications of the same line are cheap.
 uint16_t Position::chased(Color c) {
 
+    if (!st->chasedReady[c])
+    {
+        st->chasedBB[c]    = chased_squares(c);
+        st->chasedReady[c] = true;
+    }
+
     uint16_t chase = 0;
+    for (Bitboard b = st->chasedBB[c]; b;)
+        chase |= 1 << idBoard[pop_lsb(b)];
+
+    return chase;
+}
+
+
+// Returns the squares of the pieces chased by the given color
+Bitboard Position::chased_squares(Color c) {
+
+    Bitboard chase = 0;
 
     std::swap(c, sideToMove);
 
@@ -860,10 +1054,10 @@ uint16_t Position::chased(Color c) {
                 // Attacks against stronger pieces
                 if ((attackerType == KNIGHT || attackerType == CANNON)
                     && type_of(piece_on(to)) == ROOK)
-                    chase |= (1 << idBoard[to]);
+                    chase |= to;
                 if ((attackerType == ADVISOR || attackerType == BISHOP)
                     && type_of(piece_on(to)) & 1)
-                    chase |= (1 << idBoard[to]);
+                    chase |= to;
                 // Attacks against potentially unprotected pieces
                 else
                 {
@@ -889,11 +1083,11 @@ uint16_t Position::chased(Color c) {
                             sideToMove = ~sideToMove;
                             if ((attackerType == KNIGHT && ((between_bb(from, to) ^ to) & pieces()))
                                 || !chase_legal(Move(to, from)))
-                                chase |= (1 << idBoard[to]);
+                                chase |= to;
                             sideToMove = ~sideToMove;
                         }
                         else
-                            chase |= (1 << idBoard[to]);
+                            chase |= to;
                     }
                 }
             }
@@ -946,14 +1140,22 @@ Value Position::detect_chases(int d, int ply) {
 }
 
 
+// Counts the previous positions with the given key. The bloom filter
+// only gives an upper bound, as different keys can share a slot.
+int Position::repetitions(Key key) const {
+
+    int cnt = 0;
+    for (const StateInfo* stp = st->previous; stp; stp = stp->previous)
+        cnt += stp->key == key;
+    return cnt;
+}
+
+
 // Tests whether the position may end the game by rule 60, insufficient material, draw repetition,
 // perpetual check repetition or perpetual chase repetition that allows a player to claim a game result.
 bool Position::rule_judge(Value& result, int ply) {
 
-    // Restore rule 60 by adding back the checks
-    int end = std::min(st->rule60 + std::max(0, st->check10[WHITE] - 10)
-                         + std::max(0, st->check10[BLACK] - 10),
-                       st->pliesFromNull);
+    int end = repetition_window();
 
     if (end >= 4 && filter[st->key] >= 1)
     {
@@ -989,7 +1191,7 @@ bool Position::rule_judge(Value& result, int ply) {
                     return true;
 
                 // 2 fold mates need further investigations
-                if (filter[st->key] <= 1)
+                if (repetitions(st->key) <= 1)
                 {
                     // Have the same previous step
                     if (st->previous->key == stp->previous->key)
@@ -997,7 +1199,7 @@ bool Position::rule_judge(Value& result, int ply) {
                         // Even if we entering this loop again, it will not lead to a 3 fold repetition
                         StateInfo* next = st->previous;
                         while ((next = next->previous) != stp)
-                            if (filter[next->key] > 1)
+                            if (repetitions(next->key) > 1)
                                 break;
                         if (next == stp)
                             return true;
@@ -1015,7 +1217,7 @@ bool Position::rule_judge(Value& result, int ply) {
     // 60 move rule
     if (st->rule60 >= 120)
     {
-        result = MoveList<LEGAL>(*this).size() ? VALUE_DRAW : mated_in(ply);
+        result = LegalMoves(*this).next() != Move::none() ? VALUE_DRAW : mated_in(ply);
         return true;
     }
 
@@ -1076,7 +1278,7 @@ bool Position::rule_judge(Value& result, int ply) {
                 {
                     StateInfo tempSt;
                     do_move(move, tempSt);
-                    bool mate = MoveList<LEGAL>(*this).size() == 0;
+                    bool mate = LegalMoves(*this).next() == Move::none();
                     undo_move(move);
                     if (mate)
                         return false;
@@ -20,17 +20,17 @@
 #define POSITION_H_INCLUDED
 
 #include <stdint.h>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
-#include <deque>
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "bitboard.h"
-
-#include "nnue/nnue_accumulator.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -57,21 +57,62 @@ struct StateInfo {
     Bitboard   blockersForKing[COLOR_NB];
     Bitboard   pinners[COLOR_NB];
     Bitboard   checkSquares[PIECE_TYPE_NB];
+    Bitboard   screenSquares;
     bool       needSlowCheck;
     Piece      capturedPiece;
     Move       move;
 
+    // Chased squares of each color, computed on demand by chased()
+    Bitboard chasedBB[COLOR_NB];
+    bool     chasedReady[COLOR_NB];
+
     // Used by NNUE
-    Eval::NNUE::Accumulator accumulator;
-    DirtyPiece              dirtyPiece;
+    DirtyPiece dirtyPiece;
 };
 
 
 // A list to keep track of the position states along the setup moves (from the
 // start position to the position just before the search starts). Needed by
-// 'draw by repetition' detection. Use a std::deque because pointers to
-// elements are not invalidated upon list resizing.
-using StateListPtr = std::unique_ptr<std::deque<StateInfo>>;
+// 'draw by repetition' detection. The states are kept in chunks which never
+// move, so that pointers to them stay valid as the list grows, and clear()
+// keeps the chunks for the next position instead of freeing them. A new state
+// is left as it is, to be filled by Position::set() or do_move().
+class StateList {
+   public:
+    StateList() { clear(); }
+
+    StateList(const StateList&)            = delete;
+    StateList& operator=(const StateList&) = delete;
+
+    // Drops all the states but a first one
+    void clear() {
+        count = 0;
+        emplace_back();
+    }
+
+    StateInfo& emplace_back() {
+        if (count == chunks.size() * ChunkSize)
+            chunks.emplace_back(new StateInfo[ChunkSize]);
+
+        ++count;
+        return back();
+    }
+
+    StateInfo& back() {
+        assert(count);
+        return chunks[(count - 1) / ChunkSize][(count - 1) % ChunkSize];
+    }
+
+    size_t size() const { return count; }
+
+   private:
+    static constexpr size_t ChunkSize = 256;  // Enough for most games
+
+    std::vector<std::unique_ptr<StateInfo[]>> chunks;
+    size_t                                    count;
+};
+
+using StateListPtr = std::unique_ptr<StateList>;
 
 
 // Position class stores information regarding the board representation as
@@ -82,14 +123,37 @@ class Position {
    public:
     static void init();
 
+    // Checks input from untrusted sources, before it is given to set(). Each side
+    // must have one king, and no more pieces of a type than it starts with, each
+    // on a square it can reach. The side not to move can't be in check, so the
+    // kings can't face each other either. A FEN must also be well formed, with a
+    // halfmove clock within the 60 move rule.
+    static bool is_valid(const Piece squares[SQUARE_NB], Color us);
+    static bool is_valid(std::string_view fenStr);
+
     Position()                           = default;
     Position(const Position&)            = delete;
     Position& operator=(const Position&) = delete;
 
+    // Compact binary encoding of a position, see pack()
+    struct Packed {
+        std::uint8_t  occupied[12];  // Bit s is set when square s is occupied
+        std::uint8_t  pieces[16];    // 4 bit piece of each occupied square, in ascending order
+        std::uint16_t gamePly;
+        std::uint8_t  rule60;
+        std::uint8_t  sideToMove;
+    };
+
+    static constexpr size_t MaxFenLength = 128;
+
     // FEN string input/output
-    Position&   set(const std::string& fenStr, StateInfo* si);
+    Position&   set(std::string_view fenStr, StateInfo* si);
     Position&   set(const Position& pos, StateInfo* si);
+    Position&   set(const Piece squares[SQUARE_NB], Color us, int rule60, int ply, StateInfo* si);
+    Position&   set(const Packed& packed, StateInfo* si);
     std::string fen() const;
+    size_t      fen(char* buffer) const;  // Writes up to MaxFenLength chars, without a final zero
+    Packed      pack() const;
 
     // Position representation
     Bitboard pieces(PieceType pt = ALL_PIECES) const;
@@ -110,6 +174,7 @@ class Position {
     Bitboard checkers() const;
     Bitboard blockers_for_king(Color c) const;
     Bitboard check_squares(PieceType pt) const;
+    Bitboard screen_squares() const;
     Bitboard pinners(Color c) const;
 
     // Attacks to/from a given square
@@ -150,6 +215,7 @@ class Position {
     int      game_ply() const;
     bool     rule_judge(Value& result, int ply = 0);
     int      rule60_count() const;
+    int      repetition_window() const;
     uint16_t chased(Color c);
     Value    major_material(Color c) const;
     Value    major_material() const;
@@ -174,6 +240,8 @@ class Position {
     std::pair<Piece, int> light_do_move(Move m);
     void                  light_undo_move(Move m, Piece captured, int id = 0);
     Value                 detect_chases(int d, int ply = 0);
+    int                   repetitions(Key key) const;
+    Bitboard              chased_squares(Color c);
     bool                  chase_legal(Move m) const;
     template<bool AfterMove>
     Key adjust_key60(Key k) const;
@@ -261,6 +329,8 @@ inline Bitboard Position::pinners(Color c) const { return st->pinners[c]; }
 
 inline Bitboard Position::check_squares(PieceType pt) const { return st->checkSquares[pt]; }
 
+inline Bitboard Position::screen_squares() const { return st->screenSquares; }
+
 inline Key Position::key() const { return adjust_key60<false>(st->key); }
 
 template<bool AfterMove>
@@ -280,6 +350,14 @@ inline int Position::game_ply() const { return gamePly; }
 
 inline int Position::rule60_count() const { return st->rule60; }
 
+// Number of previous positions which can still repeat: those since the last
+// capture, restoring rule 60 by adding back the checks, and since the last null move.
+inline int Position::repetition_window() const {
+    return std::min(st->rule60 + std::max(0, st->check10[WHITE] - 10)
+                      + std::max(0, st->check10[BLACK] - 10),
+                    st->pliesFromNull);
+}
+
 inline bool Position::capture(Move m) const {
     assert(m.is_ok());
     return !empty(m.to_sq());
@@ -326,10 +404,16 @@ inline StateInfo* Position::state() const { return st; }
 
 inline Position& Position::set(const Position& pos, StateInfo* si) {
 
-    set(pos.fen(), si);
+    set(pos.board, pos.sideToMove, pos.st->rule60, pos.gamePly, si);
 
-    // Special cares for bloom filter
-    std::memcpy(&filter, &pos.filter, sizeof(BloomFilter));
+    // Rebuild the bloom filter from the previous positions which can still
+    // repeat. Older ones differ in material, so they can't match any more.
+    StateInfo* stp = pos.st;
+    for (int i = pos.repetition_window(); i > 0; --i)
+    {
+        stp = stp->previous;
+        ++filter[stp->key];
+    }
 
     return *this;
 }
@@ -25,11 +25,15 @@
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <initializer_list>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "distributed.h"
 #include "evaluate.h"
+#include "mate.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
@@ -38,8 +42,10 @@
 #include "nnue/nnue_common.h"
 #include "nnue/nnue_misc.h"
 #include "position.h"
+#include "tablebase.h"
 #include "thread.h"
 #include "timeman.h"
+#include "trace.h"
 #include "tt.h"
 #include "types.h"
 #include "uci.h"
@@ -68,6 +74,43 @@ constexpr int futility_move_count(bool improving, Depth depth) {
     return improving ? (3 + depth * depth) : (3 + depth * depth) / 2;
 }
 
+// ABDADA: nodes shallower than this are neither marked busy nor deferred, as
+// the table traffic would cost more than the duplicated work.
+constexpr Depth BusyMinDepth = 6;
+constexpr int   MaxDeferred  = 32;
+
+// Marks a node busy for the lifetime of the guard, if its slot is free
+class BusyGuard {
+   public:
+    BusyGuard(BusyTable& t, Key k, bool enabled) :
+        table(t),
+        key(k),
+        marked(enabled && t.mark(k)) {}
+    ~BusyGuard() {
+        if (marked)
+            table.unmark(key);
+    }
+
+   private:
+    BusyTable& table;
+    Key        key;
+    bool       marked;
+};
+
+// The k-th best score of the root moves, -VALUE_INFINITE if fewer have one
+Value kth_best_score(const RootMoves& rootMoves, size_t k) {
+    std::vector<Value> scores;
+    for (const RootMove& rm : rootMoves)
+        if (rm.score != -VALUE_INFINITE)
+            scores.push_back(rm.score);
+
+    if (scores.size() < k)
+        return -VALUE_INFINITE;
+
+    std::nth_element(scores.begin(), scores.begin() + (k - 1), scores.end(), std::greater<>());
+    return scores[k - 1];
+}
+
 // Add correctionHistory value to raw staticEval and guarantee evaluation does not hit the mate range
 Value to_corrected_static_eval(Value v, const Worker& w, const Position& pos) {
     auto cv = w.correctionHistory[pos.side_to_move()][pawn_structure_index<Correction>(pos)];
@@ -116,20 +159,31 @@ Search::Worker::Worker(SharedState&                    sharedState,
     threadIdx(threadId),
     numaAccessToken(token),
     manager(std::move(sm)),
+    ownTT(bool(sharedState.options["Deterministic"]) ? std::make_unique<TranspositionTable>()
+                                                   : nullptr),
     options(sharedState.options),
     threads(sharedState.threads),
-    tt(sharedState.tt),
+    tt(ownTT ? *ownTT : sharedState.tt),
     network(sharedState.network),
     refreshTable(network[token]) {
+    if (ownTT)
+        ownTT->attach(&sharedState.tt);
+
     clear();
 }
 
 void Search::Worker::start_searching() {
 
+    Trace::Scope scope("search");
+
+    // The hardware events of the search of each thread, see perf.h
+    const Perf::Snapshot perfStart = Perf::snapshot();
+
     // Non-main threads go directly to iterative_deepening()
     if (!is_mainthread())
     {
         iterative_deepening();
+        perfCounts = Perf::snapshot() - perfStart;
         return;
     }
 
@@ -137,31 +191,56 @@ void Search::Worker::start_searching() {
                             main_manager()->originalTimeAdjust);
     tt.new_search();
 
+    if (limits.use_time_management())
+    {
+        Trace::instant("time optimum", "ms", main_manager()->tm.optimum());
+        Trace::instant("time maximum", "ms", main_manager()->tm.maximum());
+    }
+
+    // Mates by checks are proven by the mate solver, if enabled, and the usual
+    // search only runs when it finds none.
+    const bool mateSolved = limits.mate && options["MateSolver"] && limits.searchmoves.empty()
+                         && int(options["MultiPV"]) == 1 && !rootMoves.empty() && solve_mate();
+
     if (rootMoves.empty())
     {
         rootMoves.emplace_back(Move::none());
         main_manager()->updates.onUpdateNoMoves({0, {-VALUE_MATE, rootPos}});
     }
-    else
+    else if (!mateSolved)
     {
         threads.start_searching();  // start non-main threads
         iterative_deepening();      // main thread start searching
     }
 
+    perfCounts = Perf::snapshot() - perfStart;
+
     // When we reach the maximum depth, we can arrive here without a raise of
     // threads.stop. However, if we are pondering or in an infinite search,
     // the UCI protocol states that we shouldn't print the best move before the
     // GUI sends a "stop" or "ponderhit" command. We therefore simply wait here
     // until the GUI sends one of those commands.
-    while (!threads.stop && (main_manager()->ponder || limits.infinite))
-    {}  // Busy wait for a stop or a ponder reset
+    if (!threads.stop && (main_manager()->ponder || limits.infinite))
+    {
+        Trace::Scope wait("wait for stop");
+
+        while (!threads.stop && (main_manager()->ponder || limits.infinite))
+        {}  // Busy wait for a stop or a ponder reset
+    }
 
     // Stop the threads if not already stopped (also raise the stop if
-    // "ponderhit" just reset threads.ponder).
-    threads.stop = true;
+    // "ponderhit" just reset threads.ponder). In deterministic mode the other
+    // threads finish their own work first, as where they stop must not depend
+    // on when the main thread is done.
+    if (!deterministic())
+        threads.stop = true;
 
     // Wait until all threads have finished
     threads.wait_for_search_finished();
+    threads.stop = true;
+
+    if (Perf::Enabled)
+        report_perf_counts();
 
     // When playing in 'nodes as time' mode, subtract the searched nodes from
     // the available ones before exiting.
@@ -171,14 +250,16 @@ void Search::Worker::start_searching() {
 
     Worker* bestThread = this;
 
-    if (int(options["MultiPV"]) == 1 && !limits.depth && rootMoves[0].pv[0] != Move::none())
+    if (int(options["MultiPV"]) == 1 && !limits.depth && !mateSolved
+        && rootMoves[0].pv[0] != Move::none())
         bestThread = threads.get_best_thread()->worker.get();
 
     main_manager()->bestPreviousScore        = bestThread->rootMoves[0].score;
     main_manager()->bestPreviousAverageScore = bestThread->rootMoves[0].averageScore;
 
-    // Send again PV info if we have a new best thread
-    if (bestThread != this)
+    // Send again PV info if we have a new best thread, or in deterministic mode
+    // with the final node count of all threads
+    if (bestThread != this || deterministic())
         main_manager()->pv(*bestThread, threads, tt, bestThread->completedDepth);
 
     std::string ponder;
@@ -189,6 +270,83 @@ void Search::Worker::start_searching() {
 
     auto bestmove = UCIEngine::move(bestThread->rootMoves[0].pv[0]);
     main_manager()->updates.onBestmove(bestmove, ponder);
+
+    // After the best move, so that what the result is used for doesn't delay it
+    if (main_manager()->updates.onResult && limits.searchmoves.empty())
+        main_manager()->updates.onResult(rootPos, bestThread->rootMoves[0],
+                                         bestThread->completedDepth);
+
+    if (bestThread->rootMoves[0].pv[0] != Move::none())
+        threads.search_background(std::vector<Move>(bestThread->rootMoves[0].pv));
+}
+
+// Sends the hardware events counted by the threads of the search, and adds
+// them to the totals of the program.
+void Search::Worker::report_perf_counts() {
+
+    std::vector<Perf::Snapshot> counts;
+
+    for (auto&& th : threads)
+    {
+        counts.push_back(th->worker->perfCounts);
+        Perf::add_to_total(counts.back());
+    }
+
+    if (main_manager()->updates.onInfoString)
+        for (const auto& line : Perf::report(counts))
+            main_manager()->updates.onInfoString(line);
+}
+
+// Looks for shorter and shorter mates with the mate solver, within the limits
+// of the search, and sends each one as a PV line.
+bool Search::Worker::solve_mate() {
+
+    SearchManager*    mainThread = main_manager();
+    std::vector<Move> pv;
+    bool              found = false;
+
+    mateSolver.resize(size_t(options["MateHash"]));
+
+    // The solver counts its nodes from its creation
+    const uint64_t nodesBefore = mateSolver.nodes_searched();
+
+    const auto stop = [&](uint64_t solverNodes) {
+        nodes = solverNodes - nodesBefore;
+
+        const TimePoint elapsed = mainThread->tm.elapsed([&]() { return nodes.load(); });
+
+        return threads.stop
+            || (!mainThread->ponder
+                && ((limits.use_time_management() && elapsed > mainThread->tm.maximum())
+                    || (limits.movetime && elapsed >= limits.movetime)
+                    || (limits.nodes && nodes >= limits.nodes)));
+    };
+
+    for (int moves = limits.mate; moves > 0;)
+    {
+        const int plies = mateSolver.solve(rootPos, moves, pv, stop);
+        nodes           = mateSolver.nodes_searched() - nodesBefore;
+
+        if (!plies)
+            break;
+
+        Utility::move_to_front(rootMoves, [&](const auto& rm) { return rm.pv[0] == pv[0]; });
+
+        RootMove& rm = rootMoves[0];
+        rm.pv        = pv;
+        rm.selDepth  = plies;
+        rm.score = rm.uciScore = rm.averageScore = mate_in(plies);
+        rm.scoreLowerbound = rm.scoreUpperbound = false;
+
+        completedDepth = plies;
+
+        mainThread->pv(*this, threads, tt, plies);
+
+        found = true;
+        moves = (plies + 1) / 2 - 1;
+    }
+
+    return found;
 }
 
 // Main iterative deepening loop. It calls search()
@@ -204,6 +362,14 @@ void Search::Worker::iterative_deepening() {
     Value lastBestScore     = -VALUE_INFINITE;
     auto  lastBestPV        = std::vector{Move::none()};
 
+    // Resumed analysis, see ThreadPool::resume_analysis()
+    if (completedDepth)
+    {
+        lastBestMoveDepth = completedDepth;
+        lastBestScore     = rootMoves[0].score;
+        lastBestPV        = rootMoves[0].pv;
+    }
+
     Value  alpha, beta;
     Value  bestValue     = -VALUE_INFINITE;
     Color  us            = rootPos.side_to_move();
@@ -216,6 +382,8 @@ void Search::Worker::iterative_deepening() {
     Stack  stack[MAX_PLY + 10] = {};
     Stack* ss                  = stack + 7;
 
+    accumulators.reset();
+
     for (int i = 7; i > 0; --i)
     {
         (ss - i)->continuationHistory =
@@ -240,12 +408,18 @@ void Search::Worker::iterative_deepening() {
 
     multiPV = std::min(multiPV, rootMoves.size());
 
+    // With shared lines all of them come from a single root search per iteration
+    sharedLines             = options["MultiPVMode"] == "shared" ? multiPV : 1;
+    const size_t pvSearches = sharedLines > 1 ? 1 : multiPV;
+
     int searchAgainCounter = 0;
 
     // Iterative deepening loop until requested to stop or the target depth is reached
-    while (++rootDepth < MAX_PLY && !threads.stop
-           && !(limits.depth && mainThread && rootDepth > limits.depth))
+    while (++rootDepth < MAX_PLY && !stopped()
+           && !(limits.depth && (mainThread || deterministic()) && rootDepth > limits.depth))
     {
+        Trace::Scope iteration("iteration", "depth", rootDepth);
+
         // Age out PV variability metric
         if (mainThread)
             totBestMoveChanges /= 2;
@@ -261,16 +435,21 @@ void Search::Worker::iterative_deepening() {
         if (!threads.increaseDepth)
             searchAgainCounter++;
 
-        // MultiPV loop. We perform a full root search for each PV line
-        for (pvIdx = 0; pvIdx < multiPV; ++pvIdx)
+        // MultiPV loop. We perform a full root search for each PV line, or a single
+        // one for all of them with shared lines
+        for (pvIdx = 0; pvIdx < pvSearches; ++pvIdx)
         {
             // Reset UCI info selDepth for each depth and each PV line
             selDepth = 0;
 
-            // Reset aspiration window starting size
+            Trace::instant("pv line", "pvIdx", int64_t(pvIdx));
+
+            // Reset aspiration window starting size. With shared lines the window
+            // goes from the score of the last line to the score of the first one.
             Value avg = rootMoves[pvIdx].averageScore;
+            Value low = rootMoves[pvIdx + sharedLines - 1].averageScore;
             delta     = 12 + avg * avg / 30272;
-            alpha     = std::max(avg - delta, -VALUE_INFINITE);
+            alpha     = std::max(low - delta, -VALUE_INFINITE);
             beta      = std::min(avg + delta, VALUE_INFINITE);
 
             // Adjust optimism based on root move's averageScore (~4 Elo)
@@ -288,7 +467,10 @@ void Search::Worker::iterative_deepening() {
                 Depth adjustedDepth =
                   std::max(1, rootDepth - failedHighCnt - 3 * (searchAgainCounter + 1) / 4);
                 rootDelta = beta - alpha;
+
+                Trace::begin("root search", "window", rootDelta);
                 bestValue = search<Root>(rootPos, ss, alpha, beta, adjustedDepth, false);
+                Trace::end("root search");
 
                 // Bring the best move to the front. It is critical that sorting
                 // is done with a stable algorithm because all the values but the
@@ -301,7 +483,7 @@ void Search::Worker::iterative_deepening() {
                 // If search has been stopped, we break immediately. Sorting is
                 // safe because RootMoves is still valid, although it refers to
                 // the previous iteration.
-                if (threads.stop)
+                if (stopped())
                     break;
 
                 // When failing high/low give some update (without cluttering
@@ -311,9 +493,20 @@ void Search::Worker::iterative_deepening() {
                     main_manager()->pv(*this, threads, tt, rootDepth);
 
                 // In case of failing low/high increase aspiration window and
-                // re-search, otherwise exit the loop.
-                if (bestValue <= alpha)
+                // re-search, otherwise exit the loop. Shared lines fail low when
+                // the last of them does.
+                if (sharedLines > 1 && bestValue < beta && rootMoves[multiPV - 1].score <= alpha)
                 {
+                    Trace::instant("fail low", "score", rootMoves[multiPV - 1].score);
+                    alpha = std::max(alpha - delta, -VALUE_INFINITE);
+
+                    failedHighCnt = 0;
+                    if (mainThread)
+                        mainThread->stopOnPonderhit = false;
+                }
+                else if (sharedLines == 1 && bestValue <= alpha)
+                {
+                    Trace::instant("fail low", "score", bestValue);
                     beta  = (alpha + beta) / 2;
                     alpha = std::max(bestValue - delta, -VALUE_INFINITE);
 
@@ -323,6 +516,7 @@ void Search::Worker::iterative_deepening() {
                 }
                 else if (bestValue >= beta)
                 {
+                    Trace::instant("fail high", "score", bestValue);
                     beta = std::min(bestValue + delta, VALUE_INFINITE);
                     ++failedHighCnt;
                 }
@@ -338,24 +532,25 @@ void Search::Worker::iterative_deepening() {
             std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
             if (mainThread
-                && (threads.stop || pvIdx + 1 == multiPV || elapsed_time() > 3000)
+                && (stopped() || pvIdx + 1 == pvSearches || elapsed_time() > 3000)
                 // A thread that aborted search can have mated-in/TB-loss PV and score
                 // that cannot be trusted, i.e. it can be delayed or refuted if we would have
                 // had time to fully search other root-moves. Thus we suppress this output and
                 // below pick a proven score/PV for this thread (from the previous iteration).
-                && !(threads.abortedSearch && rootMoves[0].uciScore <= VALUE_MATED_IN_MAX_PLY))
+                && !((threads.abortedSearch || quota_exhausted())
+                     && rootMoves[0].uciScore <= VALUE_MATED_IN_MAX_PLY))
                 main_manager()->pv(*this, threads, tt, rootDepth);
 
-            if (threads.stop)
+            if (stopped())
                 break;
         }
 
-        if (!threads.stop)
+        if (!stopped())
             completedDepth = rootDepth;
 
         // We make sure not to pick an unproven mated-in score,
         // in case this thread prematurely stopped search (aborted-search).
-        if (threads.abortedSearch && rootMoves[0].score != -VALUE_INFINITE
+        if ((threads.abortedSearch || quota_exhausted()) && rootMoves[0].score != -VALUE_INFINITE
             && rootMoves[0].score <= VALUE_MATED_IN_MAX_PLY)
         {
             // Bring the last best move to the front for best thread selection.
@@ -371,6 +566,11 @@ void Search::Worker::iterative_deepening() {
             lastBestMoveDepth = rootDepth;
         }
 
+        // With an own table, the entries written by the other threads only become
+        // visible here, once all of them have finished this iteration.
+        if (ownTT)
+            threads.end_tt_epoch(*this, false);
+
         if (!mainThread)
             continue;
 
@@ -381,7 +581,10 @@ void Search::Worker::iterative_deepening() {
                 || (rootMoves[0].score != -VALUE_INFINITE
                     && rootMoves[0].score <= VALUE_MATED_IN_MAX_PLY
                     && VALUE_MATE + rootMoves[0].score <= 2 * limits.mate)))
+        {
+            Trace::instant("stop: mate found");
             threads.stop = true;
+        }
 
         // Use part of the gained time from a previous stable move for the current move
         for (auto&& th : threads)
@@ -411,14 +614,25 @@ void Search::Worker::iterative_deepening() {
                              * bestMoveInstability * EvalLevel[el] * recapture;
 
             auto elapsedTime = elapsed();
+            bool nextFits    = mainThread->tm.next_iteration_fits(
+              completedDepth, threads.nodes_searched(), elapsedTime);
+
+            Trace::instant("time target", "ms", int64_t(totalTime));
 
             if (completedDepth >= 10 && nodesEffort >= 89 && elapsedTime > totalTime * 0.80
                 && !mainThread->ponder)
+            {
+                Trace::instant("stop: best move effort", "elapsed", elapsedTime);
                 threads.stop = true;
+            }
 
-            // Stop the search if we have exceeded the totalTime
-            if (elapsedTime > totalTime)
+            // Stop the search if we have exceeded the totalTime, or if the next
+            // iteration is not expected to end in time
+            if (elapsedTime > totalTime || !nextFits)
             {
+                Trace::instant(nextFits ? "stop: time target" : "stop: next iteration won't fit",
+                               "elapsed", elapsedTime);
+
                 // If we are allowed to ponder do not stop the search now but
                 // keep pondering until the GUI sends "ponderhit" or "stop".
                 if (mainThread->ponder)
@@ -434,6 +648,9 @@ void Search::Worker::iterative_deepening() {
         iterIdx                        = (iterIdx + 1) & 3;
     }
 
+    if (ownTT)
+        threads.end_tt_epoch(*this, true);
+
     if (!mainThread)
         return;
 
@@ -457,6 +674,85 @@ void Search::Worker::clear() {
         reductions[i] = int((20.55 + std::log(size_t(options["Threads"])) / 2) * std::log(i));
 
     refreshTable.clear(network[numaAccessToken]);
+    evalCache.clear();
+    networkVersion = network.get_version();
+    completedDepth = 0;  // Nothing to resume after a new game
+
+    if (ownTT)
+        ownTT->discard();
+
+    mateSolver.clear();
+}
+
+bool Search::Worker::stopped() const {
+    return threads.stop.load(std::memory_order_relaxed) || quota_exhausted();
+}
+
+
+void Search::Worker::do_move(Position& pos, const Move move, StateInfo& st) {
+    do_move(pos, move, st, pos.gives_check(move));
+}
+
+void Search::Worker::do_move(Position&  pos,
+                             const Move move,
+                             StateInfo& st,
+                             const bool givesCheck) {
+    pos.do_move(move, st, givesCheck);
+    accumulators.push();
+}
+
+void Search::Worker::do_null_move(Position& pos, StateInfo& st) {
+    pos.do_null_move(st, tt);
+    accumulators.push();
+}
+
+void Search::Worker::undo_move(Position& pos, const Move move) {
+    pos.undo_move(move);
+    accumulators.pop();
+}
+
+void Search::Worker::undo_null_move(Position& pos) {
+    pos.undo_null_move();
+    accumulators.pop();
+}
+
+Value Search::Worker::evaluate(const Position& pos) {
+    ++stats.evaluations;
+    return Eval::evaluate(network[numaAccessToken], pos, accumulators, refreshTable,
+                          optimism[pos.side_to_move()], &evalCache);
+}
+
+std::vector<Value> Search::Worker::evaluate_batch(const std::vector<const Position*>& positions) {
+    stats.evaluations += positions.size();
+    return Eval::evaluate_batch(network[numaAccessToken], positions, accumulators, refreshTable);
+}
+
+Value Search::Worker::qsearch_root(Position& pos) {
+
+    Move   pv[MAX_PLY + 1];
+    Stack  stack[MAX_PLY + 10] = {};
+    Stack* ss                  = stack + 7;
+
+    accumulators.reset();
+    optimism[WHITE] = optimism[BLACK] = VALUE_ZERO;
+
+    for (int i = 7; i > 0; --i)
+    {
+        (ss - i)->continuationHistory = &continuationHistory[0][0][NO_PIECE][0];
+        (ss - i)->staticEval          = VALUE_NONE;
+    }
+
+    for (int i = 0; i <= MAX_PLY + 2; ++i)
+        (ss + i)->ply = i;
+
+    ss->pv = pv;
+
+    return qsearch<PV>(pos, ss, -VALUE_INFINITE, VALUE_INFINITE);
+}
+
+void Search::Worker::hint_common_parent_position(const Position& pos) {
+    Eval::NNUE::hint_common_parent_position(pos, network[numaAccessToken], accumulators,
+                                            refreshTable);
 }
 
 
@@ -482,7 +778,6 @@ Value Search::Worker::search(
 
     Move      pv[MAX_PLY + 1], capturesSearched[32], quietsSearched[32];
     StateInfo st;
-    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
     Key   posKey;
     Move  move, excludedMove, bestMove;
@@ -531,10 +826,9 @@ Value Search::Worker::search(
                 beta = std::min(beta, VALUE_DRAW + 1);
         }
 
-        if (threads.stop.load(std::memory_order_relaxed) || ss->ply >= MAX_PLY)
-            return (ss->ply >= MAX_PLY && !ss->inCheck)
-                   ? evaluate(network[numaAccessToken], pos, refreshTable, thisThread->optimism[us])
-                   : value_draw(thisThread->nodes);
+        if (stopped() || ss->ply >= MAX_PLY)
+            return (ss->ply >= MAX_PLY && !ss->inCheck) ? evaluate(pos)
+                                                        : value_draw(thisThread->nodes);
 
         // Step 3. Mate distance pruning. Even if we mate at the next move our score
         // would be at best mate_in(ss->ply + 1), but if alpha is already bigger because
@@ -569,6 +863,8 @@ Value Search::Worker::search(
     ss->ttPv     = excludedMove ? ss->ttPv : PvNode || (ttHit && ttData.is_pv);
     ttCapture    = ttData.move && pos.capture(ttData.move);
 
+    stats.ttHits += ttHit;
+
     // At this point, if excluded, skip straight to step 5, static eval. However,
     // to save indentation, we list the condition in all code between here and there.
 
@@ -597,6 +893,23 @@ Value Search::Worker::search(
             return ttData.value;
     }
 
+    // Tablebases probe, which only knows about forced mates
+    if (!rootNode && !excludedMove && pos.count<ALL_PIECES>() <= thisThread->tbCardinality)
+    {
+        Value tbValue = Tablebases::probe(pos, ss->ply);
+
+        if (tbValue != VALUE_NONE)
+        {
+            thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
+
+            ttWriter.write(posKey, value_to_tt(tbValue, ss->ply), ss->ttPv, BOUND_EXACT,
+                           std::min(MAX_PLY - 1, depth + 6), Move::none(), VALUE_NONE,
+                           tt.generation());
+
+            return tbValue;
+        }
+    }
+
     // Step 5. Static evaluation of the position
     Value unadjustedStaticEval = VALUE_NONE;
     if (ss->inCheck)
@@ -610,7 +923,7 @@ Value Search::Worker::search(
     {
         // Providing the hint that this node's accumulator will be used often
         // brings significant Elo gain (~13 Elo).
-        Eval::NNUE::hint_common_parent_position(pos, network[numaAccessToken], refreshTable);
+        hint_common_parent_position(pos);
         unadjustedStaticEval = eval = ss->staticEval;
     }
     else if (ss->ttHit)
@@ -618,10 +931,9 @@ Value Search::Worker::search(
         // Never assume anything about values stored in TT
         unadjustedStaticEval = ttData.eval;
         if (unadjustedStaticEval == VALUE_NONE)
-            unadjustedStaticEval =
-              evaluate(network[numaAccessToken], pos, refreshTable, thisThread->optimism[us]);
+            unadjustedStaticEval = evaluate(pos);
         else if (PvNode)
-            Eval::NNUE::hint_common_parent_position(pos, network[numaAccessToken], refreshTable);
+            hint_common_parent_position(pos);
 
         ss->staticEval = eval = to_corrected_static_eval(unadjustedStaticEval, *thisThread, pos);
 
@@ -632,8 +944,7 @@ Value Search::Worker::search(
     }
     else
     {
-        unadjustedStaticEval =
-          evaluate(network[numaAccessToken], pos, refreshTable, thisThread->optimism[us]);
+        unadjustedStaticEval = evaluate(pos);
         ss->staticEval = eval = to_corrected_static_eval(unadjustedStaticEval, *thisThread, pos);
 
         // Static evaluation is saved as it was before adjustment by correction history
@@ -695,11 +1006,11 @@ Value Search::Worker::search(
         ss->currentMove         = Move::null();
         ss->continuationHistory = &thisThread->continuationHistory[0][0][NO_PIECE][0];
 
-        pos.do_null_move(st, tt);
+        do_null_move(pos, st);
 
         Value nullValue = -search<NonPV>(pos, ss + 1, -beta, -beta + 1, depth - R, !cutNode);
 
-        pos.undo_null_move();
+        undo_null_move(pos);
 
         // Do not return unproven mate
         if (nullValue >= beta && nullValue < VALUE_MATE_IN_MAX_PLY)
@@ -730,7 +1041,7 @@ Value Search::Worker::search(
     if (PvNode && !ttData.move)
         depth -= 2 + (ss->ttHit && ttData.depth >= depth);
 
-    if (!PvNode && ss->ttHit && (tte->bound() & BOUND_UPPER) && ttValue > alpha + 5 * depth)
+    if (!PvNode && ss->ttHit && (ttData.bound & BOUND_UPPER) && ttData.value > alpha + 5 * depth)
         depth--;
 
     // Use qsearch if depth <= 0.
@@ -769,11 +1080,11 @@ Value Search::Worker::search(
 
                 ss->currentMove = move;
                 ss->continuationHistory =
-                  &this
-                     ->continuationHistory[ss->inCheck][true][pos.moved_piece(move)][move.to_sq()];
+                  &this->continuationHistory[ss->inCheck][true]
+                                            [cont_hist_piece(pos.moved_piece(move))][move.to_sq()];
 
                 thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
-                pos.do_move(move, st);
+                do_move(pos, move, st);
 
                 // Perform a preliminary qsearch to verify that the move holds
                 value = -qsearch<NonPV>(pos, ss + 1, -probCutBeta, -probCutBeta + 1);
@@ -783,7 +1094,7 @@ Value Search::Worker::search(
                     value = -search<NonPV>(pos, ss + 1, -probCutBeta, -probCutBeta + 1, depth - 4,
                                            !cutNode);
 
-                pos.undo_move(move);
+                undo_move(pos, move);
 
                 if (value >= probCutBeta)
                 {
@@ -795,7 +1106,7 @@ Value Search::Worker::search(
                 }
             }
 
-        Eval::NNUE::hint_common_parent_position(pos, network[numaAccessToken], refreshTable);
+        hint_common_parent_position(pos);
     }
 
 moves_loop:  // When in check, search starts here
@@ -820,14 +1131,38 @@ moves_loop:  // When in check, search starts here
     MovePicker mp(pos, ttData.move, depth, &thisThread->mainHistory, &thisThread->captureHistory,
                   contHist, &thisThread->pawnHistory, countermove, ss->killers);
 
+    if (thisThread->prefetchAhead)
+        mp.prefetch_ahead(tt, thisThread->prefetchAhead);
+
     value            = bestValue;
     moveCountPruning = false;
     singularValue    = VALUE_INFINITE;
     singularBound    = BOUND_NONE;
 
+    // With ABDADA the moves leading to nodes searched by other threads are
+    // deferred until the move picker is exhausted, and then searched in turn.
+    const bool deferBusy = thisThread->abdada && !rootNode && depth >= BusyMinDepth;
+    BusyGuard  busyGuard(thisThread->threads.busyNodes, posKey, deferBusy && !excludedMove);
+    Move       deferred[MaxDeferred];
+    int        deferredCount = 0, deferredIdx = 0;
+    bool       picking       = true;
+
+    auto next_move = [&]() {
+        if (picking && (move = mp.next_move(moveCountPruning)) != Move::none())
+            return move;
+        picking = false;
+        return move = deferredIdx < deferredCount ? deferred[deferredIdx++] : Move::none();
+    };
+
+    // With shared MultiPV lines, the root moves are ranked on the scores of this
+    // search only
+    if (rootNode && thisThread->sharedLines > 1)
+        for (RootMove& rm : thisThread->rootMoves)
+            rm.score = -VALUE_INFINITE;
+
     // Step 12. Loop through all pseudo-legal moves until no moves remain
     // or a beta cutoff occurs.
-    while ((move = mp.next_move(moveCountPruning)) != Move::none())
+    while (next_move() != Move::none())
     {
         assert(move.is_ok());
 
@@ -845,9 +1180,17 @@ moves_loop:  // When in check, search starts here
                            thisThread->rootMoves.begin() + thisThread->pvLast, move))
             continue;
 
+        // Defer the move if another thread is searching the node it leads to
+        if (deferBusy && picking && moveCount && deferredCount < MaxDeferred
+            && thisThread->threads.busyNodes.busy(pos.key_after(move)))
+        {
+            deferred[deferredCount++] = move;
+            continue;
+        }
+
         ss->moveCount = ++moveCount;
 
-        if (rootNode && is_mainthread() && elapsed_time() > 3000)
+        if (rootNode && is_mainthread() && elapsed_time() > 3000 && !main_manager()->background)
         {
             main_manager()->updates.onIter(
               {depth, UCIEngine::move(move), moveCount + thisThread->pvIdx});
@@ -1016,14 +1359,15 @@ moves_loop:  // When in check, search starts here
 
         // Update the current move (this must be done after singular extension search)
         ss->currentMove = move;
-        ss->continuationHistory =
-          &thisThread->continuationHistory[ss->inCheck][capture][movedPiece][move.to_sq()];
+        ss->continuationHistory = &thisThread->continuationHistory[ss->inCheck][capture]
+                                                                  [cont_hist_piece(movedPiece)]
+                                                                  [move.to_sq()];
 
         uint64_t nodeCount = rootNode ? uint64_t(nodes) : 0;
 
         // Step 15. Make the move
         thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
-        pos.do_move(move, st, givesCheck);
+        do_move(pos, move, st, givesCheck);
 
         // These reduction adjustments have proven non-linear scaling.
         // They are optimized to time controls of 180 + 1.8 and longer so
@@ -1122,7 +1466,7 @@ moves_loop:  // When in check, search starts here
         }
 
         // Step 18. Undo move
-        pos.undo_move(move);
+        undo_move(pos, move);
 
         assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
@@ -1130,7 +1474,7 @@ moves_loop:  // When in check, search starts here
         // Finished searching the move. If a stop occurred, the return value of
         // the search cannot be trusted, and we return immediately without
         // updating best move, PV and TT.
-        if (threads.stop.load(std::memory_order_relaxed))
+        if (stopped())
             return VALUE_ZERO;
 
         if (rootNode)
@@ -1171,7 +1515,7 @@ moves_loop:  // When in check, search starts here
                 // We record how often the best move has been changed in each iteration.
                 // This information is used for time management. In MultiPV mode,
                 // we must take care to only do this for the first PV line.
-                if (moveCount > 1 && !thisThread->pvIdx)
+                if (moveCount > 1 && !thisThread->pvIdx && value > bestValue)
                     ++thisThread->bestMoveChanges;
             }
             else
@@ -1201,10 +1545,11 @@ moves_loop:  // When in check, search starts here
                 if (value >= beta)
                 {
                     ss->cutoffCnt += 1 + !ttData.move - (extension >= 2);
+                    ++stats.cutoffs[std::min(moveCount, SearchStats::CutoffSlots) - 1];
                     assert(value >= beta);  // Fail high
                     break;
                 }
-                else
+                else if (!rootNode || thisThread->sharedLines == 1)
                 {
                     // Reduce other moves if we have found at least one score improvement (~2 Elo)
                     if (depth > 2 && depth < 10 && std::abs(value) < VALUE_MATE_IN_MAX_PLY)
@@ -1216,6 +1561,10 @@ moves_loop:  // When in check, search starts here
             }
         }
 
+        // With shared MultiPV lines, a move only has to beat the last of them
+        if (rootNode && thisThread->sharedLines > 1)
+            alpha = std::max(alpha, kth_best_score(thisThread->rootMoves, thisThread->sharedLines));
+
         // If the move is worse than some previously searched move,
         // remember it, to update its stats later.
         if (move != bestMove && moveCount <= 32)
@@ -1275,11 +1624,22 @@ moves_loop:  // When in check, search starts here
     // Write gathered information in transposition table
     // Static evaluation is saved as it was before correction history
     if (!excludedMove && !(rootNode && thisThread->pvIdx))
-        ttWriter.write(posKey, value_to_tt(bestValue, ss->ply), ss->ttPv,
-                       bestValue >= beta    ? BOUND_LOWER
-                       : PvNode && bestMove ? BOUND_EXACT
-                                            : BOUND_UPPER,
-                       depth, bestMove, unadjustedStaticEval, tt.generation());
+    {
+        const Bound bound = bestValue >= beta    ? BOUND_LOWER
+                          : PvNode && bestMove ? BOUND_EXACT
+                                               : BOUND_UPPER;
+
+        ttWriter.write(posKey, value_to_tt(bestValue, ss->ply), ss->ttPv, bound, depth, bestMove,
+                       unadjustedStaticEval, tt.generation());
+
+        // In cluster mode, share the deep exact entries with the other hosts
+        if (bound == BOUND_EXACT && depth >= Distributed::ShareMinDepth
+            && thisThread->threads.clusterOutbox)
+            thisThread->threads.clusterOutbox->push(
+              {posKey, std::int16_t(value_to_tt(bestValue, ss->ply)),
+               std::int16_t(unadjustedStaticEval), bestMove.raw(), std::uint8_t(depth),
+               std::uint8_t(bound)});
+    }
 
     // Adjust correction history
     if (!ss->inCheck && (!bestMove || !pos.capture(bestMove))
@@ -1315,7 +1675,6 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
 
     Move      pv[MAX_PLY + 1];
     StateInfo st;
-    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
     Key   posKey;
     Move  move, bestMove;
@@ -1335,6 +1694,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     bestMove           = Move::none();
     ss->inCheck        = bool(pos.checkers());
     moveCount          = 0;
+    ++stats.qsearchNodes;
 
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && thisThread->selDepth < ss->ply + 1)
@@ -1362,9 +1722,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     }
 
     if (ss->ply >= MAX_PLY)
-        return !ss->inCheck
-               ? evaluate(network[numaAccessToken], pos, refreshTable, thisThread->optimism[us])
-               : VALUE_DRAW;
+        return !ss->inCheck ? evaluate(pos) : VALUE_DRAW;
 
     assert(0 <= ss->ply && ss->ply < MAX_PLY);
 
@@ -1382,6 +1740,8 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     ttData.value = ttHit ? value_from_tt(ttData.value, ss->ply, pos.rule60_count()) : VALUE_NONE;
     pvHit        = ttHit && ttData.is_pv;
 
+    stats.ttHits += ttHit;
+
     // At non-PV nodes we check for an early TT cutoff
     if (!PvNode && ttData.depth >= qsTtDepth
         && ttData.value != VALUE_NONE  // Can happen when !ttHit or when access race in probe()
@@ -1399,8 +1759,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
             // Never assume anything about values stored in TT
             unadjustedStaticEval = ttData.eval;
             if (unadjustedStaticEval == VALUE_NONE)
-                unadjustedStaticEval =
-                  evaluate(network[numaAccessToken], pos, refreshTable, thisThread->optimism[us]);
+                unadjustedStaticEval = evaluate(pos);
             ss->staticEval = bestValue =
               to_corrected_static_eval(unadjustedStaticEval, *thisThread, pos);
 
@@ -1413,9 +1772,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
         {
             // In case of null move search, use previous static eval with a different sign
             unadjustedStaticEval =
-              (ss - 1)->currentMove != Move::null()
-                ? evaluate(network[numaAccessToken], pos, refreshTable, thisThread->optimism[us])
-                : -(ss - 1)->staticEval;
+              (ss - 1)->currentMove != Move::null() ? evaluate(pos) : -(ss - 1)->staticEval;
             ss->staticEval = bestValue =
               to_corrected_static_eval(unadjustedStaticEval, *thisThread, pos);
         }
@@ -1450,6 +1807,9 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
     MovePicker mp(pos, ttData.move, depth, &thisThread->mainHistory, &thisThread->captureHistory,
                   contHist, &thisThread->pawnHistory);
 
+    if (thisThread->prefetchAhead)
+        mp.prefetch_ahead(tt, thisThread->prefetchAhead);
+
     // Step 5. Loop through all pseudo-legal moves until no moves remain or a beta cutoff occurs.
     while ((move = mp.next_move()) != Move::none())
     {
@@ -1521,13 +1881,14 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta,
         ss->currentMove = move;
         ss->continuationHistory =
           &thisThread
-             ->continuationHistory[ss->inCheck][capture][pos.moved_piece(move)][move.to_sq()];
+             ->continuationHistory[ss->inCheck][capture][cont_hist_piece(pos.moved_piece(move))]
+                                  [move.to_sq()];
 
         // Step 7. Make and search the move
         thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
-        pos.do_move(move, st, givesCheck);
+        do_move(pos, move, st, givesCheck);
         value = -qsearch<nodeType>(pos, ss + 1, -beta, -alpha, depth - 1);
-        pos.undo_move(move);
+        undo_move(pos, move);
 
         assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
@@ -1781,8 +2142,12 @@ void SearchManager::check_time(Search::Worker& worker) {
       worker.completedDepth >= 1
       && ((worker.limits.use_time_management() && (elapsed > tm.maximum() || stopOnPonderhit))
           || (worker.limits.movetime && elapsed >= worker.limits.movetime)
-          || (worker.limits.nodes && worker.threads.nodes_searched() >= worker.limits.nodes)))
+          || (worker.limits.nodes && !worker.nodeQuota
+              && worker.threads.nodes_searched() >= worker.limits.nodes)))
+    {
+        Trace::instant("stop: limit reached", "elapsed", elapsed);
         worker.threads.stop = worker.threads.abortedSearch = true;
+    }
 }
 
 void SearchManager::pv(const Search::Worker&     worker,
@@ -1790,6 +2155,9 @@ void SearchManager::pv(const Search::Worker&     worker,
                        const TranspositionTable& tt,
                        Depth                     depth) const {
 
+    if (background)
+        return;
+
     const auto  nodes     = threads.nodes_searched();
     const auto& rootMoves = worker.rootMoves;
     const auto& pos       = worker.rootPos;
@@ -1837,9 +2205,10 @@ void SearchManager::pv(const Search::Worker&     worker,
         info.timeMs   = time;
         info.nodes    = nodes;
         info.nps      = nodes * 1000 / time;
-        info.tbHits   = 0;
+        info.tbHits   = threads.tb_hits();
         info.pv       = pv;
         info.hashfull = tt.hashfull();
+        info.pvMoves  = &rootMoves[i].pv;
 
         updates.onUpdateFull(info);
     }
@@ -1852,7 +2221,6 @@ void SearchManager::pv(const Search::Worker&     worker,
 bool RootMove::extract_ponder_from_tt(const TranspositionTable& tt, Position& pos) {
 
     StateInfo st;
-    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
     assert(pv.size() == 1);
     if (pv[0] == Move::none())
@@ -1863,7 +2231,7 @@ bool RootMove::extract_ponder_from_tt(const TranspositionTable& tt, Position& po
     auto [ttHit, ttData, ttWriter] = tt.probe(pos.key());
     if (ttHit)
     {
-        if (MoveList<LEGAL>(pos).contains(ttData.move))
+        if (is_legal(pos, ttData.move))
             pv.push_back(ttData.move);
     }
 
@@ -30,14 +30,18 @@
 #include <string_view>
 #include <vector>
 
+#include "evaluate.h"
+#include "mate.h"
 #include "misc.h"
 #include "movepick.h"
 #include "nnue/network.h"
 #include "nnue/nnue_accumulator.h"
 #include "numa.h"
+#include "perf.h"
 #include "position.h"
 #include "score.h"
 #include "timeman.h"
+#include "tt.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -49,7 +53,6 @@ enum NodeType {
     Root
 };
 
-class TranspositionTable;
 class ThreadPool;
 class OptionsMap;
 
@@ -125,6 +128,68 @@ struct LimitsType {
 };
 
 
+// SearchStats holds the telemetry counters of one thread. They are reset at
+// the start of each search, only written by the thread owning them, and can be
+// read by any other thread while the search is running.
+struct alignas(64) SearchStats {
+    static constexpr int CutoffSlots = 8;
+
+    RelaxedCounter ttHits, qsearchNodes, evaluations;
+    RelaxedCounter cutoffs[CutoffSlots];  // Beta cutoffs by move number, last slot is the rest
+
+    void clear() {
+        ttHits.reset();
+        qsearchNodes.reset();
+        evaluations.reset();
+        for (auto& c : cutoffs)
+            c.reset();
+    }
+};
+
+
+// A copy of the counters of one thread, see ThreadPool::search_stats()
+struct StatsSnapshot {
+    uint64_t nodes, ttHits, qsearchNodes, evaluations, evalCacheHits, nnueRefreshes, nnueUpdates,
+      nnueRefreshFeatures;
+    uint64_t cutoffs[SearchStats::CutoffSlots];
+};
+
+
+// Nodes being searched by some thread, for the ABDADA scheme: a thread defers
+// the moves leading to a busy node until it has searched its other moves, so
+// that the threads spread over different subtrees. Entries are lossy, a node
+// may look busy because of another one with the same slot, which only costs
+// move ordering.
+class BusyTable {
+   public:
+    static constexpr size_t Size = 1 << 15;
+
+    BusyTable() {
+        for (auto& e : entries)
+            e.store(0, std::memory_order_relaxed);
+    }
+
+    bool busy(Key key) const {
+        return entries[index(key)].load(std::memory_order_relaxed) == tag(key);
+    }
+
+    // Returns whether the node was marked, which fails if its slot is taken
+    bool mark(Key key) {
+        uint32_t expected = 0;
+        return entries[index(key)].compare_exchange_strong(expected, tag(key),
+                                                           std::memory_order_relaxed);
+    }
+
+    void unmark(Key key) { entries[index(key)].store(0, std::memory_order_relaxed); }
+
+   private:
+    static size_t   index(Key key) { return size_t(key) & (Size - 1); }
+    static uint32_t tag(Key key) { return uint32_t(key >> 32) | 1; }
+
+    std::array<std::atomic<uint32_t>, Size> entries;
+};
+
+
 // The UCI stores the uci options, thread pool, and transposition table.
 // This struct is used to easily forward data to the Search::Worker class.
 struct SharedState {
@@ -169,6 +234,8 @@ struct InfoFull: InfoShort {
     size_t           tbHits;
     std::string_view pv;
     int              hashfull;
+
+    const std::vector<Move>* pvMoves;  // The same pv, for the binary protocol
 };
 
 struct InfoIteration {
@@ -185,12 +252,16 @@ class SearchManager: public ISearchManager {
     using UpdateFull     = std::function<void(const InfoFull&)>;
     using UpdateIter     = std::function<void(const InfoIteration&)>;
     using UpdateBestmove = std::function<void(std::string_view, std::string_view)>;
+    using UpdateResult   = std::function<void(const Position&, const RootMove&, Depth)>;
+    using UpdateString   = std::function<void(const std::string&)>;
 
     struct UpdateContext {
         UpdateShort    onUpdateNoMoves;
         UpdateFull     onUpdateFull;
         UpdateIter     onIter;
         UpdateBestmove onBestmove;
+        UpdateResult   onResult;      // Optional, the best root move of searches of all moves
+        UpdateString   onInfoString;  // Optional, like the hardware events of the search
     };
 
 
@@ -214,6 +285,7 @@ class SearchManager: public ISearchManager {
     Value                bestPreviousScore;
     Value                bestPreviousAverageScore;
     bool                 stopOnPonderhit;
+    bool                 background = false;  // No output, see ThreadPool::search_background()
 
     size_t id;
 
@@ -241,8 +313,19 @@ class Worker {
     // It searches from the root position and outputs the "bestmove".
     void start_searching();
 
+    // Label positions outside of a search, see Engine::label(). None of the
+    // positions given to evaluate_batch() may be in check.
+    std::vector<Value> evaluate_batch(const std::vector<const Position*>& positions);
+    Value              qsearch_root(Position& pos);  // Full window quiescence search
+
     bool is_mainthread() const { return threadIdx == 0; }
 
+    // Bytes taken by the history tables of each thread, see COMPACT_HISTORY
+    static constexpr size_t history_size() {
+        return sizeof(counterMoves) + sizeof(mainHistory) + sizeof(captureHistory)
+             + sizeof(continuationHistory) + sizeof(pawnHistory) + sizeof(correctionHistory);
+    }
+
     // Public because they need to be updatable by the stats
     CounterMoveHistory    counterMoves;
     ButterflyHistory      mainHistory;
@@ -254,6 +337,11 @@ class Worker {
    private:
     void iterative_deepening();
 
+    // Runs the mate solver for "go mate", returns false if it found no mate
+    bool solve_mate();
+
+    void report_perf_counts();
+
     // Main search function for both PV and non-PV nodes
     template<NodeType nodeType>
     Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cutNode);
@@ -262,6 +350,23 @@ class Worker {
     template<NodeType nodeType>
     Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth = 0);
 
+    // Make and unmake moves on the search line, keeping the accumulator stack in sync
+    void do_move(Position& pos, Move move, StateInfo& st);
+    void do_move(Position& pos, Move move, StateInfo& st, bool givesCheck);
+    void do_null_move(Position& pos, StateInfo& st);
+    void undo_move(Position& pos, Move move);
+    void undo_null_move(Position& pos);
+
+    Value evaluate(const Position& pos);
+    void  hint_common_parent_position(const Position& pos);
+
+    // With a node quota, the thread stops on its own instead of waiting for threads.stop
+    bool quota_exhausted() const {
+        return nodeQuota && nodes.load(std::memory_order_relaxed) >= nodeQuota;
+    }
+    bool stopped() const;
+    bool deterministic() const { return ownTT && (limits.nodes || limits.depth); }
+
     Depth reduction(bool i, Depth d, int mn, int delta) const;
 
     // Get a pointer to the search manager, only allowed to be called by the
@@ -276,14 +381,23 @@ class Worker {
 
     LimitsType limits;
 
-    size_t                pvIdx, pvLast;
-    std::atomic<uint64_t> nodes, bestMoveChanges;
-    int                   selDepth, nmpMinPly;
+    size_t                pvIdx, pvLast, sharedLines = 1;
+    std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
+    uint64_t              nodeQuota;
+    int                   selDepth, nmpMinPly, tbCardinality, prefetchAhead;
+    bool                  abdada;
+    SearchStats           stats;
+    Perf::Snapshot        perfCounts;  // Of the last search of the thread
 
     Value optimism[COLOR_NB];
 
     Position  rootPos;
     StateInfo rootState;
+
+    // The keys of the positions before the root which the repetition and chase
+    // rules can see, most recent first. Kept for ResumeAnalysis, as the states
+    // of the root are freed with its game.
+    std::vector<Key> rootHistory;
     RootMoves rootMoves;
     Depth     rootDepth, completedDepth;
     Value     rootDelta;
@@ -297,13 +411,24 @@ class Worker {
     // The main thread has a SearchManager, the others have a NullSearchManager
     std::unique_ptr<ISearchManager> manager;
 
+    // In deterministic mode the thread writes to its own table, attached to the
+    // shared one, and the writes of all threads are merged at the end of each
+    // iteration, see ThreadPool::end_tt_epoch().
+    std::unique_ptr<TranspositionTable> ownTT;
+
+    // Only allocated by the first "go mate" with the MateSolver option
+    Mate::Solver mateSolver;
+
     const OptionsMap&                          options;
     ThreadPool&                                threads;
     TranspositionTable&                        tt;
     const NumaReplicated<Eval::NNUE::Network>& network;
 
     // Used by NNUE
+    Eval::NNUE::AccumulatorStack  accumulators;
     Eval::NNUE::AccumulatorCaches refreshTable;
+    Eval::EvalCache               evalCache;
+    std::uint64_t                 networkVersion = 0;  // Of the network the two above are for
 
     friend class Stockfish::ThreadPool;
     friend class SearchManager;
@@ -0,0 +1,526 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tablebase.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bitboard.h"
+#include "memory.h"
+#include "movegen.h"
+#include "position.h"
+
+namespace Stockfish::Tablebases {
+
+int MaxCardinality;
+
+namespace {
+
+#ifndef _WIN32
+constexpr char SepChar = ':';
+#else
+constexpr char SepChar = ';';
+#endif
+
+constexpr std::uint32_t Magic      = 0x42544B50;  // "PKTB"
+constexpr size_t        HeaderSize = 8;           // Magic and number of positions
+
+constexpr PieceType NonKings[]               = {ROOK, ADVISOR, CANNON, PAWN, KNIGHT, BISHOP};
+constexpr int       MaxCount[PIECE_TYPE_NB]  = {0, 2, 2, 2, 5, 2, 2, 1};
+constexpr char      PieceChar[PIECE_TYPE_NB] = {' ', 'R', 'A', 'C', 'P', 'N', 'B', 'K'};
+
+// The squares a piece can stand on in ascending order, and the reverse map
+int    SquareCount[COLOR_NB][PIECE_TYPE_NB];
+Square Squares[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
+int    SquareIndex[COLOR_NB][PIECE_TYPE_NB][SQUARE_NB];
+
+void init_squares() {
+
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt : {ROOK, ADVISOR, CANNON, PAWN, KNIGHT, BISHOP, KING})
+        {
+            SquareCount[c][pt] = 0;
+            for (Square s = SQ_A0; s <= SQ_I9; ++s)
+                if (can_stand(c, pt, s))
+                {
+                    SquareIndex[c][pt][s]                = SquareCount[c][pt];
+                    Squares[c][pt][SquareCount[c][pt]++] = s;
+                }
+                else
+                    SquareIndex[c][pt][s] = -1;
+        }
+}
+
+// The pieces of each side by type, always with one king
+struct Material {
+    int count[COLOR_NB][PIECE_TYPE_NB] = {};
+
+    std::uint64_t key(bool flip = false) const {
+        std::uint64_t k = 0;
+        for (Color c : {WHITE, BLACK})
+            for (PieceType pt : NonKings)
+                k |= std::uint64_t(count[flip ? ~c : c][pt]) << (24 * c + 3 * pt);
+        return k;
+    }
+
+    int pieces() const {
+        int n = 0;
+        for (Color c : {WHITE, BLACK})
+            for (PieceType pt : NonKings)
+                n += count[c][pt];
+        return n + 2;
+    }
+
+    std::string name() const {
+        std::string s;
+        for (Color c : {WHITE, BLACK})
+        {
+            s += c == WHITE ? "K" : "vK";
+            for (PieceType pt : NonKings)
+                s += std::string(count[c][pt], PieceChar[pt]);
+        }
+        return s;
+    }
+};
+
+bool parse_material(const std::string& name, Material& m) {
+
+    const size_t v = name.find('v');
+
+    if (v == std::string::npos)
+        return false;
+
+    for (Color c : {WHITE, BLACK})
+    {
+        const std::string side = c == WHITE ? name.substr(0, v) : name.substr(v + 1);
+
+        for (char ch : side)
+        {
+            const auto pt = std::find(PieceChar + 1, PieceChar + PIECE_TYPE_NB, ch) - PieceChar;
+            if (pt == PIECE_TYPE_NB || ++m.count[c][pt] > MaxCount[pt])
+                return false;
+        }
+
+        if (m.count[c][KING] != 1)
+            return false;
+    }
+
+    return m.pieces() <= MaxPieces;
+}
+
+Material material_of(const Position& pos) {
+
+    Material m;
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt : NonKings)
+            m.count[c][pt] = popcount(pos.pieces(c, pt));
+    return m;
+}
+
+// A position is indexed by the squares of its pieces, white king first then
+// the other white pieces by type, then the same for black, and by the side to
+// move. Pieces of the same kind are taken in ascending order of squares.
+struct Table {
+    explicit Table(const Material& m) :
+        material(m) {
+
+        size = COLOR_NB;
+        for (Color c : {WHITE, BLACK})
+            for (PieceType pt : {KING, ROOK, ADVISOR, CANNON, PAWN, KNIGHT, BISHOP})
+                for (int i = 0; i < m.count[c][pt]; ++i)
+                {
+                    slots.emplace_back(c, pt);
+                    size *= SquareCount[c][pt];
+                }
+    }
+
+    Table(const Table&)            = delete;
+    Table& operator=(const Table&) = delete;
+    ~Table() { unmap_file(mapping, mappingSize); }
+
+    // With flip, the position is seen with colors swapped and ranks mirrored,
+    // for a table of the opposite material.
+    bool index(const Position& pos, bool flip, size_t& idx) const {
+
+        idx = flip ? ~pos.side_to_move() : pos.side_to_move();
+
+        for (size_t i = 0; i < slots.size();)
+        {
+            const auto [c, pt] = slots[i];
+            Square   sq[MaxPieces];
+            int      n = 0;
+            Bitboard b = pos.pieces(flip ? ~c : c, pt);
+
+            while (b)
+            {
+                Square s = pop_lsb(b);
+                sq[n++]  = flip ? flip_rank(s) : s;
+            }
+            std::sort(sq, sq + n);
+
+            for (int k = 0; k < n; ++k)
+            {
+                if (SquareIndex[c][pt][sq[k]] < 0)
+                    return false;
+                idx = idx * SquareCount[c][pt] + SquareIndex[c][pt][sq[k]];
+            }
+            i += n;
+        }
+        return true;
+    }
+
+    // The inverse of index(), returns the side to move
+    Color decode(size_t idx, Square sq[]) const {
+
+        for (size_t i = slots.size(); i-- > 0;)
+        {
+            const auto [c, pt] = slots[i];
+            sq[i]              = Squares[c][pt][idx % SquareCount[c][pt]];
+            idx /= SquareCount[c][pt];
+        }
+        return Color(idx);
+    }
+
+    Material                                 material;
+    std::vector<std::pair<Color, PieceType>> slots;
+    size_t                                   size;
+
+    const std::uint8_t*       data = nullptr;  // 0 if not a mate, else 1 + plies to mate
+    std::vector<std::uint8_t> generated;
+    void*                     mapping     = nullptr;
+    size_t                    mappingSize = 0;
+};
+
+std::unordered_map<std::uint64_t, std::unique_ptr<Table>> Tables;
+
+void add(std::unique_ptr<Table>&& t) {
+
+    MaxCardinality = std::max(MaxCardinality, t->material.pieces());
+    Tables[t->material.key()] = std::move(t);
+}
+
+const Table* find(const Material& m, bool& flip) {
+
+    for (bool f : {false, true})
+        if (auto it = Tables.find(m.key(f)); it != Tables.end())
+        {
+            flip = f;
+            return it->second.get();
+        }
+    return nullptr;
+}
+
+// The stored byte of the position, -1 if there is no table
+int probe_byte(const Position& pos) {
+
+    bool         flip;
+    size_t       idx;
+    const Table* t = find(material_of(pos), flip);
+
+    return t && t->index(pos, flip, idx) ? t->data[idx] : -1;
+}
+
+std::string path_of(const std::string& dir, const Material& m) {
+    return (dir.empty() ? "" : dir + "/") + m.name() + ".ptb";
+}
+
+bool load(const std::string& dir, const Material& m) {
+
+    bool flip;
+    if (find(m, flip) && !flip)
+        return false;
+
+    size_t size = 0;
+    void*  mem  = map_file(path_of(dir, m), size);
+
+    if (!mem)
+        return false;
+
+    auto          t = std::make_unique<Table>(m);
+    std::uint32_t header[2];
+    std::memcpy(header, mem, std::min(size, sizeof(header)));
+
+    if (size != HeaderSize + t->size || header[0] != Magic || header[1] != t->size)
+    {
+        unmap_file(mem, size);
+        return false;
+    }
+
+    t->mapping     = mem;
+    t->mappingSize = size;
+    t->data        = static_cast<std::uint8_t*>(mem) + HeaderSize;
+    add(std::move(t));
+    return true;
+}
+
+// Calls f for each material of up to MaxPieces pieces
+template<typename F>
+void for_each_material(Material& m, int first, int left, const F& f) {
+
+    f(m);
+
+    for (int k = first; left && k < 2 * 6; ++k)
+    {
+        const Color     c  = Color(k / 6);
+        const PieceType pt = NonKings[k % 6];
+
+        if (m.count[c][pt] < MaxCount[pt])
+        {
+            ++m.count[c][pt];
+            for_each_material(m, k, left - 1, f);
+            --m.count[c][pt];
+        }
+    }
+}
+
+// Retrograde analysis by passes: positions without legal moves are lost, then
+// pass k finds the positions which are mated in exactly k plies, wins when k is
+// odd and losses when it is even. Captures lead to smaller tables, whose values
+// are known from the start.
+bool generate(const std::string& dir, const Material& m, std::ostringstream& report) {
+
+    bool flip;
+    if (find(m, flip))
+        return true;
+
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt : NonKings)
+            if (m.count[c][pt])
+            {
+                Material sub = m;
+                --sub.count[c][pt];
+                if (!generate(dir, sub, report))
+                    return false;
+            }
+
+    constexpr std::int16_t Unknown = -1, Invalid = -2, None = -1;
+
+    auto         t    = std::make_unique<Table>(m);
+    const size_t size = t->size;
+
+    std::vector<std::int16_t>  dist(size, Unknown);
+    std::vector<std::uint32_t> first(size + 1), children;
+
+    // The capture children: the shortest loss, the longest win, any other
+    constexpr std::int16_t    NoLoss = std::numeric_limits<std::int16_t>::max();
+    std::vector<std::int16_t> captureLoss(size, NoLoss);
+    std::vector<std::int16_t> captureWin(size, None);
+    std::vector<bool>         captureDraw(size);
+    int                       longestCapture = None;
+
+    for (size_t idx = 0; idx < size; ++idx)
+    {
+        first[idx] = std::uint32_t(children.size());
+
+        Square sq[MaxPieces];
+        Color  stm = t->decode(idx, sq);
+        Piece  board[SQUARE_NB];
+        bool   valid = true;
+
+        std::fill(board, board + SQUARE_NB, NO_PIECE);
+
+        for (size_t i = 0; i < t->slots.size(); ++i)
+        {
+            // Pieces of the same kind must be in ascending order, see Table
+            valid &= board[sq[i]] == NO_PIECE
+                  && (!i || t->slots[i - 1] != t->slots[i] || sq[i - 1] < sq[i]);
+            board[sq[i]] = make_piece(t->slots[i].first, t->slots[i].second);
+        }
+
+        StateInfo st;
+        Position  pos;
+
+        if (valid)
+            pos.set(board, stm, 0, 0, &st);
+
+        // The side to move can't be able to capture the king
+        if (!valid || pos.checkers_to(stm, pos.king_square(~stm)))
+        {
+            dist[idx] = Invalid;
+            continue;
+        }
+
+        for (const auto& move : MoveList<LEGAL>(pos))
+        {
+            StateInfo  st2;
+            const bool capture = pos.capture(move);
+
+            pos.do_move(move, st2);
+
+            if (capture)
+            {
+                const int d = probe_byte(pos) - 1;
+
+                if (d < 0)
+                    captureDraw[idx] = true;
+                else if (d % 2)
+                    captureWin[idx] = std::max(captureWin[idx], std::int16_t(d));
+                else
+                    captureLoss[idx] = std::min(captureLoss[idx], std::int16_t(d));
+
+                longestCapture = std::max(longestCapture, d);
+            }
+            else
+            {
+                size_t child;
+                t->index(pos, false, child);
+                children.push_back(std::uint32_t(child));
+            }
+
+            pos.undo_move(move);
+        }
+    }
+    first[size] = std::uint32_t(children.size());
+
+    size_t wins = 0, losses = 0;
+    int    longest = 0;
+
+    for (int k = 0; k < 255; ++k)
+    {
+        size_t found = 0;
+
+        for (size_t idx = 0; idx < size; ++idx)
+        {
+            if (dist[idx] != Unknown)
+                continue;
+
+            bool resolved;
+
+            if (k % 2)
+            {
+                resolved = captureLoss[idx] == k - 1;
+                for (auto c = first[idx]; !resolved && c < first[idx + 1]; ++c)
+                    resolved = dist[children[c]] == k - 1;
+            }
+            else
+            {
+                int longestWin = captureWin[idx];
+
+                resolved = !captureDraw[idx] && captureLoss[idx] == NoLoss;
+                for (auto c = first[idx]; resolved && c < first[idx + 1]; ++c)
+                {
+                    const int d = dist[children[c]];
+                    resolved    = d >= 0 && d % 2 && d < k;
+                    longestWin  = std::max(longestWin, d);
+                }
+                resolved &= longestWin == k - 1;
+            }
+
+            if (resolved)
+            {
+                dist[idx] = std::int16_t(k);
+                ++found;
+            }
+        }
+
+        (k % 2 ? wins : losses) += found;
+        longest = found ? k : longest;
+
+        if (!found && k > longestCapture + 1)
+            break;
+    }
+
+    t->generated.resize(size);
+    for (size_t idx = 0; idx < size; ++idx)
+        t->generated[idx] = std::uint8_t(dist[idx] >= 0 ? dist[idx] + 1 : 0);
+    t->data = t->generated.data();
+
+    const std::string   file = path_of(dir, m);
+    std::ofstream       ofs(file, std::ios::binary);
+    const std::uint32_t header[2] = {Magic, std::uint32_t(size)};
+
+    ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(t->data), std::streamsize(size));
+
+    report << m.name() << ": " << wins << " wins and " << losses << " losses in " << size
+           << " positions, longest mate " << longest << " plies";
+
+    if (!ofs)
+    {
+        report << ", failed to write " << file << "\n";
+        return false;
+    }
+
+    report << ", written to " << file << "\n";
+    add(std::move(t));
+    return true;
+}
+
+}  // namespace
+
+size_t init(const std::string& paths) {
+
+    init_squares();
+    Tables.clear();
+    MaxCardinality = 0;
+
+    std::istringstream ss(paths);
+    std::string        dir;
+    size_t             found = 0;
+
+    while (std::getline(ss, dir, SepChar))
+    {
+        Material m;
+        m.count[WHITE][KING] = m.count[BLACK][KING] = 1;
+
+        for_each_material(m, 0, MaxPieces - 2,
+                          [&](const Material& mat) { found += load(dir, mat); });
+    }
+
+    return found;
+}
+
+Value probe(const Position& pos, int ply) {
+
+    const int plies = probe_byte(pos) - 1;
+
+    if (plies < 0 || ply + plies >= MAX_PLY || pos.rule60_count() + plies >= 120)
+        return VALUE_NONE;
+
+    return plies % 2 ? mate_in(ply + plies) : mated_in(ply + plies);
+}
+
+std::string generate(const std::string& paths, const std::string& material) {
+
+    Material m;
+
+    if (!parse_material(material, m))
+        return "Invalid material " + material + ", the format is like KRvKA, with at most "
+             + std::to_string(MaxPieces) + " pieces";
+
+    std::istringstream ss(paths);
+    std::string        dir;
+    std::getline(ss, dir, SepChar);
+
+    std::ostringstream report;
+    generate(dir, m, report);
+
+    std::string s = report.str();
+    return s.empty() ? "Table " + m.name() + " is already available" : s;
+}
+
+}  // namespace Stockfish::Tablebases
@@ -0,0 +1,61 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TABLEBASE_H_INCLUDED
+#define TABLEBASE_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+#include "types.h"
+
+namespace Stockfish {
+class Position;
+}
+
+namespace Stockfish::Tablebases {
+
+// Distance to mate tables for endings of up to MaxPieces pieces, kings included.
+// A table is named after its material, like KRvKA, and stored in a file of the
+// same name with the .ptb extension: an 8-byte header then one byte per
+// position, mapped in memory as is so that a probe is a single read.
+//
+// The tables know nothing about the repetition rules, like the ban on perpetual
+// check, so drawn positions are not stored and only forced mates are reported.
+// A mate never needs a repetition, so these are exact.
+constexpr int MaxPieces = 4;
+
+extern int MaxCardinality;  // Pieces of the largest table available, 0 if none
+
+// Loads the tables found in the directories of the path, separated by ':' or
+// ';' on Windows, and returns how many there are. Not thread safe, there must
+// be no search running.
+size_t init(const std::string& paths);
+
+// The mate score of the position from the point of view of the side to move,
+// VALUE_NONE if there is no table, if it is not a forced mate or if the mate
+// would not fit in the remaining moves of the 60 moves rule.
+Value probe(const Position& pos, int ply);
+
+// Generates the table of the material, and first the missing ones it converts
+// to by captures, in the first directory of the path. Returns a report.
+std::string generate(const std::string& paths, const std::string& material);
+
+}  // namespace Stockfish::Tablebases
+
+#endif  // #ifndef TABLEBASE_H_INCLUDED
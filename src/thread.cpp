@@ -20,21 +20,93 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
-
+#include <vector>
+
+#if defined(_WIN32)
+    #if !defined(NOMINMAX)
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined(__linux__) && !defined(__ANDROID__)
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include "misc.h"
 #include "movegen.h"
 #include "search.h"
+#include "tablebase.h"
 #include "timeman.h"
+#include "trace.h"
 #include "types.h"
 #include "uci.h"
 #include "ucioption.h"
 
 namespace Stockfish {
 
+namespace {
+
+// Lowers the scheduling priority of the calling thread for the background
+// search, or restores it. Linux keeps a nice value per thread, but without
+// privileges lowering it back is only allowed as far as RLIMIT_NICE goes, so
+// there the priority is left alone when it could not be restored.
+void set_low_priority(bool low) {
+#if defined(_WIN32)
+    SetThreadPriority(GetCurrentThread(), low ? THREAD_PRIORITY_IDLE : THREAD_PRIORITY_NORMAL);
+#elif defined(__linux__) && !defined(__ANDROID__)
+    thread_local int  normalNice = 0;
+    thread_local bool lowered    = false;
+
+    const id_t tid = id_t(syscall(SYS_gettid));
+
+    if (!low)
+    {
+        if (lowered)
+            setpriority(PRIO_PROCESS, tid, normalNice);
+
+        lowered = false;
+        return;
+    }
+
+    errno          = 0;
+    const int nice = getpriority(PRIO_PROCESS, tid);
+    rlimit    limit;
+
+    if (lowered || errno || getrlimit(RLIMIT_NICE, &limit))
+        return;
+
+    if (geteuid() != 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < rlim_t(20 - nice))
+        return;
+
+    normalNice = nice;
+    lowered    = setpriority(PRIO_PROCESS, tid, 19) == 0;
+#else
+    (void) low;
+#endif
+}
+
+// See Search::Worker::rootHistory
+std::vector<Key> history_of(const Position& pos) {
+
+    std::vector<Key> keys;
+    const StateInfo* st = pos.state();
+
+    for (int i = 0; i < pos.repetition_window() && st->previous; ++i)
+        keys.push_back((st = st->previous)->key);
+
+    return keys;
+}
+
+}  // namespace
+
 // Constructor launches the thread and waits until it goes to sleep
 // in idle_loop(). Note that 'searching' and 'exit' should be already set.
 Thread::Thread(Search::SharedState&                    sharedState,
@@ -52,8 +124,8 @@ Thread::Thread(Search::SharedState&                    sharedState,
         // the Worker allocation.
         // Ideally we would also allocate the SearchManager here, but that's minor.
         this->numaAccessToken = binder();
-        this->worker =
-          std::make_unique<Search::Worker>(sharedState, std::move(sm), n, this->numaAccessToken);
+        this->worker = make_unique_large_page<Search::Worker>(sharedState, std::move(sm), n,
+                                                              this->numaAccessToken);
     });
 
     wait_for_search_finished();
@@ -78,12 +150,6 @@ void Thread::start_searching() {
     run_custom_job([this]() { worker->start_searching(); });
 }
 
-// Wakes up the thread that will start the search
-void Thread::clear_worker() {
-    assert(worker != nullptr);
-    run_custom_job([this]() { worker->clear(); });
-}
-
 // Blocks on the condition variable
 // until the thread has finished searching.
 void Thread::wait_for_search_finished() {
@@ -92,6 +158,12 @@ void Thread::wait_for_search_finished() {
     cv.wait(lk, [&] { return !searching; });
 }
 
+bool Thread::is_searching() {
+
+    std::unique_lock<std::mutex> lk(mutex);
+    return searching;
+}
+
 void Thread::run_custom_job(std::function<void()> f) {
     {
         std::unique_lock<std::mutex> lk(mutex);
@@ -105,12 +177,18 @@ void Thread::run_custom_job(std::function<void()> f) {
 // Thread gets parked here, blocked on the
 // condition variable, when it has no work to do.
 void Thread::idle_loop() {
+
+    Trace::name_thread("search thread " + std::to_string(idx));
+
     while (true)
     {
         std::unique_lock<std::mutex> lk(mutex);
         searching = false;
         cv.notify_one();  // Wake up anyone waiting for search finished
+
+        Trace::begin("idle");
         cv.wait(lk, [&] { return searching; });
+        Trace::end("idle");
 
         if (exit)
             return;
@@ -128,85 +206,218 @@ void Thread::idle_loop() {
 Search::SearchManager* ThreadPool::main_manager() { return main_thread()->worker->main_manager(); }
 
 uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
+uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+
+// Takes a copy of the telemetry counters of every thread. The threads are
+// not stopped, so while searching the copy is only approximately consistent.
+std::vector<Search::StatsSnapshot> ThreadPool::search_stats() const {
+
+    std::vector<Search::StatsSnapshot> result;
+
+    for (auto&& th : threads)
+    {
+        const Search::Worker& w = *th->worker;
+        Search::StatsSnapshot s{w.nodes.load(std::memory_order_relaxed),
+                                w.stats.ttHits.load(),
+                                w.stats.qsearchNodes.load(),
+                                w.stats.evaluations.load(),
+                                w.evalCache.hits.load(),
+                                w.accumulators.refreshes.load(),
+                                w.accumulators.updates.load(),
+                                w.accumulators.refreshFeatures.load(),
+                                {}};
+
+        for (int i = 0; i < Search::SearchStats::CutoffSlots; ++i)
+            s.cutoffs[i] = w.stats.cutoffs[i].load();
+
+        result.push_back(s);
+    }
+
+    return result;
+}
+
+// Ends an iteration of a deterministic search for the calling thread, or with
+// leave its whole search. Once every thread still searching has arrived, the
+// last one merges the pending TT writes of all threads, always in the same
+// order, and only then the others go on with their next iteration. As the
+// shared table does not change during an iteration, what a thread reads from
+// it does not depend on the speed of the others. The main thread keeps
+// checking the time limits while it waits, so that they stop the others.
+void ThreadPool::end_tt_epoch(Search::Worker& worker, bool leave) {
+
+    std::unique_lock<std::mutex> lk(epochMutex);
+
+    const uint64_t current = epoch;
+
+    if (leave)
+        --epochThreads;
+    else
+        ++epochArrived;
+
+    if (epochArrived == epochThreads)
+    {
+        for (auto&& th : threads)
+            if (th->worker->ownTT)
+                th->worker->ownTT->flush();
+
+        epochArrived = 0;
+        ++epoch;
+        lk.unlock();
+        epochCv.notify_all();
+    }
+    else if (!leave)
+    {
+        Trace::Scope scope("wait for epoch");
+
+        while (!epochCv.wait_for(lk, std::chrono::milliseconds(1),
+                                 [&] { return epoch != current; }))
+            if (worker.is_mainthread())
+            {
+                lk.unlock();
+                main_manager()->callsCnt = 0;
+                main_manager()->check_time(worker);
+                lk.lock();
+            }
+    }
+}
 
 // Creates/destroys threads to match the requested number.
 // Created and launched threads will immediately go to sleep in idle_loop.
 // Upon resizing, threads are recreated to allow for binding if necessary.
-void ThreadPool::set(const NumaConfig&                           numaConfig,
+// With keepWorkers the existing threads are kept instead, with their histories
+// and caches, as long as their binding doesn't change: only the threads beyond
+// the old count are created or destroyed. Returns whether they were kept.
+bool ThreadPool::set(const NumaConfig&                           numaConfig,
                      Search::SharedState                         sharedState,
-                     const Search::SearchManager::UpdateContext& updateContext) {
+                     const Search::SearchManager::UpdateContext& updateContext,
+                     bool                                        keepWorkers) {
+
+    const size_t requested = sharedState.options["Threads"];
 
-    if (threads.size() > 0)  // destroy any existing thread(s)
+    // Binding threads may be problematic when there's multiple NUMA nodes and
+    // multiple Stockfish instances running. In particular, if each instance
+    // runs a single thread then they would all be mapped to the first NUMA node.
+    // This is undesirable, and so the default behaviour (i.e. when the user does not
+    // change the NumaConfig UCI setting) is to not bind the threads to processors
+    // unless we know for sure that we span NUMA nodes and replication is required.
+    const std::string numaPolicy =
+      NumaConfig::split_core_class_policy(sharedState.options["NumaPolicy"]).first;
+    const bool doBindThreads = [&]() {
+        if (numaPolicy == "none")
+            return false;
+
+        if (numaPolicy == "auto")
+            return numaConfig.suggests_binding_threads(requested);
+
+        // numaPolicy == "system", or explicitly set by the user
+        return true;
+    }();
+
+    std::vector<NumaIndex> binding = doBindThreads
+                                     ? numaConfig.distribute_threads_among_numa_nodes(requested)
+                                     : std::vector<NumaIndex>{};
+
+    // The threads kept must stay on their node, and the assignment of the
+    // performance cores depends on the threads before, so the common prefix
+    // of the old and new bindings must match.
+    const size_t common = std::min(threads.size(), requested);
+    const bool   keep   = keepWorkers && common > 0
+                     && doBindThreads == !boundThreadToNumaNode.empty()
+                     && std::equal(binding.begin(), binding.begin() + (doBindThreads ? common : 0),
+                                   boundThreadToNumaNode.begin());
+
+    if (threads.size() > 0)
     {
+        stop_background();
         main_thread()->wait_for_search_finished();
+        wait_for_clearing();
 
-        threads.clear();
-
-        boundThreadToNumaNode.clear();
+        threads.resize(keep ? common : 0);  // destroy the threads not kept
     }
 
-    const size_t requested = sharedState.options["Threads"];
+    boundThreadToNumaNode = std::move(binding);
+
+    if (requested == 0)
+        return keep;
+
+    const size_t kept = threads.size();
+
+    // On hybrid processors the threads bound to a node, starting with the main
+    // thread, take its performance cores, and only the rest spill onto the whole node.
+    std::vector<CpuIndex> threadsOnNode(numaConfig.num_numa_nodes(), 0);
 
-    if (requested > 0)  // create new thread(s)
+    for (size_t threadId = 0; threadId < requested; ++threadId)
     {
-        // Binding threads may be problematic when there's multiple NUMA nodes and
-        // multiple Stockfish instances running. In particular, if each instance
-        // runs a single thread then they would all be mapped to the first NUMA node.
-        // This is undesirable, and so the default behaviour (i.e. when the user does not
-        // change the NumaConfig UCI setting) is to not bind the threads to processors
-        // unless we know for sure that we span NUMA nodes and replication is required.
-        const std::string numaPolicy(sharedState.options["NumaPolicy"]);
-        const bool        doBindThreads = [&]() {
-            if (numaPolicy == "none")
-                return false;
-
-            if (numaPolicy == "auto")
-                return numaConfig.suggests_binding_threads(requested);
-
-            // numaPolicy == "system", or explicitly set by the user
-            return true;
-        }();
-
-        boundThreadToNumaNode = doBindThreads
-                                ? numaConfig.distribute_threads_among_numa_nodes(requested)
-                                : std::vector<NumaIndex>{};
-
-        while (threads.size() < requested)
-        {
-            const size_t    threadId = threads.size();
-            const NumaIndex numaId   = doBindThreads ? boundThreadToNumaNode[threadId] : 0;
-            auto            manager  = threadId == 0 ? std::unique_ptr<Search::ISearchManager>(
-                                             std::make_unique<Search::SearchManager>(updateContext))
-                                                     : std::make_unique<Search::NullSearchManager>();
-
-            // When not binding threads we want to force all access to happen
-            // from the same NUMA node, because in case of NUMA replicated memory
-            // accesses we don't want to trash cache in case the threads get scheduled
-            // on the same NUMA node.
-            auto binder = doBindThreads ? OptionalThreadToNumaNodeBinder(numaConfig, numaId)
-                                        : OptionalThreadToNumaNodeBinder(numaId);
-
-            threads.emplace_back(
-              std::make_unique<Thread>(sharedState, std::move(manager), threadId, binder));
-        }
+        const NumaIndex numaId = doBindThreads ? boundThreadToNumaNode[threadId] : 0;
 
-        clear();
+        const bool onPerformanceCores =
+          doBindThreads && numaConfig.is_hybrid()
+          && threadsOnNode[numaId]++ < numaConfig.num_performance_cpus_in_numa_node(numaId);
 
-        main_thread()->wait_for_search_finished();
+        if (threadId < kept)
+            continue;
+
+        auto manager = threadId == 0 ? std::unique_ptr<Search::ISearchManager>(
+                                         std::make_unique<Search::SearchManager>(updateContext))
+                                     : std::make_unique<Search::NullSearchManager>();
+
+        // When not binding threads we want to force all access to happen
+        // from the same NUMA node, because in case of NUMA replicated memory
+        // accesses we don't want to trash cache in case the threads get scheduled
+        // on the same NUMA node.
+        auto binder = doBindThreads
+                      ? OptionalThreadToNumaNodeBinder(numaConfig, numaId, onPerformanceCores)
+                      : OptionalThreadToNumaNodeBinder(numaId);
+
+        threads.emplace_back(
+          std::make_unique<Thread>(sharedState, std::move(manager), threadId, binder));
+    }
+
+    if (keep)
+    {
+        // Only the new workers need their histories cleared
+        for (size_t i = kept; i < threads.size(); ++i)
+            threads[i]->run_custom_job([this, i]() { threads[i]->worker->clear(); });
+
+        for (size_t i = kept; i < threads.size(); ++i)
+            threads[i]->wait_for_search_finished();
     }
+    else
+        clear();
+
+    main_thread()->wait_for_search_finished();
+
+    return keep;
 }
 
 
 // Sets threadPool data to initial values
 void ThreadPool::clear() {
+    start_clearing();
+    wait_for_clearing();
+}
+
+// Starts clearing the histories of the workers, and the transposition table
+// if given, and returns at once. Each thread zeroes its own structures and its
+// part of the table, which keeps the pages on its NUMA node. They must not be
+// used before wait_for_clearing(), which start_thinking() implies as it waits
+// for each thread to finish its job.
+void ThreadPool::start_clearing(TranspositionTable* tt) {
     if (threads.size() == 0)
         return;
 
-    for (auto&& th : threads)
-        th->clear_worker();
+    stop_background();
 
-    for (auto&& th : threads)
-        th->wait_for_search_finished();
+    const size_t count = threads.size();
+
+    for (size_t i = 0; i < count; ++i)
+        threads[i]->run_custom_job([this, tt, i, count]() {
+            if (tt)
+                tt->clear_part(i, count);
+            threads[i]->worker->clear();
+        });
+
+    clearing = true;
 
     // These two affect the time taken on the first move of a game:
     main_manager()->bestPreviousAverageScore = VALUE_INFINITE;
@@ -218,8 +429,19 @@ void ThreadPool::clear() {
     main_manager()->tm.clear();
 }
 
+void ThreadPool::wait_for_clearing() {
+    if (!clearing)
+        return;
+
+    for (auto&& th : threads)
+        th->wait_for_search_finished();
+
+    clearing = false;
+}
+
 void ThreadPool::run_on_thread(size_t threadId, std::function<void()> f) {
     assert(threads.size() > threadId);
+    stop_background();
     threads[threadId]->run_custom_job(std::move(f));
 }
 
@@ -232,14 +454,22 @@ size_t ThreadPool::num_threads() const { return threads.size(); }
 
 // Wakes up main thread waiting in idle_loop() and
 // returns immediately. Main thread will wake up other threads and start the search.
-void ThreadPool::start_thinking(Position& pos, StateListPtr& states, Search::LimitsType limits) {
-
+// With background set, the threads go on searching after the best move has
+// been sent, see search_background().
+void ThreadPool::start_thinking(Position&          pos,
+                                StateListPtr&      states,
+                                Search::LimitsType limits,
+                                bool               background) {
+
+    stop_background();
     main_thread()->wait_for_search_finished();
 
     main_manager()->stopOnPonderhit = stop = abortedSearch = false;
     main_manager()->ponder                                 = limits.ponderMode;
 
     increaseDepth = true;
+    epochThreads  = threads.size();
+    epochArrived  = 0;
 
     Search::RootMoves rootMoves;
     const auto        legalmoves = MoveList<LEGAL>(pos);
@@ -269,23 +499,241 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states, Search::Lim
     // setupStates->back() later. The rootState is per thread, earlier states are shared
     // since they are read-only.
     for (auto&& th : threads)
-    {
-        th->run_custom_job([&]() {
-            th->worker->limits = limits;
-            th->worker->nodes = th->worker->nmpMinPly = th->worker->bestMoveChanges = 0;
-            th->worker->rootDepth = th->worker->completedDepth = 0;
-            th->worker->rootMoves                              = rootMoves;
-            th->worker->rootPos.set(pos, &th->worker->rootState);
-            th->worker->rootState = setupStates->back();
-        });
-    }
+        th->run_custom_job(
+          [&]() { prepare_worker(*th->worker, pos, setupStates->back(), limits, rootMoves); });
 
     for (auto&& th : threads)
         th->wait_for_search_finished();
 
+    // Any clear job ran before, so wait_for_clearing() must not wait for this search
+    clearing = false;
+
+    {
+        std::lock_guard<std::mutex> lk(backgroundMutex);
+        backgroundAllowed = background;
+    }
+
     main_thread()->start_searching();
 }
 
+// With ResumeAnalysis, a search without time management goes on from the root
+// moves of the last search of the worker, if its root is the same position with
+// the same moves, or the position after the first move of its best line. The
+// positions before the root which can still repeat must be the same as well,
+// since the repetition and chase rules change the scores. The
+// moves keep their scores, lines and effort, and the iterations restart after
+// the last completed one. Otherwise, it starts over with the given root moves.
+// Returns the depth the worker resumes from, and sets its root moves.
+Depth ThreadPool::resume_analysis(Search::Worker&           w,
+                                  const Position&           pos,
+                                  const Search::LimitsType& limits,
+                                  const Search::RootMoves&  rootMoves) {
+
+    Depth depth = 0;
+
+    if (w.options["ResumeAnalysis"] && !limits.use_time_management() && !w.ownTT
+        && w.completedDepth > 0 && !w.rootMoves.empty())
+    {
+        const Search::RootMove& best = w.rootMoves[0];
+
+        auto all_in = [](const Search::RootMoves& from, const Search::RootMoves& to) {
+            return std::all_of(from.begin(), from.end(), [&](const Search::RootMove& rm) {
+                return std::count(to.begin(), to.end(), rm.pv[0]);
+            });
+        };
+
+        const std::vector<Key> history = history_of(pos);
+
+        // After a move, the last root is the latest position of the history
+        const bool continued =
+          !history.empty() && history[0] == w.rootPos.key()
+          && history.size() <= w.rootHistory.size() + 1
+          && std::equal(history.begin() + 1, history.end(), w.rootHistory.begin());
+
+        if (pos.key() == w.rootPos.key() && history == w.rootHistory
+            && w.rootMoves.size() == rootMoves.size() && all_in(rootMoves, w.rootMoves))
+        {
+            // An iteration stopped midway left the moves it didn't search without a score
+            for (Search::RootMove& rm : w.rootMoves)
+                if (rm.score == -VALUE_INFINITE)
+                    rm.score = rm.uciScore = rm.previousScore;
+
+            depth = w.completedDepth;
+        }
+        else if (best.pv.size() >= 2 && pos.key() == w.rootPos.key_after(best.pv[0])
+                 && continued && std::count(rootMoves.begin(), rootMoves.end(), best.pv[1]))
+        {
+            Search::RootMove next = best;
+            next.pv.erase(next.pv.begin());
+            next.score = next.previousScore = next.uciScore = -best.score;
+            next.averageScore                               = -best.averageScore;
+            next.selDepth = next.effort = 0;
+
+            w.rootMoves = rootMoves;
+            Utility::move_to_front(w.rootMoves,
+                                   [&](const Search::RootMove& rm) { return rm == next.pv[0]; });
+            w.rootMoves[0] = next;
+
+            depth = w.completedDepth - 1;
+        }
+
+        // Search at least one iteration, which sends the info of the position
+        if (limits.depth)
+            depth = std::min(depth, limits.depth - 1);
+    }
+
+    if (!depth)
+        w.rootMoves = rootMoves;
+
+    return std::max(depth, 0);
+}
+
+void ThreadPool::prepare_worker(Search::Worker&           w,
+                                const Position&           pos,
+                                const StateInfo&          rootState,
+                                const Search::LimitsType& limits,
+                                const Search::RootMoves&  rootMoves) {
+    w.limits = limits;
+    w.nodes = w.tbHits = w.nmpMinPly = w.bestMoveChanges = 0;
+    w.tbCardinality = std::min(int(w.options["TablebaseProbeLimit"]), Tablebases::MaxCardinality);
+    w.abdada        = w.options["ABDADA"] && threads.size() > 1 && !w.ownTT;
+    w.prefetchAhead = w.options["PrefetchAhead"];
+    w.stats.clear();
+    w.accumulators.refreshes.reset();
+    w.accumulators.updates.reset();
+    w.accumulators.refreshFeatures.reset();
+
+    // Called on the thread of the worker, which allocates and first touches
+    // its eval cache on its own NUMA node
+    w.evalCache.resize(size_t(w.options["EvalCache"]));
+    w.evalCache.hits.reset();
+
+    // The network may have been replaced since the last search, see Engine::go()
+    if (w.networkVersion != w.network.get_version())
+    {
+        w.refreshTable.clear(w.network[w.numaAccessToken]);
+        w.evalCache.clear();
+        w.networkVersion = w.network.get_version();
+        w.completedDepth = 0;  // The scores of the last search are of the old network
+    }
+
+    w.nodeQuota = 0;
+    if (w.ownTT)
+    {
+        w.ownTT->attach();
+
+        // Split the nodes evenly, the main thread also takes the remainder
+        const uint64_t n = threads.size();
+        if (limits.nodes)
+            w.nodeQuota =
+              std::max(uint64_t(1), limits.nodes / n + (w.is_mainthread() ? limits.nodes % n : 0));
+    }
+    w.rootDepth   = w.completedDepth = resume_analysis(w, pos, limits, rootMoves);
+    w.rootHistory = history_of(pos);
+    w.rootPos.set(pos, &w.rootState);
+    w.rootState = rootState;
+}
+
+// Called by the main thread once it has sent the best move of a search started
+// with background analysis. All threads then search the position after the
+// given moves at a low priority, without any output, until stop_background()
+// is called by the next command. The hash keeps what they find, as when pondering.
+void ThreadPool::search_background(const std::vector<Move>& moves) {
+
+    Search::Worker& main = *main_thread()->worker;
+
+    if (main.ownTT)  // Would break the deterministic mode
+        return;
+
+    // Same setup as in start_thinking(), the root state is copied so that the
+    // current one of the main thread can be replaced.
+    StateInfo st[3];
+    Position  pos;
+    pos.set(main.rootPos, &st[0]);
+    st[0] = *main.rootPos.state();
+
+    for (size_t i = 0; i < std::min(moves.size(), size_t(2)); ++i)
+        pos.do_move(moves[i], st[i + 1]);
+
+    Search::RootMoves rootMoves;
+    for (const auto& m : MoveList<LEGAL>(pos))
+        rootMoves.emplace_back(m);
+
+    {
+        std::lock_guard<std::mutex> lk(backgroundMutex);
+        backgroundRunning = backgroundAllowed && !rootMoves.empty();
+        backgroundAllowed = false;
+
+        if (!backgroundRunning)
+            return;
+
+        stop = false;
+    }
+
+    Search::LimitsType limits;
+    limits.startTime = now();
+    limits.infinite  = 1;
+    limits.capSq     = SQ_NONE;
+
+    for (auto&& th : threads)
+        if (th != threads.front())
+            th->run_custom_job([&]() {
+                set_low_priority(true);
+                prepare_worker(*th->worker, pos, *pos.state(), limits, rootMoves);
+            });
+
+    set_low_priority(true);
+    prepare_worker(main, pos, *pos.state(), limits, rootMoves);
+    wait_for_search_finished();
+
+    // Keep what the time management of the next search depends on
+    Search::SearchManager* mm            = main_manager();
+    const auto             iterValue     = mm->iterValue;
+    const double           timeReduction = mm->previousTimeReduction;
+
+    mm->background = true;
+    start_searching();
+    main.iterative_deepening();
+
+    {
+        std::unique_lock<std::mutex> lk(backgroundMutex);
+        backgroundCv.wait(lk, [&] { return bool(stop); });  // Until the next command
+    }
+
+    wait_for_search_finished();
+
+    for (auto&& th : threads)
+        if (th != threads.front())
+            th->run_custom_job([]() { set_low_priority(false); });
+
+    set_low_priority(false);
+    wait_for_search_finished();
+
+    mm->background            = false;
+    mm->iterValue             = iterValue;
+    mm->previousTimeReduction = timeReduction;
+
+    std::lock_guard<std::mutex> lk(backgroundMutex);
+    backgroundRunning = false;
+}
+
+// Stops the background search and waits for it, or prevents the next one from
+// starting. Called before giving the threads any other work, never by them.
+void ThreadPool::stop_background() {
+    {
+        std::lock_guard<std::mutex> lk(backgroundMutex);
+
+        backgroundAllowed = false;
+        if (!backgroundRunning)
+            return;
+
+        stop = true;
+    }
+
+    backgroundCv.notify_one();
+    main_thread()->wait_for_search_finished();
+}
+
 Thread* ThreadPool::get_best_thread() const {
 
     Thread* bestThread = threads.front().get();
@@ -367,11 +815,24 @@ void ThreadPool::start_searching() {
 
 void ThreadPool::wait_for_search_finished() const {
 
+    Trace::Scope scope("wait for threads");
+
     for (auto&& th : threads)
         if (th != threads.front())
             th->wait_for_search_finished();
 }
 
+// Gives back the states the last search was started on, so that the game can be
+// continued from them. Returns nullptr while the search is still running, as its
+// threads may be reading them.
+StateListPtr ThreadPool::reclaim_setup_states() {
+
+    if (threads.empty() || main_thread()->is_searching())
+        return nullptr;
+
+    return std::move(setupStates);
+}
+
 std::vector<size_t> ThreadPool::get_bound_thread_count_by_numa_node() const {
     std::vector<size_t> counts;
 
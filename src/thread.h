@@ -28,6 +28,7 @@
 #include <mutex>
 #include <vector>
 
+#include "memory.h"
 #include "numa.h"
 #include "position.h"
 #include "search.h"
@@ -35,6 +36,10 @@
 
 namespace Stockfish {
 
+namespace Distributed {
+class Outbox;
+}
+
 using Value = int;
 
 // Sometimes we don't want to actually bind the threads, but the recipent still
@@ -45,15 +50,17 @@ class OptionalThreadToNumaNodeBinder {
    public:
     OptionalThreadToNumaNodeBinder(NumaIndex n) :
         numaConfig(nullptr),
-        numaId(n) {}
+        numaId(n),
+        performanceCoresOnly(false) {}
 
-    OptionalThreadToNumaNodeBinder(const NumaConfig& cfg, NumaIndex n) :
+    OptionalThreadToNumaNodeBinder(const NumaConfig& cfg, NumaIndex n, bool pCoresOnly = false) :
         numaConfig(&cfg),
-        numaId(n) {}
+        numaId(n),
+        performanceCoresOnly(pCoresOnly) {}
 
     NumaReplicatedAccessToken operator()() const {
         if (numaConfig != nullptr)
-            return numaConfig->bind_current_thread_to_numa_node(numaId);
+            return numaConfig->bind_current_thread_to_numa_node(numaId, performanceCoresOnly);
         else
             return NumaReplicatedAccessToken(numaId);
     }
@@ -61,6 +68,7 @@ class OptionalThreadToNumaNodeBinder {
    private:
     const NumaConfig* numaConfig;
     NumaIndex         numaId;
+    bool              performanceCoresOnly;
 };
 
 // Abstraction of a thread. It contains a pointer to the worker and a native thread.
@@ -78,7 +86,6 @@ class Thread {
 
     void idle_loop();
     void start_searching();
-    void clear_worker();
     void run_custom_job(std::function<void()> f);
 
     // Thread has been slightly altered to allow running custom jobs, so
@@ -87,10 +94,11 @@ class Thread {
     // appropriate specificity regarding search, from the point of view of an
     // outside user, so renaming of this function in left for whenever that happens.
     void   wait_for_search_finished();
+    bool   is_searching();
     size_t id() const { return idx; }
 
-    std::unique_ptr<Search::Worker> worker;
-    std::function<void()>           jobFunc;
+    LargePagePtr<Search::Worker> worker;
+    std::function<void()>        jobFunc;
 
    private:
     std::mutex                mutex;
@@ -113,7 +121,9 @@ class ThreadPool {
         // destroy any existing thread(s)
         if (threads.size() > 0)
         {
+            stop_background();
             main_thread()->wait_for_search_finished();
+            wait_for_clearing();
 
             threads.clear();
         }
@@ -125,25 +135,39 @@ class ThreadPool {
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool& operator=(ThreadPool&&)      = delete;
 
-    void   start_thinking(Position&, StateListPtr&, Search::LimitsType);
+    void   start_thinking(Position&, StateListPtr&, Search::LimitsType, bool background = false);
+    void   search_background(const std::vector<Move>& moves);
+    void   stop_background();
     void   run_on_thread(size_t threadId, std::function<void()> f);
     void   wait_on_thread(size_t threadId);
     size_t num_threads() const;
     void   clear();
-    void   set(const NumaConfig& numaConfig,
+    void   start_clearing(TranspositionTable* tt = nullptr);
+    void   wait_for_clearing();
+    bool   set(const NumaConfig& numaConfig,
                Search::SharedState,
-               const Search::SearchManager::UpdateContext&);
+               const Search::SearchManager::UpdateContext&,
+               bool keepWorkers = false);
 
     Search::SearchManager* main_manager();
     Thread*                main_thread() const { return threads.front().get(); }
     uint64_t               nodes_searched() const;
+    uint64_t               tb_hits() const;
     Thread*                get_best_thread() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
+    StateListPtr           reclaim_setup_states();
+
+    std::vector<size_t>                get_bound_thread_count_by_numa_node() const;
+    std::vector<Search::StatsSnapshot> search_stats() const;
+
+    void end_tt_epoch(Search::Worker& worker, bool leave);
 
-    std::vector<size_t> get_bound_thread_count_by_numa_node() const;
+    std::atomic_bool  stop, abortedSearch, increaseDepth;
+    Search::BusyTable busyNodes;
 
-    std::atomic_bool stop, abortedSearch, increaseDepth;
+    // Where the search threads put the entries to share with other hosts, if any
+    Distributed::Outbox* clusterOutbox = nullptr;
 
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
@@ -153,9 +177,29 @@ class ThreadPool {
     auto empty() const noexcept { return threads.empty(); }
 
    private:
+    void prepare_worker(Search::Worker&,
+                        const Position&,
+                        const StateInfo&,
+                        const Search::LimitsType&,
+                        const Search::RootMoves&);
+    static Depth resume_analysis(Search::Worker&,
+                                 const Position&,
+                                 const Search::LimitsType&,
+                                 const Search::RootMoves&);
+
     StateListPtr                         setupStates;
     std::vector<std::unique_ptr<Thread>> threads;
     std::vector<NumaIndex>               boundThreadToNumaNode;
+    bool                                 clearing = false;
+
+    std::mutex              backgroundMutex;
+    std::condition_variable backgroundCv;
+    bool                    backgroundAllowed = false, backgroundRunning = false;
+
+    std::mutex              epochMutex;
+    std::condition_variable epochCv;
+    size_t                  epochThreads = 0, epochArrived = 0;
+    uint64_t                epoch        = 0;
 
     uint64_t accumulate(std::atomic<uint64_t> Search::Worker::*member) const {
 
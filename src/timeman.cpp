@@ -33,6 +33,7 @@ TimePoint TimeManagement::maximum() const { return maximumTime; }
 
 void TimeManagement::clear() {
     availableNodes = -1;  // When in 'nodes as time' mode
+    branchFactor   = 2.0;
 }
 
 void TimeManagement::advance_nodes_time(std::int64_t nodes) {
@@ -55,6 +56,8 @@ void TimeManagement::init(Search::LimitsType& limits,
     // startTime is used by movetime and useNodesTime is used in elapsed calls.
     startTime    = limits.startTime;
     useNodesTime = npmsec != 0;
+    predictive   = options["TimeModel"] == "predictive";
+    lastNodes = lastIterationNodes = 0;
 
     if (limits.time[us] == 0)
         return;
@@ -137,4 +140,30 @@ void TimeManagement::init(Search::LimitsType& limits,
         optimumTime += optimumTime / 4;
 }
 
+// Called by the main thread after each iteration with the nodes searched so far.
+// It measures the growth of the tree from one iteration to the next, averaged
+// over the game, and the speed of this search. In predictive mode, returns
+// false if at this speed the next iteration would not end before the maximum
+// time, so starting it would mostly waste the clock.
+bool TimeManagement::next_iteration_fits(Depth depth, std::uint64_t nodes, TimePoint elapsed) {
+
+    const std::uint64_t iterationNodes = nodes - lastNodes;
+
+    // The first iterations are too small to tell anything
+    if (depth > 8 && lastIterationNodes)
+        branchFactor = 0.8 * branchFactor
+                     + 0.2 * std::clamp(double(iterationNodes) / lastIterationNodes, 1.0, 8.0);
+
+    lastNodes          = nodes;
+    lastIterationNodes = iterationNodes;
+
+    if (!predictive || elapsed <= 0)
+        return true;
+
+    // With nodes as time, elapsed is already a number of nodes
+    const double nodesPerUnit = useNodesTime ? 1.0 : double(nodes) / elapsed;
+
+    return elapsed + iterationNodes * branchFactor / nodesPerUnit <= maximumTime;
+}
+
 }  // namespace Stockfish
@@ -52,6 +52,7 @@ class TimeManagement {
 
     void clear();
     void advance_nodes_time(std::int64_t nodes);
+    bool next_iteration_fits(Depth depth, std::uint64_t nodes, TimePoint elapsed);
 
    private:
     TimePoint startTime;
@@ -60,6 +61,11 @@ class TimeManagement {
 
     std::int64_t availableNodes = -1;     // When in 'nodes as time' mode
     bool         useNodesTime   = false;  // True if we are in 'nodes as time' mode
+
+    // When the TimeModel option is 'predictive', see next_iteration_fits()
+    bool          predictive   = false;
+    std::uint64_t lastNodes    = 0, lastIterationNodes = 0;
+    double        branchFactor = 2.0;  // Averaged over the game
 };
 
 }  // namespace Stockfish
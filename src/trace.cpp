@@ -0,0 +1,187 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Stockfish::Trace {
+
+#if defined(USE_TRACE)
+
+namespace {
+
+constexpr uint64_t Capacity = 1 << 15;  // Events kept by each thread
+
+struct Event {
+    int64_t     time;  // In nanoseconds since the start of the program
+    const char* name;
+    const char* argName;
+    int64_t     arg;
+    char        phase;
+};
+
+// The events of a thread. Only the thread writes them, and count is published
+// after each one, so that dump() knows which ones it may have read while they
+// were overwritten.
+struct Buffer {
+    std::string           name;
+    std::atomic<uint64_t> count{0};
+    Event                 events[Capacity];
+};
+
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point              start = Clock::now();
+std::atomic<int64_t>                 clearTime{0};
+std::mutex                           buffersMutex;
+std::vector<std::unique_ptr<Buffer>> buffers;  // Kept until exit, as the events of ended threads
+thread_local Buffer*                 buffer = nullptr;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+Buffer& thread_buffer() {
+
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.push_back(std::make_unique<Buffer>());
+        buffer       = buffers.back().get();
+        buffer->name = "thread " + std::to_string(buffers.size() - 1);
+    }
+
+    return *buffer;
+}
+
+// Names and strings of the events are literals of the program, with no
+// character to escape in JSON.
+void write_event(std::ofstream& out, const Event& e, size_t tid, bool& first) {
+
+    out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"" << e.phase
+        << "\",\"ts\":" << e.time / 1000 << '.' << std::setw(3) << std::setfill('0')
+        << e.time % 1000 << ",\"pid\":1,\"tid\":" << tid;
+
+    if (e.phase == 'i')
+        out << ",\"s\":\"t\"";
+
+    if (e.argName)
+        out << ",\"args\":{\"" << e.argName << "\":" << e.arg << "}";
+
+    out << "}";
+    first = false;
+}
+
+}  // namespace
+
+namespace Detail {
+
+void record(char phase, const char* name, const char* argName, int64_t arg) {
+
+    Buffer&        b = thread_buffer();
+    const uint64_t n = b.count.load(std::memory_order_relaxed);
+
+    b.events[n % Capacity] = {now_ns(), name, argName, arg, phase};
+    b.count.store(n + 1, std::memory_order_release);
+}
+
+void name_thread(const std::string& name) {
+
+    Buffer& b = thread_buffer();
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    b.name = name;
+}
+
+}  // namespace Detail
+
+std::string dump(const std::string& file) {
+
+    std::ofstream out(file);
+
+    if (!out)
+        return "Failed to open " + file;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    const int64_t from   = clearTime.load(std::memory_order_relaxed);
+    size_t        events = 0;
+    bool          first  = true;
+
+    out << "{\"traceEvents\":[";
+
+    for (size_t tid = 0; tid < buffers.size(); ++tid)
+    {
+        const Buffer& b = *buffers[tid];
+
+        out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << tid << ",\"args\":{\"name\":\"" << b.name << "\"}}";
+        first = false;
+
+        // Copy the events first, then drop the ones the thread may have been
+        // overwriting meanwhile, up to the one it may be writing now.
+        const uint64_t    end   = b.count.load(std::memory_order_acquire);
+        const uint64_t    begin = end > Capacity ? end - Capacity : 0;
+        std::vector<Event> copy;
+
+        for (uint64_t i = begin; i < end; ++i)
+            copy.push_back(b.events[i % Capacity]);
+
+        const uint64_t after = b.count.load(std::memory_order_acquire);
+        const uint64_t valid = after + 1 > Capacity ? after + 1 - Capacity : 0;
+
+        for (uint64_t i = std::max(begin, valid); i < end; ++i)
+            if (copy[i - begin].time >= from)
+            {
+                write_event(out, copy[i - begin], tid, first);
+                ++events;
+            }
+    }
+
+    out << "\n]}\n";
+
+    return "Wrote " + std::to_string(events) + " events of " + std::to_string(buffers.size())
+         + " threads to " + file;
+}
+
+void clear() { clearTime = now_ns(); }
+
+#else
+
+namespace Detail {
+
+void record(char, const char*, const char*, int64_t) {}
+void name_thread(const std::string&) {}
+
+}  // namespace Detail
+
+std::string dump(const std::string&) { return "Tracing is not compiled in, build with trace=yes"; }
+
+void clear() {}
+
+#endif
+
+}  // namespace Stockfish::Trace
@@ -0,0 +1,94 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2024 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+// A timeline of what each thread does, in builds with trace=yes (USE_TRACE):
+// the iterations and aspiration re-searches of the search, the decisions of
+// the time manager and the waits of the threads. Each thread writes its events
+// with their time into a ring buffer of its own, which keeps the last ones,
+// and the "trace" command writes them all in the Chrome trace format, which
+// Perfetto and chrome://tracing open. Without the build flag, all the calls
+// below compile to nothing.
+namespace Stockfish::Trace {
+
+#if defined(USE_TRACE)
+constexpr bool Enabled = true;
+#else
+constexpr bool Enabled = false;
+#endif
+
+namespace Detail {
+
+void record(char phase, const char* name, const char* argName, int64_t arg);
+void name_thread(const std::string& name);
+
+}  // namespace Detail
+
+// The names are string literals, kept as pointers. An event may have one
+// integer argument, shown with its name.
+inline void begin(const char* name, const char* argName = nullptr, int64_t arg = 0) {
+    if constexpr (Enabled)
+        Detail::record('B', name, argName, arg);
+}
+
+inline void end(const char* name) {
+    if constexpr (Enabled)
+        Detail::record('E', name, nullptr, 0);
+}
+
+inline void instant(const char* name, const char* argName = nullptr, int64_t arg = 0) {
+    if constexpr (Enabled)
+        Detail::record('i', name, argName, arg);
+}
+
+// Names the timeline of the calling thread
+inline void name_thread([[maybe_unused]] const std::string& name) {
+    if constexpr (Enabled)
+        Detail::name_thread(name);
+}
+
+// Begins an event, which ends with the scope
+class Scope {
+   public:
+    explicit Scope(const char* n, const char* argName = nullptr, int64_t arg = 0) :
+        name(n) {
+        begin(name, argName, arg);
+    }
+    ~Scope() { end(name); }
+
+    Scope(const Scope&)            = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    const char* name;
+};
+
+// Writes the events of all the threads to a file, as JSON in the Chrome trace
+// format, and returns a message for the user. It may be called during a search,
+// then leaving out the events written meanwhile. clear() drops the events so far.
+std::string dump(const std::string& file);
+void        clear();
+
+}  // namespace Stockfish::Trace
+
+#endif  // #ifndef TRACE_H_INCLUDED
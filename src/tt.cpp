@@ -18,14 +18,18 @@
 
 #include "tt.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
 
 #include "memory.h"
 #include "misc.h"
+#include "perf.h"
 #include "thread.h"
 
 namespace Stockfish {
@@ -135,24 +139,65 @@ void TTWriter::write(
 // A TranspositionTable is an array of Cluster, of size clusterCount. Each cluster consists of ClusterSize number
 // of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
 // divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
+//
+// By default a cluster is half a cache line. Building with TT_CLUSTER_64 (make ttcluster=64) uses whole cache
+// line clusters instead, which gives every probe twice as many candidate entries for the same single miss. This
+// lowers the replacement rate on very large, heavily filled tables, at the price of scanning more entries.
+
+#if defined(TT_CLUSTER_64)
+static constexpr int ClusterSize = 6;
 
+struct Cluster {
+    TTEntry entry[ClusterSize];
+    char    padding[4];  // Pad to 64 bytes, the first byte marks touched clusters, see attach()
+};
+
+static_assert(sizeof(Cluster) == 64, "Suboptimal Cluster size");
+#else
 static constexpr int ClusterSize = 3;
 
 struct Cluster {
     TTEntry entry[ClusterSize];
-    char    padding[2];  // Pad to 32 bytes
+    char    padding[2];  // Pad to 32 bytes, the first byte marks touched clusters, see attach()
 };
 
 static_assert(sizeof(Cluster) == 32, "Suboptimal Cluster size");
+#endif
+
+
+// Number of clusters zeroed at once by a thread when the table is interleaved,
+// matching the size of a large page.
+static constexpr size_t InterleaveChunk = 2 * 1024 * 1024 / sizeof(Cluster);
+
+
+// Returns the least valuable entry of a cluster. The replace value of an entry is calculated as
+// its depth minus 8 times its relative age. TTEntry t1 is considered more valuable than TTEntry
+// t2 if its replace value is greater than that of t2. The 64-byte clusters use the same
+// value: favouring PV or exact entries, or a weaker age term, gave no consistent gain.
+TTEntry* TranspositionTable::replacement(TTEntry* tte, const uint8_t generation8) {
+
+    TTEntry* replace = tte;
+    for (int i = 1; i < ClusterSize; ++i)
+        if (replace->depth8 - replace->relative_age(generation8) * 2
+            > tte[i].depth8 - tte[i].relative_age(generation8) * 2)
+            replace = &tte[i];
+
+    return replace;
+}
 
 
 // Sets the size of the transposition table,
 // measured in megabytes. Transposition table consists
 // of clusters and each cluster consists of ClusterSize number of TTEntry.
-void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
+// The memory is only committed when clear() first touches it from the search
+// threads, so on NUMA hosts with bound threads the placement of the pages
+// follows the way clear() splits the work: one contiguous slice per thread by
+// default, or chunks dealt round-robin to all threads when interleaving.
+void TranspositionTable::resize(size_t mbSize, ThreadPool& threads, bool interleave) {
     aligned_large_pages_free(table);
 
     clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    interleaved  = interleave;
 
     table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
 
@@ -169,23 +214,131 @@ void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
 // Initializes the entire transposition table to zero,
 // in a multi-threaded way.
 void TranspositionTable::clear(ThreadPool& threads) {
-    generation8              = 0;
     const size_t threadCount = threads.num_threads();
 
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.run_on_thread(i, [this, i, threadCount]() { clear_part(i, threadCount); });
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+}
+
+// Zeroes the part of the table of thread idx, the first one also resets the
+// generation. The table must not be used until all count parts are done.
+void TranspositionTable::clear_part(size_t idx, size_t count) {
+    if (idx == 0)
+        generation8 = 0;
+
+    // Each thread will zero every count-th chunk, so that the pages end
+    // up spread evenly over the NUMA nodes of all threads.
+    if (interleaved)
+    {
+        for (size_t start = idx * InterleaveChunk; start < clusterCount;
+             start += count * InterleaveChunk)
+            std::memset(&table[start], 0,
+                        std::min(InterleaveChunk, clusterCount - start) * sizeof(Cluster));
+        return;
+    }
+
+    // Each thread will zero its part of the hash table
+    const size_t stride = clusterCount / count;
+    const size_t start  = stride * idx;
+    const size_t len    = idx + 1 != count ? stride : clusterCount - start;
+
+    std::memset(&table[start], 0, len * sizeof(Cluster));
+}
+
+
+// A hash file consists of this header followed by the clusters exactly as they
+// are laid out in memory. It can only be loaded into a table of the same size,
+// since the cluster index of an entry depends on the number of clusters.
+struct HashFileHeader {
+    uint64_t magic;
+    uint64_t clusterCount;
+    uint32_t clusterSize;
+    uint32_t generation;
+};
+
+static constexpr uint64_t HashFileMagic = 0x4853414846414B50ULL;  // "PKAFHASH"
+static constexpr size_t   HashFileChunk = 64 * 1024 * 1024;
+
+
+// Writes the whole table to a file with large sequential writes. The current
+// generation is saved as well, so that entry ages stay meaningful after a load.
+bool TranspositionTable::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    const HashFileHeader header{HashFileMagic, clusterCount, uint32_t(sizeof(Cluster)),
+                                generation8};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const char*  data = reinterpret_cast<const char*>(table);
+    const size_t size = clusterCount * sizeof(Cluster);
+
+    for (size_t offset = 0; offset < size && file; offset += HashFileChunk)
+        file.write(data + offset, std::streamsize(std::min(HashFileChunk, size - offset)));
+
+    return bool(file);
+}
+
+
+// Replaces the table contents with a file written by save(), instead of
+// clearing it. Each thread reads its own part of the file, like in clear(),
+// so that the pages also end up on the NUMA node of the thread using them.
+bool TranspositionTable::load(const std::string& path, ThreadPool& threads) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    const size_t   size     = clusterCount * sizeof(Cluster);
+    const auto     fileSize = size_t(file.tellg());
+    HashFileHeader header{};
+
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (!file || header.magic != HashFileMagic || header.clusterCount != clusterCount
+        || header.clusterSize != sizeof(Cluster) || fileSize != sizeof(header) + size)
+        return false;
+
+    const size_t threadCount = threads.num_threads();
+    auto         ok          = std::make_unique<bool[]>(threadCount);
+
     for (size_t i = 0; i < threadCount; ++i)
     {
-        threads.run_on_thread(i, [this, i, threadCount]() {
-            // Each thread will zero its part of the hash table
+        threads.run_on_thread(i, [this, i, threadCount, &path, &ok]() {
+            // Each thread will read its part of the hash table
             const size_t stride = clusterCount / threadCount;
             const size_t start  = stride * i;
             const size_t len    = i + 1 != threadCount ? stride : clusterCount - start;
 
-            std::memset(&table[start], 0, len * sizeof(Cluster));
+            std::ifstream part(path, std::ios::binary);
+            part.seekg(std::streamoff(sizeof(HashFileHeader) + start * sizeof(Cluster)));
+
+            char*        data  = reinterpret_cast<char*>(&table[start]);
+            const size_t bytes = len * sizeof(Cluster);
+
+            for (size_t offset = 0; offset < bytes && part; offset += HashFileChunk)
+                part.read(data + offset, std::streamsize(std::min(HashFileChunk, bytes - offset)));
+
+            ok[i] = bool(part);
         });
     }
 
     for (size_t i = 0; i < threadCount; ++i)
         threads.wait_on_thread(i);
+
+    for (size_t i = 0; i < threadCount; ++i)
+        if (!ok[i])
+        {
+            clear(threads);
+            return false;
+        }
+
+    generation8 = uint8_t(header.generation);
+    return true;
 }
 
 
@@ -194,6 +347,9 @@ void TranspositionTable::clear(ThreadPool& threads) {
 // Only counts entries which match the current generation.
 int TranspositionTable::hashfull() const {
 
+    if (base)
+        return base->hashfull();
+
     int cnt = 0;
     for (int i = 0; i < 1000; ++i)
         for (int j = 0; j < ClusterSize; ++j)
@@ -206,21 +362,27 @@ int TranspositionTable::hashfull() const {
 
 void TranspositionTable::new_search() {
     // increment by delta to keep lower bits as is
-    generation8 += GENERATION_DELTA;
+    if (base)
+        base->new_search();
+    else
+        generation8 += GENERATION_DELTA;
 }
 
 
-uint8_t TranspositionTable::generation() const { return generation8; }
+uint8_t TranspositionTable::generation() const { return base ? base->generation8 : generation8; }
 
 
 // Looks up the current position in the transposition
 // table. It returns true if the position is found.
 // Otherwise, it returns false and a pointer to an empty or least valuable TTEntry
-// to be replaced later. The replace value of an entry is calculated as its depth
-// minus 8 times its relative age. TTEntry t1 is considered more valuable than
-// TTEntry t2 if its replace value is greater than that of t2.
+// to be replaced later.
 std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) const {
 
+    const Perf::Scope<Perf::TTProbe> perfScope;
+
+    if (base)
+        return probe_attached(key);
+
     TTEntry* const tte   = first_entry(key);
     const uint16_t key16 = uint16_t(key);  // Use the low 16 bits as key inside the cluster
 
@@ -231,16 +393,113 @@ std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) cons
             return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
 
     // Find an entry to be replaced according to the replacement strategy
-    TTEntry* replace = tte;
-    for (int i = 1; i < ClusterSize; ++i)
-        if (replace->depth8 - replace->relative_age(generation8) * 2
-            > tte[i].depth8 - tte[i].relative_age(generation8) * 2)
-            replace = &tte[i];
+    TTEntry* replace = replacement(tte, generation8);
+
+    return {false, replace->read(), TTWriter(replace)};
+}
+
+
+// Like probe(), for a table attached to a shared one. An entry found only in the
+// shared table is copied into this one, so that the following write updates it
+// the same way as it would update the shared entry.
+std::tuple<bool, TTData, TTWriter> TranspositionTable::probe_attached(const Key key) const {
+
+    const size_t   index = mul_hi64(key, clusterCount);
+    TTEntry* const tte   = table[index].entry;
+    const uint16_t key16 = uint16_t(key);
+
+    if (!table[index].padding[0])
+    {
+        table[index].padding[0] = 1;
+        touched.push_back(index);
+    }
+
+    for (int i = 0; i < ClusterSize; ++i)
+        if (tte[i].key16 == key16)
+            return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
+
+    TTEntry* replace = replacement(tte, base->generation8);
+
+    for (const TTEntry& e : base->table[index].entry)
+        if (e.key16 == key16 && e.is_occupied())
+        {
+            *replace = e;
+            return {true, replace->read(), TTWriter(replace)};
+        }
 
     return {false, replace->read(), TTWriter(replace)};
 }
 
 
+// Attaches the table to a shared one and gives it the same size. Must be called
+// from the thread the table belongs to, which then commits the memory.
+void TranspositionTable::attach(TranspositionTable* shared) {
+
+    if (shared)
+        base = shared;
+
+    assert(base);
+
+    if (clusterCount != base->clusterCount)
+    {
+        aligned_large_pages_free(table);
+
+        clusterCount = base->clusterCount;
+        table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+
+        if (!table)
+        {
+            std::cerr << "Failed to allocate " << clusterCount * sizeof(Cluster) / (1024 * 1024)
+                      << "MB for transposition table." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        std::memset(table, 0, clusterCount * sizeof(Cluster));
+        touched.clear();
+    }
+}
+
+
+// Stores the entries of the touched clusters into the same clusters of the
+// shared table, replacing entries there as a normal write would.
+void TranspositionTable::flush() {
+
+    for (size_t index : touched)
+    {
+        TTEntry* const tte = base->table[index].entry;
+
+        for (const TTEntry& e : table[index].entry)
+        {
+            if (!e.is_occupied())
+                continue;
+
+            TTEntry* target = replacement(tte, base->generation8);
+            for (int i = 0; i < ClusterSize; ++i)
+                if (tte[i].key16 == e.key16)
+                {
+                    target = &tte[i];
+                    break;
+                }
+
+            target->save(e.key16, Value(e.value16), bool(e.genBound8 & 0x4),
+                         Bound(e.genBound8 & 0x3), Depth(e.depth8 + DEPTH_ENTRY_OFFSET),
+                         e.move16, Value(e.eval16), uint8_t(e.genBound8 & GENERATION_MASK));
+        }
+    }
+
+    discard();
+}
+
+
+void TranspositionTable::discard() {
+
+    for (size_t index : touched)
+        std::memset(&table[index], 0, sizeof(Cluster));
+
+    touched.clear();
+}
+
+
 TTEntry* TranspositionTable::first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
 }
@@ -21,7 +21,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
 #include <tuple>
+#include <vector>
 
 #include "memory.h"
 #include "types.h"
@@ -71,8 +73,11 @@ class TranspositionTable {
    public:
     ~TranspositionTable() { aligned_large_pages_free(table); }
 
-    void resize(size_t mbSize, ThreadPool& threads);  // Set TT size
+    void resize(size_t mbSize, ThreadPool& threads, bool interleave);  // Set TT size and placement
     void clear(ThreadPool& threads);                  // Re-initialize memory, multithreaded
+    void clear_part(size_t idx, size_t count);        // The share of clear() of one of count threads
+    bool save(const std::string& path) const;         // Dump the table to a file
+    bool load(const std::string& path, ThreadPool& threads);  // Restore a dump, multithreaded
     int  hashfull()
       const;  // Approximate what fraction of entries (permille) have been written to during this root search
 
@@ -84,13 +89,30 @@ class TranspositionTable {
     TTEntry* first_entry(const Key key)
       const;  // This is the hash function; its only external use is memory prefetching.
 
+    // A table attached to a shared one only keeps the writes of a single thread. Probes fall
+    // back to the shared table, which is not written until flush() merges the writes into it.
+    // This is what makes the deterministic multi-threaded search possible.
+    void attach(TranspositionTable* shared = nullptr);  // Without argument, follow a resize
+    void flush();    // Merge the pending writes into the shared table and forget them
+    void discard();  // Forget the pending writes
+
+    // Size of the hugetlb pages of the table, 0 if on transparent or regular ones
+    size_t huge_page_size() const { return Stockfish::huge_page_size(table); }
+
    private:
     friend struct TTEntry;
 
-    size_t   clusterCount;
-    Cluster* table = nullptr;
+    std::tuple<bool, TTData, TTWriter> probe_attached(const Key key) const;
+    static TTEntry*                    replacement(TTEntry* tte, uint8_t generation8);
+
+    size_t   clusterCount = 0;
+    Cluster* table        = nullptr;
+    bool     interleaved  = false;
 
     uint8_t generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
+
+    TranspositionTable*         base = nullptr;  // The shared table, if attached
+    mutable std::vector<size_t> touched;         // Clusters holding pending writes
 };
 
 }  // namespace Stockfish
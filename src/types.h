@@ -80,6 +80,10 @@ using __uint128_t = std::_Unsigned128;
         #include <xmmintrin.h>  // Microsoft header for _mm_prefetch()
     #endif
 
+    #if defined(USE_POPCNT) && defined(USE_NEON) && !defined(_MSC_VER)
+        #include <arm_neon.h>  // Header for vcntq_u8() intrinsic
+    #endif
+
     #if defined(USE_PEXT)
         #include <immintrin.h>  // Header for _pext_u64() intrinsic
         #if defined(_MSC_VER) && !defined(__clang__)
@@ -245,14 +249,16 @@ enum Rank : int {
     RANK_NB
 };
 
-// For fast repetition checks
+// For fast repetition checks. Counts how often each key occurs among the
+// previous positions, up to collisions: a zero count rules out a repetition,
+// the exact counts are taken from the state list when they matter.
 struct BloomFilter {
-    constexpr static uint64_t FILTER_SIZE = 1 << 14;
+    constexpr static uint64_t FILTER_SIZE = 1 << 12;
     uint8_t                   operator[](Key key) const { return table[key & (FILTER_SIZE - 1)]; }
     uint8_t&                  operator[](Key key) { return table[key & (FILTER_SIZE - 1)]; }
 
    private:
-    uint8_t table[1 << 14];
+    uint8_t table[FILTER_SIZE];
 };
 
 // Keep track of what a move changes on the board (used by NNUE)
@@ -273,8 +279,8 @@ struct DirtyPiece {
 };
 
     #define ENABLE_INCR_OPERATORS_ON(T) \
-        inline T& operator++(T& d) { return d = T(int(d) + 1); } \
-        inline T& operator--(T& d) { return d = T(int(d) - 1); }
+        constexpr T& operator++(T& d) { return d = T(int(d) + 1); } \
+        constexpr T& operator--(T& d) { return d = T(int(d) - 1); }
 
 ENABLE_INCR_OPERATORS_ON(PieceType)
 ENABLE_INCR_OPERATORS_ON(Square)
@@ -288,10 +294,10 @@ constexpr Direction operator+(Direction d1, Direction d2) { return Direction(int
 constexpr Direction operator*(int i, Direction d) { return Direction(i * int(d)); }
 
 // Additional operators to add a Direction to a Square
-constexpr Square operator+(Square s, Direction d) { return Square(int(s) + int(d)); }
-constexpr Square operator-(Square s, Direction d) { return Square(int(s) - int(d)); }
-inline Square&   operator+=(Square& s, Direction d) { return s = s + d; }
-inline Square&   operator-=(Square& s, Direction d) { return s = s - d; }
+constexpr Square  operator+(Square s, Direction d) { return Square(int(s) + int(d)); }
+constexpr Square  operator-(Square s, Direction d) { return Square(int(s) - int(d)); }
+constexpr Square& operator+=(Square& s, Direction d) { return s = s + d; }
+constexpr Square& operator-=(Square& s, Direction d) { return s = s - d; }
 
 // Toggle color
 constexpr Color operator~(Color c) { return Color(c ^ BLACK); }
@@ -19,19 +19,36 @@
 #include "uci.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <deque>
+#include <fstream>
 #include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
 #include "benchmark.h"
+#include "binary.h"
+#include "datagen.h"
 #include "engine.h"
 #include "movegen.h"
+#include "perf.h"
 #include "position.h"
 #include "score.h"
 #include "search.h"
+#include "trace.h"
 #include "types.h"
 #include "ucioption.h"
 
@@ -67,11 +84,30 @@ UCIEngine::UCIEngine(int argc, char** argv) :
             print_info_string(*str);
     });
 
-    engine.set_on_iter([](const auto& i) { on_iter(i); });
-    engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves(i); });
-    engine.set_on_update_full(
-      [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
-    engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
+    engine.set_on_verify_network([](std::string_view msg) { print_info_string(std::string(msg)); });
+    engine.set_on_info_string([this](const std::string& msg) {
+        output.post(AsyncOutput::Line, 0, "info string " + msg + '\n');
+    });
+
+    init_search_update_listeners();
+}
+
+// The updates of the search are written by the output thread, so that the main
+// search thread doesn't wait on the GUI reading them.
+void UCIEngine::init_search_update_listeners() {
+    engine.set_on_iter([this](const auto& i) {
+        output.post(AsyncOutput::CurrMove, 0, format_iter(i, "") + '\n');
+    });
+    engine.set_on_update_no_moves([this](const auto& i) {
+        output.post(AsyncOutput::Line, 0, format_update_no_moves(i, "") + '\n');
+    });
+    engine.set_on_update_full([this](const auto& i) {
+        output.post(AsyncOutput::Info, i.multiPV,
+                    format_update_full(i, engine.get_options()["UCI_ShowWDL"], "") + '\n');
+    });
+    engine.set_on_bestmove([this](const auto& bm, const auto& p) {
+        output.post(AsyncOutput::Line, 0, format_bestmove(bm, p, "") + '\n');
+    });
 }
 
 void UCIEngine::loop() {
@@ -101,6 +137,30 @@ void UCIEngine::loop() {
         else if (token == "ponderhit")
             engine.set_ponderhit(false);
 
+        // Print the telemetry counters of the current or last search, as plain text
+        // or as one JSON line with 'stats json'. Does not interrupt the search.
+        else if (token == "stats")
+        {
+            std::string format;
+            is >> format;
+            sync_cout << engine.search_stats(format == "json") << sync_endl;
+        }
+
+        // Write the timeline of the threads to a file in the Chrome trace format,
+        // or drop the events so far with 'trace clear'. Does not interrupt the search.
+        else if (token == "trace")
+        {
+            std::string file;
+            is >> file;
+
+            if (file.empty())
+                print_info_string("Usage: trace <file|clear>");
+            else if (file == "clear")
+                Trace::clear();
+            else
+                print_info_string(Trace::dump(file));
+        }
+
         else if (token == "uci")
         {
             sync_cout << "id name " << engine_info(true) << "\n"
@@ -123,7 +183,10 @@ void UCIEngine::loop() {
         else if (token == "ucinewgame")
             engine.search_clear();
         else if (token == "isready")
+        {
+            engine.wait_for_search_clear();
             sync_cout << "readyok" << sync_endl;
+        }
 
         // Add custom non-UCI commands, mainly for debugging purposes.
         // These commands must not be used during a search!
@@ -131,6 +194,38 @@ void UCIEngine::loop() {
             engine.flip();
         else if (token == "bench")
             bench(is);
+        else if (token == "microbench")
+            microbench(is);
+        else if (token == "scalebench")
+            scalebench(is);
+        else if (token == "server")
+            server();
+        else if (token == "binary")
+        {
+            binary();
+            token = "quit";  // The binary protocol ends the session
+        }
+        else if (token == "tbgen")
+        {
+            while (is >> token)
+                print_info_string(engine.generate_tablebase(token));
+        }
+        else if (token == "cluster")
+        {
+            int         port    = 0;
+            std::string address = "127.0.0.1";
+            if (is >> port && port > 0)
+            {
+                is >> address;  // Loopback unless given
+                engine.serve_cluster(port, address);
+            }
+            else
+                print_info_string("Usage: cluster <port> [address]");
+        }
+        else if (token == "gensfen")
+            gensfen(is);
+        else if (token == "label")
+            label(is);
         else if (token == "d")
             sync_cout << engine.visualize() << sync_endl;
         else if (token == "eval")
@@ -145,6 +240,14 @@ void UCIEngine::loop() {
                 file = f;
             engine.save_network(file);
         }
+        else if (token == "export_mapped_net")
+        {
+            std::string f;
+            if (is >> std::skipws >> f)
+                engine.save_network_mapped(f);
+            else
+                sync_cout << "Usage: export_mapped_net <filename>" << sync_endl;
+        }
         else if (token == "--help" || token == "help" || token == "--license" || token == "license")
             sync_cout
               << "\nPikafish is a powerful xiangqi engine for playing and analyzing."
@@ -218,7 +321,7 @@ void UCIEngine::bench(std::istream& args) {
 
     engine.set_on_update_full([&](const auto& i) {
         nodesSearched = i.nodes;
-        on_update_full(i, options["UCI_ShowWDL"]);
+        on_update_full(i, options["UCI_ShowWDL"], "");
     });
 
     std::vector<std::string> list = Benchmark::setup_bench(engine.fen(), args);
@@ -226,7 +329,8 @@ void UCIEngine::bench(std::istream& args) {
     num = count_if(list.begin(), list.end(),
                    [](const std::string& s) { return s.find("go ") == 0 || s.find("eval") == 0; });
 
-    TimePoint elapsed = now();
+    const Perf::Snapshot perfStart = Perf::total();
+    TimePoint            elapsed   = now();
 
     for (const auto& cmd : list)
     {
@@ -262,6 +366,7 @@ void UCIEngine::bench(std::istream& args) {
         else if (token == "ucinewgame")
         {
             engine.search_clear();  // search_clear may take a while
+            engine.wait_for_search_clear();
             elapsed = now();
         }
     }
@@ -273,26 +378,571 @@ void UCIEngine::bench(std::istream& args) {
     std::cerr << "\n==========================="    //
               << "\nTotal time (ms) : " << elapsed  //
               << "\nNodes searched  : " << nodes    //
-              << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+              << "\nNodes/second    : " << 1000 * nodes / elapsed  //
+              << "\nHistory memory  : " << Search::Worker::history_size() / 1024
+              << " KiB per thread" << std::endl;
+
+    for (const auto& line : Perf::report({Perf::total() - perfStart}))
+        std::cerr << line << std::endl;
 
     // reset callback, to not capture a dangling reference to nodesSearched
-    engine.set_on_update_full([&](const auto& i) { on_update_full(i, options["UCI_ShowWDL"]); });
+    init_search_update_listeners();
 }
 
 
+// The totals of one run_bench_searches()
+struct UCIEngine::BenchRun {
+    uint64_t  nodes       = 0;
+    uint64_t  ttHits      = 0;
+    TimePoint elapsed     = 0;
+    int       reached     = 0;  // Positions where the depth was completed
+    TimePoint timeToDepth = 0;  // Summed over these positions
+};
+
+// Searches the default bench positions for a fixed time each, with the given
+// number of threads and the current hash size. The other search output is
+// dropped, the caller has to restore it with init_search_update_listeners().
+UCIEngine::BenchRun
+UCIEngine::run_bench_searches(size_t threads, const std::string& movetime, int depth) {
+    BenchRun           run;
+    uint64_t           nodesSearched = 0;
+    TimePoint          reachedAt     = -1;
+    std::istringstream benchArgs(std::to_string(int(engine.get_options()["Hash"])) + " "
+                                 + std::to_string(threads) + " " + movetime + " default movetime");
+
+    engine.set_on_update_full([&](const auto& i) {
+        nodesSearched = i.nodes;
+        if (reachedAt < 0 && i.depth >= depth)
+            reachedAt = TimePoint(i.timeMs);
+    });
+    engine.set_on_iter([](const auto&) {});
+    engine.set_on_bestmove([](const auto&, const auto&) {});
+
+    for (const auto& cmd : Benchmark::setup_bench(engine.fen(), benchArgs))
+    {
+        std::istringstream is(cmd);
+        std::string        token;
+        is >> std::skipws >> token;
+
+        if (token == "go")
+        {
+            Search::LimitsType limits = parse_limits(is);
+            TimePoint          start  = now();
+
+            reachedAt = -1;
+            engine.go(limits);
+            engine.wait_for_search_finished();
+
+            run.elapsed += now() - start;
+            run.nodes += nodesSearched;
+            run.ttHits += engine.search_stats_total().ttHits;
+
+            if (reachedAt >= 0)
+            {
+                run.reached++;
+                run.timeToDepth += reachedAt;
+            }
+        }
+        else if (token == "setoption")
+            setoption(is);
+        else if (token == "position")
+            position(is);
+        else if (token == "ucinewgame")
+        {
+            engine.search_clear();
+            engine.wait_for_search_clear();
+        }
+    }
+
+    run.elapsed = std::max(run.elapsed, TimePoint(1));
+    return run;
+}
+
+// Times the hot paths one by one, see Benchmark::run_microbench(), then the
+// whole search on the default bench positions with 1, 2, 4... threads up to
+// the given number. The results are printed as one line of JSON, so that the
+// sections can be tracked separately from one commit to the next:
+//
+//   microbench [max threads] [movetime per position in ms]
+void UCIEngine::microbench(std::istream& args) {
+    size_t      maxThreads = get_hardware_concurrency();
+    std::string movetime   = "100";
+    auto&       options    = engine.get_options();
+
+    if (size_t n; args >> n)
+        maxThreads = std::max(n, size_t(1));
+    args >> movetime;
+
+    const std::string threadsBefore = std::to_string(int(options["Threads"]));
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2) << "{\"engine\":\"" << engine_info()
+       << "\",\"sections\":{";
+
+    auto results = engine.microbench();
+    for (size_t i = 0; i < results.size(); ++i)
+        ss << (i ? "," : "") << "\"" << results[i].name << "\":{\"ops\":" << results[i].ops
+           << ",\"ns_per_op\":" << results[i].nsPerOp << "}";
+
+    ss << "},\"search\":[";
+
+    for (size_t threads = 1;; threads = std::min(2 * threads, maxThreads))
+    {
+        BenchRun run = run_bench_searches(threads, movetime, MAX_PLY);
+
+        ss << (threads > 1 ? "," : "") << "{\"threads\":" << threads << ",\"nodes\":" << run.nodes
+           << ",\"time_ms\":" << run.elapsed << ",\"nps\":" << 1000 * run.nodes / run.elapsed
+           << "}";
+
+        if (threads == maxThreads)
+            break;
+    }
+
+    ss << "]}";
+
+    std::istringstream restore("name Threads value " + threadsBefore);
+    setoption(restore);
+    init_search_update_listeners();
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+// Searches the default bench positions for a fixed time each, for every
+// combination of 1, 2, 4... threads up to the given number and the given
+// NumaPolicy values ("auto" by default). For each one it prints the NPS, also
+// per thread, the TT hit rate (hits per node), the average time to complete
+// the given depth and how many threads were bound to each NUMA node. The
+// results are one line of JSON:
+//
+//   scalebench [max threads] [movetime per position in ms] [depth] [policy...]
+void UCIEngine::scalebench(std::istream& args) {
+    size_t                   maxThreads = get_hardware_concurrency();
+    std::string              movetime   = "1000";
+    int                      depth      = 14;
+    std::vector<std::string> policies;
+    auto&                    options = engine.get_options();
+
+    if (size_t n; args >> n)
+        maxThreads = std::max(n, size_t(1));
+    args >> movetime >> depth;
+
+    for (std::string policy; args >> policy;)
+        policies.push_back(policy);
+
+    if (policies.empty())
+        policies.push_back("auto");
+
+    const std::string threadsBefore = std::to_string(int(options["Threads"]));
+    const std::string policyBefore  = options["NumaPolicy"];
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3) << "{\"engine\":\"" << engine_info()
+       << "\",\"movetime\":" << movetime << ",\"depth\":" << depth << ",\"runs\":[";
+
+    for (size_t p = 0; p < policies.size(); ++p)
+    {
+        std::istringstream setPolicy("name NumaPolicy value " + policies[p]);
+        setoption(setPolicy);
+
+        for (size_t threads = 1;; threads = std::min(2 * threads, maxThreads))
+        {
+            BenchRun run = run_bench_searches(threads, movetime, depth);
+
+            const uint64_t nps = 1000 * run.nodes / run.elapsed;
+
+            ss << (p || threads > 1 ? "," : "") << "{\"numapolicy\":\"" << policies[p]
+               << "\",\"threads\":" << threads << ",\"nodes\":" << run.nodes
+               << ",\"nps\":" << nps << ",\"nps_per_thread\":" << nps / threads
+               << ",\"tt_hit_rate\":" << double(run.ttHits) / std::max(run.nodes, uint64_t(1))
+               << ",\"reached_depth\":" << run.reached << ",\"time_to_depth_ms\":"
+               << (run.reached ? run.timeToDepth / run.reached : -1) << ",\"numa_nodes\":[";
+
+            // Bound threads and available CPUs of each node, empty when not bound
+            size_t n = 0;
+            for (auto&& [current, total] : engine.get_bound_thread_count_by_numa_node())
+                ss << (n++ ? "," : "") << "{\"threads\":" << current << ",\"cpus\":" << total
+                   << "}";
+
+            ss << "]}";
+
+            if (threads == maxThreads)
+                break;
+        }
+    }
+
+    ss << "]}";
+
+    std::istringstream restorePolicy("name NumaPolicy value " + policyBefore);
+    std::istringstream restoreThreads("name Threads value " + threadsBefore);
+    setoption(restorePolicy);
+    setoption(restoreThreads);
+    init_search_update_listeners();
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+
+// Speaks the binary protocol described in binary.h until a Quit message or the
+// end of the input. The search updates are posted to the output thread like in
+// UCI mode, the replies to the client are written directly.
+void UCIEngine::binary() {
+
+    using Binary::MessageType;
+
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    auto reply = [](const std::string& frame) { sync_cout << frame << std::flush << IO_UNLOCK; };
+
+    engine.set_on_iter([this](const auto& i) {
+        output.post(AsyncOutput::CurrMove, 0, Binary::encode_iter(i));
+    });
+    engine.set_on_update_no_moves(
+      [this](const auto& i) { output.post(AsyncOutput::Line, 0, Binary::encode_info(i)); });
+    engine.set_on_update_full([this](const auto& i) {
+        output.post(AsyncOutput::Info, i.multiPV, Binary::encode_info(i));
+    });
+    engine.set_on_bestmove([this](const auto& bm, const auto& p) {
+        output.post(AsyncOutput::Line, 0, Binary::encode_bestmove(bm, p));
+    });
+    engine.get_options().add_info_listener([reply](const std::optional<std::string>& str) {
+        if (str.has_value())
+            reply(Binary::encode_string(MessageType::InfoString, *str));
+    });
+    engine.set_on_verify_network([reply](std::string_view msg) {
+        reply(Binary::encode_string(MessageType::InfoString, msg));
+    });
+    engine.set_on_info_string([this](const std::string& msg) {
+        output.post(AsyncOutput::Line, 0, Binary::encode_string(MessageType::InfoString, msg));
+    });
+
+    MessageType type;
+    std::string body;
+
+    while (Binary::read_frame(std::cin, type, body) && type != MessageType::Quit)
+    {
+        if (type == MessageType::Position)
+        {
+            Binary::PositionData data;
+            if (Binary::decode_position(body, data))
+                engine.set_position(data.board, data.sideToMove, data.rule60, data.gamePly,
+                                    data.moves);
+            else
+                reply(Binary::encode_string(MessageType::InfoString, "malformed position"));
+        }
+        else if (type == MessageType::Go)
+        {
+            Search::LimitsType limits;
+            limits.startTime = now();
+            if (Binary::decode_limits(body, limits))
+                engine.go(limits);
+            else
+                reply(Binary::encode_string(MessageType::InfoString, "malformed go"));
+        }
+        else if (type == MessageType::Stop)
+            engine.stop();
+        else if (type == MessageType::PonderHit)
+            engine.set_ponderhit(false);
+        else if (type == MessageType::IsReady)
+        {
+            engine.wait_for_search_clear();
+            reply(Binary::encode(MessageType::ReadyOk));
+        }
+        else if (type == MessageType::NewGame)
+            engine.search_clear();
+        else if (type == MessageType::SetOption)
+        {
+            std::string name, value;
+            engine.wait_for_search_finished();
+            if (!Binary::decode_option(body, name, value) || !engine.get_options().count(name))
+                reply(Binary::encode_string(MessageType::InfoString, "no such option " + name));
+            else
+                engine.get_options()[name] = value;
+        }
+        else
+            reply(Binary::encode_string(MessageType::InfoString, "unknown message"));
+    }
+
+    engine.stop();
+}
+
 void UCIEngine::setoption(std::istringstream& is) {
     engine.wait_for_search_finished();
     engine.get_options().setoption(is);
 }
 
 std::uint64_t UCIEngine::perft(const Search::LimitsType& limits) {
-    auto nodes = engine.perft(engine.fen(), limits.perft);
+    auto nodes = engine.perft(engine.fen(), limits.perft, [](std::string_view move, uint64_t n) {
+        sync_cout << move << ": " << n << sync_endl;
+    });
     sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
     return nodes;
 }
 
-void UCIEngine::position(std::istringstream& is) {
-    std::string token, fen;
+// Generates training data from self-play games, see Datagen::generate(). The
+// arguments are optional name and value pairs:
+//
+//   gensfen [file <name>] [games <n>] [concurrency <n>] [hash <mb>] [depth <n>]
+//           [nodes <n>] [random <plies>] [maxply <n>] [evallimit <n>]
+void UCIEngine::gensfen(std::istream& args) {
+    Datagen::Params params;
+
+    for (std::string name; args >> name;)
+        if (name == "file")
+            args >> params.file;
+        else if (name == "games")
+            args >> params.games;
+        else if (name == "concurrency")
+            args >> params.concurrency;
+        else if (name == "hash")
+            args >> params.hashMb;
+        else if (name == "depth")
+            args >> params.depth;
+        else if (name == "nodes")
+            args >> params.nodes;
+        else if (name == "random")
+            args >> params.randomPlies;
+        else if (name == "maxply")
+            args >> params.maxPly;
+        else if (name == "evallimit")
+            args >> params.evalLimit;
+
+    engine.verify_network();
+    engine.wait_for_search_finished();
+
+    Datagen::generate(engine, params, print_info_string);
+}
+
+// Labels positions in bulk, see Engine::label(). The input has one FEN per
+// line, '-' reads them from stdin. Without an output file the labels are
+// written to stdout.
+//
+//   label <eval|qsearch> <input file|-> [output file]
+void UCIEngine::label(std::istream& args) {
+    std::string mode, input, outputFile;
+    args >> mode >> input >> outputFile;
+
+    if ((mode != "eval" && mode != "qsearch") || input.empty())
+    {
+        print_info_string("Usage: label <eval|qsearch> <input file|-> [output file]");
+        return;
+    }
+
+    std::ifstream file;
+    std::ofstream out;
+
+    if (input != "-")
+        file.open(input);
+
+    if (!outputFile.empty())
+        out.open(outputFile);
+
+    if ((input != "-" && !file) || (!outputFile.empty() && !out))
+    {
+        print_info_string("Failed to open " + (input != "-" && !file ? input : outputFile));
+        return;
+    }
+
+    const TimePoint start = now();
+    const size_t    count = engine.label(input != "-" ? file : std::cin,
+                                         outputFile.empty() ? std::cout : out, mode == "qsearch");
+    const TimePoint elapsed = std::max(now() - start, TimePoint(1));
+
+    print_info_string("Labeled " + std::to_string(count) + " positions, "
+                      + std::to_string(count * 1000 / size_t(elapsed)) + " positions/s");
+}
+
+// Runs many independent searches in one process, sharing the network. Each
+// line is either a server command:
+//
+//   new <id> [threads] [hash]   creates a session, by default with 1 thread and 16 MB hash
+//   free <id>                   stops and deletes a session
+//   quit                        stops all sessions and leaves the server mode
+//
+// or a session id followed by 'position', 'go' or 'stop', which work as in UCI.
+// A session must wait for its "bestmove" before it gets another command other
+// than 'stop'. The output of a session is prefixed with its id.
+//
+// The Threads option is the total number of search threads run at once. When
+// they are all in use, further searches are queued and started in order as
+// soon as enough of the running ones have finished. A queued search only
+// starts its clock once it starts running.
+void UCIEngine::server() {
+
+    struct Session {
+        std::unique_ptr<SearchSession> search;
+        bool                           busy = false;
+    };
+
+    std::map<std::string, Session>                         sessions;
+    std::deque<std::pair<std::string, Search::LimitsType>> queue;
+    std::mutex                                             mutex;
+
+    const size_t budget  = size_t(int(engine.get_options()["Threads"]));
+    size_t       running = 0;
+
+    // Starts queued searches while there are enough free threads. Must be
+    // called with the mutex held.
+    auto schedule = [&]() {
+        while (!queue.empty())
+        {
+            auto& [id, limits] = queue.front();
+            Session& s         = sessions.at(id);
+            size_t   n         = s.search->num_threads();
+
+            if (running && running + n > budget)
+                break;
+
+            running += n;
+            limits.startTime = now();
+            s.search->go(limits);
+            queue.pop_front();
+        }
+    };
+
+    auto create = [&](const std::string& id, size_t threadCount, size_t hashMb) {
+        const bool        showWDL = engine.get_options()["UCI_ShowWDL"];
+        const std::string prefix  = id + " ";
+
+        Search::SearchManager::UpdateContext ctx;
+        ctx.onUpdateNoMoves = [prefix](const auto& i) { on_update_no_moves(i, prefix); };
+        ctx.onUpdateFull    = [prefix, showWDL](const auto& i) {
+            on_update_full(i, showWDL, prefix);
+        };
+        ctx.onIter     = [prefix](const auto& i) { on_iter(i, prefix); };
+        ctx.onBestmove = [&, id, prefix](std::string_view bm, std::string_view p) {
+            std::lock_guard<std::mutex> lock(mutex);
+            Session&                    s = sessions.at(id);
+
+            on_bestmove(bm, p, prefix);
+            running -= s.search->num_threads();
+            s.busy = false;
+            schedule();
+        };
+
+        return engine.create_session(threadCount, hashMb, std::move(ctx));
+    };
+
+    std::string line;
+
+    engine.verify_network();
+    sync_cout << "info string server ready" << sync_endl;
+
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream is(line);
+        std::string        id, token;
+
+        is >> std::skipws >> id;
+
+        if (id == "quit")
+            break;
+
+        if (id == "new")
+        {
+            size_t threadCount = 1, hashMb = 16;
+            is >> id >> threadCount >> hashMb;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (id.empty() || sessions.count(id))
+                sync_cout << "info string invalid or duplicate session id" << sync_endl;
+            else
+                sessions[id].search = create(id, std::clamp<size_t>(threadCount, 1, 1024),
+                                             std::max<size_t>(hashMb, 1));
+            continue;
+        }
+
+        if (id == "free")
+        {
+            is >> id;
+            std::unique_ptr<SearchSession> search;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto                        it = sessions.find(id);
+                if (it == sessions.end() || it->second.busy)
+                {
+                    sync_cout << "info string unknown or busy session " << id << sync_endl;
+                    continue;
+                }
+                search = std::move(it->second.search);
+                sessions.erase(it);
+            }
+            continue;  // The session is deleted here, without holding the mutex
+        }
+
+        is >> token;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        auto                         it = sessions.find(id);
+
+        if (it == sessions.end())
+        {
+            if (!id.empty() && id[0] != '#')
+                sync_cout << "info string unknown session " << id << sync_endl;
+            continue;
+        }
+
+        Session& s = it->second;
+
+        if (token == "stop")
+        {
+            auto queued = std::find_if(queue.begin(), queue.end(),
+                                       [&](const auto& q) { return q.first == id; });
+            if (queued != queue.end())
+            {
+                // Never started, so report it as finished right away
+                queue.erase(queued);
+                s.busy = false;
+                sync_cout << id << " bestmove (none)" << sync_endl;
+            }
+            else
+                s.search->stop();
+        }
+        else if (s.busy)
+            sync_cout << "info string session " << id << " is searching" << sync_endl;
+
+        else if (token == "position")
+        {
+            std::string              fen;
+            std::vector<std::string> moves;
+            if (parse_position(is, fen, moves))
+                s.search->set_position(fen, moves);
+        }
+        else if (token == "go")
+        {
+            Search::LimitsType limits = parse_limits(is);
+            if (limits.perft)
+                sync_cout << "info string perft is not supported in server mode" << sync_endl;
+            else
+            {
+                s.busy = true;
+                queue.emplace_back(id, limits);
+                schedule();
+            }
+        }
+        else
+            sync_cout << "info string unknown session command " << token << sync_endl;
+    }
+
+    // Stop everything, then wait for the searches without holding the mutex,
+    // as their final callbacks need it.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.clear();
+        for (auto& [id, s] : sessions)
+            s.search->stop();
+    }
+
+    for (auto& [id, s] : sessions)
+        s.search->wait_for_search_finished();
+}
+
+bool UCIEngine::parse_position(std::istream&             is,
+                               std::string&              fen,
+                               std::vector<std::string>& moves) {
+    std::string token;
 
     is >> token;
 
@@ -305,16 +955,22 @@ void UCIEngine::position(std::istringstream& is) {
         while (is >> token && token != "moves")
             fen += token + " ";
     else
-        return;
-
-    std::vector<std::string> moves;
+        return false;
 
     while (is >> token)
     {
         moves.push_back(token);
     }
 
-    engine.set_position(fen, moves);
+    return true;
+}
+
+void UCIEngine::position(std::istringstream& is) {
+    std::string              fen;
+    std::vector<std::string> moves;
+
+    if (parse_position(is, fen, moves))
+        engine.set_position(fen, moves);
 }
 
 namespace {
@@ -324,35 +980,49 @@ struct WinRateParams {
     double b;
 };
 
-WinRateParams win_rate_params(const Position& pos) {
+constexpr int MaxMaterial = 2 * (2 * 10 + 2 * 5 + 2 * 5 + 2 * 3 + 2 * 2 + 5);
+
+WinRateParams win_rate_params(int material) {
 
-    int material = 10 * pos.count<ROOK>() + 5 * pos.count<KNIGHT>() + 5 * pos.count<CANNON>()
-                 + 3 * pos.count<BISHOP>() + 2 * pos.count<ADVISOR>() + pos.count<PAWN>();
+    // The parameters only depend on the material count, so they are computed
+    // once for every count and looked up afterwards.
+    static const auto params = [] {
+        std::array<WinRateParams, MaxMaterial + 1> table{};
 
-    // The fitted model only uses data for material counts in [17, 110], and is anchored at count 65.
-    double m = std::clamp(material, 17, 110) / 65.0;
+        for (int count = 0; count <= MaxMaterial; ++count)
+        {
+            // The fitted model only uses data for material counts in [17, 110], and is anchored at count 65.
+            double m = std::clamp(count, 17, 110) / 65.0;
+
+            // a = p_a(material) and b = p_b(material), see github.com/official-stockfish/WDL_model
+            constexpr double as[] = {220.59891365, -810.35730430, 928.68185198, 79.83955423};
+            constexpr double bs[] = {61.99287416, -233.72674182, 325.85508322, -68.72720854};
 
-    // Return a = p_a(material) and b = p_b(material), see github.com/official-stockfish/WDL_model
-    constexpr double as[] = {220.59891365, -810.35730430, 928.68185198, 79.83955423};
-    constexpr double bs[] = {61.99287416, -233.72674182, 325.85508322, -68.72720854};
+            double a = (((as[0] * m + as[1]) * m + as[2]) * m) + as[3];
+            double b = (((bs[0] * m + bs[1]) * m + bs[2]) * m) + bs[3];
 
-    double a = (((as[0] * m + as[1]) * m + as[2]) * m) + as[3];
-    double b = (((bs[0] * m + bs[1]) * m + bs[2]) * m) + bs[3];
+            table[count] = {a, b};
+        }
+        return table;
+    }();
 
-    return {a, b};
+    return params[std::clamp(material, 0, MaxMaterial)];
 }
 
 // The win rate model is 1 / (1 + exp((a - eval) / b)), where a = p_a(material) and b = p_b(material).
 // It fits the LTC fishtest statistics rather accurately.
-int win_rate_model(Value v, const Position& pos) {
-
-    auto [a, b] = win_rate_params(pos);
+int win_rate_model(Value v, const WinRateParams& p) {
 
     // Return the win rate in per mille units, rounded to the nearest integer.
-    return int(0.5 + 1000 / (1 + std::exp((a - double(v)) / b)));
+    return int(0.5 + 1000 / (1 + std::exp((p.a - double(v)) / p.b)));
 }
 }
 
+int UCIEngine::material(const Position& pos) {
+    return 10 * pos.count<ROOK>() + 5 * pos.count<KNIGHT>() + 5 * pos.count<CANNON>()
+         + 3 * pos.count<BISHOP>() + 2 * pos.count<ADVISOR>() + pos.count<PAWN>();
+}
+
 std::string UCIEngine::format_score(const Score& s) {
     const auto format = overload{[](Score::Mate mate) -> std::string {
                                      auto m = (mate.plies > 0 ? (mate.plies + 1) : mate.plies) / 2;
@@ -367,28 +1037,45 @@ std::string UCIEngine::format_score(const Score& s) {
 
 // Turns a Value to an integer centipawn number,
 // without treatment of mate and similar special scores.
-int UCIEngine::to_cp(Value v, const Position& pos) {
+int UCIEngine::to_cp(Value v, const Position& pos) { return to_cp(v, material(pos)); }
+
+int UCIEngine::to_cp(Value v, int material) {
 
     // In general, the score can be defined via the WDL as
     // (log(1/L - 1) - log(1/W - 1)) / (log(1/L - 1) + log(1/W - 1)).
     // Based on our win_rate_model, this simply yields v / a.
 
-    auto [a, b] = win_rate_params(pos);
+    auto [a, b] = win_rate_params(material);
 
     return std::round(100 * int(v) / a);
 }
 
+void UCIEngine::to_cp(const Value* v, const int* material, int* cp, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        cp[i] = to_cp(v[i], material[i]);
+}
+
 std::string UCIEngine::wdl(Value v, const Position& pos) {
     std::stringstream ss;
 
-    int wdl_w = win_rate_model(v, pos);
-    int wdl_l = win_rate_model(-v, pos);
-    int wdl_d = 1000 - wdl_w - wdl_l;
-    ss << wdl_w << " " << wdl_d << " " << wdl_l;
+    int m = material(pos), wdl[3];
+    UCIEngine::wdl(&v, &m, wdl, 1);
+    ss << wdl[0] << " " << wdl[1] << " " << wdl[2];
 
     return ss.str();
 }
 
+void UCIEngine::wdl(const Value* v, const int* material, int* wdl, size_t n) {
+    for (size_t i = 0; i < n; ++i, wdl += 3)
+    {
+        const auto params = win_rate_params(material[i]);
+
+        wdl[0] = win_rate_model(v[i], params);
+        wdl[2] = win_rate_model(-v[i], params);
+        wdl[1] = 1000 - wdl[0] - wdl[2];
+    }
+}
+
 std::string UCIEngine::square(Square s) {
     return std::string{char('a' + file_of(s)), char('0' + rank_of(s))};
 }
@@ -408,22 +1095,34 @@ std::string UCIEngine::move(Move m) {
     return move;
 }
 
+// Parses the squares of the move and validates it directly, instead of
+// looking it up in the list of all legal moves.
 Move UCIEngine::to_move(const Position& pos, std::string str) {
-    for (const auto& m : MoveList<LEGAL>(pos))
-        if (str == move(m))
-            return m;
+    if (str.length() != 4 || str[0] < 'a' || str[0] > 'i' || str[1] < '0' || str[1] > '9'
+        || str[2] < 'a' || str[2] > 'i' || str[3] < '0' || str[3] > '9')
+        return Move::none();
 
-    return Move::none();
+    Move m(make_square(File(str[0] - 'a'), Rank(str[1] - '0')),
+           make_square(File(str[2] - 'a'), Rank(str[3] - '0')));
+
+    return is_legal(pos, m) ? m : Move::none();
 }
 
-void UCIEngine::on_update_no_moves(const Engine::InfoShort& info) {
-    sync_cout << "info depth " << info.depth << " score " << format_score(info.score) << sync_endl;
+std::string UCIEngine::format_update_no_moves(const Engine::InfoShort& info,
+                                              std::string_view         prefix) {
+    std::stringstream ss;
+
+    ss << prefix << "info depth " << info.depth << " score " << format_score(info.score);
+
+    return ss.str();
 }
 
-void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
+std::string UCIEngine::format_update_full(const Engine::InfoFull& info,
+                                          bool                   showWDL,
+                                          std::string_view       prefix) {
     std::stringstream ss;
 
-    ss << "info";
+    ss << prefix << "info";
     ss << " depth " << info.depth                 //
        << " seldepth " << info.selDepth           //
        << " multipv " << info.multiPV             //
@@ -442,25 +1141,50 @@ void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
        << " time " << info.timeMs        //
        << " pv " << info.pv;             //
 
-    sync_cout << ss.str() << sync_endl;
+    return ss.str();
 }
 
-void UCIEngine::on_iter(const Engine::InfoIter& info) {
+std::string UCIEngine::format_iter(const Engine::InfoIter& info, std::string_view prefix) {
     std::stringstream ss;
 
-    ss << "info";
+    ss << prefix << "info";
     ss << " depth " << info.depth                     //
        << " currmove " << info.currmove               //
        << " currmovenumber " << info.currmovenumber;  //
 
-    sync_cout << ss.str() << sync_endl;
+    return ss.str();
 }
 
-void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder) {
-    sync_cout << "bestmove " << bestmove;
+std::string UCIEngine::format_bestmove(std::string_view bestmove,
+                                       std::string_view ponder,
+                                       std::string_view prefix) {
+    std::stringstream ss;
+
+    ss << prefix << "bestmove " << bestmove;
     if (!ponder.empty())
-        std::cout << " ponder " << ponder;
-    std::cout << sync_endl;
+        ss << " ponder " << ponder;
+
+    return ss.str();
+}
+
+void UCIEngine::on_update_no_moves(const Engine::InfoShort& info, std::string_view prefix) {
+    sync_cout << format_update_no_moves(info, prefix) << sync_endl;
+}
+
+void UCIEngine::on_update_full(const Engine::InfoFull& info,
+                               bool                   showWDL,
+                               std::string_view       prefix) {
+    sync_cout << format_update_full(info, showWDL, prefix) << sync_endl;
+}
+
+void UCIEngine::on_iter(const Engine::InfoIter& info, std::string_view prefix) {
+    sync_cout << format_iter(info, prefix) << sync_endl;
+}
+
+void UCIEngine::on_bestmove(std::string_view bestmove,
+                            std::string_view ponder,
+                            std::string_view prefix) {
+    sync_cout << format_bestmove(bestmove, ponder, prefix) << sync_endl;
 }
 
 }  // namespace Stockfish
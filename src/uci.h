@@ -19,10 +19,12 @@
 #ifndef UCI_H_INCLUDED
 #define UCI_H_INCLUDED
 
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "engine.h"
 #include "misc.h"
@@ -43,10 +45,18 @@ class UCIEngine {
     void loop();
 
     static int         to_cp(Value v, const Position& pos);
+    static int         to_cp(Value v, int material);
+    static std::string wdl(Value v, const Position& pos);
+    static int         material(const Position& pos);  // The material count of the WDL model
+
+    // Convert n scores at once, with the material counts from material().
+    // wdl receives 3 permille values per score.
+    static void to_cp(const Value* v, const int* material, int* cp, size_t n);
+    static void wdl(const Value* v, const int* material, int* wdl, size_t n);
+
     static std::string format_score(const Score& s);
     static std::string square(Square s);
     static std::string move(Move m);
-    static std::string wdl(Value v, const Position& pos);
     static Move        to_move(const Position& pos, std::string str);
 
     static Search::LimitsType parse_limits(std::istream& is);
@@ -54,6 +64,7 @@ class UCIEngine {
     auto& engine_options() { return engine.get_options(); }
 
    private:
+    AsyncOutput output;  // Outlives the engine, which may still post a bestmove
     Engine      engine;
     CommandLine cli;
 
@@ -61,14 +72,36 @@ class UCIEngine {
 
     void          go(std::istringstream& is);
     void          bench(std::istream& args);
+    void          microbench(std::istream& args);
+    void          scalebench(std::istream& args);
+    void          gensfen(std::istream& args);
+    void          label(std::istream& args);
+    void          server();
+    void          binary();
     void          position(std::istringstream& is);
     void          setoption(std::istringstream& is);
     std::uint64_t perft(const Search::LimitsType&);
 
-    static void on_update_no_moves(const Engine::InfoShort& info);
-    static void on_update_full(const Engine::InfoFull& info, bool showWDL);
-    static void on_iter(const Engine::InfoIter& info);
-    static void on_bestmove(std::string_view bestmove, std::string_view ponder);
+    static bool parse_position(std::istream& is, std::string& fen, std::vector<std::string>& moves);
+
+    struct BenchRun;
+    BenchRun run_bench_searches(size_t threads, const std::string& movetime, int depth);
+    void     init_search_update_listeners();
+
+    // The prefix is prepended to each line, it is used by the server mode
+    static std::string format_update_no_moves(const Engine::InfoShort& info,
+                                              std::string_view         prefix);
+    static std::string
+    format_update_full(const Engine::InfoFull& info, bool showWDL, std::string_view prefix);
+    static std::string format_iter(const Engine::InfoIter& info, std::string_view prefix);
+    static std::string
+    format_bestmove(std::string_view bestmove, std::string_view ponder, std::string_view prefix);
+
+    static void on_update_no_moves(const Engine::InfoShort& info, std::string_view prefix);
+    static void on_update_full(const Engine::InfoFull& info, bool showWDL, std::string_view prefix);
+    static void on_iter(const Engine::InfoIter& info, std::string_view prefix);
+    static void
+    on_bestmove(std::string_view bestmove, std::string_view ponder, std::string_view prefix);
 };
 
 }  // namespace Stockfish
@@ -59,6 +59,7 @@ void OptionsMap::setoption(std::istringstream& is) {
 
 Option OptionsMap::operator[](const std::string& name) const {
     auto it = options_map.find(name);
+    assert(it != options_map.end());  // Only the added options can be read
     return it != options_map.end() ? it->second : Option(this);
 }
 
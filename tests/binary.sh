@@ -0,0 +1,177 @@
+#!/bin/bash
+# verify the binary protocol: the same search as in UCI mode, and the rejection
+# of malformed messages and frames (see binary.h for the format)
+
+error()
+{
+  echo "binary protocol testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "binary protocol testing started"
+
+# messages are built as hex strings, little-endian, and only turned into bytes
+# when sent, so that their sizes are easy to get
+le()
+{
+  for ((i = 0; i < $1; i++)); do printf %02x $((($2 >> (8 * i)) & 255)); done
+}
+
+frame()
+{
+  echo -n "$(le 4 $((${#2} / 2 + 1)))$(le 1 $1)$2"
+}
+
+str()
+{
+  echo -n "$(le 2 ${#1})$(echo -n "$1" | od -An -v -tx1 | tr -d ' \n')"
+}
+
+move()
+{
+  local from=$(( (${1:1:1} * 9 + $(printf %d "'${1:0:1}") - 97) ))
+  local to=$(( (${1:3:1} * 9 + $(printf %d "'${1:2:1}") - 97) ))
+  le 2 $((from * 128 + to))
+}
+
+# the 45 bytes of the board of a FEN
+board()
+{
+  local pieces=" RACPNBK racpnbk" fen=$1 r=9 f=0 c p squares=()
+  for ((s = 0; s < 90; s++)); do squares[s]=0; done
+  for ((i = 0; i < ${#fen}; i++)); do
+    c=${fen:i:1}
+    case $c in
+      /) r=$((r - 1)); f=0 ;;
+      [1-9]) f=$((f + c)) ;;
+      *) p=${pieces%%"$c"*}; squares[r * 9 + f]=${#p}; f=$((f + 1)) ;;
+    esac
+  done
+  for ((s = 0; s < 90; s += 2)); do le 1 $((squares[s] | squares[s + 1] << 4)); done
+}
+
+# position <board of a FEN> <side to move> <rule60> [moves...]
+position()
+{
+  local body="$(le 1 $2)$(le 2 $3)$(le 2 0)$(board "$1")$(le 2 $(($# - 3)))"
+  for m in "${@:4}"; do body+=$(move $m); done
+  frame 1 "$body"
+}
+
+go_depth()
+{
+  frame 2 "$(le 8 0)$(le 8 0)$(le 8 0)$(le 8 0)$(le 8 0)$(le 4 0)$(le 4 $1)$(le 4 0)$(le 8 0)$(le 1 0)$(le 2 0)"
+}
+
+setoption()
+{
+  frame 7 "$(str "$1")$(str "$2")"
+}
+
+send()
+{
+  printf "$(echo -n "$1" | sed 's/../\\x&/g')"
+}
+
+# the replies in UCI like text, with scores in internal units
+decode()
+{
+  local hex=$(od -An -v -tx1 | tr -d ' \n') size type body
+  hex=${hex#*0a}  # the text line of the engine name
+
+  uci_move()
+  {
+    local m=$((16#${1:2:2}${1:0:2}))
+    if [ $m -eq 0 ]; then
+      echo -n "(none)"
+    else
+      printf "\\x$(printf %x $((97 + (m >> 7) % 9)))$(((m >> 7) / 9))"
+      printf "\\x$(printf %x $((97 + (m & 127) % 9)))$(((m & 127) / 9))"
+    fi
+  }
+
+  while [ ${#hex} -ge 10 ]; do
+    size=$((16#${hex:6:2}${hex:4:2}${hex:2:2}${hex:0:2}))
+    type=${hex:8:2}
+    body=${hex:10:2 * size - 2}
+    hex=${hex:8 + 2 * size}
+    case $type in
+      81) echo "readyok" ;;
+      82) echo -n "info depth $((16#${body:6:2}${body:4:2}${body:2:2}${body:0:2}))"
+          echo -n " nodes $((16#${body:62:2}${body:60:2}${body:58:2}${body:56:2}${body:54:2}${body:52:2}${body:50:2}${body:48:2}))"
+          echo -n " pv"
+          for ((i = 124; i < ${#body}; i += 4)); do echo -n " $(uci_move ${body:i:4})"; done
+          echo ;;
+      85) echo "bestmove $(uci_move ${body:0:4}) ponder $(uci_move ${body:4:4})" ;;
+      86) echo "info string $(printf "$(echo -n ${body:4} | sed 's/../\\x&/g')")" ;;
+    esac
+  done
+}
+
+startpos="rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR"
+
+# the same search gives the same last info line and best move as in UCI mode,
+# setoption waits for the search to finish
+cat << EOF | ./pikafish | awk '/^bestmove/ {print last; print} {last = $0}' \
+  | sed 's/ seldepth .* nodes / nodes /; s/ nps .* pv / pv /' > uci.out
+position startpos moves h2e2 h9g7
+go depth 8
+setoption name Hash value 16
+quit
+EOF
+
+{ echo binary
+  send "$(position "$startpos" 0 0 h2e2 h9g7)$(go_depth 8)$(setoption Hash 16)$(frame 8)"
+} | ./pikafish | decode | awk '/^bestmove/ {print last; print} {last = $0}' > binary.out
+
+diff uci.out binary.out
+grep -q "^bestmove [a-i][0-9][a-i][0-9] ponder [a-i][0-9][a-i][0-9]$" binary.out
+
+# malformed messages are answered with an info string, and the session goes on
+valid=$(position "$startpos" 0 0 h2e2)
+{ echo binary
+  send "$(position "$startpos" 0 121)"                                 # rule 60 counter
+  send "$(position "$startpos" 2 0)"                                   # side to move
+  send "$(frame 1 "${valid:10:${#valid} - 12}")"                       # truncated
+  send "$(frame 1 "$(echo -n ${valid:10})00")"                         # trailing byte
+  send "$(frame 1 "$(echo -n ${valid:10:${#valid} - 14})$(le 2 90)")"  # move off the board
+  send "$(position "4k4/9/9/9/9/9/9/9/RRR6/3K5" 0 0)"                  # too many rooks
+  send "$(position "4k4/9/9/9/9/9/9/9/B8/3K5" 0 0)"                    # bishop off its squares
+  send "$(position "4k4/9/9/9/9/9/9/9/9/4K4" 0 0)"                     # facing kings
+  send "$(position "4k4/9/9/9/9/9/9/9/4R4/3K5" 0 0)"                   # side not to move in check
+  send "$(position "4k4/9/9/9/9/9/9/9/4R4/3K5" 1 0)"                   # valid
+  send "$(frame 2 "$(le 8 0)")"                                        # truncated go
+  send "$(setoption NoSuchOption 1)"
+  send "$(frame 7 "$(str Hash)$(le 2 4)")"                             # truncated value
+  send "$(frame 66)"                                                   # unknown message
+  send "$(frame 5)$(frame 8)"
+} | ./pikafish | decode > binary.out
+
+cat << EOF | diff - binary.out
+info string malformed position
+info string malformed position
+info string malformed position
+info string malformed position
+info string malformed position
+info string malformed position
+info string malformed position
+info string malformed position
+info string malformed position
+info string malformed go
+info string no such option NoSuchOption
+info string no such option Hash
+info string unknown message
+readyok
+EOF
+
+# a malformed frame ends the session, before the isready which follows it
+for bad in "$(le 4 0)" "$(le 4 $(((1 << 20) + 1)))05" "$(le 4 100)0500"
+do
+  { echo binary; send "$(frame 5)${bad}$(frame 5)"; } | ./pikafish | decode > binary.out
+  echo "readyok" | diff - binary.out
+done
+
+rm -f uci.out binary.out
+
+echo "binary protocol testing OK"
@@ -0,0 +1,87 @@
+#!/bin/bash
+# verify that searches learned into a book are played from it, and that bad
+# book files and entries are not used
+
+error()
+{
+  echo "book testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "book testing started"
+
+rm -f book.bin
+
+# the book info strings and the best moves of two searches, the second one with
+# the given limits. setoption waits for the search to finish.
+run()
+{
+  cat << EOF | ./pikafish | grep "book\|Book\|bestmove" | sed 's/ ponder .*//'
+setoption name BookFile value $1
+setoption name BookLearn value $2
+position startpos moves h2e2
+go depth 6
+setoption name Hash value 16
+position startpos moves h2e2
+go depth 6 $3
+setoption name Hash value 16
+quit
+EOF
+}
+
+# the first search is learned, and played from the book in the next run
+run book.bin true > book.out
+
+move=$(grep -m 1 "^bestmove" book.out | cut -d " " -f 2)
+
+run book.bin false "searchmoves h9g7" >> book.out
+
+cat << EOF | diff - book.out
+info string Failed to load book book.bin
+bestmove $move
+info string book hit $move weight 1
+bestmove $move
+info string Book book.bin has 1 entries
+info string book hit $move weight 1
+bestmove $move
+info string book miss
+bestmove h9g7
+EOF
+
+# entries are 16 bytes: key, move, weight, value and depth. The moves a0a5,
+# which is illegal, and one off the board get a higher weight than the learned
+# move, so that they would be played if they were not checked.
+key=$(head -c 8 book.bin | od -An -v -tx1 | tr -d ' \n' | sed 's/../\\x&/g')
+entry()
+{
+  printf "$key$1\\x00\\x00\\x00\\x00"
+}
+
+{ entry '\x2d\x00\xc8\x00'; entry '\xff\xff\xc8\x00'; } > bad.bin
+{ printf '\xff\xff\xff\xff\xff\xff\xff\xff\x2d\x00\x01\x00\x00\x00\x00\x00'; cat bad.bin book.bin; } > unsorted.bin
+{ cat book.bin; printf '\x00'; } > truncated.bin
+
+run bad.bin false "searchmoves h9g7" > book.out
+run unsorted.bin false "searchmoves h9g7" >> book.out
+run truncated.bin false "searchmoves h9g7" >> book.out
+
+cat << EOF | diff - book.out
+info string Book bad.bin has 2 entries
+info string book miss
+bestmove $move
+info string book miss
+bestmove h9g7
+info string Book unsorted.bin has 4 entries
+info string book hit $move weight 1
+bestmove $move
+info string book miss
+bestmove h9g7
+info string Failed to load book truncated.bin
+bestmove $move
+bestmove h9g7
+EOF
+
+rm -f book.bin bad.bin unsorted.bin truncated.bin book.out
+
+echo "book testing OK"
@@ -0,0 +1,110 @@
+#!/bin/bash
+# verify that a cluster host only accepts a coordinator with the secret, and
+# only valid positions from it
+
+error()
+{
+  echo "cluster testing failed on line $1"
+  kill $helper 2> /dev/null
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "cluster testing started"
+
+port=$((20000 + RANDOM % 20000))
+
+# without a secret, neither side of the cluster starts
+printf "cluster $port\nsetoption name ClusterHosts value 127.0.0.1:$port\nquit\n" | ./pikafish \
+  | grep -c "ClusterSecret must be set first" | grep -q 2
+
+# the host runs in the background, reading its commands from a pipe
+rm -f helper.in
+mkfifo helper.in
+./pikafish < helper.in > helper.log &
+helper=$!
+exec 4> helper.in
+echo "setoption name ClusterSecret value s3cret" >&4
+echo "cluster $port" >&4
+sleep 1
+
+# a message is a uint32 type and a uint32 size, little-endian, then the payload.
+# The types are 0 Position, 1 Go, 2 Stop, 3 Entries and 4 Hello.
+message()
+{
+  printf "\\x$(printf %02x $1)\\x00\\x00\\x00"
+  printf "\\x$(printf %02x $(($2 % 256)))\\x$(printf %02x $(($2 / 256)))\\x00\\x00"
+}
+
+# sends the messages written by the given commands over one connection
+connect()
+{
+  exec 3<> /dev/tcp/127.0.0.1/$port
+  eval "$1" >&3
+  sleep 0.5
+  exec 3>&-
+  sleep 0.5
+}
+
+position()
+{
+  message 0 $((${#1} + 1))
+  printf "%s\n" "$1"
+}
+
+# a wrong secret, a missing one, and a hello which is too long
+connect 'message 4 5; printf wrong'
+connect 'position "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1"'
+connect 'message 4 2000; head -c 2000 /dev/zero'
+
+# with the secret, positions which are not well formed or not valid are refused
+connect 'message 4 6; printf s3cret
+         position "rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1"
+         position "4k4/9/9/9/9/9/9/9/9/4K4 w - - 0 1"
+         position "4k4/9/9/9/9/9/9/9/4R4/3K5 w - - 0 1"
+         position "4k4/9/9/9/9/9/9/9/4R4/3K5 b - - 0 1"
+         position "4k4/9/9/9/9/9/9/9/9/4K4/9 w - - 0 1"
+         position "4k4/9/9/9/9/9/9/9/9/3K5 w - - 121 1"
+         position "4k4/9/9/9/9/9/9/9/RRR6/3K5 w - - 0 1"'
+
+# a coordinator with the secret gets its bestmove, one with another is rejected
+cat << EOF | ./pikafish | grep -q "^bestmove"
+setoption name ClusterSecret value s3cret
+setoption name ClusterHosts value 127.0.0.1:$port
+position startpos moves h2e2
+go depth 8
+setoption name ClusterHosts value
+quit
+EOF
+sleep 0.5
+
+printf "setoption name ClusterSecret value other\nsetoption name ClusterHosts value 127.0.0.1:$port\nquit\n" \
+  | ./pikafish > /dev/null
+sleep 0.5
+
+exec 4>&-
+kill $helper
+wait $helper || true
+
+cat << EOF > helper.exp
+info string Waiting for a coordinator on 127.0.0.1 port $port
+info string Rejected a connection without the secret
+info string Rejected a connection without the secret
+info string Rejected a connection without the secret
+info string Coordinator connected
+info string Invalid position from the coordinator: 4k4/9/9/9/9/9/9/9/9/4K4 w - - 0 1
+info string Invalid position from the coordinator: 4k4/9/9/9/9/9/9/9/4R4/3K5 w - - 0 1
+info string Invalid position from the coordinator: 4k4/9/9/9/9/9/9/9/9/4K4/9 w - - 0 1
+info string Invalid position from the coordinator: 4k4/9/9/9/9/9/9/9/9/3K5 w - - 121 1
+info string Invalid position from the coordinator: 4k4/9/9/9/9/9/9/9/RRR6/3K5 w - - 0 1
+info string Coordinator disconnected
+info string Coordinator connected
+info string Coordinator disconnected
+info string Rejected a connection without the secret
+EOF
+
+grep "^info string" helper.log | grep -v "NNUE evaluation" | diff helper.exp -
+
+rm -f helper.in helper.log helper.exp
+
+echo "cluster testing OK"
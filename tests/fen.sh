@@ -0,0 +1,56 @@
+#!/bin/bash
+# verify that FENs are written as they were read, that a position set from the
+# FEN of a game gives the same key and checkers, and how incomplete FENs are read
+
+error()
+{
+  echo "fen testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "fen testing started"
+
+# the FEN, key and checkers of each position
+show()
+{
+  for pos in "$@"; do printf "position $pos\nd\n"; done \
+    | ./pikafish | grep "^Fen:\|^Key:\|^Checkers:"
+}
+
+fens=("rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1"
+      "r1bakabr1/9/1cn3nc1/p1p1p1p1p/9/9/P1P1P1P1P/1CN1C1N2/9/R1BAKAB1R b - - 3 12"
+      "3k5/9/9/9/9/9/9/4N4/9/4K4 w - - 117 300"
+      "4k4/9/9/9/9/9/9/9/4R4/3K5 b - - 0 1"
+      "2bak4/4a4/4b4/9/2n6/6C2/9/9/4A4/4KA3 w - - 58 201")
+
+show "${fens[@]/#/fen }" | grep "^Fen:" | cut -d " " -f 2- > fen.out
+printf "%s\n" "${fens[@]}" | diff - fen.out
+
+# a position set from the FEN of a game, in check or not
+for moves in "h2e2 h9g7 h0g2 i9h9" "h2e2 h7e7 e2e6"
+do
+  show "startpos moves $moves" > game.out
+  fen=$(grep "^Fen:" game.out | cut -d " " -f 2-)
+  show "fen $fen" | diff game.out -
+done
+
+# a missing side to move means black, missing counters are 0 and 1, and a
+# counter which is not a number ends the parsing
+show "fen 3k5/9/9/9/9/9/9/4N4/9/4K4" \
+     "fen 3k5/9/9/9/9/9/9/4N4/9/4K4 w" \
+     "fen 3k5/9/9/9/9/9/9/4N4/9/4K4 w - - 5" \
+     "fen 3k5/9/9/9/9/9/9/4N4/9/4K4 w - - x 7" \
+     "fen 3k5/9/9/9/9/9/9/4N4/9/4K4 w - - 5 x" | grep "^Fen:" > fen.out
+
+cat << EOF | diff - fen.out
+Fen: 3k5/9/9/9/9/9/9/4N4/9/4K4 b - - 0 1
+Fen: 3k5/9/9/9/9/9/9/4N4/9/4K4 w - - 0 1
+Fen: 3k5/9/9/9/9/9/9/4N4/9/4K4 w - - 5 1
+Fen: 3k5/9/9/9/9/9/9/4N4/9/4K4 w - - 0 1
+Fen: 3k5/9/9/9/9/9/9/4N4/9/4K4 w - - 5 1
+EOF
+
+rm -f fen.out game.out
+
+echo "fen testing OK"
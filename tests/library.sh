@@ -0,0 +1,130 @@
+#!/bin/bash
+# verify the C API of the library, built before with 'make library'
+
+error()
+{
+  echo "library testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "library testing started"
+
+cat << EOF > library_test.c
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pikafish.h"
+
+static void on_info(void* user, const pikafish_info* info) {
+    snprintf((char*) user, 1024, "info depth %d nodes %llu pv %s", info->depth,
+             (unsigned long long) info->nodes, info->pv);
+}
+
+static void on_bestmove(void* user, const char* bestmove, const char* ponder) {
+    printf("%s\nbestmove %s ponder %s\n", (const char*) user, bestmove, ponder);
+}
+
+static void on_message(void* user, const char* message) { ++*(int*) user; }
+
+static void on_perft(void* user, const char* move, uint64_t nodes) {
+    ((uint64_t*) user)[0]++;
+    ((uint64_t*) user)[1] += nodes;
+}
+
+int main(int argc, char* argv[]) {
+    pikafish_engine* e = pikafish_create(NULL);
+    char             info[1024] = "", fen[128];
+    uint64_t         counts[2]  = {0, 0};
+    int              cp, errors = 0;
+
+    const char* moves[]   = {"h2e2", "h9g7"};
+    const char* illegal[] = {"h2e2", "a0a5", "h9g7"};
+
+    pikafish_set_on_update_full(e, on_info, info);
+    pikafish_set_on_bestmove(e, on_bestmove, info);
+    pikafish_set_on_verify_network(e, on_message, &errors);
+
+    printf("option %d %d\n", pikafish_set_option(e, "Threads", "1"),
+           pikafish_set_option(e, "NoSuchOption", "1"));
+
+    /* The FEN of a position is the one it was set from */
+    pikafish_set_position(e, NULL, moves, 2);
+    pikafish_fen(e, fen, sizeof(fen));
+    pikafish_set_position(e, fen, NULL, 0);
+    printf("fen %s\n", fen);
+    pikafish_fen(e, fen, sizeof(fen));
+    printf("fen %s\n", fen);
+
+    /* Playing stops at an illegal move, a short buffer is not written */
+    pikafish_set_position(e, NULL, illegal, 3);
+    strcpy(fen, "unchanged");
+    printf("fen %d %s\n", (int) pikafish_fen(e, fen, 10), fen);
+    pikafish_fen(e, fen, sizeof(fen));
+    printf("fen %s\n", fen);
+
+    printf("perft %llu", (unsigned long long) pikafish_perft(e, NULL, 3, on_perft, counts));
+    printf(" %llu %llu\n", (unsigned long long) counts[0], (unsigned long long) counts[1]);
+
+    pikafish_set_position(e, "4k4/9/9/9/9/9/9/9/4R4/3K5 b", NULL, 0);
+    printf("evaluate %d", pikafish_evaluate(e, &cp));
+    pikafish_set_position(e, NULL, NULL, 0);
+    printf(" %d\n", pikafish_evaluate(e, &cp));
+
+    pikafish_limits limits = {0};
+    limits.depth           = 8;
+    pikafish_set_position(e, NULL, moves, 2);
+    int result = pikafish_go(e, &limits);
+    pikafish_wait(e);
+    printf("go %d\n", result);
+    pikafish_destroy(e);
+
+    /* Without a network everything which needs it fails */
+    if (chdir(argv[1]))
+        return 1;
+
+    e      = pikafish_create(NULL);
+    errors = 0;
+    pikafish_set_on_verify_network(e, on_message, &errors);
+    printf("go %d", pikafish_go(e, &limits));
+    printf(" evaluate %d", pikafish_evaluate(e, &cp));
+    printf(" perft %llu", (unsigned long long) pikafish_perft(e, NULL, 1, NULL, NULL));
+    printf(" %s\n", errors ? "reported" : "not reported");
+
+    pikafish_destroy(e);
+    return 0;
+}
+EOF
+
+${CC:-cc} -c -I. library_test.c -o library_test.o
+${CXX:-c++} library_test.o libpikafish.a -o library_test -lpthread
+mkdir -p library_empty
+./library_test library_empty > library.out
+
+# the search gives the same last info line and best move as in UCI mode,
+# setoption waits for the search to finish
+cat << EOF | ./pikafish | awk '/^bestmove/ {print last; print} {last = $0}' \
+  | sed 's/ seldepth .* nodes / nodes /; s/ nps .* pv / pv /' > uci.out
+position startpos moves h2e2 h9g7
+go depth 8
+setoption name Hash value 16
+quit
+EOF
+
+cat << EOF | diff - library.out
+option 0 -1
+fen rnbakab1r/9/1c4nc1/p1p1p1p1p/9/9/P1P1P1P1P/1C2C4/9/RNBAKABNR w - - 2 2
+fen rnbakab1r/9/1c4nc1/p1p1p1p1p/9/9/P1P1P1P1P/1C2C4/9/RNBAKABNR w - - 2 2
+fen 69 unchanged
+fen rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C2C4/9/RNBAKABNR b - - 1 1
+perft 79666 44 79666
+evaluate -1 0
+$(cat uci.out)
+go 0
+go -1 evaluate -2 perft 0 reported
+EOF
+
+rm -rf library_test.c library_test.o library_test library_empty library.out uci.out
+
+echo "library testing OK"
@@ -1,5 +1,6 @@
 #!/bin/bash
-# verify perft numbers (positions from www.chessprogramming.org/Perft_Results)
+# verify perft numbers, without and with the perft hash. The start position
+# numbers are the known ones, the others were computed without the perft hash.
 
 error()
 {
@@ -10,23 +11,20 @@ trap 'error ${LINENO}' ERR
 
 echo "perft testing started"
 
-cat << EOF > perft.exp
-   set timeout 10
-   lassign \$argv pos depth result
-   spawn ./stockfish
-   send "position \$pos\\ngo perft \$depth\\n"
-   expect "Nodes searched? \$result" {} timeout {exit 1}
-   send "quit\\n"
-   expect eof
-EOF
-
-expect perft.exp startpos 5 4865609 > /dev/null
-expect perft.exp "fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -" 5 193690690 > /dev/null
-expect perft.exp "fen 8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -" 6 11030083 > /dev/null
-expect perft.exp "fen r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1" 5 15833292 > /dev/null
-expect perft.exp "fen rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8" 5 89941194 > /dev/null
-expect perft.exp "fen r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10" 5 164075551 > /dev/null
+# perft <position> <depth> <result>
+perft()
+{
+  for options in "PerftHash value 0" "PerftHash value 16" "Threads value 2"
+  do
+    printf "setoption name $options\nposition $1\ngo perft $2\nquit\n" | ./pikafish \
+      | grep -q "^Nodes searched: $3$" || return 1
+  done
+}
 
-rm perft.exp
+perft startpos 4 3290240
+perft startpos 5 133312995
+perft "fen r1bakabr1/9/1cn3nc1/p1p1p1p1p/9/9/P1P1P1P1P/1CN1C1N2/9/R1BAKAB1R b - - 3 12" 5 58153300
+perft "fen rnbakabnr/9/1c2c4/p1p1C1p1p/9/9/P1P1P1P1P/1C7/9/RNBAKABNR b - - 0 2" 5 15013720
+perft "fen 2bak4/4a4/4b4/9/2n6/6C2/9/9/4A4/4KA3 w - - 58 201" 5 1351755
 
 echo "perft testing OK"
@@ -15,7 +15,7 @@ echo "reprosearch testing started"
 # the same node count for each iteration.
 cat << EOF > repeat.exp
  set timeout 10
- spawn ./stockfish
+ spawn ./pikafish
  lassign \$argv nodes
 
  send "uci\n"
@@ -26,7 +26,7 @@ cat << EOF > repeat.exp
  send "go nodes \$nodes\n"
  expect "bestmove"
 
- send "position startpos moves e2e4 e7e6\n"
+ send "position startpos moves h2e2 h9g7\n"
  send "go nodes \$nodes\n"
  expect "bestmove"
 
@@ -35,7 +35,7 @@ cat << EOF > repeat.exp
  send "go nodes \$nodes\n"
  expect "bestmove"
 
- send "position startpos moves e2e4 e7e6\n"
+ send "position startpos moves h2e2 h9g7\n"
  send "go nodes \$nodes\n"
  expect "bestmove"
 
@@ -58,4 +58,54 @@ done
 
 rm repeat.exp
 
+# in the deterministic mode, several threads give the same final info line and
+# best move on every run, for a node limit as for a depth limit. The info lines
+# sent during the search depend on when they are sent, so they are left out.
+cat << EOF > deterministic.exp
+ set timeout 30
+ spawn ./pikafish
+ lassign \$argv nodes
+
+ send "uci\n"
+ expect "uciok"
+
+ send "setoption name Threads value 4\n"
+ send "setoption name Deterministic value true\n"
+
+ send "ucinewgame\n"
+ send "position startpos\n"
+ send "go nodes \$nodes\n"
+ expect "bestmove"
+
+ send "position startpos moves h2e2 h9g7\n"
+ send "go depth 8\n"
+ expect "bestmove"
+
+ send "ucinewgame\n"
+ send "position startpos\n"
+ send "go nodes \$nodes\n"
+ expect "bestmove"
+
+ send "position startpos moves h2e2 h9g7\n"
+ send "go depth 8\n"
+ expect "bestmove"
+
+ send "quit\n"
+ expect eof
+EOF
+
+for nodes in 10000 100000
+do
+
+  echo "reprosearch testing deterministic mode with $nodes nodes"
+
+  # the last info line before each best move, without its timings, and the
+  # best move should appear exactly an even number of times
+  expect deterministic.exp $nodes 2>&1 | awk '/^bestmove/ {print last; print} {last = $0}' \
+    | sed 's/ nps [0-9]*\| time [0-9]*\| hashfull [0-9]*//g' | sort | uniq -c | awk '{if ($1%2!=0) exit(1)}'
+
+done
+
+rm deterministic.exp
+
 echo "reprosearch testing OK"
@@ -0,0 +1,100 @@
+#!/bin/bash
+# verify that generated tablebases are found, give consistent mates along their
+# own lines for both colors, and that damaged tables are not used
+
+error()
+{
+  echo "tablebase testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "tablebase testing started"
+
+rm -rf tables
+mkdir tables
+
+cat << EOF | ./pikafish | grep "info string" > tablebase.out
+setoption name TablebasePath value tables
+tbgen KNvK KRvKA
+tbgen KNvK
+tbgen KQvK KRvKAB
+quit
+EOF
+
+cat << EOF | diff - tablebase.out
+info string Found 0 tablebases
+info string KvK: 0 wins and 0 losses in 162 positions, longest mate 0 plies, written to tables/KvK.ptb
+info string KNvK: 4590 wins and 4806 losses in 14580 positions, longest mate 14 plies, written to tables/KNvK.ptb
+info string KvKA: 0 wins and 0 losses in 810 positions, longest mate 0 plies, written to tables/KvKA.ptb
+info string KRvK: 3834 wins and 4806 losses in 14580 positions, longest mate 4 plies, written to tables/KRvK.ptb
+info string KRvKA: 18507 wins and 22074 losses in 72900 positions, longest mate 10 plies, written to tables/KRvKA.ptb
+info string Table KNvK is already available
+info string Invalid material KQvK, the format is like KRvKA, with at most 4 pieces
+info string Invalid material KRvKAB, the format is like KRvKA, with at most 4 pieces
+EOF
+
+# the score, tbhits and best move of a short search. setoption waits for the
+# search to finish.
+search()
+{
+  cat << EOF | ./pikafish | grep "^info depth\|^bestmove" | tail -2 \
+    | grep -o "score [a-z]* -*[0-9]*\|tbhits [0-9]*\|bestmove [^ ]*" | paste -sd " " -
+setoption name TablebasePath value $1
+setoption name TablebaseProbeLimit value $2
+position fen $3 - - 0 1 moves $4
+go depth 4
+setoption name Hash value 16
+quit
+EOF
+}
+
+# plays the best moves from a position while it is won, the mates must count
+# down to a position where the side to move has no legal move, also without
+# the tables
+follow()
+{
+  local moves="" out
+  for ((i = 0; i < 20; i++))
+  do
+    out=$(search tables 4 "$1" "$moves")
+    echo "$out" | sed 's/ tbhits [0-9]*//'
+    [[ $out == *"bestmove (none)"* ]] && break
+    moves="$moves ${out##* }"
+  done
+  search "" 4 "$1" "$moves"
+}
+
+follow "3k5/9/9/9/9/9/9/4N4/9/4K4 w" > tablebase.out
+follow "4k4/9/4n4/9/9/9/9/9/9/3K5 b" >> tablebase.out
+
+cat << EOF > tablebase.exp
+score mate 3 bestmove e2d4
+score mate -2 bestmove d9d8
+score mate 2 bestmove d4c6
+score mate -1 bestmove d8d7
+score mate 1 bestmove e0e1
+score mate 0 bestmove (none)
+score mate 0 bestmove (none)
+EOF
+flipped=$(sed 's/e2d4/e7d5/; s/d9d8/d0d1/; s/d4c6/d5c3/; s/d8d7/d1d2/; s/e0e1/e9e8/' tablebase.exp)
+echo "$flipped" >> tablebase.exp
+
+diff tablebase.exp tablebase.out
+
+# probes are reported, but not without the tables, beyond the probe limit or
+# from a damaged table
+search tables 4 "3k5/9/9/9/9/9/9/4N4/9/4K4 w" | grep -q "tbhits [1-9]"
+search tables 2 "3k5/9/9/9/9/9/9/4N4/9/4K4 w" | grep -q "tbhits 0 "
+search "" 4 "3k5/9/9/9/9/9/9/4N4/9/4K4 w" | grep -q "tbhits 0 "
+
+head -c 100 tables/KNvK.ptb > damaged.ptb
+mv damaged.ptb tables/KNvK.ptb
+printf "XXXX" | dd of=tables/KRvK.ptb conv=notrunc 2> /dev/null
+
+printf "setoption name TablebasePath value tables\nquit\n" | ./pikafish | grep -q "Found 3 tablebases"
+search tables 4 "3k5/9/9/9/9/9/9/4N4/9/4K4 w" | grep -q "tbhits 0 "
+
+rm -rf tables tablebase.out tablebase.exp
+
+echo "tablebase testing OK"